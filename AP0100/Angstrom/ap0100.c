@@ -22,6 +22,7 @@
 #include <linux/videodev2.h>
 
 #include <media/ap0100.h>
+#include <media/aptina-i2c.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-subdev.h>
@@ -89,6 +90,7 @@ struct ap0100_priv {
 	struct ap0100_platform_data *pdata;
 	struct mutex power_lock; /* lock to protect power_count */
 	int power_count;
+	struct aptina_i2c_stats i2c_stats;
 };
 
 /************************************************************************
@@ -137,7 +139,8 @@ static int ap0100_read(struct i2c_client *client, u16 addr)
 	* it means error.
 	* else, under 16bit is valid data.
 	*/
-	ret = i2c_transfer(client->adapter, msg, 2);
+	ret = aptina_i2c_transfer(&to_ap0100(client)->i2c_stats, client,
+				  msg, 2);
 
 	if (ret < 0) {
 		v4l_err(client, "Read from offset 0x%x error %d", addr, ret);
@@ -178,7 +181,8 @@ static int ap0100_read_8(struct i2c_client *client, u16 addr)
 	* it means error.
 	* else, under 16bit is valid data.
 	*/
-	ret = i2c_transfer(client->adapter, msg, 2);
+	ret = aptina_i2c_transfer(&to_ap0100(client)->i2c_stats, client,
+				  msg, 2);
 
 	if (ret < 0) {
 		v4l_err(client, "Read from offset 0x%x error %d", addr, ret);
@@ -217,7 +221,8 @@ static int ap0100_write(struct i2c_client *client, u16 addr,
 	msg.buf   = buf;
 
 	/* i2c_transfer returns message length, but function should return 0 */
-	ret = i2c_transfer(client->adapter, &msg, 1);
+	ret = aptina_i2c_transfer(&to_ap0100(client)->i2c_stats, client,
+				  &msg, 1);
 	if (ret >= 0)
 		return 0;
 
@@ -253,7 +258,8 @@ static int ap0100_write_8(struct i2c_client *client, u16 addr,
 	msg.buf   = buf;
 
 	/* i2c_transfer returns message length, but function should return 0 */
-	ret = i2c_transfer(client->adapter, &msg, 1);
+	ret = aptina_i2c_transfer(&to_ap0100(client)->i2c_stats, client,
+				  &msg, 1);
 	if (ret >= 0)
 		return 0;
 
@@ -419,7 +425,7 @@ int ap0100_change_config(struct i2c_client *client)
 ************************************************************************/
 #define V4L2_CID_TEST_PATTERN           (V4L2_CID_USER_BASE | 0x1001)
 
-static int ap0100_s_ctrl(struct v4l2_ctrl *ctrl)
+static int __ap0100_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct ap0100_priv *ap0100 = container_of(ctrl->handler,
 					struct ap0100_priv, ctrls);
@@ -477,6 +483,19 @@ out:
 	return ret;
 }
 
+static int ap0100_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct ap0100_priv *ap0100 = container_of(ctrl->handler,
+					struct ap0100_priv, ctrls);
+	int ret;
+
+	aptina_i2c_begin(&ap0100->i2c_stats, APTINA_I2C_OP_CTRL);
+	ret = __ap0100_s_ctrl(ctrl);
+	aptina_i2c_end(&ap0100->i2c_stats);
+
+	return ret;
+}
+
 static struct v4l2_ctrl_ops ap0100_ctrl_ops = {
 	.s_ctrl = ap0100_s_ctrl,
 };
@@ -535,6 +554,7 @@ static int ap0100_s_power(struct v4l2_subdev *sd, int on)
 	int ret = 0;
 
 	mutex_lock(&ap0100->power_lock);
+	aptina_i2c_begin(&ap0100->i2c_stats, APTINA_I2C_OP_POWER);
 
 	/*
 	* If the power count is modified from 0 to != 0 or from != 0 to 0,
@@ -553,6 +573,7 @@ static int ap0100_s_power(struct v4l2_subdev *sd, int on)
 	ap0100->power_count += on ? 1 : -1;
 	WARN_ON(ap0100->power_count < 0);
 out:
+	aptina_i2c_end(&ap0100->i2c_stats);
 	mutex_unlock(&ap0100->power_lock);
 	return ret;
 }
@@ -561,7 +582,7 @@ out:
 		v4l2_subdev_video_ops
 ****************************************************/
 
-static int ap0100_s_stream(struct v4l2_subdev *sd, int enable)
+static int __ap0100_s_stream(struct v4l2_subdev *sd, int enable)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	int ret, count;
@@ -598,6 +619,19 @@ static int ap0100_s_stream(struct v4l2_subdev *sd, int enable)
 	return 0;
 }
 
+static int ap0100_s_stream(struct v4l2_subdev *sd, int enable)
+{
+	struct ap0100_priv *ap0100 = container_of(sd,
+				struct ap0100_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&ap0100->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __ap0100_s_stream(sd, enable);
+	aptina_i2c_end(&ap0100->i2c_stats);
+
+	return ret;
+}
+
 /***************************************************
 		v4l2_subdev_pad_ops
 ****************************************************/
@@ -720,7 +754,7 @@ static int ap0100_set_crop(struct v4l2_subdev *sd,
 /***********************************************************
 	V4L2 subdev internal operations
 ************************************************************/
-static int ap0100_registered(struct v4l2_subdev *sd)
+static int __ap0100_registered(struct v4l2_subdev *sd)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct ap0100_priv *ap0100 = to_ap0100(client);
@@ -744,6 +778,19 @@ static int ap0100_registered(struct v4l2_subdev *sd)
 	return 0;
 }
 
+static int ap0100_registered(struct v4l2_subdev *sd)
+{
+	struct ap0100_priv *ap0100 = container_of(sd,
+				struct ap0100_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&ap0100->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __ap0100_registered(sd);
+	aptina_i2c_end(&ap0100->i2c_stats);
+
+	return ret;
+}
+
 static int ap0100_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 {
 	return ap0100_s_power(sd, 1);
@@ -843,6 +890,7 @@ static int ap0100_probe(struct i2c_client *client,
 
 	mutex_init(&ap0100->power_lock);
 	v4l2_i2c_subdev_init(&ap0100->subdev, client, &ap0100_subdev_ops);
+	aptina_i2c_stats_init(&ap0100->i2c_stats, client, 2);
 	ap0100->subdev.internal_ops = &ap0100_subdev_internal_ops;
 
 	ap0100->pad.flags = MEDIA_PAD_FL_SOURCE;
@@ -867,6 +915,7 @@ done:
 	if (ret < 0) {
 		v4l2_ctrl_handler_free(&ap0100->ctrls);
 		media_entity_cleanup(&ap0100->subdev.entity);
+		aptina_i2c_stats_cleanup(&ap0100->i2c_stats);
 		dev_err(&client->dev, "Probe failed\n");
 	}
 
@@ -881,6 +930,7 @@ static int ap0100_remove(struct i2c_client *client)
 	v4l2_ctrl_handler_free(&ap0100->ctrls);
 	v4l2_device_unregister_subdev(subdev);
 	media_entity_cleanup(&subdev->entity);
+	aptina_i2c_stats_cleanup(&ap0100->i2c_stats);
 
 	return 0;
 }
@@ -25,6 +25,7 @@
 #include <linux/videodev2.h>
 #include <linux/sysfs.h>
 
+#include <media/aptina-i2c.h>
 #include <media/ap0100.h>
 #include <media/v4l2-int-device.h>
 #include <media/v4l2-chip-ident.h>
@@ -93,6 +94,7 @@ struct ap0100_priv {
 	int scaler;
 	int ver;
 	int  model;
+	struct aptina_i2c_stats i2c_stats;
 	u32  flags;
 /* for flags */
 #define INIT_DONE  (1<<0)
@@ -130,6 +132,7 @@ const struct v4l2_fract ap0100_frameintervals[] = {
  */
 static int ap0100_reg_read(const struct i2c_client *client, u16 addr)
 {
+        struct ap0100_priv *priv = i2c_get_clientdata(client);
         struct i2c_msg msg[2];
         u8 buf[2];
         u16 __addr;
@@ -153,7 +156,7 @@ static int ap0100_reg_read(const struct i2c_client *client, u16 addr)
         * it means error.
         * else, under 16bit is valid data.
         */
-        ret = i2c_transfer(client->adapter, msg, 2);
+        ret = aptina_i2c_transfer(&priv->i2c_stats, client, msg, 2);
 
         if (ret < 0) {
                 v4l_err(client, "Read from offset 0x%x error %d", addr, ret);
@@ -172,6 +175,7 @@ static int ap0100_reg_read(const struct i2c_client *client, u16 addr)
 static int ap0100_reg_write(const struct i2c_client *client, u16 addr,
                                 u16 data)
 {
+        struct ap0100_priv *priv = i2c_get_clientdata(client);
         struct i2c_msg msg;
         u8 buf[4];
         u16 __addr, __data;
@@ -192,7 +196,7 @@ static int ap0100_reg_write(const struct i2c_client *client, u16 addr,
         msg.buf   = buf;
 
         /* i2c_transfer returns message length, but function should return 0 */
-        ret = i2c_transfer(client->adapter, &msg, 1);
+        ret = aptina_i2c_transfer(&priv->i2c_stats, client, &msg, 1);
         if (ret >= 0)
                 return 0;
 
@@ -310,7 +314,6 @@ ap0100_v4l2_int_s_power(struct v4l2_int_device *s, enum v4l2_power power)
 	struct ap0100_priv *priv = s->priv;
 	struct i2c_client *client = priv->client;
 	static int sensor_is_ready = 0;
-	
 	int ret;
 
 	switch (power) {
@@ -325,7 +328,9 @@ ap0100_v4l2_int_s_power(struct v4l2_int_device *s, enum v4l2_power power)
 			break;	
 		}
 		
+		aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_POWER);
 		ap0100_suspend_camera(client);
+		aptina_i2c_end(&priv->i2c_stats);
 		ret = priv->pdata->power_set(s, power);
 		if (ret < 0) {
 			dev_err(&client->dev, "Unable to set target board power" " state (OFF/STANDBY)\n");
@@ -356,7 +361,9 @@ ap0100_v4l2_int_s_power(struct v4l2_int_device *s, enum v4l2_power power)
 #endif
 
 		if (!(priv->flags & INIT_DONE)) {
+			aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_PROBE);
 			ret = ap0100_detect(client);
+			aptina_i2c_end(&priv->i2c_stats);
 			if (ret < 0) {
 				dev_err(&client->dev, "Unable to detect sensor\n");
 				return ret;
@@ -364,7 +371,9 @@ ap0100_v4l2_int_s_power(struct v4l2_int_device *s, enum v4l2_power power)
 			priv->flags |= INIT_DONE;
 		}
 
+		aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_POWER);
 		ret = ap0100_init_camera(client);
+		aptina_i2c_end(&priv->i2c_stats);
 		if (ret < 0) {
 			dev_err(&client->dev, "Unable to initialize sensor\n");
 			return ret;
@@ -899,10 +908,12 @@ ap0100_probe(struct i2c_client *client, const struct i2c_device_id *did)
 	priv->pix.height      = AP0100_DEFAULT_HEIGHT;
 	priv->pix.pixelformat = ap0100_formats[0].pixelformat;
 	i2c_set_clientdata(client, priv);
+	aptina_i2c_stats_init(&priv->i2c_stats, client, 2);
 	sysPriv.client = priv->client;
 
 	ret = v4l2_int_device_register(priv->v4l2_int_device);
 	if (ret) {
+		aptina_i2c_stats_cleanup(&priv->i2c_stats);
 		i2c_set_clientdata(client, NULL);
 		kfree(v4l2_int_device);
 		kfree(priv);
@@ -926,6 +937,7 @@ ap0100_remove(struct i2c_client *client)
 	struct ap0100_priv *priv = i2c_get_clientdata(client);
 
 	v4l2_int_device_unregister(priv->v4l2_int_device);
+	aptina_i2c_stats_cleanup(&priv->i2c_stats);
 	i2c_set_clientdata(client, NULL);
 
 #ifdef AP0100_DEBUG_REG_ACCESS
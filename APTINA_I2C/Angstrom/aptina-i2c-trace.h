@@ -0,0 +1,90 @@
+/*
+ * include/trace/events/aptina-i2c-trace.h
+ *
+ * Aptina sensor I2C register access trace events
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM aptina_i2c
+
+#if !defined(__APTINA_I2C_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __APTINA_I2C_TRACE_H__
+
+#include <linux/device.h>
+#include <linux/i2c.h>
+#include <linux/tracepoint.h>
+
+#include <media/aptina-i2c.h>
+
+/*
+ * One event per i2c_transfer() call. @reg is the register the transfer
+ * accesses, @value the data written or read (0 when only the address pointer
+ * is set), @len the message payload and @retry the number of the attempt on
+ * a register whose previous transfer failed.
+ */
+TRACE_EVENT(aptina_i2c_transfer,
+
+	TP_PROTO(const struct i2c_client *client, enum aptina_i2c_op op,
+		 u16 reg, u32 value, unsigned int len, bool read, int ret,
+		 unsigned int retry, u64 latency_ns),
+
+	TP_ARGS(client, op, reg, value, len, read, ret, retry, latency_ns),
+
+	TP_STRUCT__entry(
+		__string(	name,		client->name		)
+		__string(	dev,		dev_name(&client->dev)	)
+		__field(	unsigned int,	op			)
+		__field(	u16,		reg			)
+		__field(	u32,		value			)
+		__field(	unsigned int,	len			)
+		__field(	bool,		read			)
+		__field(	int,		ret			)
+		__field(	unsigned int,	retry			)
+		__field(	u64,		latency_ns		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, client->name);
+		__assign_str(dev, dev_name(&client->dev));
+		__entry->op		= op;
+		__entry->reg		= reg;
+		__entry->value		= value;
+		__entry->len		= len;
+		__entry->read		= read;
+		__entry->ret		= ret;
+		__entry->retry		= retry;
+		__entry->latency_ns	= latency_ns;
+	),
+
+	TP_printk("%s %s %s %s reg=0x%04x value=0x%04x len=%u ret=%d retry=%u latency=%lluns",
+		  __get_str(name), __get_str(dev),
+		  __print_symbolic(__entry->op,
+				   { APTINA_I2C_OP_OTHER,	"other" },
+				   { APTINA_I2C_OP_PROBE,	"probe" },
+				   { APTINA_I2C_OP_POWER,	"power" },
+				   { APTINA_I2C_OP_STREAM,	"stream" },
+				   { APTINA_I2C_OP_CTRL,	"ctrl" }),
+		  __entry->read ? "read" : "write", __entry->reg,
+		  __entry->value, __entry->len, __entry->ret, __entry->retry,
+		  (unsigned long long)__entry->latency_ns)
+);
+
+#endif /* __APTINA_I2C_TRACE_H__ */
+
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE aptina-i2c-trace
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,260 @@
+/*
+ *
+ * Aptina sensor I2C register access tracing and statistics
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * Register accesses of the sensor drivers go through aptina_i2c_transfer(),
+ * which emits a trace event per transfer and accounts the transfers, bytes,
+ * errors and latency to the driver operation in progress, so slow probes and
+ * stream starts can be profiled with ftrace/perf on production kernels.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/debugfs.h>
+#include <linux/i2c.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+
+#include <media/aptina-i2c.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/aptina-i2c-trace.h>
+
+static const char * const aptina_i2c_op_names[APTINA_I2C_OP_COUNT] = {
+	[APTINA_I2C_OP_OTHER]	= "other",
+	[APTINA_I2C_OP_PROBE]	= "probe",
+	[APTINA_I2C_OP_POWER]	= "power",
+	[APTINA_I2C_OP_STREAM]	= "stream",
+	[APTINA_I2C_OP_CTRL]	= "ctrl",
+};
+
+static struct dentry *aptina_i2c_debugfs;
+
+/************************************************************************
+			Register access
+************************************************************************/
+/* Big endian value of the first bytes of a message, as the sensors send them */
+static u32 aptina_i2c_get_be(const u8 *buf, unsigned int len)
+{
+	u32 value = 0;
+
+	len = min(len, 4U);
+	while (len--)
+		value = (value << 8) | *buf++;
+
+	return value;
+}
+
+int aptina_i2c_transfer(struct aptina_i2c_stats *stats,
+			const struct i2c_client *client, struct i2c_msg *msgs,
+			int num)
+{
+	struct aptina_i2c_counters *counters;
+	enum aptina_i2c_op op;
+	unsigned int bytes = 0;
+	unsigned int retry;
+	bool has_reg = false;
+	bool read = false;
+	u32 value = 0;
+	u16 reg = 0;
+	ktime_t start;
+	u64 ns;
+	int ret;
+	int i;
+
+	start = ktime_get();
+	ret = i2c_transfer(client->adapter, msgs, num);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	/*
+	 * A write carries the register address followed by the data, a read
+	 * returns the data of the register addressed by the previous write,
+	 * in the same transfer or, for the MT9P031, in the previous one.
+	 */
+	for (i = 0; i < num; i++) {
+		const struct i2c_msg *msg = &msgs[i];
+
+		bytes += msg->len;
+
+		if (msg->flags & I2C_M_RD) {
+			read = true;
+			if (ret >= 0)
+				value = aptina_i2c_get_be(msg->buf, msg->len);
+		} else if (msg->len >= stats->reg_bytes) {
+			has_reg = true;
+			reg = aptina_i2c_get_be(msg->buf, stats->reg_bytes);
+			value = aptina_i2c_get_be(msg->buf + stats->reg_bytes,
+						  msg->len - stats->reg_bytes);
+		}
+	}
+
+	spin_lock(&stats->lock);
+
+	if (!has_reg)
+		reg = stats->reg;
+
+	retry = stats->failed && reg == stats->reg ? stats->retry + 1 : 0;
+	stats->reg = reg;
+	stats->failed = ret < 0;
+	stats->retry = retry;
+
+	op = stats->op;
+	counters = &stats->counters[op];
+	counters->transfers++;
+	counters->bytes += bytes;
+	if (ret < 0)
+		counters->errors++;
+	if (retry)
+		counters->retries++;
+	counters->time_ns += ns;
+	if (ns > counters->max_ns)
+		counters->max_ns = ns;
+
+	spin_unlock(&stats->lock);
+
+	trace_aptina_i2c_transfer(client, op, reg, value, bytes, read, ret,
+				  retry, ns);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(aptina_i2c_transfer);
+
+/************************************************************************
+			debugfs
+************************************************************************/
+static int aptina_i2c_stats_show(struct seq_file *s, void *v)
+{
+	struct aptina_i2c_stats *stats = s->private;
+	struct aptina_i2c_counters counters[APTINA_I2C_OP_COUNT];
+	struct aptina_i2c_counters total;
+	unsigned int i;
+
+	spin_lock(&stats->lock);
+	memcpy(counters, stats->counters, sizeof(counters));
+	spin_unlock(&stats->lock);
+
+	memset(&total, 0, sizeof(total));
+
+	seq_printf(s, "%s at 0x%02x on %s\n", stats->client->name,
+		   stats->client->addr, stats->client->adapter->name);
+	seq_printf(s, "%-6s %9s %8s %6s %7s %10s %8s\n", "op", "transfers",
+		   "bytes", "errors", "retries", "time(us)", "max(us)");
+
+	for (i = 0; i <= APTINA_I2C_OP_COUNT; i++) {
+		const struct aptina_i2c_counters *c =
+			i < APTINA_I2C_OP_COUNT ? &counters[i] : &total;
+
+		if (i < APTINA_I2C_OP_COUNT) {
+			total.transfers += c->transfers;
+			total.bytes += c->bytes;
+			total.errors += c->errors;
+			total.retries += c->retries;
+			total.time_ns += c->time_ns;
+			total.max_ns = max(total.max_ns, c->max_ns);
+		}
+
+		seq_printf(s, "%-6s %9u %8u %6u %7u %10llu %8llu\n",
+			   i < APTINA_I2C_OP_COUNT ? aptina_i2c_op_names[i]
+			   : "total", c->transfers, c->bytes, c->errors,
+			   c->retries, div_u64(c->time_ns, 1000),
+			   div_u64(c->max_ns, 1000));
+	}
+
+	return 0;
+}
+
+static int aptina_i2c_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, aptina_i2c_stats_show, inode->i_private);
+}
+
+/* Any write clears the counters */
+static ssize_t aptina_i2c_stats_write(struct file *file,
+				      const char __user *buf, size_t count,
+				      loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct aptina_i2c_stats *stats = s->private;
+
+	spin_lock(&stats->lock);
+	memset(stats->counters, 0, sizeof(stats->counters));
+	spin_unlock(&stats->lock);
+
+	return count;
+}
+
+static const struct file_operations aptina_i2c_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= aptina_i2c_stats_open,
+	.read		= seq_read,
+	.write		= aptina_i2c_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void aptina_i2c_stats_init(struct aptina_i2c_stats *stats,
+			   struct i2c_client *client, unsigned int reg_bytes)
+{
+	char name[I2C_NAME_SIZE + 16];
+
+	memset(stats, 0, sizeof(*stats));
+	spin_lock_init(&stats->lock);
+	stats->client = client;
+	stats->reg_bytes = reg_bytes;
+
+	/* Tracing and the counters work without debugfs */
+	if (IS_ERR_OR_NULL(aptina_i2c_debugfs))
+		return;
+
+	snprintf(name, sizeof(name), "%s-%s", client->name,
+		 dev_name(&client->dev));
+	stats->debugfs = debugfs_create_dir(name, aptina_i2c_debugfs);
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, stats->debugfs, stats,
+			    &aptina_i2c_stats_fops);
+}
+EXPORT_SYMBOL_GPL(aptina_i2c_stats_init);
+
+void aptina_i2c_stats_cleanup(struct aptina_i2c_stats *stats)
+{
+	debugfs_remove_recursive(stats->debugfs);
+	stats->debugfs = NULL;
+}
+EXPORT_SYMBOL_GPL(aptina_i2c_stats_cleanup);
+
+/************************************************************************
+			Module
+************************************************************************/
+static int __init aptina_i2c_init(void)
+{
+	aptina_i2c_debugfs = debugfs_create_dir("aptina-i2c", NULL);
+	if (IS_ERR_OR_NULL(aptina_i2c_debugfs))
+		pr_info("aptina-i2c: debugfs not available, no stats files\n");
+
+	return 0;
+}
+
+static void __exit aptina_i2c_exit(void)
+{
+	debugfs_remove_recursive(aptina_i2c_debugfs);
+}
+
+module_init(aptina_i2c_init);
+module_exit(aptina_i2c_exit);
+
+MODULE_DESCRIPTION("Aptina sensor I2C register access tracing and statistics");
+MODULE_AUTHOR("Aptina Imaging");
+MODULE_LICENSE("GPL v2");
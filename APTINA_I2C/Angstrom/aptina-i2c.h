@@ -0,0 +1,147 @@
+/*
+ * include/media/aptina-i2c.h
+ *
+ * Aptina sensor I2C register access tracing and statistics
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __APTINA_I2C_H__
+#define __APTINA_I2C_H__
+
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+struct dentry;
+struct i2c_client;
+struct i2c_msg;
+
+/*
+ * Driver operations the transfers are accounted to. Transfers outside of
+ * them (format, crop, register debug) go to APTINA_I2C_OP_OTHER.
+ */
+enum aptina_i2c_op {
+	APTINA_I2C_OP_OTHER,
+	APTINA_I2C_OP_PROBE,
+	APTINA_I2C_OP_POWER,
+	APTINA_I2C_OP_STREAM,
+	APTINA_I2C_OP_CTRL,
+	APTINA_I2C_OP_COUNT,
+};
+
+/*
+ * struct aptina_i2c_counters - bus usage of one operation
+ * @transfers: i2c_transfer() calls
+ * @bytes: message payload, register address included
+ * @errors: failed transfers
+ * @retries: transfers repeating the register access of a failed one
+ * @time_ns: cumulative transfer latency
+ * @max_ns: longest transfer latency
+ */
+struct aptina_i2c_counters {
+	unsigned int transfers;
+	unsigned int bytes;
+	unsigned int errors;
+	unsigned int retries;
+	u64 time_ns;
+	u64 max_ns;
+};
+
+/*
+ * struct aptina_i2c_stats - per device register access state
+ * @reg_bytes: register address size, 2 for 16-bit addresses, 1 for 8-bit
+ * @op: operation the transfers are accounted to
+ * @depth: operations in progress, nested or concurrent
+ * @reg: last register accessed, the address pointer of split reads
+ * @failed: the last transfer failed
+ * @retry: consecutive attempts on the failed register
+ */
+struct aptina_i2c_stats {
+	spinlock_t lock;	/* protects the counters, op and depth */
+	struct i2c_client *client;
+	struct dentry *debugfs;
+	unsigned int reg_bytes;
+	enum aptina_i2c_op op;
+	unsigned int depth;
+	u16 reg;
+	bool failed;
+	unsigned int retry;
+	struct aptina_i2c_counters counters[APTINA_I2C_OP_COUNT];
+};
+
+/**
+ * aptina_i2c_transfer - i2c_transfer() with tracing and statistics
+ * @stats: device statistics
+ * @client: I2C client issuing the transfer
+ * @msgs: messages to transfer
+ * @num: number of messages
+ *
+ * Every call emits the aptina_i2c:aptina_i2c_transfer trace event with the
+ * decoded register address, value, length, result and latency, and is
+ * accounted to the current operation of @stats. Returns the i2c_transfer()
+ * result.
+ */
+int aptina_i2c_transfer(struct aptina_i2c_stats *stats,
+			const struct i2c_client *client, struct i2c_msg *msgs,
+			int num);
+
+/**
+ * aptina_i2c_stats_init - initialize the statistics of a device
+ * @stats: statistics to initialize
+ * @client: I2C client of the sensor
+ * @reg_bytes: register address size in bytes
+ *
+ * Creates the aptina-i2c/<name>-<device>/stats file in debugfs. Reading it
+ * reports the counters per operation, writing to it clears them.
+ */
+void aptina_i2c_stats_init(struct aptina_i2c_stats *stats,
+			   struct i2c_client *client, unsigned int reg_bytes);
+
+/**
+ * aptina_i2c_stats_cleanup - remove the debugfs file of a device
+ * @stats: statistics to clean up
+ */
+void aptina_i2c_stats_cleanup(struct aptina_i2c_stats *stats);
+
+/**
+ * aptina_i2c_begin - account the following transfers to an operation
+ * @stats: device statistics
+ * @op: operation starting
+ *
+ * Nested operations, such as the controls restored when powering on, are
+ * accounted to the outermost one, and so are operations running
+ * concurrently with it. Transfers go back to APTINA_I2C_OP_OTHER once every
+ * operation has ended, whatever order they end in.
+ */
+static inline void aptina_i2c_begin(struct aptina_i2c_stats *stats,
+				    enum aptina_i2c_op op)
+{
+	spin_lock(&stats->lock);
+	if (stats->depth++ == 0)
+		stats->op = op;
+	spin_unlock(&stats->lock);
+}
+
+/**
+ * aptina_i2c_end - end an operation started by aptina_i2c_begin()
+ * @stats: device statistics
+ */
+static inline void aptina_i2c_end(struct aptina_i2c_stats *stats)
+{
+	spin_lock(&stats->lock);
+	if (--stats->depth == 0)
+		stats->op = APTINA_I2C_OP_OTHER;
+	spin_unlock(&stats->lock);
+}
+
+#endif
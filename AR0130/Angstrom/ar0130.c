@@ -7,6 +7,7 @@
 #include <media/v4l2-subdev.h>
 #include <linux/videodev2.h>
 
+#include <media/aptina-i2c.h>
 #include <media/ar0130.h>
 #include <media/v4l2-chip-ident.h>
 #include <media/v4l2-ctrls.h>
@@ -94,6 +95,8 @@ struct ar0130_priv {
 	
 	/* cache register values */
 	u16 output_control;
+
+	struct aptina_i2c_stats i2c_stats;
 };
 
 /************************************************************************
@@ -139,7 +142,7 @@ static int ar0130_reg_read(struct i2c_client *client, u16 command)
 	* it mean error.
 	* else, under 16bit is valid data.
 	*/
-	ret = i2c_transfer(client->adapter, msg, 2);
+	ret = aptina_i2c_transfer(&to_ar0130(client)->i2c_stats, client, msg, 2);
 	
 	if (ret < 0)
 		return ret;
@@ -178,7 +181,7 @@ static int ar0130_reg_write(struct i2c_client *client, u16 command,
 	msg.buf   = buf;
 	
 	/* i2c_transfer return message length, but this function should return 0 if correct case */
-	ret = i2c_transfer(client->adapter, &msg, 1);
+	ret = aptina_i2c_transfer(&to_ar0130(client)->i2c_stats, client, &msg, 1);
 	if (ret >= 0)
 		return 0;
 	else
@@ -341,7 +344,7 @@ static int ar0130_linear_mode_setup(struct i2c_client *client)
 	int i, ret;
 
 	ret = ar0130_reg_write(client, 0x3088, 0x8000);		// SEQ_CTRL_PORT
-	for(i = 0; i < 80; i++)
+	for(i = 0; i < ARRAY_SIZE(ar0130_linear_data); i++)
 		ret |= ar0130_reg_write(client, AR0130_SEQ_PORT, ar0130_linear_data[i]);
  
 	ret |= ar0130_reg_write(client, 0x309E, 0x0000);	// DCDS_PROG_START_ADDR
@@ -480,13 +483,16 @@ static int ar0130_g_ctrl(struct v4l2_subdev *sd, struct v4l2_control *ctrl)
 static int ar0130_s_ctrl(struct v4l2_subdev *sd, struct v4l2_control *ctrl)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct ar0130_priv *ar0130 = container_of(sd, struct ar0130_priv, subdev);
 	int ret = 0;
 	
+	aptina_i2c_begin(&ar0130->i2c_stats, APTINA_I2C_OP_CTRL);
 	switch (ctrl->id) {
 		case V4L2_CID_EXPOSURE_AUTO:
 			ret =  ar0130_set_autoexposure(client, ctrl->value);
 		break;
 	}
+	aptina_i2c_end(&ar0130->i2c_stats);
 
 	return ret;
 }
@@ -522,6 +528,7 @@ static int ar0130_s_power(struct v4l2_subdev *sd, int on)
 	int ret = 0;
 
 	mutex_lock(&ar0130->power_lock);
+	aptina_i2c_begin(&ar0130->i2c_stats, APTINA_I2C_OP_POWER);
 	
 	/*
 	* If the power count is modified from 0 to != 0 or from != 0 to 0,
@@ -542,6 +549,7 @@ static int ar0130_s_power(struct v4l2_subdev *sd, int on)
 	ar0130->power_count += on ? 1 : -1;
 	WARN_ON(ar0130->power_count < 0);
 out:
+	aptina_i2c_end(&ar0130->i2c_stats);
 	mutex_unlock(&ar0130->power_lock);
 	return ret; 
 }
@@ -549,7 +557,7 @@ out:
 /***************************************************
 		v4l2_subdev_video_ops	
 ****************************************************/
-static int ar0130_s_stream(struct v4l2_subdev *sd, int enable)
+static int __ar0130_s_stream(struct v4l2_subdev *sd, int enable)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct ar0130_priv *ar0130 = container_of(sd, struct ar0130_priv, subdev);
@@ -589,6 +597,18 @@ static int ar0130_s_stream(struct v4l2_subdev *sd, int enable)
 	return ret;
 }
 
+static int ar0130_s_stream(struct v4l2_subdev *sd, int enable)
+{
+	struct ar0130_priv *ar0130 = container_of(sd, struct ar0130_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&ar0130->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __ar0130_s_stream(sd, enable);
+	aptina_i2c_end(&ar0130->i2c_stats);
+
+	return ret;
+}
+
 /***************************************************
 		v4l2_subdev_pad_ops
 ****************************************************/
@@ -693,7 +713,7 @@ static int ar0130_s_crop(struct v4l2_subdev *sd, struct v4l2_crop *a)
 /***********************************************************
 	V4L2 subdev internal operations
 ************************************************************/
-static int ar0130_registered(struct v4l2_subdev *sd)
+static int __ar0130_registered(struct v4l2_subdev *sd)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct ar0130_priv *ar0130 = to_ar0130(client);
@@ -722,6 +742,18 @@ static int ar0130_registered(struct v4l2_subdev *sd)
 	return ret;
 }
 
+static int ar0130_registered(struct v4l2_subdev *sd)
+{
+	struct ar0130_priv *ar0130 = container_of(sd, struct ar0130_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&ar0130->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __ar0130_registered(sd);
+	aptina_i2c_end(&ar0130->i2c_stats);
+
+	return ret;
+}
+
 static int ar0130_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 {
 	struct ar0130_priv *ar0130 = container_of(sd, struct ar0130_priv, subdev);
@@ -823,6 +855,7 @@ static int ar0130_probe(struct i2c_client *client,
 	
 	mutex_init(&ar0130->power_lock);
 	v4l2_i2c_subdev_init(&ar0130->subdev, client, &ar0130_subdev_ops);
+	aptina_i2c_stats_init(&ar0130->i2c_stats, client, 2);
 	ar0130->subdev.internal_ops = &ar0130_subdev_internal_ops;
 
 	ar0130->pad.flags = MEDIA_PAD_FL_SOURCE;
@@ -848,6 +881,7 @@ done:
 		v4l2_device_unregister_subdev(subdev);
 		dev_err(&client->dev, "Probe failed\n");
 		media_entity_cleanup(&ar0130->subdev.entity);
+		aptina_i2c_stats_cleanup(&ar0130->i2c_stats);
 		kfree(ar0130);
 	}
 
@@ -861,6 +895,7 @@ static int ar0130_remove(struct i2c_client *client)
 
 	v4l2_device_unregister_subdev(subdev);
 	media_entity_cleanup(&ar0130->subdev.entity);
+	aptina_i2c_stats_cleanup(&ar0130->i2c_stats);
 	kfree(ar0130);
 	return 0;
 }
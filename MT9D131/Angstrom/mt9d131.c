@@ -31,6 +31,7 @@
 #include<media/v4l2-subdev.h>
 #include<linux/videodev2.h>
 
+#include<media/aptina-i2c.h>
 #include<media/mt9d131.h>
 #include<media/v4l2-chip-ident.h>
 #include<media/v4l2-ctrls.h>
@@ -107,6 +108,7 @@ struct mt9d131 {
        	/* cache register values */
  	u16 output_control;
 
+	struct aptina_i2c_stats i2c_stats;
 };
 
 
@@ -164,22 +166,58 @@ static struct mt9d131 *to_mt9d131(const struct i2c_client *client)
  * @client: pointer to i2c client
  * @reg: address of the register which is to be read
  *
+ * Same messages as an SMBus word read, the data big endian.
  */
 static int reg_read(struct i2c_client *client, const u8 reg)
 {
-       	s32 data = i2c_smbus_read_word_data(client, reg);
-       	return data<  0 ? data : swab16(data);
+	struct i2c_msg msg[2];
+	u8 addr = reg;
+	u8 buf[2];
+	int ret;
+
+	msg[0].addr = client->addr;
+	msg[0].flags = 0;
+	msg[0].len = 1;
+	msg[0].buf = &addr;
+
+	msg[1].addr = client->addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].len = 2;
+	msg[1].buf = buf;
+
+	ret = aptina_i2c_transfer(&to_mt9d131(client)->i2c_stats, client,
+				  msg, 2);
+	if (ret < 0)
+		return ret;
+
+	return (buf[0] << 8) | buf[1];
 }
 /**
  * reg_write - writes the data into the given register
  * @client: pointer to i2c client
  * @reg: address of the register in which to write
  *
+ * Same message as an SMBus word write, the data big endian.
  */
 static int reg_write(struct i2c_client *client, const u8 reg,
                        const u16 data)
 {
-       	return i2c_smbus_write_word_data(client, reg, swab16(data));
+	struct i2c_msg msg;
+	u8 buf[3];
+	int ret;
+
+	buf[0] = reg;
+	buf[1] = data >> 8;
+	buf[2] = data & 0xff;
+
+	msg.addr = client->addr;
+	msg.flags = 0;
+	msg.len = 3;
+	msg.buf = buf;
+
+	ret = aptina_i2c_transfer(&to_mt9d131(client)->i2c_stats, client,
+				  &msg, 1);
+	return ret < 0 ? ret : 0;
 }
 
 
@@ -346,7 +384,9 @@ static int mt9d131_set_power(struct v4l2_subdev *sd, int on)
 		
        	struct mt9d131 *mt9d131 = container_of(sd, struct mt9d131, subdev);
        	int ret = 0;
+
 	mutex_lock(&mt9d131->power_lock);
+	aptina_i2c_begin(&mt9d131->i2c_stats, APTINA_I2C_OP_POWER);
        /*
         * If the power count is modified from 0 to != 0 or from != 0 to 0,
         * update the power state.
@@ -368,11 +408,12 @@ static int mt9d131_set_power(struct v4l2_subdev *sd, int on)
        WARN_ON(mt9d131->power_count<  0);
 
 out:
+       aptina_i2c_end(&mt9d131->i2c_stats);
        mutex_unlock(&mt9d131->power_lock);
        return ret;
 }
 
-static int mt9d131_registered(struct v4l2_subdev *sd)
+static int __mt9d131_registered(struct v4l2_subdev *sd)
 {	
        	struct mt9d131 *mt9d131 = container_of(sd, struct mt9d131, subdev);
        	struct i2c_client *client = v4l2_get_subdevdata(&mt9d131->subdev);
@@ -389,6 +430,18 @@ static int mt9d131_registered(struct v4l2_subdev *sd)
        	return ret;
 }
 
+static int mt9d131_registered(struct v4l2_subdev *sd)
+{
+	struct mt9d131 *mt9d131 = container_of(sd, struct mt9d131, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9d131->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __mt9d131_registered(sd);
+	aptina_i2c_end(&mt9d131->i2c_stats);
+
+	return ret;
+}
+
 static inline int mt9d131_pll_disable(struct i2c_client *client)
 {	
        return reg_write(client, MT9D131_PLL_CONTROL,
@@ -456,7 +509,7 @@ static int mt9d131_set_params(struct i2c_client *client,
 	return ret;
 }
 
-static int mt9d131_s_stream(struct v4l2_subdev *sd, int enable)
+static int __mt9d131_s_stream(struct v4l2_subdev *sd, int enable)
 {	   
        struct mt9d131 *mt9d131 = container_of(sd, struct mt9d131, subdev);
        struct i2c_client *client = v4l2_get_subdevdata(&mt9d131->subdev);
@@ -492,6 +545,18 @@ static int mt9d131_s_stream(struct v4l2_subdev *sd, int enable)
        return ret;
 }
 
+static int mt9d131_s_stream(struct v4l2_subdev *sd, int enable)
+{
+	struct mt9d131 *mt9d131 = container_of(sd, struct mt9d131, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9d131->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __mt9d131_s_stream(sd, enable);
+	aptina_i2c_end(&mt9d131->i2c_stats);
+
+	return ret;
+}
+
 static int mt9d131_get_format(struct v4l2_subdev *sd,
                                struct v4l2_subdev_fh *fh,
                                struct v4l2_subdev_format *fmt)
@@ -602,7 +667,7 @@ static int mt9d131_set_zoom(u32 zoomfactor, struct i2c_client  *client) {
 
 }
 
-static int mt9d131_s_ctrl(struct v4l2_ctrl *ctrl)
+static int __mt9d131_s_ctrl(struct v4l2_ctrl *ctrl)
 {	   
        	struct mt9d131 *mt9d131 = container_of(ctrl->handler, struct mt9d131, ctrls);
        	struct i2c_client *client = v4l2_get_subdevdata(&mt9d131->subdev);
@@ -663,6 +728,18 @@ static int mt9d131_s_ctrl(struct v4l2_ctrl *ctrl)
        return 0;
 }
 
+static int mt9d131_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct mt9d131 *mt9d131 = container_of(ctrl->handler, struct mt9d131, ctrls);
+	int ret;
+
+	aptina_i2c_begin(&mt9d131->i2c_stats, APTINA_I2C_OP_CTRL);
+	ret = __mt9d131_s_ctrl(ctrl);
+	aptina_i2c_end(&mt9d131->i2c_stats);
+
+	return ret;
+}
+
 static struct v4l2_ctrl_ops mt9d131_ctrl_ops = {
        	.s_ctrl = mt9d131_s_ctrl,
 };
@@ -706,9 +783,9 @@ static int mt9d131_probe(struct i2c_client *client,
        	struct mt9d131_platform_data *pdata = client->dev.platform_data;
        	struct i2c_adapter *adapter = to_i2c_adapter(client->dev.parent);
 	
-       	if (!i2c_check_functionality(adapter, I2C_FUNC_SMBUS_WORD_DATA)) {
+       	if (!i2c_check_functionality(adapter, I2C_FUNC_I2C)) {
                	dev_warn(&adapter->dev,
-                       	"I2C-Adapter doesn't support I2C_FUNC_SMBUS_WORD\n");
+                       	"I2C-Adapter doesn't support I2C_FUNC_I2C\n");
                	return -EIO;
        	}
 
@@ -742,12 +819,15 @@ static int mt9d131_probe(struct i2c_client *client,
 
        	mutex_init(&mt9d131->power_lock);
        	v4l2_i2c_subdev_init(&mt9d131->subdev, client,&mt9d131_subdev_ops);
+	aptina_i2c_stats_init(&mt9d131->i2c_stats, client, 1);
        	mt9d131->subdev.internal_ops =&mt9d131_subdev_internal_ops;
 
        	mt9d131->pad.flags = MEDIA_PAD_FL_SOURCE;
        	ret = media_entity_init(&mt9d131->subdev.entity, 1,&mt9d131->pad, 0);
-       	if (ret)
+       	if (ret) {
+		aptina_i2c_stats_cleanup(&mt9d131->i2c_stats);
                	return ret;
+	}
 
        	mt9d131->subdev.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
 
@@ -765,6 +845,7 @@ static int mt9d131_remove(struct i2c_client *client)
        	struct mt9d131 *mt9d131 = container_of(sd, struct mt9d131, subdev);
 	v4l2_device_unregister_subdev(sd);
        	media_entity_cleanup(&sd->entity);
+	aptina_i2c_stats_cleanup(&mt9d131->i2c_stats);
        	kfree(mt9d131);
        	return 0;
 }
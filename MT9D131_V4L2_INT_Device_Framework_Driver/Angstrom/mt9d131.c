@@ -30,6 +30,7 @@
 #include <linux/videodev2.h>
 #include <linux/sysfs.h>
 
+#include <media/aptina-i2c.h>
 #include <media/mt9d131.h>
 #include <media/v4l2-int-device.h>
 #include <media/v4l2-chip-ident.h>
@@ -104,6 +105,7 @@ struct mt9d131_priv {
 	u32  flags;
 	u16 mWidth;
 	u16 mHeight;
+	struct aptina_i2c_stats i2c_stats;
 /* for flags */
 #define INIT_DONE  (1<<0)
 };
@@ -239,6 +241,7 @@ mt9d131_config_PCA9543A(const struct i2c_client *client)
 static int 
 mt9d131_reg_read(const struct i2c_client *client, u16 command, u16 *val)
 {
+	struct mt9d131_priv *priv = i2c_get_clientdata(client);
 	struct i2c_msg msg[2];
 	u8 buf[2];
 	int ret;
@@ -249,14 +252,14 @@ mt9d131_reg_read(const struct i2c_client *client, u16 command, u16 *val)
 	msg[0].flags = 0;
 	msg[0].len   = 1;
 	msg[0].buf   = buf ;
-	ret = i2c_transfer(client->adapter, &msg[0], 1);
+	ret = aptina_i2c_transfer(&priv->i2c_stats, client, &msg[0], 1);
 	
 	if(ret >= 0) {
 		msg[1].addr  = client->addr;
 		msg[1].flags = I2C_M_RD; //1
 		msg[1].len   = 2;
 		msg[1].buf   = buf;
-		ret = i2c_transfer(client->adapter, &msg[1], 1);
+		ret = aptina_i2c_transfer(&priv->i2c_stats, client, &msg[1], 1);
 	}
 	//if return value of this function is < 0, it mean error.
 	//else, under 16bit is valid data. 
@@ -281,6 +284,7 @@ mt9d131_reg_read(const struct i2c_client *client, u16 command, u16 *val)
 static int 
 mt9d131_reg_write(const struct i2c_client *client, u16 command, u16 data)
 {
+	struct mt9d131_priv *priv = i2c_get_clientdata(client);
 	struct i2c_msg msg;
 	u8 buf[3];
 	int ret;
@@ -295,7 +299,7 @@ mt9d131_reg_write(const struct i2c_client *client, u16 command, u16 data)
 	msg.buf   = buf;
 		
 	//i2c_transfer return message length, but this function should return 0 if correct case
-	ret = i2c_transfer(client->adapter, &msg, 1);
+	ret = aptina_i2c_transfer(&priv->i2c_stats, client, &msg, 1);
 
 	if(ret<0) printk("mt9d131_reg_write() failed: ret=%d, reg_addr=0x%x, reg_val=0x%x\n",ret,command,data);
 
@@ -567,7 +571,6 @@ mt9d131_v4l2_int_s_power(struct v4l2_int_device *s, enum v4l2_power power)
 	struct mt9d131_priv *priv = s->priv;
 	struct i2c_client *client = priv->client;
 	static int sensor_is_ready=0;
-	
 	int ret;
 
 	switch (power) {
@@ -617,7 +620,9 @@ mt9d131_v4l2_int_s_power(struct v4l2_int_device *s, enum v4l2_power power)
 		mt9d131_config_PCA9543A(client);	
 #endif	
 		if (!(priv->flags & INIT_DONE)) {
+			aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_PROBE);
 			ret = mt9d131_detect(client);
+			aptina_i2c_end(&priv->i2c_stats);
 			if (ret < 0) {
 				dev_err(&client->dev, "Unable to detect sensor\n");
 				return ret;
@@ -625,7 +630,9 @@ mt9d131_v4l2_int_s_power(struct v4l2_int_device *s, enum v4l2_power power)
 			priv->flags |= INIT_DONE;
 		}
 
+		aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_POWER);
 		ret = mt9d131_init_camera(client);
+		aptina_i2c_end(&priv->i2c_stats);
 		if (ret < 0) {
 			dev_err(&client->dev, "Unable to initialize sensor\n");
 			return ret;
@@ -664,6 +671,7 @@ static int mt9d131_v4l2_s_ctrl(struct v4l2_int_device *s, struct v4l2_control *v
 
 	lvc = &mt9d131_video_control[i];
 
+	aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_CTRL);
 	switch (vc->id) {
 	case V4L2_CID_EXPOSURE:
 		retval = mt9d131_set_exposure_time(vc->value, client, lvc);
@@ -675,6 +683,7 @@ static int mt9d131_v4l2_s_ctrl(struct v4l2_int_device *s, struct v4l2_control *v
 		dev_err(&client->dev, "mt9d131_v4l2_int_s_ctrl(): unknow cid:%d\n",vc->id);
 		break;
 	}
+	aptina_i2c_end(&priv->i2c_stats);
 	return retval;
 }
 
@@ -1341,10 +1350,12 @@ mt9d131_probe(struct i2c_client *client, const struct i2c_device_id *did)
 	priv->pix.height      = mt9d131_supported_framesizes[7].height;
 	priv->pix.pixelformat = mt9d131_formats[0].pixelformat;
 	i2c_set_clientdata(client, priv);
+	aptina_i2c_stats_init(&priv->i2c_stats, client, 1);
 	sysPriv.client = priv->client;
 
 	ret = v4l2_int_device_register(priv->v4l2_int_device);
 	if (ret) {
+		aptina_i2c_stats_cleanup(&priv->i2c_stats);
 		i2c_set_clientdata(client, NULL);
 		kfree(v4l2_int_device);
 		kfree(priv);
@@ -1368,6 +1379,7 @@ mt9d131_remove(struct i2c_client *client)
 	struct mt9d131_priv *priv = i2c_get_clientdata(client);
 
 	v4l2_int_device_unregister(priv->v4l2_int_device);
+	aptina_i2c_stats_cleanup(&priv->i2c_stats);
 	i2c_set_clientdata(client, NULL);
 
 #ifdef MT9D131_DEBUG_REG_ACCESS
@@ -23,6 +23,7 @@
 #include <linux/module.h>
 #include <linux/videodev2.h>
 
+#include <media/aptina-i2c.h>
 #include <media/mt9m021.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
@@ -123,7 +124,6 @@
 #define MT9M021_EXPOSURE_MAX		0x02A0
 #define MT9M021_EXPOSURE_DEF		0x0100
 
-#undef MT9M021_I2C_DEBUG
 #undef MT9M021_DEBUG
 
 struct mt9m021_frame_size {
@@ -151,6 +151,7 @@ struct mt9m021_priv {
 	struct mt9m021_pll_divs *pll;
 	int power_count;
 	enum v4l2_exposure_auto_type autoexposure;
+	struct aptina_i2c_stats i2c_stats;
 };
 
 static unsigned int mt9m021_seq_data[133] = {
@@ -223,7 +224,8 @@ static int mt9m021_read(struct i2c_client *client, u16 addr)
 	* it means error.
 	* else, under 16bit is valid data.
 	*/
-	ret = i2c_transfer(client->adapter, msg, 2);
+	ret = aptina_i2c_transfer(&to_mt9m021(client)->i2c_stats, client,
+				  msg, 2);
 
 	if (ret < 0) {
 		v4l_err(client, "Read from offset 0x%x error %d", addr, ret);
@@ -263,13 +265,10 @@ static int mt9m021_write(struct i2c_client *client, u16 addr,
 	msg.buf   = buf;
 
 	/* i2c_transfer returns message length, but function should return 0 */
-	ret = i2c_transfer(client->adapter, &msg, 1);
-	if (ret >= 0){
-#ifdef MT9M021_I2C_DEBUG
-		printk(KERN_INFO"mt9m021: REG=0x%04X, 0x%04X\n", addr,data);
-#endif
+	ret = aptina_i2c_transfer(&to_mt9m021(client)->i2c_stats, client,
+				  &msg, 1);
+	if (ret >= 0)
 		return 0;
-	}
 
 	v4l_err(client, "Write failed at 0x%x error %d\n", addr, ret);
 	return ret;
@@ -664,7 +663,7 @@ void mt9m021_power_off(struct mt9m021_priv *mt9m021)
 			v4l2_subdev_core_ops
 ************************************************************************/
 
-static int mt9m021_s_ctrl(struct v4l2_ctrl *ctrl)
+static int __mt9m021_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct mt9m021_priv *mt9m021 = container_of(ctrl->handler,
 					struct mt9m021_priv, ctrls);
@@ -773,6 +772,19 @@ static int mt9m021_s_ctrl(struct v4l2_ctrl *ctrl)
 	return ret;
 }
 
+static int mt9m021_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct mt9m021_priv *mt9m021 = container_of(ctrl->handler,
+					struct mt9m021_priv, ctrls);
+	int ret;
+
+	aptina_i2c_begin(&mt9m021->i2c_stats, APTINA_I2C_OP_CTRL);
+	ret = __mt9m021_s_ctrl(ctrl);
+	aptina_i2c_end(&mt9m021->i2c_stats);
+
+	return ret;
+}
+
 static struct v4l2_ctrl_ops mt9m021_ctrl_ops = {
 	.s_ctrl = mt9m021_s_ctrl,
 };
@@ -908,6 +920,7 @@ static int mt9m021_s_power(struct v4l2_subdev *sd, int on)
 	int ret = 0;
 
 	mutex_lock(&mt9m021->power_lock);
+	aptina_i2c_begin(&mt9m021->i2c_stats, APTINA_I2C_OP_POWER);
 
 	/*
 	* If the power count is modified from 0 to != 0 or from != 0 to 0,
@@ -932,6 +945,7 @@ static int mt9m021_s_power(struct v4l2_subdev *sd, int on)
 	mt9m021->power_count += on ? 1 : -1;
 	WARN_ON(mt9m021->power_count < 0);
 out:
+	aptina_i2c_end(&mt9m021->i2c_stats);
 	mutex_unlock(&mt9m021->power_lock);
 	return ret;
 }
@@ -941,7 +955,7 @@ out:
 ****************************************************/
 
 
-static int mt9m021_s_stream(struct v4l2_subdev *sd, int enable)
+static int __mt9m021_s_stream(struct v4l2_subdev *sd, int enable)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct mt9m021_frame_size frame;
@@ -992,6 +1006,19 @@ static int mt9m021_s_stream(struct v4l2_subdev *sd, int enable)
 
 }
 
+static int mt9m021_s_stream(struct v4l2_subdev *sd, int enable)
+{
+	struct mt9m021_priv *mt9m021 = container_of(sd,
+				struct mt9m021_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9m021->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __mt9m021_s_stream(sd, enable);
+	aptina_i2c_end(&mt9m021->i2c_stats);
+
+	return ret;
+}
+
 
 /***************************************************
 		v4l2_subdev_pad_ops
@@ -1175,7 +1202,7 @@ static int mt9m021_set_crop(struct v4l2_subdev *sd,
 /***********************************************************
 	V4L2 subdev internal operations
 ************************************************************/
-static int mt9m021_registered(struct v4l2_subdev *sd)
+static int __mt9m021_registered(struct v4l2_subdev *sd)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct mt9m021_priv *mt9m021 = to_mt9m021(client);
@@ -1202,6 +1229,19 @@ static int mt9m021_registered(struct v4l2_subdev *sd)
 	return 0;
 }
 
+static int mt9m021_registered(struct v4l2_subdev *sd)
+{
+	struct mt9m021_priv *mt9m021 = container_of(sd,
+				struct mt9m021_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9m021->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __mt9m021_registered(sd);
+	aptina_i2c_end(&mt9m021->i2c_stats);
+
+	return ret;
+}
+
 static int mt9m021_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 {
 	return mt9m021_s_power(sd, 1);
@@ -1309,6 +1349,7 @@ static int mt9m021_probe(struct i2c_client *client,
 
 	mutex_init(&mt9m021->power_lock);
 	v4l2_i2c_subdev_init(&mt9m021->subdev, client, &mt9m021_subdev_ops);
+	aptina_i2c_stats_init(&mt9m021->i2c_stats, client, 2);
 	mt9m021->subdev.internal_ops = &mt9m021_subdev_internal_ops;
 	mt9m021->subdev.ctrl_handler = &mt9m021->ctrls;
 
@@ -1334,6 +1375,7 @@ done:
 	if (ret < 0) {
 		v4l2_ctrl_handler_free(&mt9m021->ctrls);
 		media_entity_cleanup(&mt9m021->subdev.entity);
+		aptina_i2c_stats_cleanup(&mt9m021->i2c_stats);
 		dev_err(&client->dev, "Probe failed\n");
 	}
 
@@ -1348,6 +1390,7 @@ static int mt9m021_remove(struct i2c_client *client)
 	v4l2_ctrl_handler_free(&mt9m021->ctrls);
 	v4l2_device_unregister_subdev(subdev);
 	media_entity_cleanup(&subdev->entity);
+	aptina_i2c_stats_cleanup(&mt9m021->i2c_stats);
 
 	return 0;
 }
@@ -31,6 +31,7 @@
 #include<media/v4l2-subdev.h>
 #include<linux/videodev2.h>
 
+#include<media/aptina-i2c.h>
 #include<media/mt9p006.h>
 #include<media/v4l2-chip-ident.h>
 #include<media/v4l2-ctrls.h>
@@ -172,6 +173,8 @@ struct mt9p006 {
 	/* Registers cache */
 	u16 output_control;
 	u16 mode2;
+
+	struct aptina_i2c_stats i2c_stats;
 };
 
 static struct mt9p006 *to_mt9p006(struct v4l2_subdev *sd)
@@ -184,22 +187,58 @@ static struct mt9p006 *to_mt9p006(struct v4l2_subdev *sd)
  * @client: pointer to i2c client
  * @reg: address of the register which is to be read
  *
+ * Same messages as an SMBus word read, the data big endian.
  */
 static int reg_read(struct i2c_client *client, const u8 reg)
 {
-       	s32 data = i2c_smbus_read_word_data(client, reg);
-       	return data<  0 ? data : swab16(data);
+	struct mt9p006 *mt9p006 = to_mt9p006(i2c_get_clientdata(client));
+	struct i2c_msg msg[2];
+	u8 addr = reg;
+	u8 buf[2];
+	int ret;
+
+	msg[0].addr = client->addr;
+	msg[0].flags = 0;
+	msg[0].len = 1;
+	msg[0].buf = &addr;
+
+	msg[1].addr = client->addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].len = 2;
+	msg[1].buf = buf;
+
+	ret = aptina_i2c_transfer(&mt9p006->i2c_stats, client, msg, 2);
+	if (ret < 0)
+		return ret;
+
+	return (buf[0] << 8) | buf[1];
 }
 /**
  * reg_write - writes the data into the given register
  * @client: pointer to i2c client
  * @reg: address of the register in which to write
  *
+ * Same message as an SMBus word write, the data big endian.
  */
 static int reg_write(struct i2c_client *client, const u8 reg,
                        const u16 data)
 {
-       	return i2c_smbus_write_word_data(client, reg, swab16(data));
+	struct mt9p006 *mt9p006 = to_mt9p006(i2c_get_clientdata(client));
+	struct i2c_msg msg;
+	u8 buf[3];
+	int ret;
+
+	buf[0] = reg;
+	buf[1] = data >> 8;
+	buf[2] = data & 0xff;
+
+	msg.addr = client->addr;
+	msg.flags = 0;
+	msg.len = 3;
+	msg.buf = buf;
+
+	ret = aptina_i2c_transfer(&mt9p006->i2c_stats, client, &msg, 1);
+	return ret < 0 ? ret : 0;
 }
 
 
@@ -615,7 +654,7 @@ __mt9p006_get_pad_format(struct mt9p006 *mt9p006, struct v4l2_subdev_fh *fh,
 	}
 }
 
-static int mt9p006_s_stream(struct v4l2_subdev *subdev, int enable)
+static int __mt9p006_s_stream(struct v4l2_subdev *subdev, int enable)
 {
 	struct mt9p006 *mt9p006 = to_mt9p006(subdev);
 	int ret;
@@ -643,6 +682,18 @@ static int mt9p006_s_stream(struct v4l2_subdev *subdev, int enable)
 	return mt9p006_pll_enable(mt9p006);
 }
 
+static int mt9p006_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct mt9p006 *mt9p006 = to_mt9p006(subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9p006->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __mt9p006_s_stream(subdev, enable);
+	aptina_i2c_end(&mt9p006->i2c_stats);
+
+	return ret;
+}
+
 static int mt9p006_get_format(struct v4l2_subdev *subdev,
 			      struct v4l2_subdev_fh *fh,
 			      struct v4l2_subdev_format *fmt)
@@ -676,7 +727,7 @@ static int mt9p006_set_format(struct v4l2_subdev *sd,
  */
 
 
-static int mt9p006_s_ctrl(struct v4l2_ctrl *ctrl)
+static int __mt9p006_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct mt9p006 *mt9p006 =
 			container_of(ctrl->handler, struct mt9p006, ctrls);
@@ -740,6 +791,19 @@ static int mt9p006_s_ctrl(struct v4l2_ctrl *ctrl)
 	return 0;
 }
 
+static int mt9p006_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct mt9p006 *mt9p006 =
+			container_of(ctrl->handler, struct mt9p006, ctrls);
+	int ret;
+
+	aptina_i2c_begin(&mt9p006->i2c_stats, APTINA_I2C_OP_CTRL);
+	ret = __mt9p006_s_ctrl(ctrl);
+	aptina_i2c_end(&mt9p006->i2c_stats);
+
+	return ret;
+}
+
 static struct v4l2_ctrl_ops mt9p006_ctrl_ops = {
 	.s_ctrl = mt9p006_s_ctrl,
 };
@@ -753,6 +817,7 @@ static int mt9p006_set_power(struct v4l2_subdev *subdev, int on)
 	int ret = 0;
 
 	mutex_lock(&mt9p006->power_lock);
+	aptina_i2c_begin(&mt9p006->i2c_stats, APTINA_I2C_OP_POWER);
 
 	/* If the power count is modified from 0 to != 0 or from != 0 to 0,
 	 * update the power state.
@@ -768,6 +833,7 @@ static int mt9p006_set_power(struct v4l2_subdev *subdev, int on)
 	WARN_ON(mt9p006->power_count < 0);
 
 out:
+	aptina_i2c_end(&mt9p006->i2c_stats);
 	mutex_unlock(&mt9p006->power_lock);
 	return ret;
 }
@@ -776,7 +842,7 @@ out:
  * V4L2 subdev internal operations
  */
 
-static int mt9p006_registered(struct v4l2_subdev *subdev)
+static int __mt9p006_registered(struct v4l2_subdev *subdev)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(subdev);
 	struct mt9p006 *mt9p006 = to_mt9p006(subdev);
@@ -805,6 +871,18 @@ static int mt9p006_registered(struct v4l2_subdev *subdev)
 	return ret;
 }
 
+static int mt9p006_registered(struct v4l2_subdev *subdev)
+{
+	struct mt9p006 *mt9p006 = to_mt9p006(subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9p006->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __mt9p006_registered(subdev);
+	aptina_i2c_end(&mt9p006->i2c_stats);
+
+	return ret;
+}
+
 static int mt9p006_open(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh)
 {
 	struct mt9p006 *mt9p006 = to_mt9p006(subdev);
@@ -883,9 +961,9 @@ static int mt9p006_probe(struct i2c_client *client,
 		return -EINVAL;
 	}
 
-	if (!i2c_check_functionality(adapter, I2C_FUNC_SMBUS_WORD_DATA)) {
+	if (!i2c_check_functionality(adapter, I2C_FUNC_I2C)) {
 		dev_warn(&client->dev,
-			"I2C-Adapter doesn't support I2C_FUNC_SMBUS_WORD\n");
+			"I2C-Adapter doesn't support I2C_FUNC_I2C\n");
 		return -EIO;
 	}
 
@@ -919,6 +997,7 @@ static int mt9p006_probe(struct i2c_client *client,
 
 	mutex_init(&mt9p006->power_lock);
 	v4l2_i2c_subdev_init(&mt9p006->subdev, client, &mt9p006_subdev_ops);
+	aptina_i2c_stats_init(&mt9p006->i2c_stats, client, 1);
 	mt9p006->subdev.internal_ops = &mt9p006_subdev_internal_ops;
 
 	mt9p006->pad.flags = MEDIA_PAD_FL_SOURCE;
@@ -946,6 +1025,7 @@ done:
 	if (ret < 0) {
 		v4l2_ctrl_handler_free(&mt9p006->ctrls);
 		media_entity_cleanup(&mt9p006->subdev.entity);
+		aptina_i2c_stats_cleanup(&mt9p006->i2c_stats);
 		kfree(mt9p006);
 	}
 
@@ -960,6 +1040,7 @@ static int mt9p006_remove(struct i2c_client *client)
 	v4l2_ctrl_handler_free(&mt9p006->ctrls);
 	v4l2_device_unregister_subdev(subdev);
 	media_entity_cleanup(&subdev->entity);
+	aptina_i2c_stats_cleanup(&mt9p006->i2c_stats);
 	kfree(mt9p006);
 
 	return 0;
@@ -34,6 +34,7 @@
 #include <linux/videodev2.h>
 #include <linux/sysfs.h>
 
+#include <media/aptina-i2c.h>
 #include <media/mt9p031.h>
 #include <media/v4l2-int-device.h>
 #include <media/v4l2-chip-ident.h>
@@ -138,6 +139,7 @@ struct mt9p031_priv {
 	int scaler;
 	int ver;
 	int  model;
+	struct aptina_i2c_stats i2c_stats;
 	u32  flags;
 /* for flags */
 #define INIT_DONE  (1<<0)
@@ -274,6 +276,7 @@ static int mt9p031_config_PCA9543A(const struct i2c_client *client)
  */
 static int mt9p031_reg_read(const struct i2c_client *client, u16 command, u16 *val)
 {
+	struct mt9p031_priv *priv = i2c_get_clientdata(client);
 	struct i2c_msg msg[2];
 	u8 buf[2];
 	int ret;
@@ -285,14 +288,14 @@ static int mt9p031_reg_read(const struct i2c_client *client, u16 command, u16 *v
 	msg[0].flags = 0;
 	msg[0].len   = 1;
 	msg[0].buf   = buf ;
-	ret = i2c_transfer(client->adapter, &msg[0], 1);
+	ret = aptina_i2c_transfer(&priv->i2c_stats, client, &msg[0], 1);
 	
 	if(ret >= 0) {
 		msg[1].addr  = client->addr;
 		msg[1].flags = I2C_M_RD; //1
 		msg[1].len   = 2;
 		msg[1].buf   = buf;
-		ret = i2c_transfer(client->adapter, &msg[1], 1);
+		ret = aptina_i2c_transfer(&priv->i2c_stats, client, &msg[1], 1);
 	}
 	/*
 	 * if return value of this function is < 0,
@@ -318,6 +321,7 @@ static int mt9p031_reg_read(const struct i2c_client *client, u16 command, u16 *v
 static int mt9p031_reg_write(const struct i2c_client *client,
 			       u16 command, u16 data)
 {
+	struct mt9p031_priv *priv = i2c_get_clientdata(client);
 	struct i2c_msg msg;
 	u8 buf[3];
 	int ret;
@@ -337,7 +341,7 @@ static int mt9p031_reg_write(const struct i2c_client *client,
 	 * i2c_transfer return message length,
 	 * but this function should return 0 if correct case
 	 */
-	ret = i2c_transfer(client->adapter, &msg, 1);
+	ret = aptina_i2c_transfer(&priv->i2c_stats, client, &msg, 1);
 	if (ret >= 0)
 		ret = 0;
 
@@ -709,7 +713,6 @@ static int mt9p031_v4l2_int_s_power(struct v4l2_int_device *s,
 {
 	struct mt9p031_priv *priv = s->priv;
 	struct i2c_client *client = priv->client;
-	
 	int ret;
 
 	switch (power) {
@@ -732,7 +735,9 @@ static int mt9p031_v4l2_int_s_power(struct v4l2_int_device *s,
 			return ret;
 		}
 		if (!(priv->flags & INIT_DONE)) {
+			aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_PROBE);
 			ret = mt9p031_detect(client);
+			aptina_i2c_end(&priv->i2c_stats);
 			if (ret < 0) {
 				dev_err(&client->dev, "Unable to detect sensor\n");
 				return ret;
@@ -740,7 +745,9 @@ static int mt9p031_v4l2_int_s_power(struct v4l2_int_device *s,
 			priv->flags |= INIT_DONE;
 		}
 
+		aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_POWER);
 		ret = mt9p031_init_camera(client);
+		aptina_i2c_end(&priv->i2c_stats);
 		if (ret < 0) {
 				dev_err(&client->dev, "Unable to initialize sensor\n");
 				return ret;
@@ -773,6 +780,7 @@ static int mt9p031_v4l2_s_ctrl(struct v4l2_int_device *s,
 		return -EINVAL;
 	lvc = &mt9p031_video_control[i];
 
+	aptina_i2c_begin(&priv->i2c_stats, APTINA_I2C_OP_CTRL);
 	switch (vc->id) {
 	case V4L2_CID_EXPOSURE:
 		retval = mt9p031_set_exposure_time(vc->value, client, lvc);
@@ -781,6 +789,7 @@ static int mt9p031_v4l2_s_ctrl(struct v4l2_int_device *s,
 		retval = mt9p031_set_gain(vc->value, client, lvc);
 		break;
 	}
+	aptina_i2c_end(&priv->i2c_stats);
 
 	return retval;
 }
@@ -1375,11 +1384,13 @@ static int mt9p031_probe(struct i2c_client *client,
 	priv->pix.pixelformat = mt9p031_formats[0].pixelformat;
 	
 	i2c_set_clientdata(client, priv);
+	aptina_i2c_stats_init(&priv->i2c_stats, client, 1);
 	
 	sysPriv.client = priv->client;
 
 	ret = v4l2_int_device_register(priv->v4l2_int_device);
 	if (ret) {
+		aptina_i2c_stats_cleanup(&priv->i2c_stats);
 		i2c_set_clientdata(client, NULL);
 		kfree(v4l2_int_device);
 		kfree(priv);
@@ -1396,6 +1407,7 @@ static int mt9p031_remove(struct i2c_client *client)
 	struct mt9p031_priv *priv = i2c_get_clientdata(client);
 
 	v4l2_int_device_unregister(priv->v4l2_int_device);
+	aptina_i2c_stats_cleanup(&priv->i2c_stats);
 	i2c_set_clientdata(client, NULL);
 	mt9p031_sysfs_rm(&client->dev.kobj);
 	
@@ -30,6 +30,7 @@
 #include <linux/videodev2.h>
 #include <linux/v4l2-mediabus.h>
 
+#include <media/aptina-i2c.h>
 #include <media/mt9v034.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
@@ -142,6 +143,8 @@ struct mt9v034 {
 	struct mt9v034_platform_data *pdata;
 	u16 chip_control;
 	u16 aec_agc;
+
+	struct aptina_i2c_stats i2c_stats;
 };
 
 #ifdef MT9V034_HEADBOARD
@@ -177,25 +180,64 @@ static struct mt9v034 *to_mt9v034(struct v4l2_subdev *sd)
 }
 
 
+/*
+ * The registers are accessed with the same messages as an SMBus word read or
+ * write, the data big endian.
+ */
 static int mt9v034_read(struct i2c_client *client, const u8 reg)
 {
-	s32 data = i2c_smbus_read_word_data(client, reg);
+	struct mt9v034 *mt9v034 = to_mt9v034(i2c_get_clientdata(client));
+	struct i2c_msg msg[2];
+	u8 addr = reg;
+	u8 buf[2];
+	int ret;
+
+	msg[0].addr  = client->addr;
+	msg[0].flags = 0;
+	msg[0].len   = 1;
+	msg[0].buf   = &addr;
+
+	msg[1].addr  = client->addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].len   = 2;
+	msg[1].buf   = buf;
+
+	ret = aptina_i2c_transfer(&mt9v034->i2c_stats, client, msg, 2);
+	if (ret < 0)
+		return ret;
+
 	dev_dbg(&client->dev, "%s: read 0x%04x from 0x%02x\n", __func__,
-		swab16(data), reg);
-	return data < 0 ? data : swab16(data);
+		(buf[0] << 8) | buf[1], reg);
+	return (buf[0] << 8) | buf[1];
 }
 
 static int mt9v034_write(struct i2c_client *client, const u8 reg,
 			 u16 data)
 {
+	struct mt9v034 *mt9v034 = to_mt9v034(i2c_get_clientdata(client));
+	struct i2c_msg msg;
+	u8 buf[3];
 	int ret;
+
 	dev_dbg(&client->dev, "%s: writing 0x%04x to 0x%02x\n", __func__,
 		data, reg);
-	ret = i2c_smbus_write_word_data(client, reg, swab16(data));
-	if (ret < 0)
+
+	buf[0] = reg;
+	buf[1] = data >> 8;
+	buf[2] = data & 0xff;
+
+	msg.addr  = client->addr;
+	msg.flags = 0;
+	msg.len   = 3;
+	msg.buf   = buf;
+
+	ret = aptina_i2c_transfer(&mt9v034->i2c_stats, client, &msg, 1);
+	if (ret < 0) {
 		printk(KERN_ERR"MT9V034: writing 0x%04x to 0x%02x failed\n", data, reg);
+		return ret;
+	}
 
-	return ret;
+	return 0;
 }
 
 static int mt9v034_set_chip_control(struct mt9v034 *mt9v034, u16 clear, u16 set)
@@ -325,7 +367,7 @@ __mt9v034_get_pad_crop(struct mt9v034 *mt9v034, struct v4l2_subdev_fh *fh,
 	}
 }
 
-static int mt9v034_s_stream(struct v4l2_subdev *subdev, int enable)
+static int __mt9v034_s_stream(struct v4l2_subdev *subdev, int enable)
 {
 	const u16 mode = MT9V034_CHIP_CONTROL_MASTER_MODE
 		       | MT9V034_CHIP_CONTROL_DOUT_ENABLE
@@ -376,6 +418,18 @@ static int mt9v034_s_stream(struct v4l2_subdev *subdev, int enable)
 	return mt9v034_set_chip_control(mt9v034, 0, mode);
 }
 
+static int mt9v034_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct mt9v034 *mt9v034 = to_mt9v034(subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9v034->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __mt9v034_s_stream(subdev, enable);
+	aptina_i2c_end(&mt9v034->i2c_stats);
+
+	return ret;
+}
+
 static int mt9v034_enum_mbus_code(struct v4l2_subdev *subdev,
 				  struct v4l2_subdev_fh *fh,
 				  struct v4l2_subdev_mbus_code_enum *code)
@@ -512,7 +566,7 @@ static int mt9v034_set_crop(struct v4l2_subdev *subdev,
 
 #define V4L2_CID_TEST_PATTERN		(V4L2_CID_USER_BASE | 0x1001)
 
-static int mt9v034_s_ctrl(struct v4l2_ctrl *ctrl)
+static int __mt9v034_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct mt9v034 *mt9v034 =
 			container_of(ctrl->handler, struct mt9v034, ctrls);
@@ -566,6 +620,19 @@ static int mt9v034_s_ctrl(struct v4l2_ctrl *ctrl)
 	return 0;
 }
 
+static int mt9v034_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct mt9v034 *mt9v034 =
+			container_of(ctrl->handler, struct mt9v034, ctrls);
+	int ret;
+
+	aptina_i2c_begin(&mt9v034->i2c_stats, APTINA_I2C_OP_CTRL);
+	ret = __mt9v034_s_ctrl(ctrl);
+	aptina_i2c_end(&mt9v034->i2c_stats);
+
+	return ret;
+}
+
 static struct v4l2_ctrl_ops mt9v034_ctrl_ops = {
 	.s_ctrl = mt9v034_s_ctrl,
 };
@@ -594,6 +661,7 @@ static int mt9v034_set_power(struct v4l2_subdev *subdev, int on)
 	int ret = 0;
 
 	mutex_lock(&mt9v034->power_lock);
+	aptina_i2c_begin(&mt9v034->i2c_stats, APTINA_I2C_OP_POWER);
 
 	/* If the power count is modified from 0 to != 0 or from != 0 to 0,
 	 * update the power state.
@@ -609,6 +677,7 @@ static int mt9v034_set_power(struct v4l2_subdev *subdev, int on)
 	WARN_ON(mt9v034->power_count < 0);
 
 done:
+	aptina_i2c_end(&mt9v034->i2c_stats);
 	mutex_unlock(&mt9v034->power_lock);
 	return ret;
 }
@@ -617,7 +686,7 @@ done:
  * V4L2 subdev internal operations
  */
 
-static int mt9v034_registered(struct v4l2_subdev *subdev)
+static int __mt9v034_registered(struct v4l2_subdev *subdev)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(subdev);
 	struct mt9v034 *mt9v034 = to_mt9v034(subdev);
@@ -649,6 +718,18 @@ static int mt9v034_registered(struct v4l2_subdev *subdev)
 	return ret;
 }
 
+static int mt9v034_registered(struct v4l2_subdev *subdev)
+{
+	struct mt9v034 *mt9v034 = to_mt9v034(subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9v034->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __mt9v034_registered(subdev);
+	aptina_i2c_end(&mt9v034->i2c_stats);
+
+	return ret;
+}
+
 static int mt9v034_open(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh)
 {
 	struct v4l2_mbus_framefmt *format;
@@ -715,10 +796,9 @@ static int mt9v034_probe(struct i2c_client *client,
 	unsigned int i;
 	int ret;
 
-	if (!i2c_check_functionality(client->adapter,
-				     I2C_FUNC_SMBUS_WORD_DATA)) {
+	if (!i2c_check_functionality(client->adapter, I2C_FUNC_I2C)) {
 		dev_warn(&client->adapter->dev,
-			 "I2C-Adapter doesn't support I2C_FUNC_SMBUS_WORD\n");
+			 "I2C-Adapter doesn't support I2C_FUNC_I2C\n");
 		return -EIO;
 	}
 
@@ -767,13 +847,16 @@ static int mt9v034_probe(struct i2c_client *client,
 	mt9v034->aec_agc = MT9V034_AEC_ENABLE | MT9V034_AGC_ENABLE;
 
 	v4l2_i2c_subdev_init(&mt9v034->subdev, client, &mt9v034_subdev_ops);
+	aptina_i2c_stats_init(&mt9v034->i2c_stats, client, 1);
 	mt9v034->subdev.internal_ops = &mt9v034_subdev_internal_ops;
 	mt9v034->subdev.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
 
 	mt9v034->pad.flags = MEDIA_PAD_FL_SOURCE;
 	ret = media_entity_init(&mt9v034->subdev.entity, 1, &mt9v034->pad, 0);
-	if (ret < 0)
+	if (ret < 0) {
+		aptina_i2c_stats_cleanup(&mt9v034->i2c_stats);
 		kfree(mt9v034);
+	}
 
 	return ret;
 }
@@ -785,6 +868,7 @@ static int mt9v034_remove(struct i2c_client *client)
 
 	v4l2_device_unregister_subdev(subdev);
 	media_entity_cleanup(&subdev->entity);
+	aptina_i2c_stats_cleanup(&mt9v034->i2c_stats);
 	kfree(mt9v034);
 	return 0;
 }
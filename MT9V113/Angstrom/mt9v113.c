@@ -24,6 +24,7 @@
 #include <linux/module.h>
 #include <linux/videodev2.h>
 
+#include <media/aptina-i2c.h>
 #include <media/mt9v113.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
@@ -114,8 +115,6 @@
 #define MT9V113_8BIT_WALKING1		0x0020
 #define MT9V113_10BIT_WALKING1		0x0060
 
-#undef MT9V113_I2C_DEBUG
-
 struct mt9v113_frame_size {
 	u16 width;
 	u16 height;
@@ -131,6 +130,7 @@ struct mt9v113_priv {
 	struct mutex power_lock; /* lock to protect power_count */
 	struct mt9v113_pll_divs *pll;
 	int power_count;
+	struct aptina_i2c_stats i2c_stats;
 };
 
 static unsigned int mt9v113_lsc1[4] = {
@@ -216,7 +216,8 @@ static int mt9v113_read(struct i2c_client *client, u16 addr)
 	* it means error.
 	* else, under 16bit is valid data.
 	*/
-	ret = i2c_transfer(client->adapter, msg, 2);
+	ret = aptina_i2c_transfer(&to_mt9v113(client)->i2c_stats, client,
+				  msg, 2);
 
 	if (ret < 0) {
 		v4l_err(client, "Read from offset 0x%x error %d", addr, ret);
@@ -256,13 +257,10 @@ static int mt9v113_write(struct i2c_client *client, u16 addr,
 	msg.buf   = buf;
 
 	/* i2c_transfer returns message length, but function should return 0 */
-	ret = i2c_transfer(client->adapter, &msg, 1);
-	if (ret >= 0){
-#ifdef MT9V113_I2C_DEBUG
-		printk(KERN_INFO"REG=0x%04X, 0x%04X\n", addr,data);
-#endif
+	ret = aptina_i2c_transfer(&to_mt9v113(client)->i2c_stats, client,
+				  &msg, 1);
+	if (ret >= 0)
 		return 0;
-	}
 
 	v4l_err(client, "Write failed at 0x%x error %d\n", addr, ret);
 	return ret;
@@ -296,13 +294,10 @@ static int mt9v113_write_8(struct i2c_client *client, u16 addr,
 	msg.buf   = buf;
 
 	/* i2c_transfer returns message length, but function should return 0 */
-	ret = i2c_transfer(client->adapter, &msg, 1);
-	if (ret >= 0){
-#ifdef MT9V113_I2C_DEBUG
-		printk(KERN_INFO"REG8=0x%04X, 0x%04X\n", addr, data);
-#endif
+	ret = aptina_i2c_transfer(&to_mt9v113(client)->i2c_stats, client,
+				  &msg, 1);
+	if (ret >= 0)
 		return 0;
-	}
 
 	v4l_err(client, "Write failed at 0x%x error %d\n", addr, ret);
 	return ret;
@@ -427,7 +422,7 @@ static int mt9v113_update_read_mode(struct i2c_client *client, u16 data)
 	return mt9v113_write(client, MT9V113_MCU_DATA_0, data);
 }
 
-static int mt9v113_s_ctrl(struct v4l2_ctrl *ctrl)
+static int __mt9v113_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct mt9v113_priv *mt9v113 = container_of(ctrl->handler,
 					struct mt9v113_priv, ctrls);
@@ -517,6 +512,19 @@ static int mt9v113_s_ctrl(struct v4l2_ctrl *ctrl)
 	return mt9v113_write(client, MT9V113_MCU_DATA_0, MT9V113_REFRESH);
 }
 
+static int mt9v113_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct mt9v113_priv *mt9v113 = container_of(ctrl->handler,
+					struct mt9v113_priv, ctrls);
+	int ret;
+
+	aptina_i2c_begin(&mt9v113->i2c_stats, APTINA_I2C_OP_CTRL);
+	ret = __mt9v113_s_ctrl(ctrl);
+	aptina_i2c_end(&mt9v113->i2c_stats);
+
+	return ret;
+}
+
 static struct v4l2_ctrl_ops mt9v113_ctrl_ops = {
 	.s_ctrl = mt9v113_s_ctrl,
 };
@@ -613,6 +621,7 @@ static int mt9v113_s_power(struct v4l2_subdev *sd, int on)
 	int ret = 0;
 
 	mutex_lock(&mt9v113->power_lock);
+	aptina_i2c_begin(&mt9v113->i2c_stats, APTINA_I2C_OP_POWER);
 
 	/*
 	* If the power count is modified from 0 to != 0 or from != 0 to 0,
@@ -637,6 +646,7 @@ static int mt9v113_s_power(struct v4l2_subdev *sd, int on)
 	mt9v113->power_count += on ? 1 : -1;
 	WARN_ON(mt9v113->power_count < 0);
 out:
+	aptina_i2c_end(&mt9v113->i2c_stats);
 	mutex_unlock(&mt9v113->power_lock);
 	return ret;
 }
@@ -1060,7 +1070,7 @@ static int mt9v113_set_resolution(struct i2c_client *client, struct mt9v113_fram
 	return mt9v113_write(client, MT9V113_MCU_DATA_0, MT9V113_REFRESH);
 }
 
-static int mt9v113_s_stream(struct v4l2_subdev *sd, int enable)
+static int __mt9v113_s_stream(struct v4l2_subdev *sd, int enable)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct mt9v113_priv *mt9v113 = container_of(sd,
@@ -1124,6 +1134,19 @@ static int mt9v113_s_stream(struct v4l2_subdev *sd, int enable)
 	return mt9v113_write(client, MT9V113_MCU_DATA_0, MT9V113_REFRESH);
 }
 
+static int mt9v113_s_stream(struct v4l2_subdev *sd, int enable)
+{
+	struct mt9v113_priv *mt9v113 = container_of(sd,
+				struct mt9v113_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9v113->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __mt9v113_s_stream(sd, enable);
+	aptina_i2c_end(&mt9v113->i2c_stats);
+
+	return ret;
+}
+
 
 /***************************************************
 		v4l2_subdev_pad_ops
@@ -1305,7 +1328,7 @@ static int mt9v113_set_crop(struct v4l2_subdev *sd,
 /***********************************************************
 	V4L2 subdev internal operations
 ************************************************************/
-static int mt9v113_registered(struct v4l2_subdev *sd)
+static int __mt9v113_registered(struct v4l2_subdev *sd)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct mt9v113_priv *mt9v113 = to_mt9v113(client);
@@ -1333,6 +1356,19 @@ static int mt9v113_registered(struct v4l2_subdev *sd)
 	return 0;
 }
 
+static int mt9v113_registered(struct v4l2_subdev *sd)
+{
+	struct mt9v113_priv *mt9v113 = container_of(sd,
+				struct mt9v113_priv, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9v113->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __mt9v113_registered(sd);
+	aptina_i2c_end(&mt9v113->i2c_stats);
+
+	return ret;
+}
+
 static int mt9v113_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 {
 	return mt9v113_s_power(sd, 1);
@@ -1432,6 +1468,7 @@ static int mt9v113_probe(struct i2c_client *client,
 
 	mutex_init(&mt9v113->power_lock);
 	v4l2_i2c_subdev_init(&mt9v113->subdev, client, &mt9v113_subdev_ops);
+	aptina_i2c_stats_init(&mt9v113->i2c_stats, client, 2);
 	mt9v113->subdev.internal_ops = &mt9v113_subdev_internal_ops;
 	mt9v113->subdev.ctrl_handler = &mt9v113->ctrls;
 
@@ -1457,6 +1494,7 @@ done:
 	if (ret < 0) {
 		v4l2_ctrl_handler_free(&mt9v113->ctrls);
 		media_entity_cleanup(&mt9v113->subdev.entity);
+		aptina_i2c_stats_cleanup(&mt9v113->i2c_stats);
 		dev_err(&client->dev, "Probe failed\n");
 	}
 
@@ -1471,6 +1509,7 @@ static int mt9v113_remove(struct i2c_client *client)
 	v4l2_ctrl_handler_free(&mt9v113->ctrls);
 	v4l2_device_unregister_subdev(subdev);
 	media_entity_cleanup(&subdev->entity);
+	aptina_i2c_stats_cleanup(&mt9v113->i2c_stats);
 
 	return 0;
 }
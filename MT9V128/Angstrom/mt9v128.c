@@ -31,6 +31,7 @@
 #include <media/v4l2-subdev.h>
 #include <linux/videodev2.h>
 
+#include <media/aptina-i2c.h>
 #include <media/mt9v128.h>
 #include <media/v4l2-chip-ident.h>
 #include <media/v4l2-ctrls.h>
@@ -139,6 +140,7 @@ struct mt9v128 {
        	/* cache register values */
  	u16 output_control;
 
+	struct aptina_i2c_stats i2c_stats;
 };
 
 /**************************supported sizes******************************/
@@ -209,14 +211,16 @@ static int reg_read(struct i2c_client *client, const u16 command)
 	msg[0].flags = 0;
 	msg[0].len = 2;
 	msg[0].buf = buf;
-	ret = i2c_transfer(client->adapter, &msg[0], 1);
+	ret = aptina_i2c_transfer(&to_mt9v128(client)->i2c_stats, client,
+				  &msg[0], 1);
 
 	if (ret >= 0) {
 		msg[1].addr = client->addr;
 		msg[1].flags = I2C_M_RD; //1
 		msg[1].len = 2;
 		msg[1].buf = buf;
-		ret = i2c_transfer(client->adapter, &msg[1], 1);
+		ret = aptina_i2c_transfer(&to_mt9v128(client)->i2c_stats,
+					  client, &msg[1], 1);
 	}
 	/*
 	 * if return value of this function is < 0,
@@ -259,7 +263,8 @@ static int reg_write(struct i2c_client *client, const u16 command,
 	msg.buf = buf;
 
 	/* i2c_transfer return message length, but this function should return 0 if correct case */
-	ret = i2c_transfer(client->adapter, &msg, 1);
+	ret = aptina_i2c_transfer(&to_mt9v128(client)->i2c_stats, client,
+				  &msg, 1);
 	if (ret >= 0)
 		return 0;
 	else
@@ -443,6 +448,7 @@ static int mt9v128_set_power(struct v4l2_subdev *sd, int on)
 	int ret = 0;
 
 	mutex_lock(&mt9v128->power_lock);
+	aptina_i2c_begin(&mt9v128->i2c_stats, APTINA_I2C_OP_POWER);
 	/*
 	* If the power count is modified from 0 to != 0 or from != 0 to 0,
 	* update the power state.
@@ -463,11 +469,12 @@ static int mt9v128_set_power(struct v4l2_subdev *sd, int on)
 	mt9v128->power_count += on ? 1 : -1;
 	WARN_ON(mt9v128->power_count<  0);
 out:
+	aptina_i2c_end(&mt9v128->i2c_stats);
 	mutex_unlock(&mt9v128->power_lock);
 	return ret;
 }
 
-static int mt9v128_registered(struct v4l2_subdev *sd)
+static int __mt9v128_registered(struct v4l2_subdev *sd)
 {	
        	struct mt9v128 *mt9v128 = container_of(sd, struct mt9v128, subdev);
        	struct i2c_client *client = v4l2_get_subdevdata(&mt9v128->subdev);
@@ -484,6 +491,18 @@ static int mt9v128_registered(struct v4l2_subdev *sd)
        	return ret;
 }
 
+static int mt9v128_registered(struct v4l2_subdev *sd)
+{
+	struct mt9v128 *mt9v128 = container_of(sd, struct mt9v128, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9v128->i2c_stats, APTINA_I2C_OP_PROBE);
+	ret = __mt9v128_registered(sd);
+	aptina_i2c_end(&mt9v128->i2c_stats);
+
+	return ret;
+}
+
 static int mt9v128_setup_sensor_output(struct mt9v128 *mt9v128, u16 width, u16 height)
 {
 	int ret = 0, count;
@@ -996,7 +1015,7 @@ static int mt9v128_setup_sensor_output(struct mt9v128 *mt9v128, u16 width, u16 h
 	return ret;
 }
 
-static int mt9v128_s_stream(struct v4l2_subdev *sd, int enable)
+static int __mt9v128_s_stream(struct v4l2_subdev *sd, int enable)
 {	   
 	struct mt9v128 *mt9v128 = container_of(sd, struct mt9v128, subdev);
 	struct v4l2_rect *rect = &mt9v128->rect;
@@ -1010,6 +1029,18 @@ static int mt9v128_s_stream(struct v4l2_subdev *sd, int enable)
 	return mt9v128_setup_sensor_output(mt9v128, rect->width, rect->height);
 }
 
+static int mt9v128_s_stream(struct v4l2_subdev *sd, int enable)
+{
+	struct mt9v128 *mt9v128 = container_of(sd, struct mt9v128, subdev);
+	int ret;
+
+	aptina_i2c_begin(&mt9v128->i2c_stats, APTINA_I2C_OP_STREAM);
+	ret = __mt9v128_s_stream(sd, enable);
+	aptina_i2c_end(&mt9v128->i2c_stats);
+
+	return ret;
+}
+
 static int mt9v128_get_format(struct v4l2_subdev *sd,
                                struct v4l2_subdev_fh *fh,
                                struct v4l2_subdev_format *fmt)
@@ -1125,12 +1156,15 @@ static int mt9v128_probe(struct i2c_client *client,
 
 	mutex_init(&mt9v128->power_lock);
 	v4l2_i2c_subdev_init(&mt9v128->subdev, client, &mt9v128_subdev_ops);
+	aptina_i2c_stats_init(&mt9v128->i2c_stats, client, 2);
 	mt9v128->subdev.internal_ops = &mt9v128_subdev_internal_ops;
 
        	mt9v128->pad.flags = MEDIA_PAD_FL_SOURCE;
        	ret = media_entity_init(&mt9v128->subdev.entity, 1, &mt9v128->pad, 0);
-       	if (ret)
+       	if (ret) {
+		aptina_i2c_stats_cleanup(&mt9v128->i2c_stats);
                	return ret;
+	}
 
        	mt9v128->subdev.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
 
@@ -1151,6 +1185,7 @@ static int mt9v128_remove(struct i2c_client *client)
 
 	v4l2_device_unregister_subdev(sd);
        	media_entity_cleanup(&sd->entity);
+	aptina_i2c_stats_cleanup(&mt9v128->i2c_stats);
        	kfree(mt9v128);
        	return 0;
 }
@@ -0,0 +1,227 @@
+#!/bin/sh
+#
+# Golden register sequence and bus cost regression for the sensor drivers.
+#
+# Copyright (C) 2012 Aptina Imaging
+#
+# Runs every emulated sensor through probe, then power on, set format,
+# stream on, stream off and power off for each of the modes its driver
+# enumerates, on the sensor-emu I2C emulator. Every run starts from a freshly
+# probed sensor and a reset register file. The register accesses are compared
+# with the golden traces, and the transfers, bytes and modelled bus time of
+# every operation with the golden statistics.
+#
+# The emulator is the sensor-emu module, or with -e its host build, which
+# runs the same sources without a kernel.
+#
+# Exit status: 0 if everything matches, 1 on a register sequence change or
+# a bus cost increase beyond the threshold, 2 if the emulator can't be used.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+#
+
+root=/sys/kernel/debug
+params=/sys/module/sensor_emu/parameters
+golden=$(dirname "$0")/golden
+emulator=
+threshold=5
+bus_khz=100
+update=0
+status=0
+
+usage() {
+	echo "Usage: $0 [-u] [-e program] [-g golden] [-t threshold] [-b bus_khz] [sensor ...]"
+	echo "  -u  record the golden files instead of checking them"
+	echo "  -e  run the host build of the emulator, sensor-emu-host"
+	echo "  -g  golden files directory, default $golden"
+	echo "  -t  allowed bus cost increase in percent, default $threshold"
+	echo "  -b  modelled bus clock in kHz, default $bus_khz"
+	exit 2
+}
+
+cmd() {
+	if ! echo "$2" > "$1/command"; then
+		echo "$(basename "$1"): '$2' failed" >&2
+		return 1
+	fi
+}
+
+# Debugfs directory of a sensor, in $dir.
+sensor_dir() {
+	dir=$(ls -d "$root/sensor-emu/$1"-* 2>/dev/null | head -n 1)
+}
+
+# Run commands on a sensor and leave its debugfs directory in $dir. The host
+# build runs them in a new process and writes the debugfs files to $root.
+run() {
+	sensor=$1
+	shift
+
+	if [ -n "$emulator" ]; then
+		rm -rf "$root"
+		"$emulator" -p sensor_emu.sensor="$sensor" \
+			-p sensor_emu.bus_khz="$bus_khz" \
+			-p sensor_emu.busy_polls=1 "$root" "$@" || return 1
+		sensor_dir "$sensor"
+		return
+	fi
+
+	sensor_dir "$sensor"
+	if [ -z "$dir" ]; then
+		echo "$sensor: not emulated, load sensor-emu with sensor=$sensor" >&2
+		status=2
+		return 1
+	fi
+
+	for c in "$@"; do
+		cmd "$dir" "$c" || return 1
+	done
+}
+
+# Register accesses without the bus time, which the statistics cover.
+trace() {
+	awk '{ $2 = ""; print }' "$1/trace"
+}
+
+# Operation, transfers, bytes and bus time of the operations that used the bus.
+stats() {
+	awk 'NR > 2 && $1 != "total" && $1 != "records" && $3 > 0 {
+		print $1, $3, $5, $9
+	}' "$1/stats"
+}
+
+compare_stats() {
+	awk -v limit="$threshold" -v name="$1" '
+	FILENAME == ARGV[1] { transfers[$1] = $2; bus[$1] = $4; next }
+	{
+		ref = ($1 in bus) ? bus[$1] : ""
+		delta = ref ? ($4 - ref) * 100 / ref : 0
+		mark = ""
+		if (ref != "" && (delta > limit ||
+				  $2 > transfers[$1] * (1 + limit / 100))) {
+			mark = " REGRESSION"
+			fail = 1
+		}
+		printf "%-20s %-6s %9u %8u %10u %10s %+7.1f%%%s\n", name, $1,
+		       $2, $3, $4, ref == "" ? "-" : ref, delta, mark
+	}
+	END { exit fail }' "$2" "$3"
+}
+
+# Check or record a file of the last run against its golden copy.
+check_file() {
+	if [ $update = 1 ]; then
+		cp "$tmp/$1" "$golden/"
+		return
+	fi
+
+	if [ ! -f "$golden/$1" ]; then
+		echo "$1: no golden file, record it with -u" >&2
+		status=1
+		return
+	fi
+
+	if ! diff -u "$golden/$1" "$tmp/$1" > "$tmp/$1.diff"; then
+		echo "$1: $2 changed" >&2
+		cat "$tmp/$1.diff" >&2
+		status=1
+	fi
+}
+
+# Check or record the trace and statistics of the last run.
+check() {
+	name=$1
+
+	trace "$dir" > "$tmp/$name.trace"
+	stats "$dir" > "$tmp/$name.stats"
+
+	check_file "$name.trace" "register sequence"
+
+	if [ $update = 1 ]; then
+		cp "$tmp/$name.stats" "$golden/"
+		compare_stats "$name" /dev/null "$tmp/$name.stats"
+	elif [ -f "$golden/$name.stats" ]; then
+		compare_stats "$name" "$golden/$name.stats" "$tmp/$name.stats" ||
+			status=1
+	fi
+}
+
+run_sensor() {
+	sensor=$1
+
+	if ! run "$sensor" remove reset clear probe; then
+		echo "$sensor: probe failed" >&2
+		[ $status = 0 ] && status=1
+		return
+	fi
+	check "$sensor-probe"
+
+	# Modes enumerated by the driver, one WIDTHxHEIGHT and bus code per line
+	cp "$dir/modes" "$tmp/$sensor.modes" 2>/dev/null
+	check_file "$sensor.modes" "mode list"
+
+	for mode in $(cut -d ' ' -f 1 "$tmp/$sensor.modes"); do
+		if ! run "$sensor" remove reset probe reset clear "power 1" \
+			"format $mode" "stream 1" "stream 0" "power 0"; then
+			echo "$sensor: $mode failed" >&2
+			status=1
+			continue
+		fi
+		check "$sensor-$mode"
+	done
+}
+
+while getopts "ue:g:t:b:" opt; do
+	case $opt in
+	u)	update=1 ;;
+	e)	emulator=$OPTARG ;;
+	g)	golden=$OPTARG ;;
+	t)	threshold=$OPTARG ;;
+	b)	bus_khz=$OPTARG ;;
+	*)	usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+mkdir -p "$golden" || exit 2
+tmp=$(mktemp -d) || exit 2
+trap 'rm -rf "$tmp"' EXIT
+
+if [ -n "$emulator" ]; then
+	case $emulator in
+	*/*)	;;
+	*)	emulator=./$emulator ;;
+	esac
+	root=$tmp/debugfs
+	# Without commands, lists the sensors emulated by default.
+	"$emulator" "$root" || exit 2
+else
+	if [ ! -d "$root/sensor-emu" ]; then
+		echo "$root/sensor-emu not found, mount debugfs and load sensor-emu" >&2
+		exit 2
+	fi
+	# The golden files are only comparable with the same bus model.
+	echo "$bus_khz" > "$params/bus_khz" &&
+		echo 1 > "$params/busy_polls" || exit 2
+fi
+
+# The MT9P031 is a bus model only, its driver can't be probed.
+sensors=$*
+if [ -z "$sensors" ]; then
+	for dir in "$root"/sensor-emu/*-*; do
+		sensor=$(basename "$dir")
+		sensor=${sensor%-*}
+		[ "$sensor" != mt9p031 ] && sensors="$sensors $sensor"
+	done
+fi
+
+printf "%-20s %-6s %9s %8s %10s %10s %8s\n" "run" "op" "transfers" "bytes" \
+	"bus(us)" "golden" "delta"
+
+for sensor in $sensors; do
+	run_sensor "$sensor"
+done
+
+exit $status
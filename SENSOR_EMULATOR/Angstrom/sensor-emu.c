@@ -0,0 +1,1390 @@
+/*
+ *
+ * Aptina sensor I2C emulator
+ *
+ * Copyright (C) 2012 Aptina Imaging
+ *
+ * Emulated I2C adapters serving the register maps of the Aptina sensors, to
+ * run the sensor drivers probe, power, format, stream and control paths on a
+ * machine without the head board, and to measure what they cost on the bus.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/debugfs.h>
+#include <linux/i2c.h>
+#include <linux/kernel.h>
+#include <linux/kmod.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/videodev2.h>
+
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-device.h>
+#include <media/v4l2-subdev.h>
+
+/*
+ * Platform data handed to the drivers. Clock and reset callbacks have nothing
+ * to drive, the register file is always powered.
+ */
+static int sensor_emu_set_xclk(struct v4l2_subdev *subdev, int hz)
+{
+	return 0;
+}
+
+static int sensor_emu_reset_gpio(struct v4l2_subdev *subdev, int active)
+{
+	return 0;
+}
+
+#if defined(CONFIG_VIDEO_MT9M034) || defined(CONFIG_VIDEO_MT9M034_MODULE)
+#include <media/mt9m034.h>
+static struct mt9m034_platform_data sensor_emu_mt9m034_pdata = {
+	.set_xclk	= sensor_emu_set_xclk,
+	.reset		= sensor_emu_reset_gpio,
+	.ext_freq	= 24000000,
+	.target_freq	= 48000000,
+	.version	= MT9M034_COLOR_VERSION,
+};
+#define MT9M034_PDATA	(&sensor_emu_mt9m034_pdata)
+#else
+#define MT9M034_PDATA	NULL
+#endif
+
+#if defined(CONFIG_VIDEO_AR0130) || defined(CONFIG_VIDEO_AR0130_MODULE)
+#include <media/ar0130.h>
+static struct ar0130_platform_data sensor_emu_ar0130_pdata = {
+	.set_xclk	= sensor_emu_set_xclk,
+	.reset		= sensor_emu_reset_gpio,
+	.ext_freq	= 24000000,
+	.target_freq	= 48000000,
+	.version	= AR0130_COLOR_VERSION,
+};
+#define AR0130_PDATA	(&sensor_emu_ar0130_pdata)
+#else
+#define AR0130_PDATA	NULL
+#endif
+
+#if defined(CONFIG_VIDEO_MT9V113) || defined(CONFIG_VIDEO_MT9V113_MODULE)
+#include <media/mt9v113.h>
+static struct mt9v113_platform_data sensor_emu_mt9v113_pdata = {
+	.set_xclk	= sensor_emu_set_xclk,
+	.reset		= sensor_emu_reset_gpio,
+	.ext_freq	= 13500000,
+	.target_freq	= 27000000,
+};
+#define MT9V113_PDATA	(&sensor_emu_mt9v113_pdata)
+#else
+#define MT9V113_PDATA	NULL
+#endif
+
+#if defined(CONFIG_VIDEO_AP0100) || defined(CONFIG_VIDEO_AP0100_MODULE)
+#include <media/ap0100.h>
+static struct ap0100_platform_data sensor_emu_ap0100_pdata = {
+	.set_xclk	= sensor_emu_set_xclk,
+	.reset		= sensor_emu_reset_gpio,
+	.ext_freq	= 24000000,
+	.target_freq	= 74000000,
+};
+#define AP0100_PDATA	(&sensor_emu_ap0100_pdata)
+#else
+#define AP0100_PDATA	NULL
+#endif
+
+#define SENSOR_EMU_REGS			65536
+#define SENSOR_EMU_SEQ_SIZE		512
+
+/* Registers shared by the Aptina bayer sensors */
+#define APTINA_CHIP_ID_REG		0x3000
+#define APTINA_RESET_REG		0x301A
+#define APTINA_SEQ_DATA_PORT		0x3086
+#define APTINA_SEQ_CTRL_PORT		0x3088
+
+/* SOC and co-processor registers */
+#define SOC_CHIP_ID_REG			0x0000
+#define SOC_PLL_CONTROL			0x0014
+#define SOC_RESET_REG			0x001A
+#define SOC_MCU_ADDRESS			0x098C
+#define SOC_MCU_DATA_0			0x0990
+#define SOC_MCU_DATA_7			0x099E
+#define SOC_SEQ_CMD			0x0103
+
+#define AP0100_COMMAND_REGISTER		0x0040
+#define AP0100_CMD_PARAM_0		0xFC00
+#define AP0100_DOORBELL			0x8000
+#define AP0100_SET_STATE		0x8100
+#define AP0100_GET_STATE		0x8101
+#define AP0100_ENOERR			0x0000
+#define AP0100_EINVAL			0x000C
+
+#define MT9P031_CHIP_VERSION		0x00
+#define MT9P031_RESET			0x0D
+#define MT9P031_CHIP_VERSION_ALT	0xFF
+
+enum sensor_emu_op {
+	SENSOR_EMU_OP_IDLE,
+	SENSOR_EMU_OP_PROBE,
+	SENSOR_EMU_OP_POWER,
+	SENSOR_EMU_OP_FORMAT,
+	SENSOR_EMU_OP_STREAM,
+	SENSOR_EMU_OP_CTRL,
+	SENSOR_EMU_OP_COUNT,
+};
+
+static const char * const sensor_emu_op_names[SENSOR_EMU_OP_COUNT] = {
+	"idle", "probe", "power", "format", "stream", "ctrl",
+};
+
+#define SENSOR_EMU_READ		(1 << 0)
+#define SENSOR_EMU_8BIT		(1 << 1)
+#define SENSOR_EMU_BURST	(1 << 2)	/* not the first access of the transfer */
+
+/*
+ * struct sensor_emu_record - one register access
+ * @time: modelled bus time at the start of the transfer, in ns
+ * @reg: register address as sent by the driver
+ * @value: value written or read
+ * @flags: SENSOR_EMU_READ, SENSOR_EMU_8BIT, SENSOR_EMU_BURST
+ * @op: operation that issued the access
+ */
+struct sensor_emu_record {
+	u64 time;
+	u16 reg;
+	u16 value;
+	u8 flags;
+	u8 op;
+};
+
+struct sensor_emu_stats {
+	unsigned int calls;
+	unsigned int transfers;
+	unsigned int messages;
+	unsigned int bytes;
+	unsigned int reads;
+	unsigned int writes;
+	unsigned int nacks;
+	u64 bus_ns;
+	u64 wall_ns;
+};
+
+struct sensor_emu_reg {
+	u16 reg;
+	u16 value;
+};
+
+struct sensor_emu;
+
+/*
+ * struct sensor_emu_model - sensor register map
+ * @name: I2C device and driver module name
+ * @addr: 7-bit I2C address
+ * @reg_bytes: register address size, 2 for byte addressed 16-bit maps, 1 for
+ *	word addressed 8-bit maps
+ * @defaults: power-on values of the registers the drivers read back
+ * @access: register side effects, called after a write is stored or before a
+ *	read is returned. Return 1 if the register is a port that doesn't
+ *	advance the auto-increment address.
+ * @pdata: driver platform data, NULL if the driver isn't configured
+ */
+struct sensor_emu_model {
+	const char *name;
+	u16 addr;
+	unsigned int reg_bytes;
+	const struct sensor_emu_reg *defaults;
+	unsigned int num_defaults;
+	int (*access)(struct sensor_emu *emu, u16 reg, u16 *value,
+		      unsigned int width, bool read);
+	void *pdata;
+};
+
+struct sensor_emu {
+	const struct sensor_emu_model *model;
+	struct i2c_adapter adap;
+	struct i2c_client *client;
+	struct v4l2_device v4l2_dev;
+	struct v4l2_subdev *sd;
+	struct dentry *debugfs;
+
+	struct mutex lock;	/* protects the bus state below */
+	struct mutex cmd_lock;	/* serializes commands */
+
+	u8 regs[SENSOR_EMU_REGS];
+	unsigned int ptr;	/* auto-increment address, byte index */
+
+	u16 seq[SENSOR_EMU_SEQ_SIZE];
+	unsigned int seq_index;
+
+	u16 mcu_addr;
+	u16 vars[0x2000];
+
+	u16 ap0100_state;
+
+	/* Handshake in progress, see sensor_emu_hold() */
+	u32 hold_key;
+	u16 hold_value;
+	unsigned int hold_reads;
+
+	enum sensor_emu_op op;
+	u64 bus_ns;
+	struct sensor_emu_stats stats[SENSOR_EMU_OP_COUNT];
+
+	struct sensor_emu_record *records;
+	unsigned int num_records;
+	unsigned int dropped;
+};
+
+#define SENSOR_EMU_MAX			8
+
+static char *sensor[SENSOR_EMU_MAX] = { "mt9m034", "mt9v113", "ap0100", "ar0130" };
+static unsigned int num_sensors = 4;
+module_param_array(sensor, charp, &num_sensors, 0444);
+MODULE_PARM_DESC(sensor, "Emulated sensors, one adapter each");
+
+static unsigned int bus_khz = 100;
+module_param(bus_khz, uint, 0644);
+MODULE_PARM_DESC(bus_khz, "Modelled bus clock in kHz (100 or 400)");
+
+static unsigned int busy_polls = 1;
+module_param(busy_polls, uint, 0644);
+MODULE_PARM_DESC(busy_polls, "Reads a command or PLL lock stays busy for");
+
+static unsigned int max_records = 16384;
+module_param(max_records, uint, 0444);
+MODULE_PARM_DESC(max_records, "Register accesses recorded per sensor");
+
+static struct sensor_emu *sensor_emus[SENSOR_EMU_MAX];
+static struct dentry *sensor_emu_debugfs;
+
+/************************************************************************
+			Register file
+************************************************************************/
+static unsigned int sensor_emu_index(struct sensor_emu *emu, u16 reg)
+{
+	return emu->model->reg_bytes == 1 ? reg * 2 : reg;
+}
+
+static u16 sensor_emu_get(struct sensor_emu *emu, u16 reg)
+{
+	unsigned int i = sensor_emu_index(emu, reg);
+
+	return (emu->regs[i] << 8) | emu->regs[(i + 1) % SENSOR_EMU_REGS];
+}
+
+static void sensor_emu_set(struct sensor_emu *emu, u16 reg, u16 value)
+{
+	unsigned int i = sensor_emu_index(emu, reg);
+
+	emu->regs[i] = value >> 8;
+	emu->regs[(i + 1) % SENSOR_EMU_REGS] = value & 0xff;
+}
+
+static void sensor_emu_reset(struct sensor_emu *emu)
+{
+	unsigned int i;
+
+	memset(emu->regs, 0, sizeof(emu->regs));
+	memset(emu->seq, 0, sizeof(emu->seq));
+	memset(emu->vars, 0, sizeof(emu->vars));
+	emu->seq_index = 0;
+	emu->mcu_addr = 0;
+	emu->ap0100_state = 0x20;	/* idle */
+	emu->hold_reads = 0;
+
+	for (i = 0; i < emu->model->num_defaults; i++)
+		sensor_emu_set(emu, emu->model->defaults[i].reg,
+			       emu->model->defaults[i].value);
+}
+
+/* Restore a read-only register to its power-on value. */
+static void sensor_emu_restore(struct sensor_emu *emu, u16 reg)
+{
+	unsigned int i;
+
+	for (i = 0; i < emu->model->num_defaults; i++) {
+		if (emu->model->defaults[i].reg == reg)
+			sensor_emu_set(emu, reg, emu->model->defaults[i].value);
+	}
+}
+
+/*
+ * Handshakes complete when the command is written, but the register keeps
+ * reading back its busy value for busy_polls reads so that the drivers poll
+ * loops run as they would on the chip.
+ */
+static void sensor_emu_hold(struct sensor_emu *emu, u32 key, u16 value)
+{
+	emu->hold_key = key;
+	emu->hold_value = value;
+	emu->hold_reads = busy_polls;
+}
+
+static void sensor_emu_held(struct sensor_emu *emu, u32 key, u16 *value)
+{
+	if (!emu->hold_reads || emu->hold_key != key)
+		return;
+
+	emu->hold_reads--;
+	*value = emu->hold_value;
+}
+
+/* Sequencer RAM behind the control and data ports */
+static int sensor_emu_seq(struct sensor_emu *emu, u16 reg, u16 *value,
+			  bool read)
+{
+	if (reg == APTINA_SEQ_CTRL_PORT) {
+		if (!read)
+			emu->seq_index = *value % SENSOR_EMU_SEQ_SIZE;
+		return 0;
+	}
+
+	if (read)
+		*value = emu->seq[emu->seq_index];
+	else
+		emu->seq[emu->seq_index] = *value;
+	emu->seq_index = (emu->seq_index + 1) % SENSOR_EMU_SEQ_SIZE;
+
+	return 1;
+}
+
+/************************************************************************
+			Sensor models
+************************************************************************/
+
+/* MT9M034, AR0130: sequencer ports, self-clearing reset bit */
+static int aptina_access(struct sensor_emu *emu, u16 reg, u16 *value,
+			 unsigned int width, bool read)
+{
+	switch (reg) {
+	case APTINA_CHIP_ID_REG:
+		if (!read)
+			sensor_emu_restore(emu, reg);
+		break;
+	case APTINA_RESET_REG:
+		if (!read && (*value & 0x0001))
+			sensor_emu_reset(emu);
+		break;
+	case APTINA_SEQ_CTRL_PORT:
+	case APTINA_SEQ_DATA_PORT:
+		return sensor_emu_seq(emu, reg, value, read);
+	}
+
+	return 0;
+}
+
+static const struct sensor_emu_reg mt9m034_defaults[] = {
+	{ APTINA_CHIP_ID_REG,	0x2400 },
+	{ APTINA_RESET_REG,	0x0058 },
+};
+
+static const struct sensor_emu_reg ar0130_defaults[] = {
+	{ APTINA_CHIP_ID_REG,	0x2402 },
+	{ APTINA_RESET_REG,	0x0058 },
+};
+
+/*
+ * MT9V113: PLL lock flag, soft reset, and the MCU variables behind the
+ * 0x098C address and 0x0990-0x099E data window. Variables are keyed by driver
+ * and offset, the access type and width bits of the address are ignored.
+ * Sequencer commands are acknowledged by clearing SEQ_CMD.
+ */
+static int mt9v113_access(struct sensor_emu *emu, u16 reg, u16 *value,
+			  unsigned int width, bool read)
+{
+	unsigned int key;
+	u16 mask;
+
+	if (reg >= SOC_MCU_DATA_0 && reg <= SOC_MCU_DATA_7) {
+		key = (emu->mcu_addr + reg - SOC_MCU_DATA_0) & 0x1fff;
+		mask = emu->mcu_addr & 0x8000 ? 0x00ff : 0xffff;
+
+		if (read) {
+			*value = emu->vars[key] & mask;
+			sensor_emu_held(emu, 0x10000 | key, value);
+			return 0;
+		}
+
+		emu->vars[key] = *value & mask;
+		if (key == SOC_SEQ_CMD && *value) {
+			emu->vars[key] = 0;
+			sensor_emu_hold(emu, 0x10000 | key, *value & mask);
+		}
+		return 0;
+	}
+
+	switch (reg) {
+	case SOC_CHIP_ID_REG:
+		if (!read)
+			sensor_emu_restore(emu, reg);
+		break;
+	case SOC_RESET_REG:
+		if (!read && (*value & 0x0001)) {
+			sensor_emu_reset(emu);
+			sensor_emu_set(emu, reg, *value);
+		}
+		break;
+	case SOC_PLL_CONTROL:
+		if (read) {
+			sensor_emu_held(emu, reg, value);
+			break;
+		}
+		/* Bit 12 enables the PLL, bit 15 is the read-only lock flag. */
+		if (*value & 0x1000) {
+			sensor_emu_set(emu, reg, *value | 0x8000);
+			if (!(*value & 0x8000))
+				sensor_emu_hold(emu, reg, *value & ~0x8000);
+		} else {
+			sensor_emu_set(emu, reg, *value & ~0x8000);
+		}
+		break;
+	case SOC_MCU_ADDRESS:
+		if (!read)
+			emu->mcu_addr = *value;
+		break;
+	}
+
+	return 0;
+}
+
+static const struct sensor_emu_reg mt9v113_defaults[] = {
+	{ SOC_CHIP_ID_REG,	0x2280 },
+	{ SOC_PLL_CONTROL,	0x2145 },
+};
+
+/*
+ * AP0100: host commands. The command is executed when written, the doorbell
+ * stays set for busy_polls reads and the register then reads back the result
+ * code. The state requested by SET_STATE is in the high byte of CMD_PARAM_0,
+ * GET_STATE returns the current one there.
+ */
+static void ap0100_command(struct sensor_emu *emu, u16 command)
+{
+	u16 result = AP0100_ENOERR;
+
+	switch (command) {
+	case AP0100_SET_STATE:
+		switch (sensor_emu_get(emu, AP0100_CMD_PARAM_0) >> 8) {
+		case 0x28:	/* change config, streams */
+			emu->ap0100_state = 0x31;
+			break;
+		case 0x40:	/* suspend */
+			emu->ap0100_state = 0x41;
+			break;
+		case 0x50:	/* soft standby */
+			emu->ap0100_state = 0x53;
+			break;
+		default:
+			result = AP0100_EINVAL;
+			break;
+		}
+		break;
+	case AP0100_GET_STATE:
+		sensor_emu_set(emu, AP0100_CMD_PARAM_0, emu->ap0100_state << 8);
+		break;
+	default:
+		result = AP0100_EINVAL;
+		break;
+	}
+
+	sensor_emu_set(emu, AP0100_COMMAND_REGISTER, result);
+	sensor_emu_hold(emu, AP0100_COMMAND_REGISTER, command);
+}
+
+static int ap0100_access(struct sensor_emu *emu, u16 reg, u16 *value,
+			 unsigned int width, bool read)
+{
+	switch (reg) {
+	case SOC_CHIP_ID_REG:
+		if (!read)
+			sensor_emu_restore(emu, reg);
+		break;
+	case SOC_RESET_REG:
+		if (!read && (*value & 0x0001)) {
+			sensor_emu_reset(emu);
+			sensor_emu_set(emu, reg, *value);
+		}
+		break;
+	case AP0100_COMMAND_REGISTER:
+		if (read)
+			sensor_emu_held(emu, reg, value);
+		else if (*value & AP0100_DOORBELL)
+			ap0100_command(emu, *value);
+		break;
+	case APTINA_SEQ_CTRL_PORT:
+	case APTINA_SEQ_DATA_PORT:
+		return sensor_emu_seq(emu, reg, value, read);
+	}
+
+	return 0;
+}
+
+static const struct sensor_emu_reg ap0100_defaults[] = {
+	{ SOC_CHIP_ID_REG,	0x0062 },
+};
+
+/* MT9P031: 8-bit register addresses, 16-bit registers */
+static int mt9p031_access(struct sensor_emu *emu, u16 reg, u16 *value,
+			  unsigned int width, bool read)
+{
+	switch (reg) {
+	case MT9P031_CHIP_VERSION:
+	case MT9P031_CHIP_VERSION_ALT:
+		if (!read)
+			sensor_emu_restore(emu, reg);
+		break;
+	case MT9P031_RESET:
+		if (!read && (*value & 0x0001)) {
+			sensor_emu_reset(emu);
+			sensor_emu_set(emu, reg, *value);
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static const struct sensor_emu_reg mt9p031_defaults[] = {
+	{ MT9P031_CHIP_VERSION,		0x1801 },
+	{ MT9P031_CHIP_VERSION_ALT,	0x1801 },
+};
+
+static const struct sensor_emu_model sensor_emu_models[] = {
+	{
+		.name		= "mt9m034",
+		.addr		= 0x10,
+		.reg_bytes	= 2,
+		.defaults	= mt9m034_defaults,
+		.num_defaults	= ARRAY_SIZE(mt9m034_defaults),
+		.access		= aptina_access,
+		.pdata		= MT9M034_PDATA,
+	}, {
+		.name		= "ar0130",
+		.addr		= 0x10,
+		.reg_bytes	= 2,
+		.defaults	= ar0130_defaults,
+		.num_defaults	= ARRAY_SIZE(ar0130_defaults),
+		.access		= aptina_access,
+		.pdata		= AR0130_PDATA,
+	}, {
+		.name		= "mt9v113",
+		.addr		= 0x3c,
+		.reg_bytes	= 2,
+		.defaults	= mt9v113_defaults,
+		.num_defaults	= ARRAY_SIZE(mt9v113_defaults),
+		.access		= mt9v113_access,
+		.pdata		= MT9V113_PDATA,
+	}, {
+		.name		= "ap0100",
+		.addr		= 0x5d,
+		.reg_bytes	= 2,
+		.defaults	= ap0100_defaults,
+		.num_defaults	= ARRAY_SIZE(ap0100_defaults),
+		.access		= ap0100_access,
+		.pdata		= AP0100_PDATA,
+	}, {
+		/* Bus model only, the driver needs a v4l2-int-device master. */
+		.name		= "mt9p031",
+		.addr		= 0x48,
+		.reg_bytes	= 1,
+		.defaults	= mt9p031_defaults,
+		.num_defaults	= ARRAY_SIZE(mt9p031_defaults),
+		.access		= mt9p031_access,
+		.pdata		= NULL,
+	},
+};
+
+/************************************************************************
+			I2C adapter
+************************************************************************/
+static void sensor_emu_record(struct sensor_emu *emu, u64 time, u16 reg,
+			      u16 value, u8 flags)
+{
+	struct sensor_emu_record *record;
+
+	if (emu->num_records == max_records) {
+		emu->dropped++;
+		return;
+	}
+
+	record = &emu->records[emu->num_records++];
+	record->time = time;
+	record->reg = reg;
+	record->value = value;
+	record->flags = flags;
+	record->op = emu->op;
+}
+
+/*
+ * Run the register accesses of one message. Registers are accessed a word at
+ * a time, a trailing odd byte is an 8-bit access (MCU variables, AP0100
+ * byte registers).
+ */
+static void sensor_emu_msg(struct sensor_emu *emu, struct i2c_msg *msg,
+			   u64 time, u8 *flags)
+{
+	struct sensor_emu_stats *stats = &emu->stats[emu->op];
+	unsigned int reg_bytes = emu->model->reg_bytes;
+	bool read = msg->flags & I2C_M_RD;
+	unsigned int pos = 0;
+
+	if (!read) {
+		/* Too short to hold an address: an ACK probe, nothing to do. */
+		if (msg->len < reg_bytes)
+			return;
+
+		if (reg_bytes == 1)
+			emu->ptr = msg->buf[0] * 2;
+		else
+			emu->ptr = (msg->buf[0] << 8) | msg->buf[1];
+		pos = reg_bytes;
+	}
+
+	while (pos < msg->len) {
+		unsigned int width = reg_bytes == 1 || msg->len - pos >= 2 ? 2 : 1;
+		unsigned int reg = reg_bytes == 1 ? emu->ptr / 2 : emu->ptr;
+		u16 value;
+		int port;
+
+		if (read) {
+			value = width == 2 ? sensor_emu_get(emu, reg)
+			      : emu->regs[emu->ptr];
+			port = emu->model->access(emu, reg, &value, width, true);
+			if (width == 2) {
+				msg->buf[pos] = value >> 8;
+				msg->buf[pos + 1] = value & 0xff;
+			} else {
+				msg->buf[pos] = value;
+			}
+			stats->reads++;
+		} else {
+			if (width == 2) {
+				value = (msg->buf[pos] << 8) | msg->buf[pos + 1];
+				sensor_emu_set(emu, reg, value);
+			} else {
+				value = msg->buf[pos];
+				emu->regs[emu->ptr] = value;
+			}
+			port = emu->model->access(emu, reg, &value, width, false);
+			stats->writes++;
+		}
+
+		sensor_emu_record(emu, time, reg, value, *flags |
+				  (read ? SENSOR_EMU_READ : 0) |
+				  (width == 1 ? SENSOR_EMU_8BIT : 0));
+		*flags = SENSOR_EMU_BURST;
+
+		if (!port)
+			emu->ptr = (emu->ptr + width) % SENSOR_EMU_REGS;
+		pos += width;
+	}
+}
+
+/*
+ * Every message costs a START or repeated START, the address byte and its
+ * ACK, then 9 clocks per data byte. The transfer ends with a STOP.
+ */
+static int sensor_emu_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs,
+			   int num)
+{
+	struct sensor_emu *emu = i2c_get_adapdata(adap);
+	struct sensor_emu_stats *stats;
+	unsigned int bits = 1;
+	u8 flags = 0;
+	int ret = num;
+	u64 ns;
+	int i;
+
+	mutex_lock(&emu->lock);
+	stats = &emu->stats[emu->op];
+
+	for (i = 0; i < num; i++) {
+		bits += 10;
+		stats->messages++;
+
+		if (msgs[i].addr != emu->model->addr) {
+			stats->nacks++;
+			ret = -ENXIO;
+			break;
+		}
+
+		bits += 9 * msgs[i].len;
+		stats->bytes += msgs[i].len;
+		sensor_emu_msg(emu, &msgs[i], emu->bus_ns, &flags);
+	}
+
+	ns = div_u64((u64)bits * 1000000, bus_khz ? bus_khz : 100);
+	stats->transfers++;
+	stats->bus_ns += ns;
+	emu->bus_ns += ns;
+
+	mutex_unlock(&emu->lock);
+	return ret;
+}
+
+static u32 sensor_emu_func(struct i2c_adapter *adap)
+{
+	return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm sensor_emu_algo = {
+	.master_xfer	= sensor_emu_xfer,
+	.functionality	= sensor_emu_func,
+};
+
+/************************************************************************
+			Driver operations
+************************************************************************/
+
+/*
+ * Instantiate the sensor, loading its driver if needed, and register the
+ * subdev so that the driver detects the chip in its registered operation.
+ */
+static int sensor_emu_probe(struct sensor_emu *emu)
+{
+	struct i2c_board_info info;
+	struct v4l2_subdev *sd;
+	int ret;
+
+	if (emu->sd)
+		return 0;
+
+	if (emu->model->pdata == NULL) {
+		dev_err(&emu->adap.dev, "%s driver not configured\n",
+			emu->model->name);
+		return -ENODEV;
+	}
+
+	request_module("%s", emu->model->name);
+
+	memset(&info, 0, sizeof(info));
+	strlcpy(info.type, emu->model->name, sizeof(info.type));
+	info.addr = emu->model->addr;
+	info.platform_data = emu->model->pdata;
+
+	emu->client = i2c_new_device(&emu->adap, &info);
+	if (emu->client == NULL)
+		return -ENOMEM;
+
+	sd = i2c_get_clientdata(emu->client);
+	if (emu->client->driver == NULL || sd == NULL ||
+	    !try_module_get(emu->client->driver->driver.owner)) {
+		ret = -ENODEV;
+		goto error;
+	}
+
+	ret = v4l2_device_register_subdev(&emu->v4l2_dev, sd);
+	if (ret < 0) {
+		module_put(emu->client->driver->driver.owner);
+		goto error;
+	}
+
+	emu->sd = sd;
+	return 0;
+
+error:
+	i2c_unregister_device(emu->client);
+	emu->client = NULL;
+	return ret;
+}
+
+static void sensor_emu_remove(struct sensor_emu *emu)
+{
+	if (emu->sd) {
+		v4l2_device_unregister_subdev(emu->sd);
+		module_put(emu->client->driver->driver.owner);
+		emu->sd = NULL;
+	}
+
+	if (emu->client) {
+		i2c_unregister_device(emu->client);
+		emu->client = NULL;
+	}
+}
+
+static int sensor_emu_set_format(struct sensor_emu *emu, u32 width, u32 height)
+{
+	struct v4l2_subdev_format fmt;
+	int ret;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+	fmt.pad = 0;
+
+	ret = v4l2_subdev_call(emu->sd, pad, get_fmt, NULL, &fmt);
+	if (ret < 0)
+		return ret;
+
+	fmt.format.width = width;
+	fmt.format.height = height;
+	ret = v4l2_subdev_call(emu->sd, pad, set_fmt, NULL, &fmt);
+	if (ret < 0)
+		return ret;
+
+	dev_info(&emu->adap.dev, "format %ux%u\n", fmt.format.width,
+		 fmt.format.height);
+	return 0;
+}
+
+static int sensor_emu_set_ctrl(struct sensor_emu *emu, u32 id, s32 value)
+{
+	struct v4l2_ctrl *ctrl = NULL;
+
+	if (emu->sd->ctrl_handler)
+		ctrl = v4l2_ctrl_find(emu->sd->ctrl_handler, id);
+	if (ctrl == NULL)
+		return -EINVAL;
+
+	return v4l2_ctrl_s_ctrl(ctrl, value);
+}
+
+/*
+ * Frame sizes to test, as reported by the driver. Discrete sizes are taken as
+ * they are. A continuous range is sampled at its maximum, binned by 2
+ * horizontally, by 2 and by 4 in both directions, and set_fmt maps every
+ * sample to a mode of the driver. Modes are listed once, in that order, and
+ * the active format is restored afterwards.
+ */
+#define SENSOR_EMU_MAX_MODES		32
+
+struct sensor_emu_mode {
+	u32 code;
+	u32 width;
+	u32 height;
+};
+
+static int sensor_emu_try_mode(struct sensor_emu *emu, u32 code, u32 width,
+			       u32 height, struct sensor_emu_mode *modes,
+			       unsigned int *num_modes)
+{
+	struct v4l2_subdev_format fmt;
+	unsigned int i;
+	int ret;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+	fmt.format.code = code;
+	fmt.format.width = width;
+	fmt.format.height = height;
+
+	ret = v4l2_subdev_call(emu->sd, pad, set_fmt, NULL, &fmt);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < *num_modes; i++) {
+		if (modes[i].width == fmt.format.width &&
+		    modes[i].height == fmt.format.height)
+			return 0;
+	}
+
+	if (*num_modes == SENSOR_EMU_MAX_MODES)
+		return 0;
+
+	modes[*num_modes].code = fmt.format.code;
+	modes[*num_modes].width = fmt.format.width;
+	modes[*num_modes].height = fmt.format.height;
+	(*num_modes)++;
+	return 0;
+}
+
+static int sensor_emu_modes(struct sensor_emu *emu,
+			    struct sensor_emu_mode *modes)
+{
+	static const unsigned int ratios[][2] = {
+		{ 1, 1 }, { 2, 1 }, { 2, 2 }, { 4, 4 },
+	};
+	struct v4l2_subdev_mbus_code_enum code;
+	struct v4l2_subdev_frame_size_enum fse;
+	struct v4l2_subdev_format active;
+	unsigned int num_modes = 0;
+	unsigned int i;
+	int ret;
+
+	memset(&active, 0, sizeof(active));
+	active.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+	ret = v4l2_subdev_call(emu->sd, pad, get_fmt, NULL, &active);
+	if (ret < 0)
+		return ret;
+
+	memset(&code, 0, sizeof(code));
+	while (v4l2_subdev_call(emu->sd, pad, enum_mbus_code, NULL,
+				&code) == 0) {
+		memset(&fse, 0, sizeof(fse));
+		fse.code = code.code;
+
+		while (fse.index < SENSOR_EMU_MAX_MODES &&
+		       v4l2_subdev_call(emu->sd, pad, enum_frame_size, NULL,
+					&fse) == 0) {
+			for (i = 0; i < ARRAY_SIZE(ratios); i++) {
+				if (i && fse.min_width == fse.max_width &&
+				    fse.min_height == fse.max_height)
+					break;
+
+				ret = sensor_emu_try_mode(emu, code.code,
+					max(fse.max_width / ratios[i][0],
+					    fse.min_width),
+					max(fse.max_height / ratios[i][1],
+					    fse.min_height),
+					modes, &num_modes);
+				if (ret < 0)
+					goto done;
+			}
+
+			fse.index++;
+			fse.code = code.code;
+		}
+
+		code.index++;
+	}
+
+done:
+	v4l2_subdev_call(emu->sd, pad, set_fmt, NULL, &active);
+	return ret < 0 ? ret : num_modes;
+}
+
+/*
+ * Commands, one per write to the command file:
+ *
+ *	probe			instantiate and detect the sensor
+ *	remove			unregister the sensor, to probe it again
+ *	power 0|1		s_power
+ *	format WIDTHxHEIGHT	set_fmt on pad 0
+ *	stream 0|1		s_stream
+ *	ctrl ID VALUE		set a control
+ *	clear			clear the records and statistics
+ *	reset			power-on reset of the register file
+ */
+static int sensor_emu_command(struct sensor_emu *emu, const char *cmd)
+{
+	struct sensor_emu_stats before;
+	struct sensor_emu_stats *stats;
+	enum sensor_emu_op op;
+	unsigned int arg0, arg1;
+	ktime_t start;
+	int value;
+	int ret;
+
+	if (strcmp(cmd, "probe") == 0)
+		op = SENSOR_EMU_OP_PROBE;
+	else if (sscanf(cmd, "power %u", &arg0) == 1)
+		op = SENSOR_EMU_OP_POWER;
+	else if (sscanf(cmd, "format %ux%u", &arg0, &arg1) == 2)
+		op = SENSOR_EMU_OP_FORMAT;
+	else if (sscanf(cmd, "stream %u", &arg0) == 1)
+		op = SENSOR_EMU_OP_STREAM;
+	else if (sscanf(cmd, "ctrl %i %i", &arg0, &value) == 2)
+		op = SENSOR_EMU_OP_CTRL;
+	else if (strcmp(cmd, "remove") == 0) {
+		sensor_emu_remove(emu);
+		return 0;
+	} else if (strcmp(cmd, "clear") == 0 || strcmp(cmd, "reset") == 0) {
+		mutex_lock(&emu->lock);
+		if (cmd[0] == 'c') {
+			memset(emu->stats, 0, sizeof(emu->stats));
+			emu->num_records = 0;
+			emu->dropped = 0;
+			emu->bus_ns = 0;
+		} else {
+			sensor_emu_reset(emu);
+		}
+		mutex_unlock(&emu->lock);
+		return 0;
+	} else
+		return -EINVAL;
+
+	if (op != SENSOR_EMU_OP_PROBE && emu->sd == NULL)
+		return -ENODEV;
+
+	mutex_lock(&emu->lock);
+	emu->op = op;
+	before = emu->stats[op];
+	mutex_unlock(&emu->lock);
+
+	start = ktime_get();
+
+	switch (op) {
+	case SENSOR_EMU_OP_PROBE:
+		ret = sensor_emu_probe(emu);
+		break;
+	case SENSOR_EMU_OP_POWER:
+		ret = v4l2_subdev_call(emu->sd, core, s_power, arg0);
+		break;
+	case SENSOR_EMU_OP_FORMAT:
+		ret = sensor_emu_set_format(emu, arg0, arg1);
+		break;
+	case SENSOR_EMU_OP_STREAM:
+		ret = v4l2_subdev_call(emu->sd, video, s_stream, arg0);
+		break;
+	default:
+		ret = sensor_emu_set_ctrl(emu, arg0, value);
+		break;
+	}
+
+	mutex_lock(&emu->lock);
+	stats = &emu->stats[op];
+	stats->calls++;
+	stats->wall_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	emu->op = SENSOR_EMU_OP_IDLE;
+
+	dev_info(&emu->adap.dev, "%s: %d, %u transfers, %u bytes, "
+		 "%llu us on the bus\n", cmd, ret,
+		 stats->transfers - before.transfers,
+		 stats->bytes - before.bytes,
+		 div_u64(stats->bus_ns - before.bus_ns, 1000));
+	mutex_unlock(&emu->lock);
+
+	return ret;
+}
+
+/************************************************************************
+			debugfs
+************************************************************************/
+static ssize_t sensor_emu_command_write(struct file *file,
+					const char __user *buf, size_t count,
+					loff_t *ppos)
+{
+	struct sensor_emu *emu = file->private_data;
+	char cmd[64];
+	int ret;
+
+	if (count >= sizeof(cmd))
+		return -EINVAL;
+	if (copy_from_user(cmd, buf, count))
+		return -EFAULT;
+	cmd[count] = '\0';
+
+	mutex_lock(&emu->cmd_lock);
+	ret = sensor_emu_command(emu, strim(cmd));
+	mutex_unlock(&emu->cmd_lock);
+
+	return ret < 0 ? ret : count;
+}
+
+static int sensor_emu_command_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations sensor_emu_command_fops = {
+	.owner	= THIS_MODULE,
+	.open	= sensor_emu_command_open,
+	.write	= sensor_emu_command_write,
+};
+
+/*
+ * One line per register access: operation, modelled bus time in ns,
+ * direction ('+' marks the following accesses of a burst), register and
+ * value. 8-bit accesses print two digits.
+ */
+static void *sensor_emu_trace_start(struct seq_file *s, loff_t *pos)
+{
+	struct sensor_emu *emu = s->private;
+
+	mutex_lock(&emu->lock);
+	return *pos < emu->num_records ? &emu->records[*pos] : NULL;
+}
+
+static void *sensor_emu_trace_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	struct sensor_emu *emu = s->private;
+
+	++*pos;
+	return *pos < emu->num_records ? &emu->records[*pos] : NULL;
+}
+
+static void sensor_emu_trace_stop(struct seq_file *s, void *v)
+{
+	struct sensor_emu *emu = s->private;
+
+	mutex_unlock(&emu->lock);
+}
+
+static int sensor_emu_trace_show(struct seq_file *s, void *v)
+{
+	const struct sensor_emu_record *record = v;
+
+	seq_printf(s, "%-6s %10llu %c%c %04x %0*x\n",
+		   sensor_emu_op_names[record->op], record->time,
+		   record->flags & SENSOR_EMU_READ ? 'R' : 'W',
+		   record->flags & SENSOR_EMU_BURST ? '+' : ' ',
+		   record->reg, record->flags & SENSOR_EMU_8BIT ? 2 : 4,
+		   record->value);
+	return 0;
+}
+
+static const struct seq_operations sensor_emu_trace_sops = {
+	.start	= sensor_emu_trace_start,
+	.next	= sensor_emu_trace_next,
+	.stop	= sensor_emu_trace_stop,
+	.show	= sensor_emu_trace_show,
+};
+
+static int sensor_emu_trace_open(struct inode *inode, struct file *file)
+{
+	int ret;
+
+	ret = seq_open(file, &sensor_emu_trace_sops);
+	if (ret == 0)
+		((struct seq_file *)file->private_data)->private =
+			inode->i_private;
+	return ret;
+}
+
+static const struct file_operations sensor_emu_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sensor_emu_trace_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int sensor_emu_stats_show(struct seq_file *s, void *v)
+{
+	struct sensor_emu *emu = s->private;
+	struct sensor_emu_stats total;
+	unsigned int i;
+
+	memset(&total, 0, sizeof(total));
+
+	mutex_lock(&emu->lock);
+
+	seq_printf(s, "%s at 0x%02x, %u kHz\n", emu->model->name,
+		   emu->model->addr, bus_khz);
+	seq_printf(s, "%-6s %6s %9s %8s %8s %7s %7s %6s %10s %10s\n",
+		   "op", "calls", "transfers", "messages", "bytes", "reads",
+		   "writes", "nacks", "bus(us)", "wall(us)");
+
+	for (i = 0; i <= SENSOR_EMU_OP_COUNT; i++) {
+		const struct sensor_emu_stats *stats =
+			i < SENSOR_EMU_OP_COUNT ? &emu->stats[i] : &total;
+
+		if (i < SENSOR_EMU_OP_COUNT) {
+			total.calls += stats->calls;
+			total.transfers += stats->transfers;
+			total.messages += stats->messages;
+			total.bytes += stats->bytes;
+			total.reads += stats->reads;
+			total.writes += stats->writes;
+			total.nacks += stats->nacks;
+			total.bus_ns += stats->bus_ns;
+			total.wall_ns += stats->wall_ns;
+		}
+
+		seq_printf(s, "%-6s %6u %9u %8u %8u %7u %7u %6u %10llu %10llu\n",
+			   i < SENSOR_EMU_OP_COUNT ? sensor_emu_op_names[i]
+			   : "total", stats->calls, stats->transfers,
+			   stats->messages, stats->bytes, stats->reads,
+			   stats->writes, stats->nacks,
+			   div_u64(stats->bus_ns, 1000),
+			   div_u64(stats->wall_ns, 1000));
+	}
+
+	seq_printf(s, "records %u, dropped %u\n", emu->num_records,
+		   emu->dropped);
+
+	mutex_unlock(&emu->lock);
+	return 0;
+}
+
+/* One line per mode: WIDTHxHEIGHT and the media bus code. */
+static int sensor_emu_modes_show(struct seq_file *s, void *v)
+{
+	struct sensor_emu *emu = s->private;
+	struct sensor_emu_mode *modes;
+	int num_modes;
+	int i;
+
+	modes = kcalloc(SENSOR_EMU_MAX_MODES, sizeof(*modes), GFP_KERNEL);
+	if (modes == NULL)
+		return -ENOMEM;
+
+	mutex_lock(&emu->cmd_lock);
+	num_modes = emu->sd ? sensor_emu_modes(emu, modes) : -ENODEV;
+	mutex_unlock(&emu->cmd_lock);
+
+	for (i = 0; i < num_modes; i++)
+		seq_printf(s, "%ux%u 0x%04x\n", modes[i].width,
+			   modes[i].height, modes[i].code);
+
+	kfree(modes);
+	return num_modes < 0 ? num_modes : 0;
+}
+
+static int sensor_emu_modes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sensor_emu_modes_show, inode->i_private);
+}
+
+static const struct file_operations sensor_emu_modes_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sensor_emu_modes_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int sensor_emu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sensor_emu_stats_show, inode->i_private);
+}
+
+static const struct file_operations sensor_emu_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sensor_emu_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/************************************************************************
+			Module
+************************************************************************/
+static struct sensor_emu *sensor_emu_create(const struct sensor_emu_model *model)
+{
+	struct sensor_emu *emu;
+	char name[32];
+	int ret;
+
+	emu = vzalloc(sizeof(*emu));
+	if (emu == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	emu->records = vzalloc(max_records * sizeof(*emu->records));
+	if (emu->records == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+
+	emu->model = model;
+	mutex_init(&emu->lock);
+	mutex_init(&emu->cmd_lock);
+	sensor_emu_reset(emu);
+
+	emu->adap.owner = THIS_MODULE;
+	emu->adap.algo = &sensor_emu_algo;
+	snprintf(emu->adap.name, sizeof(emu->adap.name), "sensor-emu %s",
+		 model->name);
+	i2c_set_adapdata(&emu->adap, emu);
+
+	ret = i2c_add_adapter(&emu->adap);
+	if (ret < 0)
+		goto error;
+
+	/*
+	 * No parent device, the adapter driver data already holds the
+	 * emulator.
+	 */
+	snprintf(emu->v4l2_dev.name, sizeof(emu->v4l2_dev.name),
+		 "sensor-emu-%d", emu->adap.nr);
+	ret = v4l2_device_register(NULL, &emu->v4l2_dev);
+	if (ret < 0) {
+		i2c_del_adapter(&emu->adap);
+		goto error;
+	}
+
+	snprintf(name, sizeof(name), "%s-%d", model->name, emu->adap.nr);
+	emu->debugfs = debugfs_create_dir(name, sensor_emu_debugfs);
+	debugfs_create_file("command", S_IWUSR, emu->debugfs, emu,
+			    &sensor_emu_command_fops);
+	debugfs_create_file("trace", S_IRUGO, emu->debugfs, emu,
+			    &sensor_emu_trace_fops);
+	debugfs_create_file("stats", S_IRUGO, emu->debugfs, emu,
+			    &sensor_emu_stats_fops);
+	debugfs_create_file("modes", S_IRUGO, emu->debugfs, emu,
+			    &sensor_emu_modes_fops);
+
+	dev_info(&emu->adap.dev, "emulating %s at 0x%02x\n", model->name,
+		 model->addr);
+	return emu;
+
+error:
+	vfree(emu->records);
+	vfree(emu);
+	return ERR_PTR(ret);
+}
+
+static void sensor_emu_destroy(struct sensor_emu *emu)
+{
+	debugfs_remove_recursive(emu->debugfs);
+	sensor_emu_remove(emu);
+	v4l2_device_unregister(&emu->v4l2_dev);
+	i2c_del_adapter(&emu->adap);
+	vfree(emu->records);
+	vfree(emu);
+}
+
+static void sensor_emu_cleanup(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(sensor_emus); i++) {
+		if (sensor_emus[i])
+			sensor_emu_destroy(sensor_emus[i]);
+		sensor_emus[i] = NULL;
+	}
+
+	debugfs_remove_recursive(sensor_emu_debugfs);
+}
+
+static int __init sensor_emu_init(void)
+{
+	unsigned int i, j;
+
+	if (max_records == 0)
+		max_records = 1;
+
+	sensor_emu_debugfs = debugfs_create_dir("sensor-emu", NULL);
+	if (IS_ERR_OR_NULL(sensor_emu_debugfs)) {
+		pr_err("sensor-emu: debugfs not available\n");
+		return -ENODEV;
+	}
+
+	for (i = 0; i < num_sensors; i++) {
+		for (j = 0; j < ARRAY_SIZE(sensor_emu_models); j++) {
+			if (strcmp(sensor[i], sensor_emu_models[j].name) == 0)
+				break;
+		}
+
+		if (j == ARRAY_SIZE(sensor_emu_models)) {
+			pr_err("sensor-emu: unknown sensor %s\n", sensor[i]);
+			sensor_emu_cleanup();
+			return -EINVAL;
+		}
+
+		sensor_emus[i] = sensor_emu_create(&sensor_emu_models[j]);
+		if (IS_ERR(sensor_emus[i])) {
+			int ret = PTR_ERR(sensor_emus[i]);
+
+			sensor_emus[i] = NULL;
+			sensor_emu_cleanup();
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static void __exit sensor_emu_exit(void)
+{
+	sensor_emu_cleanup();
+}
+
+module_init(sensor_emu_init);
+module_exit(sensor_emu_exit);
+
+MODULE_DESCRIPTION("Aptina sensor I2C emulator");
+MODULE_AUTHOR("Aptina Imaging");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,462 @@
+/*
+ *
+ * Aptina sensor I2C emulator, host build
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * The part of the Linux 3.1 kernel API used by sensor-emu, aptina-i2c and the
+ * sensor drivers, so that they build and run unmodified as a user space
+ * program. Every linux/ and media/ header of this directory includes this
+ * file. Locks are single threaded checks, sleeps return at once and debugfs
+ * is an in-memory tree that sensor-emu-host dumps to a directory.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __HOST_KERNEL_H__
+#define __HOST_KERNEL_H__
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <linux/types.h>
+
+/************************************************************************
+			Compiler and helpers
+************************************************************************/
+#define __init
+#define __exit
+#define __user
+#define __iomem
+#define __force
+#define __must_check
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define ENOIOCTLCMD		515
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define min(x, y)		({ typeof(x) _x = (x); typeof(y) _y = (y); _x < _y ? _x : _y; })
+#define max(x, y)		({ typeof(x) _x = (x); typeof(y) _y = (y); _x > _y ? _x : _y; })
+#define min_t(type, x, y)	({ type _x = (x); type _y = (y); _x < _y ? _x : _y; })
+#define max_t(type, x, y)	({ type _x = (x); type _y = (y); _x > _y ? _x : _y; })
+#define clamp(val, lo, hi)	min(max(val, lo), hi)
+#define clamp_t(type, val, lo, hi) min_t(type, max_t(type, val, lo), hi)
+
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define DIV_ROUND_CLOSEST(x, divisor) ({				\
+	typeof(divisor) __divisor = divisor;				\
+	(((x) + ((__divisor) / 2)) / (__divisor));			\
+})
+#define ALIGN(x, a)		(((x) + ((typeof(x))(a) - 1)) & ~((typeof(x))(a) - 1))
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+#define cpu_to_be16(x)		((__force __be16)__builtin_bswap16(x))
+#define be16_to_cpu(x)		__builtin_bswap16((__force u16)(x))
+#define swab16(x)		__builtin_bswap16(x)
+
+#define MAX_ERRNO		4095
+#define IS_ERR_VALUE(x)		unlikely((unsigned long)(x) >= (unsigned long)-MAX_ERRNO)
+
+static inline void *ERR_PTR(long error)
+{
+	return (void *)error;
+}
+
+static inline long PTR_ERR(const void *ptr)
+{
+	return (long)ptr;
+}
+
+static inline long IS_ERR(const void *ptr)
+{
+	return IS_ERR_VALUE((unsigned long)ptr);
+}
+
+static inline long IS_ERR_OR_NULL(const void *ptr)
+{
+	return !ptr || IS_ERR_VALUE((unsigned long)ptr);
+}
+
+#define strlcpy(dest, src, size)	host_strlcpy(dest, src, size)
+size_t host_strlcpy(char *dest, const char *src, size_t size);
+char *strim(char *s);
+
+/************************************************************************
+			Lists
+************************************************************************/
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD_INIT(name)	{ &(name), &(name) }
+#define LIST_HEAD(name)		struct list_head name = LIST_HEAD_INIT(name)
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static inline void list_add_tail(struct list_head *entry, struct list_head *head)
+{
+	entry->prev = head->prev;
+	entry->next = head;
+	head->prev->next = entry;
+	head->prev = entry;
+}
+
+static inline void list_del(struct list_head *entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->next = entry->prev = entry;
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+	return head->next == head;
+}
+
+#define list_entry(ptr, type, member)	container_of(ptr, type, member)
+
+#define list_for_each_entry(pos, head, member)				\
+	for (pos = list_entry((head)->next, typeof(*pos), member);	\
+	     &pos->member != (head);					\
+	     pos = list_entry(pos->member.next, typeof(*pos), member))
+
+#define list_for_each_entry_safe(pos, n, head, member)			\
+	for (pos = list_entry((head)->next, typeof(*pos), member),	\
+	     n = list_entry(pos->member.next, typeof(*pos), member);	\
+	     &pos->member != (head);					\
+	     pos = n, n = list_entry(n->member.next, typeof(*n), member))
+
+/************************************************************************
+			Kernel log
+************************************************************************/
+#define KERN_EMERG		"<0>"
+#define KERN_ALERT		"<1>"
+#define KERN_CRIT		"<2>"
+#define KERN_ERR		"<3>"
+#define KERN_WARNING		"<4>"
+#define KERN_NOTICE		"<5>"
+#define KERN_INFO		"<6>"
+#define KERN_DEBUG		"<7>"
+
+struct device;
+
+int printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int host_dev_printk(const char *level, const struct device *dev,
+		    const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define pr_err(fmt, ...)	printk(KERN_ERR fmt, ##__VA_ARGS__)
+#define pr_warning(fmt, ...)	printk(KERN_WARNING fmt, ##__VA_ARGS__)
+#define pr_warn			pr_warning
+#define pr_info(fmt, ...)	printk(KERN_INFO fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...)	({ if (0) printk(KERN_DEBUG fmt, ##__VA_ARGS__); 0; })
+
+#define dev_err(dev, fmt, ...)	host_dev_printk(KERN_ERR, dev, fmt, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...)	host_dev_printk(KERN_WARNING, dev, fmt, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...)	host_dev_printk(KERN_INFO, dev, fmt, ##__VA_ARGS__)
+#define dev_dbg(dev, fmt, ...)	({ if (0) host_dev_printk(KERN_DEBUG, dev, fmt, ##__VA_ARGS__); 0; })
+
+#define WARN_ON(condition) ({						\
+	int __ret_warn_on = !!(condition);				\
+	if (unlikely(__ret_warn_on))					\
+		printk(KERN_WARNING "WARNING: at %s:%d %s()\n",		\
+		       __FILE__, __LINE__, __func__);			\
+	unlikely(__ret_warn_on);					\
+})
+
+#define BUG_ON(condition) do {						\
+	if (unlikely(condition)) {					\
+		printk(KERN_CRIT "BUG: at %s:%d %s()\n",		\
+		       __FILE__, __LINE__, __func__);			\
+		abort();						\
+	}								\
+} while (0)
+
+/************************************************************************
+			Memory
+************************************************************************/
+typedef unsigned int gfp_t;
+#define GFP_KERNEL		0
+
+static inline void *kmalloc(size_t size, gfp_t flags)
+{
+	return malloc(size);
+}
+
+static inline void *kzalloc(size_t size, gfp_t flags)
+{
+	return calloc(1, size);
+}
+
+static inline void *kcalloc(size_t n, size_t size, gfp_t flags)
+{
+	return calloc(n, size);
+}
+
+static inline void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+static inline void *vzalloc(unsigned long size)
+{
+	return calloc(1, size);
+}
+
+static inline void vfree(const void *p)
+{
+	free((void *)p);
+}
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp);
+
+static inline unsigned long copy_from_user(void *to, const void __user *from,
+					   unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+static inline unsigned long copy_to_user(void __user *to, const void *from,
+					 unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+/************************************************************************
+			Locking and time
+************************************************************************/
+/*
+ * The host build runs one thread. A lock taken twice would deadlock the
+ * kernel, abort instead.
+ */
+struct mutex {
+	int locked;
+};
+
+typedef struct {
+	int locked;
+} spinlock_t;
+
+#define mutex_init(lock)	((lock)->locked = 0)
+#define spin_lock_init(lock)	((lock)->locked = 0)
+#define mutex_lock(lock)	do { BUG_ON((lock)->locked); (lock)->locked = 1; } while (0)
+#define mutex_unlock(lock)	do { BUG_ON(!(lock)->locked); (lock)->locked = 0; } while (0)
+#define spin_lock(lock)		mutex_lock(lock)
+#define spin_unlock(lock)	mutex_unlock(lock)
+
+typedef s64 ktime_t;
+
+ktime_t ktime_get(void);
+#define ktime_sub(a, b)		((a) - (b))
+#define ktime_to_ns(kt)		((s64)(kt))
+
+/* The emulator models the bus time, the sleeps only cost wall time. */
+static inline void msleep(unsigned int msecs) { }
+static inline void mdelay(unsigned long msecs) { }
+static inline void udelay(unsigned long usecs) { }
+static inline void usleep_range(unsigned long min, unsigned long max) { }
+
+/************************************************************************
+			Modules
+************************************************************************/
+struct module;
+
+#define THIS_MODULE		((struct module *)0)
+
+#ifndef KBUILD_MODNAME
+#define KBUILD_MODNAME		"host"
+#endif
+
+#define __HOST_CONCAT(a, b)	a##b
+#define __HOST_UNIQUE(prefix)	__HOST_CONCAT(prefix, __LINE__)
+
+void host_module_register(const char *name, int (*init)(void),
+			  void (*exit)(void));
+void host_param_register(const char *module, const char *name,
+			 const char *type, void *arg, unsigned int *num,
+			 unsigned int max);
+int request_module(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#define module_init(fn)							\
+	static void __attribute__((constructor)) __host_init_##fn(void)	\
+	{								\
+		host_module_register(KBUILD_MODNAME, fn, NULL);		\
+	}
+
+#define module_exit(fn)							\
+	static void __attribute__((constructor)) __host_exit_##fn(void)	\
+	{								\
+		host_module_register(KBUILD_MODNAME, NULL, fn);		\
+	}
+
+#define module_param(name, type, perm)					\
+	static void __attribute__((constructor)) __host_param_##name(void) \
+	{								\
+		host_param_register(KBUILD_MODNAME, #name, #type, &name, \
+				    NULL, 1);				\
+	}
+
+#define module_param_array(name, type, nump, perm)			\
+	static void __attribute__((constructor)) __host_param_##name(void) \
+	{								\
+		host_param_register(KBUILD_MODNAME, #name, #type, name,	\
+				    nump, ARRAY_SIZE(name));		\
+	}
+
+#define MODULE_PARM_DESC(name, desc)
+#define MODULE_DEVICE_TABLE(type, name)
+#define MODULE_DESCRIPTION(desc)
+#define MODULE_AUTHOR(author)
+#define MODULE_LICENSE(license)
+#define EXPORT_SYMBOL(sym)
+#define EXPORT_SYMBOL_GPL(sym)
+
+static inline int try_module_get(struct module *module)
+{
+	return 1;
+}
+
+static inline void module_put(struct module *module)
+{
+}
+
+/************************************************************************
+			Devices
+************************************************************************/
+struct device_driver {
+	const char *name;
+	struct module *owner;
+};
+
+struct device {
+	struct device *parent;
+	char name[32];
+	void *platform_data;
+	void *driver_data;
+	struct list_head devres;
+};
+
+static inline const char *dev_name(const struct device *dev)
+{
+	return dev->name;
+}
+
+static inline void *dev_get_drvdata(const struct device *dev)
+{
+	return dev->driver_data;
+}
+
+static inline void dev_set_drvdata(struct device *dev, void *data)
+{
+	dev->driver_data = data;
+}
+
+/************************************************************************
+			debugfs and seq_file
+************************************************************************/
+#ifndef S_IRUGO
+#define S_IRUGO			(S_IRUSR | S_IRGRP | S_IROTH)
+#endif
+
+struct inode {
+	void *i_private;
+};
+
+struct file {
+	void *private_data;
+	loff_t f_pos;
+};
+
+struct file_operations {
+	struct module *owner;
+	loff_t (*llseek)(struct file *, loff_t, int);
+	ssize_t (*read)(struct file *, char __user *, size_t, loff_t *);
+	ssize_t (*write)(struct file *, const char __user *, size_t, loff_t *);
+	int (*open)(struct inode *, struct file *);
+	int (*release)(struct inode *, struct file *);
+};
+
+struct dentry {
+	char *name;
+	umode_t mode;
+	struct inode inode;
+	const struct file_operations *fops;
+	struct dentry *parent;
+	struct list_head children;
+	struct list_head child;
+};
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file(const char *name, umode_t mode,
+				   struct dentry *parent, void *data,
+				   const struct file_operations *fops);
+void debugfs_remove_recursive(struct dentry *dentry);
+
+struct seq_file;
+
+struct seq_operations {
+	void *(*start)(struct seq_file *m, loff_t *pos);
+	void (*stop)(struct seq_file *m, void *v);
+	void *(*next)(struct seq_file *m, void *v, loff_t *pos);
+	int (*show)(struct seq_file *m, void *v);
+};
+
+struct seq_file {
+	char *buf;
+	size_t count;
+	size_t size;
+	bool filled;
+	const struct seq_operations *op;
+	int (*single_show)(struct seq_file *, void *);
+	void *private;
+};
+
+int seq_open(struct file *file, const struct seq_operations *op);
+ssize_t seq_read(struct file *file, char __user *buf, size_t size,
+		 loff_t *ppos);
+loff_t seq_lseek(struct file *file, loff_t offset, int origin);
+int seq_release(struct inode *inode, struct file *file);
+int seq_printf(struct seq_file *m, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+int single_open(struct file *file, int (*show)(struct seq_file *, void *),
+		void *data);
+int single_release(struct inode *inode, struct file *file);
+
+/************************************************************************
+			Host program
+************************************************************************/
+extern int host_verbose;
+
+int host_param_set(const char *param);
+int host_load_module(const char *name);
+void host_unload_modules(void);
+struct dentry *host_debugfs_root(void);
+
+#endif
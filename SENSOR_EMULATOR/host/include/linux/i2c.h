@@ -0,0 +1,109 @@
+/*
+ * Host build: I2C core, see host-kernel.h
+ */
+
+#ifndef __HOST_LINUX_I2C_H__
+#define __HOST_LINUX_I2C_H__
+
+#include <host-kernel.h>
+
+#include_next <linux/i2c.h>
+
+#define I2C_NAME_SIZE		20
+
+struct i2c_adapter;
+struct i2c_client;
+
+struct i2c_device_id {
+	char name[I2C_NAME_SIZE];
+	kernel_ulong_t driver_data;
+};
+
+struct i2c_algorithm {
+	int (*master_xfer)(struct i2c_adapter *adap, struct i2c_msg *msgs,
+			   int num);
+	u32 (*functionality)(struct i2c_adapter *adap);
+};
+
+struct i2c_adapter {
+	struct module *owner;
+	const struct i2c_algorithm *algo;
+	void *algo_data;
+	int timeout;
+	int retries;
+	struct device dev;
+	int nr;
+	char name[48];
+	struct list_head list;
+};
+
+struct i2c_driver {
+	unsigned int class;
+	int (*probe)(struct i2c_client *client, const struct i2c_device_id *id);
+	int (*remove)(struct i2c_client *client);
+	struct device_driver driver;
+	const struct i2c_device_id *id_table;
+	struct list_head list;
+};
+
+struct i2c_client {
+	unsigned short flags;
+	unsigned short addr;
+	char name[I2C_NAME_SIZE];
+	struct i2c_adapter *adapter;
+	struct i2c_driver *driver;
+	struct device dev;
+	int irq;
+};
+
+struct i2c_board_info {
+	char type[I2C_NAME_SIZE];
+	unsigned short flags;
+	unsigned short addr;
+	void *platform_data;
+	int irq;
+};
+
+#define to_i2c_adapter(d)	container_of(d, struct i2c_adapter, dev)
+#define to_i2c_client(d)	container_of(d, struct i2c_client, dev)
+
+static inline void *i2c_get_clientdata(const struct i2c_client *client)
+{
+	return dev_get_drvdata(&client->dev);
+}
+
+static inline void i2c_set_clientdata(struct i2c_client *client, void *data)
+{
+	dev_set_drvdata(&client->dev, data);
+}
+
+static inline void *i2c_get_adapdata(const struct i2c_adapter *adap)
+{
+	return dev_get_drvdata(&adap->dev);
+}
+
+static inline void i2c_set_adapdata(struct i2c_adapter *adap, void *data)
+{
+	dev_set_drvdata(&adap->dev, data);
+}
+
+static inline u32 i2c_get_functionality(struct i2c_adapter *adap)
+{
+	return adap->algo->functionality(adap);
+}
+
+static inline int i2c_check_functionality(struct i2c_adapter *adap, u32 func)
+{
+	return (func & i2c_get_functionality(adap)) == func;
+}
+
+int i2c_add_adapter(struct i2c_adapter *adap);
+int i2c_del_adapter(struct i2c_adapter *adap);
+int i2c_add_driver(struct i2c_driver *driver);
+void i2c_del_driver(struct i2c_driver *driver);
+struct i2c_client *i2c_new_device(struct i2c_adapter *adap,
+				  struct i2c_board_info const *info);
+void i2c_unregister_device(struct i2c_client *client);
+int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num);
+
+#endif
@@ -0,0 +1,2 @@
+/* Host build, see host-kernel.h */
+#include <host-kernel.h>
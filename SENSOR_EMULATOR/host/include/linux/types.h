@@ -0,0 +1,24 @@
+/*
+ * Host build: the user space linux/types.h with the kernel integer types.
+ */
+
+#ifndef __HOST_LINUX_TYPES_H__
+#define __HOST_LINUX_TYPES_H__
+
+#include_next <linux/types.h>
+
+#include <stdbool.h>
+
+typedef __u8 u8;
+typedef __s8 s8;
+typedef __u16 u16;
+typedef __s16 s16;
+typedef __u32 u32;
+typedef __s32 s32;
+typedef __u64 u64;
+typedef __s64 s64;
+
+typedef unsigned short umode_t;
+typedef unsigned long kernel_ulong_t;
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Host build: the user space V4L2 API. The drivers define their own private
+ * control IDs under names the current API has taken since.
+ */
+
+#ifndef __HOST_LINUX_VIDEODEV2_H__
+#define __HOST_LINUX_VIDEODEV2_H__
+
+#include <host-kernel.h>
+
+#include_next <linux/videodev2.h>
+#include <linux/v4l2-mediabus.h>
+
+#undef V4L2_CID_TEST_PATTERN
+
+/* Removed from the API in Linux 3.17 */
+struct v4l2_dbg_chip_ident {
+	struct v4l2_dbg_match match;
+	__u32 ident;
+	__u32 revision;
+} __attribute__((packed));
+
+#endif
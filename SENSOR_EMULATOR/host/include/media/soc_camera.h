@@ -0,0 +1,2 @@
+/* Host build: nothing of soc_camera is used */
+#include <media/v4l2-device.h>
@@ -0,0 +1,87 @@
+/*
+ * Host build: V4L2 controls as in Linux 3.1, without clusters and events,
+ * see host-kernel.h
+ */
+
+#ifndef __HOST_MEDIA_V4L2_CTRLS_H__
+#define __HOST_MEDIA_V4L2_CTRLS_H__
+
+#include <host-kernel.h>
+
+#include <linux/videodev2.h>
+
+struct v4l2_ctrl;
+struct v4l2_ctrl_handler;
+
+struct v4l2_ctrl_ops {
+	int (*g_volatile_ctrl)(struct v4l2_ctrl *ctrl);
+	int (*try_ctrl)(struct v4l2_ctrl *ctrl);
+	int (*s_ctrl)(struct v4l2_ctrl *ctrl);
+};
+
+struct v4l2_ctrl {
+	struct list_head node;
+	struct v4l2_ctrl_handler *handler;
+	unsigned int done:1;
+	unsigned int is_new:1;
+	const struct v4l2_ctrl_ops *ops;
+	u32 id;
+	const char *name;
+	enum v4l2_ctrl_type type;
+	s32 minimum, maximum, default_value;
+	union {
+		u32 step;
+		u32 menu_skip_mask;
+	};
+	const char * const *qmenu;
+	unsigned long flags;
+	union {
+		s32 val;
+		s64 val64;
+	} cur;
+	union {
+		s32 val;
+		s64 val64;
+	};
+	void *priv;
+};
+
+struct v4l2_ctrl_handler {
+	struct mutex lock;
+	struct list_head ctrls;
+	int error;
+};
+
+struct v4l2_ctrl_config {
+	const struct v4l2_ctrl_ops *ops;
+	u32 id;
+	const char *name;
+	enum v4l2_ctrl_type type;
+	s32 min;
+	s32 max;
+	u32 step;
+	s32 def;
+	u32 flags;
+	u32 menu_skip_mask;
+	const char * const *qmenu;
+	unsigned int is_private:1;
+};
+
+int v4l2_ctrl_handler_init(struct v4l2_ctrl_handler *hdl,
+			   unsigned int nr_of_controls_hint);
+void v4l2_ctrl_handler_free(struct v4l2_ctrl_handler *hdl);
+int v4l2_ctrl_handler_setup(struct v4l2_ctrl_handler *hdl);
+struct v4l2_ctrl *v4l2_ctrl_new_custom(struct v4l2_ctrl_handler *hdl,
+				       const struct v4l2_ctrl_config *cfg,
+				       void *priv);
+struct v4l2_ctrl *v4l2_ctrl_new_std(struct v4l2_ctrl_handler *hdl,
+				    const struct v4l2_ctrl_ops *ops, u32 id,
+				    s32 min, s32 max, u32 step, s32 def);
+struct v4l2_ctrl *v4l2_ctrl_new_std_menu(struct v4l2_ctrl_handler *hdl,
+					 const struct v4l2_ctrl_ops *ops,
+					 u32 id, s32 max, s32 mask, s32 def);
+struct v4l2_ctrl *v4l2_ctrl_find(struct v4l2_ctrl_handler *hdl, u32 id);
+s32 v4l2_ctrl_g_ctrl(struct v4l2_ctrl *ctrl);
+int v4l2_ctrl_s_ctrl(struct v4l2_ctrl *ctrl, s32 val);
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * Host build: V4L2 devices as in Linux 3.1, see host-kernel.h
+ */
+
+#ifndef __HOST_MEDIA_V4L2_DEVICE_H__
+#define __HOST_MEDIA_V4L2_DEVICE_H__
+
+#include <linux/i2c.h>
+#include <media/v4l2-subdev.h>
+
+#define V4L2_DEVICE_NAME_SIZE	(20 + 16)
+
+struct v4l2_device {
+	struct device *dev;
+	struct list_head subdevs;
+	char name[V4L2_DEVICE_NAME_SIZE];
+	struct v4l2_ctrl_handler *ctrl_handler;
+};
+
+int v4l2_device_register(struct device *dev, struct v4l2_device *v4l2_dev);
+void v4l2_device_unregister(struct v4l2_device *v4l2_dev);
+int v4l2_device_register_subdev(struct v4l2_device *v4l2_dev,
+				struct v4l2_subdev *sd);
+void v4l2_device_unregister_subdev(struct v4l2_subdev *sd);
+
+void v4l2_i2c_subdev_init(struct v4l2_subdev *sd, struct i2c_client *client,
+			  const struct v4l2_subdev_ops *ops);
+
+#endif
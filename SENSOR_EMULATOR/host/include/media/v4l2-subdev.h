@@ -0,0 +1,172 @@
+/*
+ * Host build: V4L2 sub-devices and media entities as in Linux 3.1, see
+ * host-kernel.h
+ */
+
+#ifndef __HOST_MEDIA_V4L2_SUBDEV_H__
+#define __HOST_MEDIA_V4L2_SUBDEV_H__
+
+#include <host-kernel.h>
+
+#include <linux/i2c.h>
+#include <linux/media.h>
+#include <linux/v4l2-subdev.h>
+#include <linux/videodev2.h>
+
+/* Messages of I2C sub-devices, prefixed with the driver and device names */
+#define v4l_client_printk(level, client, fmt, arg...)			\
+	host_dev_printk(level, &(client)->dev, "%s: " fmt,		\
+			(client)->driver ? (client)->driver->driver.name \
+			: "(no driver)", ## arg)
+
+#define v4l_err(client, fmt, arg...) \
+	v4l_client_printk(KERN_ERR, client, fmt, ## arg)
+#define v4l_warn(client, fmt, arg...) \
+	v4l_client_printk(KERN_WARNING, client, fmt, ## arg)
+#define v4l_info(client, fmt, arg...) \
+	v4l_client_printk(KERN_INFO, client, fmt, ## arg)
+
+/************************************************************************
+			Media entities
+************************************************************************/
+struct media_entity;
+
+struct media_pad {
+	struct media_entity *entity;
+	u16 index;
+	unsigned long flags;
+};
+
+struct media_entity {
+	u16 num_pads;
+	struct media_pad *pads;
+};
+
+static inline int media_entity_init(struct media_entity *entity, u16 num_pads,
+				    struct media_pad *pads, u16 extra_links)
+{
+	unsigned int i;
+
+	entity->num_pads = num_pads;
+	entity->pads = pads;
+
+	for (i = 0; i < num_pads; i++) {
+		pads[i].entity = entity;
+		pads[i].index = i;
+	}
+
+	return 0;
+}
+
+static inline void media_entity_cleanup(struct media_entity *entity)
+{
+}
+
+/************************************************************************
+			Sub-devices
+************************************************************************/
+struct v4l2_device;
+struct v4l2_ctrl_handler;
+struct v4l2_subdev;
+
+struct v4l2_subdev_fh {
+	struct v4l2_mbus_framefmt *try_fmt;
+	struct v4l2_rect *try_crop;
+};
+
+static inline struct v4l2_mbus_framefmt *
+v4l2_subdev_get_try_format(struct v4l2_subdev_fh *fh, unsigned int pad)
+{
+	return &fh->try_fmt[pad];
+}
+
+static inline struct v4l2_rect *
+v4l2_subdev_get_try_crop(struct v4l2_subdev_fh *fh, unsigned int pad)
+{
+	return &fh->try_crop[pad];
+}
+
+struct v4l2_subdev_core_ops {
+	int (*g_chip_ident)(struct v4l2_subdev *sd,
+			    struct v4l2_dbg_chip_ident *chip);
+	int (*g_ctrl)(struct v4l2_subdev *sd, struct v4l2_control *ctrl);
+	int (*s_ctrl)(struct v4l2_subdev *sd, struct v4l2_control *ctrl);
+	int (*g_register)(struct v4l2_subdev *sd, struct v4l2_dbg_register *reg);
+	int (*s_register)(struct v4l2_subdev *sd, struct v4l2_dbg_register *reg);
+	int (*s_power)(struct v4l2_subdev *sd, int on);
+};
+
+struct v4l2_subdev_video_ops {
+	int (*s_stream)(struct v4l2_subdev *sd, int enable);
+	int (*g_crop)(struct v4l2_subdev *sd, struct v4l2_crop *crop);
+	int (*s_crop)(struct v4l2_subdev *sd, struct v4l2_crop *crop);
+};
+
+struct v4l2_subdev_pad_ops {
+	int (*enum_mbus_code)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
+			      struct v4l2_subdev_mbus_code_enum *code);
+	int (*enum_frame_size)(struct v4l2_subdev *sd,
+			       struct v4l2_subdev_fh *fh,
+			       struct v4l2_subdev_frame_size_enum *fse);
+	int (*get_fmt)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
+		       struct v4l2_subdev_format *format);
+	int (*set_fmt)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
+		       struct v4l2_subdev_format *format);
+	int (*set_crop)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
+			struct v4l2_subdev_crop *crop);
+	int (*get_crop)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
+			struct v4l2_subdev_crop *crop);
+};
+
+struct v4l2_subdev_ops {
+	const struct v4l2_subdev_core_ops *core;
+	const struct v4l2_subdev_video_ops *video;
+	const struct v4l2_subdev_pad_ops *pad;
+};
+
+struct v4l2_subdev_internal_ops {
+	int (*registered)(struct v4l2_subdev *sd);
+	void (*unregistered)(struct v4l2_subdev *sd);
+	int (*open)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh);
+	int (*close)(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh);
+};
+
+#define V4L2_SUBDEV_NAME_SIZE		32
+
+#define V4L2_SUBDEV_FL_IS_I2C		(1U << 0)
+#define V4L2_SUBDEV_FL_IS_SPI		(1U << 1)
+#define V4L2_SUBDEV_FL_HAS_DEVNODE	(1U << 2)
+#define V4L2_SUBDEV_FL_HAS_EVENTS	(1U << 3)
+
+struct v4l2_subdev {
+	struct media_entity entity;
+	struct list_head list;
+	struct module *owner;
+	u32 flags;
+	struct v4l2_device *v4l2_dev;
+	const struct v4l2_subdev_ops *ops;
+	const struct v4l2_subdev_internal_ops *internal_ops;
+	struct v4l2_ctrl_handler *ctrl_handler;
+	char name[V4L2_SUBDEV_NAME_SIZE];
+	u32 grp_id;
+	void *dev_priv;
+	void *host_priv;
+};
+
+static inline void v4l2_set_subdevdata(struct v4l2_subdev *sd, void *p)
+{
+	sd->dev_priv = p;
+}
+
+static inline void *v4l2_get_subdevdata(const struct v4l2_subdev *sd)
+{
+	return sd->dev_priv;
+}
+
+void v4l2_subdev_init(struct v4l2_subdev *sd, const struct v4l2_subdev_ops *ops);
+
+#define v4l2_subdev_call(sd, o, f, args...)				\
+	(!(sd) ? -ENODEV : (((sd)->ops->o && (sd)->ops->o->f) ?	\
+		(sd)->ops->o->f((sd) , ##args) : -ENOIOCTLCMD))
+
+#endif
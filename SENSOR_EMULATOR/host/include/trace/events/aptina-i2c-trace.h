@@ -0,0 +1,8 @@
+/* Host build: no tracing */
+static inline void trace_aptina_i2c_transfer(const struct i2c_client *client,
+					     enum aptina_i2c_op op, u16 reg,
+					     u32 value, unsigned int len,
+					     bool read, int ret,
+					     unsigned int retry, u64 latency_ns)
+{
+}
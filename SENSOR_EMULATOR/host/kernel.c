@@ -0,0 +1,1121 @@
+/*
+ *
+ * Aptina sensor I2C emulator, host build
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * Kernel services behind include/host-kernel.h: the log, modules and their
+ * parameters, debugfs and seq_file, the I2C core, V4L2 devices and sub-devices
+ * and the V4L2 control framework, with the Linux 3.1 behaviour the drivers
+ * rely on. Drivers are bound synchronously, controls are restored in creation
+ * order and only written when their value changes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <ctype.h>
+#include <time.h>
+
+#include <linux/debugfs.h>
+#include <linux/i2c.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-device.h>
+#include <media/v4l2-subdev.h>
+
+int host_verbose;
+
+/************************************************************************
+			Helpers and log
+************************************************************************/
+size_t host_strlcpy(char *dest, const char *src, size_t size)
+{
+	size_t len = strlen(src);
+
+	if (size) {
+		size_t n = len >= size ? size - 1 : len;
+
+		memcpy(dest, src, n);
+		dest[n] = '\0';
+	}
+
+	return len;
+}
+
+char *strim(char *s)
+{
+	size_t len = strlen(s);
+
+	while (len && isspace((unsigned char)s[len - 1]))
+		s[--len] = '\0';
+	while (isspace((unsigned char)*s))
+		s++;
+
+	return s;
+}
+
+ktime_t ktime_get(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (s64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Errors always go to stderr, the rest of the log with -v only. */
+static void host_vlog(const char *prefix, const char *fmt, va_list ap)
+{
+	int level = 4;
+
+	if (fmt[0] == '<' && fmt[1] >= '0' && fmt[1] <= '7' && fmt[2] == '>') {
+		level = fmt[1] - '0';
+		fmt += 3;
+	}
+
+	if (level > 3 && !host_verbose)
+		return;
+
+	fputs(prefix, stderr);
+	vfprintf(stderr, fmt, ap);
+}
+
+int printk(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	host_vlog("", fmt, ap);
+	va_end(ap);
+	return 0;
+}
+
+int host_dev_printk(const char *level, const struct device *dev,
+		    const char *fmt, ...)
+{
+	char prefix[64];
+	char lfmt[512];
+	va_list ap;
+
+	snprintf(prefix, sizeof(prefix), "%s: ",
+		 dev ? dev_name(dev) : "(NULL device *)");
+	snprintf(lfmt, sizeof(lfmt), "%s%s", level, fmt);
+
+	va_start(ap, fmt);
+	host_vlog(prefix, lfmt, ap);
+	va_end(ap);
+	return 0;
+}
+
+/************************************************************************
+			Device resources
+************************************************************************/
+struct host_devres {
+	struct list_head node;
+	max_align_t data[];
+};
+
+static void host_device_init(struct device *dev, struct device *parent,
+			     const char *name)
+{
+	dev->parent = parent;
+	strlcpy(dev->name, name, sizeof(dev->name));
+	INIT_LIST_HEAD(&dev->devres);
+}
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp)
+{
+	struct host_devres *dr;
+
+	dr = calloc(1, sizeof(*dr) + size);
+	if (dr == NULL)
+		return NULL;
+
+	list_add_tail(&dr->node, &dev->devres);
+	return dr->data;
+}
+
+/* Resources are released when the driver is unbound. */
+static void host_devres_release(struct device *dev)
+{
+	struct host_devres *dr, *next;
+
+	list_for_each_entry_safe(dr, next, &dev->devres, node) {
+		list_del(&dr->node);
+		free(dr);
+	}
+}
+
+/************************************************************************
+			Modules
+************************************************************************/
+#define HOST_MAX_MODULES	16
+#define HOST_MAX_PARAMS		32
+
+struct host_module {
+	const char *name;
+	int (*init)(void);
+	void (*exit)(void);
+	bool loaded;
+};
+
+struct host_param {
+	const char *module;
+	const char *name;
+	const char *type;
+	void *arg;
+	unsigned int *num;
+	unsigned int max;
+};
+
+static struct host_module host_modules[HOST_MAX_MODULES];
+static unsigned int host_num_modules;
+static struct host_module *host_load_order[HOST_MAX_MODULES];
+static unsigned int host_num_loaded;
+
+static struct host_param host_params[HOST_MAX_PARAMS];
+static unsigned int host_num_params;
+
+static struct host_module *host_find_module(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < host_num_modules; i++) {
+		if (strcmp(host_modules[i].name, name) == 0)
+			return &host_modules[i];
+	}
+
+	return NULL;
+}
+
+void host_module_register(const char *name, int (*init)(void),
+			  void (*exit)(void))
+{
+	struct host_module *module = host_find_module(name);
+
+	if (module == NULL) {
+		BUG_ON(host_num_modules == HOST_MAX_MODULES);
+		module = &host_modules[host_num_modules++];
+		module->name = name;
+	}
+
+	if (init)
+		module->init = init;
+	if (exit)
+		module->exit = exit;
+}
+
+void host_param_register(const char *module, const char *name,
+			 const char *type, void *arg, unsigned int *num,
+			 unsigned int max)
+{
+	struct host_param *param;
+
+	BUG_ON(host_num_params == HOST_MAX_PARAMS);
+	param = &host_params[host_num_params++];
+	param->module = module;
+	param->name = name;
+	param->type = type;
+	param->arg = arg;
+	param->num = num;
+	param->max = max;
+}
+
+static int host_param_value(const struct host_param *param, unsigned int index,
+			    const char *value)
+{
+	char *end;
+
+	if (strcmp(param->type, "charp") == 0) {
+		((char **)param->arg)[index] = strdup(value);
+		return 0;
+	}
+
+	if (strcmp(param->type, "uint") == 0) {
+		((unsigned int *)param->arg)[index] = strtoul(value, &end, 0);
+		return *value && !*end ? 0 : -EINVAL;
+	}
+
+	if (strcmp(param->type, "int") == 0) {
+		((int *)param->arg)[index] = strtol(value, &end, 0);
+		return *value && !*end ? 0 : -EINVAL;
+	}
+
+	return -EINVAL;
+}
+
+/* module.param=value, arrays as comma separated values */
+int host_param_set(const char *arg)
+{
+	const char *dot = strchr(arg, '.');
+	const char *eq = strchr(arg, '=');
+	unsigned int i;
+
+	if (dot == NULL || eq == NULL || dot > eq)
+		return -EINVAL;
+
+	for (i = 0; i < host_num_params; i++) {
+		const struct host_param *param = &host_params[i];
+		char *values, *value, *save;
+		unsigned int n = 0;
+		int ret = 0;
+
+		if (strlen(param->module) != (size_t)(dot - arg) ||
+		    strncmp(param->module, arg, dot - arg) ||
+		    strlen(param->name) != (size_t)(eq - dot - 1) ||
+		    strncmp(param->name, dot + 1, eq - dot - 1))
+			continue;
+
+		if (param->num == NULL)
+			return host_param_value(param, 0, eq + 1);
+
+		values = strdup(eq + 1);
+		for (value = strtok_r(values, ",", &save); value && !ret;
+		     value = strtok_r(NULL, ",", &save)) {
+			if (n == param->max)
+				ret = -EINVAL;
+			else
+				ret = host_param_value(param, n++, value);
+		}
+		free(values);
+		*param->num = n;
+		return ret;
+	}
+
+	return -ENOENT;
+}
+
+int host_load_module(const char *name)
+{
+	struct host_module *module = host_find_module(name);
+	int ret;
+
+	if (module == NULL)
+		return -ENOENT;
+	if (module->loaded)
+		return 0;
+
+	ret = module->init ? module->init() : 0;
+	if (ret < 0)
+		return ret;
+
+	module->loaded = true;
+	host_load_order[host_num_loaded++] = module;
+	return 0;
+}
+
+void host_unload_modules(void)
+{
+	while (host_num_loaded) {
+		struct host_module *module = host_load_order[--host_num_loaded];
+
+		if (module->exit)
+			module->exit();
+		module->loaded = false;
+	}
+}
+
+/* The driver modules are linked in, loading one runs its init. */
+int request_module(const char *fmt, ...)
+{
+	char name[64];
+	va_list ap;
+	char *p;
+
+	va_start(ap, fmt);
+	vsnprintf(name, sizeof(name), fmt, ap);
+	va_end(ap);
+
+	for (p = name; *p; p++) {
+		if (*p == '-')
+			*p = '_';
+	}
+
+	return host_load_module(name);
+}
+
+/************************************************************************
+			debugfs
+************************************************************************/
+static struct dentry host_debugfs = {
+	.name		= "",
+	.mode		= S_IFDIR | 0755,
+	.children	= LIST_HEAD_INIT(host_debugfs.children),
+};
+
+struct dentry *host_debugfs_root(void)
+{
+	return &host_debugfs;
+}
+
+static struct dentry *host_debugfs_create(const char *name, umode_t mode,
+					  struct dentry *parent, void *data,
+					  const struct file_operations *fops)
+{
+	struct dentry *dentry;
+
+	dentry = calloc(1, sizeof(*dentry));
+	if (dentry == NULL)
+		return NULL;
+
+	dentry->name = strdup(name);
+	dentry->mode = mode;
+	dentry->inode.i_private = data;
+	dentry->fops = fops;
+	dentry->parent = parent ? parent : &host_debugfs;
+	INIT_LIST_HEAD(&dentry->children);
+	list_add_tail(&dentry->child, &dentry->parent->children);
+
+	return dentry;
+}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+	return host_debugfs_create(name, S_IFDIR | 0755, parent, NULL, NULL);
+}
+
+struct dentry *debugfs_create_file(const char *name, umode_t mode,
+				   struct dentry *parent, void *data,
+				   const struct file_operations *fops)
+{
+	return host_debugfs_create(name, S_IFREG | mode, parent, data, fops);
+}
+
+void debugfs_remove_recursive(struct dentry *dentry)
+{
+	struct dentry *child, *next;
+
+	if (IS_ERR_OR_NULL(dentry) || dentry == &host_debugfs)
+		return;
+
+	list_for_each_entry_safe(child, next, &dentry->children, child)
+		debugfs_remove_recursive(child);
+
+	list_del(&dentry->child);
+	free(dentry->name);
+	free(dentry);
+}
+
+/************************************************************************
+			seq_file
+************************************************************************/
+int seq_open(struct file *file, const struct seq_operations *op)
+{
+	struct seq_file *m;
+
+	m = calloc(1, sizeof(*m));
+	if (m == NULL)
+		return -ENOMEM;
+
+	m->op = op;
+	file->private_data = m;
+	return 0;
+}
+
+int seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+
+	if (m->count + len + 1 > m->size) {
+		size_t size = max_t(size_t, m->size * 2, m->count + len + 1);
+		char *buf = realloc(m->buf, size);
+
+		if (buf == NULL)
+			return -ENOMEM;
+		m->buf = buf;
+		m->size = size;
+	}
+
+	va_start(ap, fmt);
+	vsnprintf(m->buf + m->count, len + 1, fmt, ap);
+	va_end(ap);
+	m->count += len;
+	return 0;
+}
+
+/* The whole file is generated at the first read. */
+static int seq_fill(struct seq_file *m)
+{
+	loff_t pos = 0;
+	int ret = 0;
+	void *p;
+
+	p = m->op->start(m, &pos);
+	while (p) {
+		if (IS_ERR(p)) {
+			ret = PTR_ERR(p);
+			break;
+		}
+		ret = m->op->show(m, p);
+		if (ret < 0)
+			break;
+		ret = 0;
+		p = m->op->next(m, p, &pos);
+	}
+	m->op->stop(m, p);
+
+	return ret;
+}
+
+ssize_t seq_read(struct file *file, char __user *buf, size_t size,
+		 loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	int ret;
+
+	if (!m->filled) {
+		ret = seq_fill(m);
+		if (ret < 0)
+			return ret;
+		m->filled = true;
+	}
+
+	if ((size_t)*ppos >= m->count)
+		return 0;
+
+	size = min(size, m->count - (size_t)*ppos);
+	copy_to_user(buf, m->buf + *ppos, size);
+	*ppos += size;
+	return size;
+}
+
+loff_t seq_lseek(struct file *file, loff_t offset, int origin)
+{
+	if (origin != SEEK_SET || offset < 0)
+		return -EINVAL;
+
+	file->f_pos = offset;
+	return offset;
+}
+
+int seq_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+
+	free(m->buf);
+	free(m);
+	return 0;
+}
+
+static void *single_start(struct seq_file *m, loff_t *pos)
+{
+	return *pos ? NULL : (void *)1;
+}
+
+static void *single_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return NULL;
+}
+
+static void single_stop(struct seq_file *m, void *v)
+{
+}
+
+static int single_show(struct seq_file *m, void *v)
+{
+	return m->single_show(m, v);
+}
+
+static const struct seq_operations single_sops = {
+	.start	= single_start,
+	.next	= single_next,
+	.stop	= single_stop,
+	.show	= single_show,
+};
+
+int single_open(struct file *file, int (*show)(struct seq_file *, void *),
+		void *data)
+{
+	struct seq_file *m;
+	int ret;
+
+	ret = seq_open(file, &single_sops);
+	if (ret < 0)
+		return ret;
+
+	m = file->private_data;
+	m->single_show = show;
+	m->private = data;
+	return 0;
+}
+
+int single_release(struct inode *inode, struct file *file)
+{
+	return seq_release(inode, file);
+}
+
+/************************************************************************
+			I2C core
+************************************************************************/
+static LIST_HEAD(i2c_adapters);
+static LIST_HEAD(i2c_drivers);
+static int i2c_next_nr;
+
+struct host_i2c_client {
+	struct i2c_client client;
+	struct list_head list;
+};
+
+static LIST_HEAD(i2c_clients);
+
+int i2c_add_adapter(struct i2c_adapter *adap)
+{
+	char name[16];
+
+	adap->nr = i2c_next_nr++;
+	snprintf(name, sizeof(name), "i2c-%d", adap->nr);
+	host_device_init(&adap->dev, NULL, name);
+	list_add_tail(&adap->list, &i2c_adapters);
+
+	return 0;
+}
+
+static const struct i2c_device_id *i2c_match_id(const struct i2c_device_id *id,
+						const struct i2c_client *client)
+{
+	for (; id->name[0]; id++) {
+		if (strcmp(client->name, id->name) == 0)
+			return id;
+	}
+
+	return NULL;
+}
+
+static void i2c_device_bind(struct i2c_client *client)
+{
+	const struct i2c_device_id *id = NULL;
+	struct i2c_driver *driver;
+
+	list_for_each_entry(driver, &i2c_drivers, list) {
+		id = driver->id_table ? i2c_match_id(driver->id_table, client)
+		   : NULL;
+		if (id)
+			break;
+	}
+
+	if (id == NULL || driver->probe == NULL)
+		return;
+
+	client->driver = driver;
+	if (driver->probe(client, id)) {
+		client->driver = NULL;
+		i2c_set_clientdata(client, NULL);
+		host_devres_release(&client->dev);
+	}
+}
+
+static void i2c_device_unbind(struct i2c_client *client)
+{
+	if (client->driver == NULL)
+		return;
+
+	if (client->driver->remove)
+		client->driver->remove(client);
+	client->driver = NULL;
+	i2c_set_clientdata(client, NULL);
+	host_devres_release(&client->dev);
+}
+
+int i2c_add_driver(struct i2c_driver *driver)
+{
+	struct host_i2c_client *hc;
+
+	list_add_tail(&driver->list, &i2c_drivers);
+
+	list_for_each_entry(hc, &i2c_clients, list) {
+		if (hc->client.driver == NULL)
+			i2c_device_bind(&hc->client);
+	}
+
+	return 0;
+}
+
+void i2c_del_driver(struct i2c_driver *driver)
+{
+	struct host_i2c_client *hc;
+
+	list_for_each_entry(hc, &i2c_clients, list) {
+		if (hc->client.driver == driver)
+			i2c_device_unbind(&hc->client);
+	}
+
+	list_del(&driver->list);
+}
+
+/* The device is bound to its driver before returning, as in the kernel. */
+struct i2c_client *i2c_new_device(struct i2c_adapter *adap,
+				  struct i2c_board_info const *info)
+{
+	struct host_i2c_client *hc;
+	struct i2c_client *client;
+	char name[16];
+
+	hc = calloc(1, sizeof(*hc));
+	if (hc == NULL)
+		return NULL;
+
+	client = &hc->client;
+	client->adapter = adap;
+	client->addr = info->addr;
+	client->flags = info->flags;
+	client->irq = info->irq;
+	strlcpy(client->name, info->type, sizeof(client->name));
+
+	snprintf(name, sizeof(name), "%d-%04x", adap->nr, client->addr);
+	host_device_init(&client->dev, &adap->dev, name);
+	client->dev.platform_data = info->platform_data;
+
+	list_add_tail(&hc->list, &i2c_clients);
+	i2c_device_bind(client);
+
+	return client;
+}
+
+void i2c_unregister_device(struct i2c_client *client)
+{
+	struct host_i2c_client *hc;
+
+	if (client == NULL)
+		return;
+
+	hc = container_of(client, struct host_i2c_client, client);
+	i2c_device_unbind(client);
+	list_del(&hc->list);
+	free(hc);
+}
+
+int i2c_del_adapter(struct i2c_adapter *adap)
+{
+	struct host_i2c_client *hc, *next;
+
+	list_for_each_entry_safe(hc, next, &i2c_clients, list) {
+		if (hc->client.adapter == adap)
+			i2c_unregister_device(&hc->client);
+	}
+
+	list_del(&adap->list);
+	return 0;
+}
+
+int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+	int ret;
+	int try;
+
+	if (adap->algo->master_xfer == NULL)
+		return -EOPNOTSUPP;
+
+	for (ret = 0, try = 0; try <= adap->retries; try++) {
+		ret = adap->algo->master_xfer(adap, msgs, num);
+		if (ret != -EAGAIN)
+			break;
+	}
+
+	return ret;
+}
+
+/************************************************************************
+			V4L2 devices and sub-devices
+************************************************************************/
+int v4l2_device_register(struct device *dev, struct v4l2_device *v4l2_dev)
+{
+	if (v4l2_dev == NULL)
+		return -EINVAL;
+
+	INIT_LIST_HEAD(&v4l2_dev->subdevs);
+	v4l2_dev->dev = dev;
+	if (dev && !v4l2_dev->name[0])
+		strlcpy(v4l2_dev->name, dev_name(dev), sizeof(v4l2_dev->name));
+
+	return 0;
+}
+
+void v4l2_device_unregister(struct v4l2_device *v4l2_dev)
+{
+	struct v4l2_subdev *sd, *next;
+
+	if (v4l2_dev == NULL)
+		return;
+
+	list_for_each_entry_safe(sd, next, &v4l2_dev->subdevs, list)
+		v4l2_device_unregister_subdev(sd);
+}
+
+/*
+ * As in Linux 3.1, the sub-device keeps its v4l2_dev when the registered
+ * operation fails, the driver remove unregisters it.
+ */
+int v4l2_device_register_subdev(struct v4l2_device *v4l2_dev,
+				struct v4l2_subdev *sd)
+{
+	int err;
+
+	if (v4l2_dev == NULL || sd == NULL || !sd->name[0])
+		return -EINVAL;
+
+	WARN_ON(sd->v4l2_dev != NULL);
+
+	if (!try_module_get(sd->owner))
+		return -ENODEV;
+
+	sd->v4l2_dev = v4l2_dev;
+	if (sd->internal_ops && sd->internal_ops->registered) {
+		err = sd->internal_ops->registered(sd);
+		if (err) {
+			module_put(sd->owner);
+			return err;
+		}
+	}
+
+	list_add_tail(&sd->list, &v4l2_dev->subdevs);
+	return 0;
+}
+
+void v4l2_device_unregister_subdev(struct v4l2_subdev *sd)
+{
+	if (sd == NULL || sd->v4l2_dev == NULL)
+		return;
+
+	list_del(&sd->list);
+	if (sd->internal_ops && sd->internal_ops->unregistered)
+		sd->internal_ops->unregistered(sd);
+	sd->v4l2_dev = NULL;
+	module_put(sd->owner);
+}
+
+void v4l2_subdev_init(struct v4l2_subdev *sd, const struct v4l2_subdev_ops *ops)
+{
+	INIT_LIST_HEAD(&sd->list);
+	sd->ops = ops;
+	sd->v4l2_dev = NULL;
+	sd->flags = 0;
+	sd->name[0] = '\0';
+	sd->grp_id = 0;
+	sd->dev_priv = NULL;
+	sd->host_priv = NULL;
+}
+
+void v4l2_i2c_subdev_init(struct v4l2_subdev *sd, struct i2c_client *client,
+			  const struct v4l2_subdev_ops *ops)
+{
+	v4l2_subdev_init(sd, ops);
+	sd->flags |= V4L2_SUBDEV_FL_IS_I2C;
+	sd->owner = client->driver->driver.owner;
+	v4l2_set_subdevdata(sd, client);
+	i2c_set_clientdata(client, sd);
+	snprintf(sd->name, sizeof(sd->name), "%s %d-%04x",
+		 client->driver->driver.name, client->adapter->nr,
+		 client->addr);
+}
+
+/************************************************************************
+			V4L2 controls
+************************************************************************/
+static const char * const v4l2_ctrl_exposure_auto_menu[] = {
+	"Auto Mode",
+	"Manual Mode",
+	"Shutter Priority Mode",
+	"Aperture Priority Mode",
+	NULL
+};
+
+/* The standard controls the drivers create */
+static void v4l2_ctrl_fill(u32 id, const char **name,
+			   enum v4l2_ctrl_type *type, u32 *flags)
+{
+	*flags = 0;
+
+	switch (id) {
+	case V4L2_CID_HFLIP:
+		*name = "Horizontal Flip";
+		*type = V4L2_CTRL_TYPE_BOOLEAN;
+		break;
+	case V4L2_CID_VFLIP:
+		*name = "Vertical Flip";
+		*type = V4L2_CTRL_TYPE_BOOLEAN;
+		break;
+	case V4L2_CID_EXPOSURE_AUTO:
+		*name = "Auto Exposure";
+		*type = V4L2_CTRL_TYPE_MENU;
+		break;
+	case V4L2_CID_GAIN:
+		*name = "Gain";
+		*type = V4L2_CTRL_TYPE_INTEGER;
+		break;
+	case V4L2_CID_EXPOSURE:
+		*name = "Exposure";
+		*type = V4L2_CTRL_TYPE_INTEGER;
+		break;
+	default:
+		*name = NULL;
+		*type = V4L2_CTRL_TYPE_INTEGER;
+		break;
+	}
+}
+
+static const char * const *v4l2_ctrl_get_menu(u32 id)
+{
+	return id == V4L2_CID_EXPOSURE_AUTO ? v4l2_ctrl_exposure_auto_menu
+	     : NULL;
+}
+
+static void handler_set_err(struct v4l2_ctrl_handler *hdl, int err)
+{
+	if (hdl->error == 0)
+		hdl->error = err;
+}
+
+int v4l2_ctrl_handler_init(struct v4l2_ctrl_handler *hdl,
+			   unsigned int nr_of_controls_hint)
+{
+	mutex_init(&hdl->lock);
+	INIT_LIST_HEAD(&hdl->ctrls);
+	hdl->error = 0;
+	return 0;
+}
+
+void v4l2_ctrl_handler_free(struct v4l2_ctrl_handler *hdl)
+{
+	struct v4l2_ctrl *ctrl, *next;
+
+	if (hdl == NULL || hdl->ctrls.next == NULL)
+		return;
+
+	list_for_each_entry_safe(ctrl, next, &hdl->ctrls, node) {
+		list_del(&ctrl->node);
+		free(ctrl);
+	}
+}
+
+static struct v4l2_ctrl *v4l2_ctrl_new(struct v4l2_ctrl_handler *hdl,
+				       const struct v4l2_ctrl_ops *ops,
+				       u32 id, const char *name,
+				       enum v4l2_ctrl_type type, s32 min,
+				       s32 max, u32 step, s32 def, u32 flags,
+				       const char * const *qmenu, void *priv)
+{
+	struct v4l2_ctrl *ctrl;
+
+	if (hdl->error)
+		return NULL;
+
+	if (id == 0 || name == NULL || id >= V4L2_CID_PRIVATE_BASE ||
+	    max < min ||
+	    (type == V4L2_CTRL_TYPE_INTEGER && step == 0) ||
+	    (type == V4L2_CTRL_TYPE_MENU && qmenu == NULL) ||
+	    ((type == V4L2_CTRL_TYPE_INTEGER || type == V4L2_CTRL_TYPE_MENU ||
+	      type == V4L2_CTRL_TYPE_BOOLEAN) && (def < min || def > max))) {
+		handler_set_err(hdl, -ERANGE);
+		return NULL;
+	}
+
+	if (type == V4L2_CTRL_TYPE_BUTTON)
+		flags |= V4L2_CTRL_FLAG_WRITE_ONLY;
+
+	ctrl = calloc(1, sizeof(*ctrl));
+	if (ctrl == NULL) {
+		handler_set_err(hdl, -ENOMEM);
+		return NULL;
+	}
+
+	ctrl->handler = hdl;
+	ctrl->ops = ops;
+	ctrl->id = id;
+	ctrl->name = name;
+	ctrl->type = type;
+	ctrl->flags = flags;
+	ctrl->minimum = min;
+	ctrl->maximum = max;
+	ctrl->step = step;
+	ctrl->qmenu = qmenu;
+	ctrl->priv = priv;
+	ctrl->cur.val = ctrl->val = ctrl->default_value = def;
+
+	list_add_tail(&ctrl->node, &hdl->ctrls);
+	return ctrl;
+}
+
+struct v4l2_ctrl *v4l2_ctrl_new_custom(struct v4l2_ctrl_handler *hdl,
+				       const struct v4l2_ctrl_config *cfg,
+				       void *priv)
+{
+	const char * const *qmenu = cfg->qmenu;
+	enum v4l2_ctrl_type type = cfg->type;
+	const char *name = cfg->name;
+	u32 flags = cfg->flags;
+	bool is_menu;
+
+	if (name == NULL)
+		v4l2_ctrl_fill(cfg->id, &name, &type, &flags);
+
+	is_menu = cfg->type == V4L2_CTRL_TYPE_MENU;
+	if (is_menu)
+		WARN_ON(cfg->step);
+	else
+		WARN_ON(cfg->menu_skip_mask);
+	if (is_menu && qmenu == NULL)
+		qmenu = v4l2_ctrl_get_menu(cfg->id);
+
+	return v4l2_ctrl_new(hdl, cfg->ops, cfg->id, name, type, cfg->min,
+			     cfg->max, is_menu ? cfg->menu_skip_mask : cfg->step,
+			     cfg->def, flags, qmenu, priv);
+}
+
+struct v4l2_ctrl *v4l2_ctrl_new_std(struct v4l2_ctrl_handler *hdl,
+				    const struct v4l2_ctrl_ops *ops, u32 id,
+				    s32 min, s32 max, u32 step, s32 def)
+{
+	enum v4l2_ctrl_type type;
+	const char *name;
+	u32 flags;
+
+	v4l2_ctrl_fill(id, &name, &type, &flags);
+	if (type == V4L2_CTRL_TYPE_MENU) {
+		handler_set_err(hdl, -EINVAL);
+		return NULL;
+	}
+
+	return v4l2_ctrl_new(hdl, ops, id, name, type, min, max, step, def,
+			     flags, NULL, NULL);
+}
+
+struct v4l2_ctrl *v4l2_ctrl_new_std_menu(struct v4l2_ctrl_handler *hdl,
+					 const struct v4l2_ctrl_ops *ops,
+					 u32 id, s32 max, s32 mask, s32 def)
+{
+	enum v4l2_ctrl_type type;
+	const char *name;
+	u32 flags;
+
+	v4l2_ctrl_fill(id, &name, &type, &flags);
+	if (type != V4L2_CTRL_TYPE_MENU) {
+		handler_set_err(hdl, -EINVAL);
+		return NULL;
+	}
+
+	return v4l2_ctrl_new(hdl, ops, id, name, type, 0, max, mask, def,
+			     flags, v4l2_ctrl_get_menu(id), NULL);
+}
+
+struct v4l2_ctrl *v4l2_ctrl_find(struct v4l2_ctrl_handler *hdl, u32 id)
+{
+	struct v4l2_ctrl *ctrl;
+
+	if (hdl == NULL)
+		return NULL;
+
+	list_for_each_entry(ctrl, &hdl->ctrls, node) {
+		if (ctrl->id == id)
+			return ctrl;
+	}
+
+	return NULL;
+}
+
+/* Restore every control to the hardware, in creation order. */
+int v4l2_ctrl_handler_setup(struct v4l2_ctrl_handler *hdl)
+{
+	struct v4l2_ctrl *ctrl;
+	int ret = 0;
+
+	if (hdl == NULL)
+		return 0;
+
+	mutex_lock(&hdl->lock);
+	list_for_each_entry(ctrl, &hdl->ctrls, node) {
+		if (ctrl->type == V4L2_CTRL_TYPE_BUTTON ||
+		    (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY))
+			continue;
+
+		ctrl->val = ctrl->cur.val;
+		ctrl->is_new = 1;
+		ret = ctrl->ops && ctrl->ops->s_ctrl ? ctrl->ops->s_ctrl(ctrl) : 0;
+		if (ret)
+			break;
+	}
+	mutex_unlock(&hdl->lock);
+
+	return ret;
+}
+
+s32 v4l2_ctrl_g_ctrl(struct v4l2_ctrl *ctrl)
+{
+	return ctrl->cur.val;
+}
+
+static int validate_new_int(const struct v4l2_ctrl *ctrl, s32 *pval)
+{
+	s32 val = *pval;
+	u32 offset;
+
+	switch (ctrl->type) {
+	case V4L2_CTRL_TYPE_INTEGER:
+		/* Round towards the closest legal value */
+		val += ctrl->step / 2;
+		if (val < ctrl->minimum)
+			val = ctrl->minimum;
+		if (val > ctrl->maximum)
+			val = ctrl->maximum;
+		offset = val - ctrl->minimum;
+		offset = ctrl->step * (offset / ctrl->step);
+		*pval = ctrl->minimum + offset;
+		return 0;
+	case V4L2_CTRL_TYPE_BOOLEAN:
+		*pval = !!val;
+		return 0;
+	case V4L2_CTRL_TYPE_MENU:
+		if (val < ctrl->minimum || val > ctrl->maximum)
+			return -ERANGE;
+		if (ctrl->qmenu[val][0] == '\0' ||
+		    (ctrl->menu_skip_mask & (1 << val)))
+			return -EINVAL;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* The driver is only called when the value changes. */
+int v4l2_ctrl_s_ctrl(struct v4l2_ctrl *ctrl, s32 val)
+{
+	int ret;
+
+	if (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY)
+		return -EACCES;
+
+	ret = validate_new_int(ctrl, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&ctrl->handler->lock);
+	ctrl->val = val;
+	ctrl->is_new = 1;
+
+	if (ctrl->ops && ctrl->ops->try_ctrl)
+		ret = ctrl->ops->try_ctrl(ctrl);
+	if (ret == 0 && ctrl->val != ctrl->cur.val) {
+		ret = ctrl->ops && ctrl->ops->s_ctrl ? ctrl->ops->s_ctrl(ctrl)
+		    : 0;
+		if (ret == 0)
+			ctrl->cur.val = ctrl->val;
+	}
+	mutex_unlock(&ctrl->handler->lock);
+
+	return ret;
+}
@@ -0,0 +1,193 @@
+/*
+ *
+ * Aptina sensor I2C emulator, host build
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * Runs sensor-emu and the sensor drivers as a user space program: loads the
+ * emulator with the given module parameters, writes the commands to the
+ * command file of every emulated sensor, then copies the debugfs files to a
+ * directory laid out as /sys/kernel/debug, so that sensor-emu-check.sh checks
+ * the drivers without a kernel.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <limits.h>
+#include <unistd.h>
+
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-v] [-p module.param=value]... dir "
+		"[command]...\n", argv0);
+	fprintf(stderr, "  -p  module parameter, e.g. sensor_emu.sensor=mt9v113\n");
+	fprintf(stderr, "  -v  print the kernel log\n");
+	fprintf(stderr, "The debugfs files are written to dir after the "
+		"commands.\n");
+}
+
+static int write_command(struct dentry *file, const char *cmd)
+{
+	struct file f = { 0 };
+	loff_t pos = 0;
+	ssize_t ret;
+
+	ret = file->fops->open(&file->inode, &f);
+	if (ret < 0)
+		return ret;
+
+	ret = file->fops->write(&f, cmd, strlen(cmd), &pos);
+	if (file->fops->release)
+		file->fops->release(&file->inode, &f);
+
+	return ret < 0 ? ret : 0;
+}
+
+/* Write a command to the command file of every emulated sensor. */
+static int run_command(const char *cmd)
+{
+	struct dentry *root = host_debugfs_root();
+	struct dentry *emu, *sensor, *file;
+	int status = 0;
+
+	list_for_each_entry(emu, &root->children, child) {
+		if (strcmp(emu->name, "sensor-emu"))
+			continue;
+
+		list_for_each_entry(sensor, &emu->children, child) {
+			list_for_each_entry(file, &sensor->children, child) {
+				int ret;
+
+				if (strcmp(file->name, "command"))
+					continue;
+
+				ret = write_command(file, cmd);
+				if (ret < 0) {
+					fprintf(stderr, "%s: '%s' failed: %s\n",
+						sensor->name, cmd,
+						strerror(-ret));
+					status = ret;
+				}
+			}
+		}
+	}
+
+	return status;
+}
+
+/* Copy a readable file, as cat would. A read error leaves no file. */
+static void dump_file(struct dentry *file, const char *path)
+{
+	struct file f = { 0 };
+	loff_t pos = 0;
+	char buf[4096];
+	ssize_t len;
+	FILE *out;
+
+	if (file->fops->open(&file->inode, &f) < 0)
+		return;
+
+	out = fopen(path, "w");
+	if (out == NULL) {
+		perror(path);
+		goto done;
+	}
+
+	while ((len = file->fops->read(&f, buf, sizeof(buf), &pos)) > 0)
+		fwrite(buf, 1, len, out);
+
+	fclose(out);
+	if (len < 0)
+		unlink(path);
+
+done:
+	if (file->fops->release)
+		file->fops->release(&file->inode, &f);
+}
+
+static int dump(struct dentry *dir, const char *path)
+{
+	struct dentry *child;
+	char name[PATH_MAX];
+
+	if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+		perror(path);
+		return -1;
+	}
+
+	list_for_each_entry(child, &dir->children, child) {
+		snprintf(name, sizeof(name), "%s/%s", path, child->name);
+
+		if (S_ISDIR(child->mode)) {
+			if (dump(child, name) < 0)
+				return -1;
+		} else if ((child->mode & S_IRUSR) && child->fops->read) {
+			dump_file(child, name);
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int status = 0;
+	int opt;
+	int ret;
+	int i;
+
+	while ((opt = getopt(argc, argv, "p:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			ret = host_param_set(optarg);
+			if (ret < 0) {
+				fprintf(stderr, "%s: %s\n", optarg,
+					strerror(-ret));
+				return 2;
+			}
+			break;
+		case 'v':
+			host_verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	/* The drivers are loaded on demand by the emulator. */
+	if (host_load_module("aptina_i2c") < 0 ||
+	    (ret = host_load_module("sensor_emu")) < 0) {
+		fprintf(stderr, "sensor-emu failed to load\n");
+		return 2;
+	}
+
+	for (i = optind + 1; i < argc; i++) {
+		if (run_command(argv[i]) < 0) {
+			status = 1;
+			break;
+		}
+	}
+
+	if (dump(host_debugfs_root(), argv[optind]) < 0)
+		status = 2;
+
+	host_unload_modules();
+	return status;
+}
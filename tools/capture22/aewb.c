@@ -0,0 +1,244 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// AE/AWB controller on H3A AEWB statistics.  See aewb.h.
+//
+// H3A AEWB buffer layout (OMAP3 ISP), little endian 16-bit words:
+//
+//   every window, in raster order and followed by the black row, is one
+//   8 word packet; words 0..3 are the sums of the four colour positions of
+//   the subsample points (each point is a 2x2 Bayer cell) of the window.
+//   After every 8 window packets comes one packet holding, for each of
+//   those 8 windows, the number of points without a saturated pixel.
+//
+// ALAW compression is left off so the sums stay linear in exposure, which
+// the controller relies on.  10-bit sums fit 16 bits for up to 64 points
+// per window; aewb_config () sizes the subsampling accordingly.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <string.h>
+#include <math.h>
+
+#include "aewb.h"
+
+#define PACKET_WORDS    8
+#define MAX_POINTS      64          // per window, so that 10-bit sums fit 16 bits
+#define GRID_COLUMNS    16
+#define GRID_ROWS       12
+#define MAX_STEP        8.0f        // exposure change per iteration, either way
+#define WB_DARK         32.0f       // windows darker than this don't vote for white balance
+
+//***********************************************************************************
+static unsigned int clampu (unsigned int v, unsigned int lo, unsigned int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+void aewb_config (struct isph3a_aewb_config * cfg, unsigned int width, unsigned int height)
+{
+unsigned int inc;
+
+    memset (cfg, 0, sizeof (*cfg));
+    cfg->hor_win_count = GRID_COLUMNS;
+    cfg->ver_win_count = GRID_ROWS;
+    cfg->win_width = clampu ((width / GRID_COLUMNS) & ~1u, MIN_WIN_W, MAX_WIN_W);
+    cfg->win_height = clampu ((height / (GRID_ROWS + 1)) & ~1u, MIN_WIN_H, MAX_WIN_H);
+
+    // Smallest even subsampling step that keeps the sums in 16 bits.
+    for (inc = MIN_SUB_INC; inc < MAX_SUB_INC; inc += 2) {
+        if ((cfg->win_width / inc) * (cfg->win_height / inc) <= MAX_POINTS)
+            break;
+    }
+    cfg->subsample_hor_inc = inc;
+    cfg->subsample_ver_inc = inc;
+
+    cfg->hor_win_start = (width - cfg->win_width * GRID_COLUMNS) / 2 & ~1u;
+    cfg->ver_win_start = 0;
+    cfg->blk_ver_win_start = clampu (cfg->win_height * GRID_ROWS, 0, height - MIN_WIN_H);
+    cfg->blk_win_height = MIN_WIN_H;
+    cfg->saturation_limit = MAX_SATURATION_LIM - 1;
+    cfg->alaw_enable = 0;
+    cfg->aewb_enable = 1;
+}
+
+unsigned int aewb_buffer_size (const struct isph3a_aewb_config * cfg)
+{
+unsigned int windows = (cfg->ver_win_count + 1) * cfg->hor_win_count;
+
+    return (windows + (windows + 7) / 8) * PACKET_WORDS * 2;
+}
+
+//***********************************************************************************
+// Colour position (raster order in the 2x2 cell) of red and blue.
+//
+static void bayer_positions (enum bayer_order order, unsigned int * r, unsigned int * b)
+{
+    switch (order) {
+        case BAYER_RGGB: *r = 0; *b = 3; break;
+        case BAYER_GRBG: *r = 1; *b = 2; break;
+        case BAYER_GBRG: *r = 2; *b = 1; break;
+        case BAYER_BGGR: *r = 3; *b = 0; break;
+    }
+}
+
+void aewb_parse (const void * buf, const struct isph3a_aewb_config * cfg,
+                 enum bayer_order order, struct aewb_stats * s)
+{
+const uint16_t *w = buf;
+unsigned int points = (cfg->win_width / cfg->subsample_hor_inc) *
+                      (cfg->win_height / cfg->subsample_ver_inc);
+float scale = points ? 1.0f / points : 0.0f;
+unsigned int ri = 1, bi = 2;
+unsigned int i, j, gi0, gi1;
+
+    bayer_positions (order, &ri, &bi);
+    gi0 = ri ^ 1;                   // the greens share a row with red and blue
+    gi1 = bi ^ 1;
+
+    s->windows = cfg->ver_win_count * cfg->hor_win_count;
+    s->columns = cfg->hor_win_count;
+
+    for (i = 0; i < s->windows; i += 8) {
+        const uint16_t *counts = w + 8 * PACKET_WORDS;
+
+        for (j = 0; j < 8 && i + j < s->windows; ++j, w += PACKET_WORDS) {
+            s->r[i + j] = w[ri] * scale;
+            s->b[i + j] = w[bi] * scale;
+            s->g[i + j] = (w[gi0] + w[gi1]) * 0.5f * scale;
+            s->saturated[i + j] = counts[j] * 4 < points * 3;
+        }
+        w = counts + PACKET_WORDS;
+    }
+}
+
+//***********************************************************************************
+// Windows in the middle half of the frame count twice.
+//
+float aewb_luma (const struct aewb_stats * s)
+{
+unsigned int rows = s->windows / s->columns;
+float sum = 0.0f, weight = 0.0f;
+unsigned int i, x, y;
+
+    for (i = 0; i < s->windows; ++i) {
+        float wt;
+
+        x = i % s->columns;
+        y = i / s->columns;
+        wt = (x >= s->columns / 4 && x < s->columns - s->columns / 4 &&
+              y >= rows / 4 && y < rows - rows / 4) ? 2.0f : 1.0f;
+        sum += wt * (s->r[i] + 2.0f * s->g[i] + s->b[i]) * 0.25f;
+        weight += wt;
+    }
+
+    return weight > 0.0f ? sum / weight : 0.0f;
+}
+
+void aewb_init (struct aewb_state * st, const struct aewb_params * p,
+                unsigned int exposure, unsigned int gain)
+{
+    memset (st, 0, sizeof (*st));
+    st->p = *p;
+    st->exposure = clampu (exposure, p->exposure_min, p->exposure_max);
+    st->gain = clampu (gain, p->gain_min, p->gain_max);
+    st->wb_r = st->wb_g = st->wb_b = AEWB_WB_ONE;
+    st->converged = -1;
+}
+
+//***********************************************************************************
+// Exposure: split the wanted exposure * gain product, exposure first.
+//
+static int update_exposure (struct aewb_state * st, float ratio)
+{
+const struct aewb_params *p = &st->p;
+float total = (float)st->exposure * st->gain * ratio;
+unsigned int exposure, gain;
+
+    exposure = clampu (total / p->gain_min + 0.5f, p->exposure_min, p->exposure_max);
+    gain = clampu (total / exposure + 0.5f, p->gain_min, p->gain_max);
+    if (exposure == st->exposure && gain == st->gain)
+        return 0;
+
+    st->exposure = exposure;
+    st->gain = gain;
+    return 1;
+}
+
+static int update_wb (struct aewb_state * st, const struct aewb_stats * s)
+{
+float r = 0.0f, g = 0.0f, b = 0.0f;
+unsigned int i, wb_r, wb_b;
+
+    for (i = 0; i < s->windows; ++i) {
+        if (s->saturated[i] || s->g[i] < WB_DARK)
+            continue;
+        r += s->r[i];
+        g += s->g[i];
+        b += s->b[i];
+    }
+    if (r <= 0.0f || b <= 0.0f)
+        return 0;
+
+    // Half way each frame: the statistics see the ISP input, which the
+    // gains don't change, so this only filters noise.
+    wb_r = clampu ((st->wb_r + AEWB_WB_ONE * g / r) * 0.5f + 0.5f, AEWB_WB_ONE / 2, 255);
+    wb_b = clampu ((st->wb_b + AEWB_WB_ONE * g / b) * 0.5f + 0.5f, AEWB_WB_ONE / 2, 255);
+    if (wb_r == st->wb_r && wb_b == st->wb_b)
+        return 0;
+
+    st->wb_r = wb_r;
+    st->wb_b = wb_b;
+    return 1;
+}
+
+int aewb_update (struct aewb_state * st, const struct aewb_stats * s)
+{
+const struct aewb_params *p = &st->p;
+unsigned int i, saturated = 0;
+float ratio, error;
+int changed = 0;
+
+    st->luma = aewb_luma (s);
+    error = st->luma / p->target - 1.0f;
+
+    // Frames exposed with older settings say nothing about the new ones.
+    if (st->frame - st->changed >= p->latency || st->frame == 0) {
+        for (i = 0; i < s->windows; ++i)
+            saturated += s->saturated[i];
+
+        ratio = p->target / (st->luma > 1.0f ? st->luma : 1.0f);
+        if (saturated > p->max_saturated * s->windows) {
+            float cut = 1.0f - 0.5f * saturated / s->windows;
+
+            if (ratio > cut)
+                ratio = cut;
+        }
+        if (fabsf (error) > p->tolerance || ratio < 1.0f - p->tolerance) {
+            ratio = powf (ratio, p->damping);
+            if (ratio > MAX_STEP)
+                ratio = MAX_STEP;
+            if (ratio < 1.0f / MAX_STEP)
+                ratio = 1.0f / MAX_STEP;
+            if (update_exposure (st, ratio)) {
+                st->changed = st->frame;
+                changed = 1;
+            }
+        }
+    }
+
+    changed |= update_wb (st, s);
+
+    if (fabsf (error) <= p->tolerance) {
+        if (st->stable++ == 0)
+            st->converged = st->frame;
+    } else {
+        st->stable = 0;
+        st->converged = -1;
+    }
+
+    st->frame++;
+    return changed;
+}
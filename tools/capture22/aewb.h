@@ -0,0 +1,110 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Auto exposure / auto white balance from OMAP3 ISP H3A AEWB statistics.
+//
+// aewb_config () lays a grid of windows over the frame, aewb_parse ()
+// turns the H3A buffer into per-window colour means, and aewb_update ()
+// runs one controller iteration: it returns the exposure, analog gain and
+// white balance gains to program for the next frame.
+//
+// Exposure control works on the product exposure * gain, which the sensor
+// response is proportional to as long as nothing clips.  Each iteration
+// moves the product by (target / measured)^k in one step (k < 1 damps the
+// overshoot caused by clipping and by the measurement noise), limited to a
+// factor of 8 either way, and backs off further when too many windows
+// saturate.  Exposure is raised before gain and lowered after it, which
+// keeps the gain, and the noise, as low as the frame time allows.  The
+// sensor applies new settings only some frames later: statistics of frames
+// taken before the last change is in effect are not acted upon.
+//
+// White balance is grey world over the windows that are neither saturated
+// nor too dark.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __AEWB_H
+#define __AEWB_H
+
+#include <stdint.h>
+
+#include "isp_user.h"
+#include "bayer.h"
+
+#define AEWB_MAX_WINDOWS    (MAX_WINVC * MAX_WINHC)
+#define AEWB_WB_ONE         32              // U8Q5 white balance gain 1.0
+#define AEWB_STABLE_FRAMES  3               // in tolerance this long to count as converged
+
+//
+// Statistics of one frame.  Means are on the 10-bit sample scale.
+//
+struct aewb_stats {
+    unsigned int windows;
+    unsigned int columns;
+    float r[AEWB_MAX_WINDOWS];
+    float g[AEWB_MAX_WINDOWS];
+    float b[AEWB_MAX_WINDOWS];
+    unsigned char saturated[AEWB_MAX_WINDOWS];
+};
+
+struct aewb_params {
+    float target;                   // mean luma to reach [180]
+    float tolerance;                // converged within target * (1 +- tolerance) [0.05]
+    float damping;                  // step exponent k [0.85]
+    float max_saturated;            // tolerated fraction of saturated windows [0.02]
+    unsigned int exposure_min;      // sensor exposure units
+    unsigned int exposure_max;
+    unsigned int gain_min;          // sensor analog gain units, linear
+    unsigned int gain_max;
+    unsigned int latency;           // frames until new settings take effect [2]
+};
+
+struct aewb_state {
+    struct aewb_params p;
+    unsigned int exposure;
+    unsigned int gain;
+    unsigned int wb_r;              // U8Q5
+    unsigned int wb_b;
+    unsigned int wb_g;
+
+    unsigned long frame;            // iterations so far
+    unsigned long changed;          // frame the current settings were set on
+    float luma;                     // last measured mean
+    unsigned int stable;            // consecutive frames within tolerance
+    long converged;                 // first frame of the last stable run, -1 while hunting
+};
+
+//
+// Window grid for a width x height frame.
+//
+void aewb_config (struct isph3a_aewb_config * cfg, unsigned int width, unsigned int height);
+
+//
+// Size of the H3A buffer for cfg.
+//
+unsigned int aewb_buffer_size (const struct isph3a_aewb_config * cfg);
+
+//
+// Decode an H3A AEWB buffer.  order is the Bayer order of the frame.
+//
+void aewb_parse (const void * buf, const struct isph3a_aewb_config * cfg,
+                 enum bayer_order order, struct aewb_stats * s);
+
+void aewb_init (struct aewb_state * st, const struct aewb_params * p,
+                unsigned int exposure, unsigned int gain);
+
+//
+// One iteration on the statistics of the current frame.  Returns 1 when
+// exposure, gain or white balance changed and must be programmed, 0
+// otherwise.
+//
+int aewb_update (struct aewb_state * st, const struct aewb_stats * s);
+
+//
+// Centre weighted mean luma of the frame.
+//
+float aewb_luma (const struct aewb_stats * s);
+
+#endif /* __AEWB_H */
@@ -0,0 +1,639 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Closed loop AE/AWB daemon (aewb.h).
+//
+//   aewbd -d /dev/video2 [-s /dev/v4l-subdev8]   run on the ISP
+//   aewbd -d /dev/video2 -w stats.aewb           ... and record the statistics
+//   aewbd -r stats.aewb                          replay a recording
+//   aewbd -S                                     synthetic scene
+//
+// On the ISP the daemon waits for the H3A statistics of every frame,
+// runs one controller iteration and programs the result straight away,
+// through the sensor subdev controls (-s) or the ISP AEWB request, so the
+// new settings reach the sensor during the next frame.  It runs alongside
+// capture22, which owns the stream.
+//
+// The simulation replays recorded statistics as the sensor would have
+// produced them under the controller's settings: window sums are scaled by
+// the ratio of the simulated to the recorded exposure * gain and clipped
+// at the saturation limit, with the sensor latency applied.  Windows that
+// were clipped in the recording can't be recovered, so replays of scenes
+// with large highlights are optimistic.  The synthetic scene is a random
+// grey-world chart under a tinted light that brightens 8x half way, to
+// measure convergence from a cold start and after a step.
+//
+// Reported: frames to converge (within tolerance for AEWB_STABLE_FRAMES
+// frames) and CPU time per iteration (statistics decode + controller).
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <linux/videodev2.h>
+
+#include "aewb.h"
+
+#define RECORD_MAGIC    "AEWBREC1"
+
+//
+// Recording: header, then one record + statistics buffer per frame.
+//
+struct record_header {
+    char magic[8];
+    uint32_t buffer_size;
+    uint32_t order;                 // enum bayer_order
+    struct isph3a_aewb_config config;
+    uint16_t reserved;
+};
+
+struct record {
+    uint32_t frame;
+    uint32_t exposure;              // settings the frame was taken with
+    uint32_t gain;
+    uint32_t reserved;
+    uint64_t timestamp;             // us
+};
+
+struct cost {
+    unsigned long long total;       // ns
+    unsigned long long max;
+    unsigned long n;
+};
+
+static volatile sig_atomic_t stop = 0;
+static int verbose = 0;
+
+static void on_signal (int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static unsigned long long thread_ns (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int xioctl (int fd, int request, void * arg)
+{
+int r;
+
+    do r = ioctl (fd, request, arg);
+    while (-1 == r && EINTR == errno);
+    return r;
+}
+
+//***********************************************************************************
+// One controller iteration, timed.
+//
+static int iterate (struct aewb_state * st, const void * buf,
+                    const struct isph3a_aewb_config * cfg, enum bayer_order order,
+                    struct cost * c)
+{
+static struct aewb_stats stats;
+unsigned long long t = thread_ns ();
+int changed;
+
+    aewb_parse (buf, cfg, order, &stats);
+    changed = aewb_update (st, &stats);
+
+    t = thread_ns () - t;
+    c->total += t;
+    if (t > c->max)
+        c->max = t;
+    c->n++;
+
+    if (verbose)
+        printf ("%6lu luma %6.1f  exposure %5u gain %4u  wb r %3u b %3u%s\n",
+                st->frame - 1, st->luma, st->exposure, st->gain, st->wb_r, st->wb_b,
+                st->stable >= AEWB_STABLE_FRAMES ? "  converged" : "");
+    return changed;
+}
+
+//
+// Frames from start until the run that is still stable at the end began,
+// or -1 if the controller did not settle.
+//
+static long convergence (const struct aewb_state * st, unsigned long start)
+{
+    if (st->stable < AEWB_STABLE_FRAMES || st->converged < (long)start)
+        return -1;
+    return st->converged - start;
+}
+
+static void report (const char * what, long frames, const struct cost * c)
+{
+    if (frames < 0)
+        printf ("%s: not converged\n", what);
+    else
+        printf ("%s: converged in %ld frames\n", what, frames);
+    if (c->n)
+        printf ("  %lu iterations, %.1f us mean, %.1f us max CPU per iteration\n",
+                c->n, c->total / 1e3 / c->n, c->max / 1e3);
+}
+
+//***********************************************************************************
+// Simulation.  applied[] holds the settings in effect for each frame.
+//
+static void scale_stats (const uint16_t * in, uint16_t * out,
+                         const struct isph3a_aewb_config * cfg, float f)
+{
+unsigned int windows = (cfg->ver_win_count + 1) * cfg->hor_win_count;
+unsigned int points = (cfg->win_width / cfg->subsample_hor_inc) *
+                      (cfg->win_height / cfg->subsample_ver_inc);
+float limit = (float)cfg->saturation_limit * points;
+unsigned int i, j, k;
+
+    for (i = 0; i < windows; i += 8, in += 9 * 8, out += 9 * 8) {
+        uint16_t *counts = out + 8 * 8;
+
+        memcpy (counts, in + 8 * 8, 8 * 2);
+        for (j = 0; j < 8; ++j) {
+            const uint16_t *w = in + j * 8;
+            uint16_t *o = out + j * 8;
+            float peak = 0.0f;
+
+            for (k = 0; k < 4; ++k) {
+                float v = w[k] * f;
+
+                o[k] = v > limit ? limit : v + 0.5f;
+                if (v > peak)
+                    peak = v;
+            }
+            for (k = 4; k < 8; ++k)
+                o[k] = w[k];
+
+            // Saturation as recorded, unless the scaling moved the window
+            // clearly into or out of it.
+            if (peak >= limit * 0.98f)
+                counts[j] = 0;
+            else if (peak < limit * 0.8f)
+                counts[j] = points;
+        }
+    }
+}
+
+//
+// Synthetic chart: per window reflectance and a light that brightens 8x
+// at frame step.  Sums for exposure * gain of total.
+//
+static void synth_stats (uint16_t * out, const struct isph3a_aewb_config * cfg,
+                         enum bayer_order order, float total, unsigned long frame,
+                         unsigned long step)
+{
+static const float tint[4] = { 0.55f, 1.0f, 1.0f, 0.75f };     // R G G B
+static float refl[AEWB_MAX_WINDOWS];
+unsigned int windows = (cfg->ver_win_count + 1) * cfg->hor_win_count;
+unsigned int points = (cfg->win_width / cfg->subsample_hor_inc) *
+                      (cfg->win_height / cfg->subsample_ver_inc);
+float limit = cfg->saturation_limit;
+float light = (frame >= step ? 8.0f : 1.0f) * 0.01f;
+unsigned int pos[4], i, j, k, unsat;
+
+    if (refl[0] == 0.0f) {
+        srand (1);
+        for (i = 0; i < AEWB_MAX_WINDOWS; ++i)
+            refl[i] = 0.05f + 0.9f * rand () / RAND_MAX;
+        refl[5] = refl[6] = 4.0f;                               // a lamp
+    }
+
+    // Colour of each position in the 2x2 cell for this Bayer order.
+    switch (order) {
+        case BAYER_RGGB: pos[0] = 0; pos[1] = 1; pos[2] = 2; pos[3] = 3; break;
+        case BAYER_GRBG: pos[0] = 1; pos[1] = 0; pos[2] = 3; pos[3] = 2; break;
+        case BAYER_GBRG: pos[0] = 2; pos[1] = 3; pos[2] = 0; pos[3] = 1; break;
+        case BAYER_BGGR: pos[0] = 3; pos[1] = 2; pos[2] = 1; pos[3] = 0; break;
+    }
+
+    for (i = 0; i < windows; i += 8) {
+        uint16_t *counts = out + 8 * 8;
+
+        for (j = 0; j < 8; ++j, out += 8) {
+            unsat = points;
+            memset (out, 0, 8 * 2);
+            for (k = 0; k < 4; ++k) {
+                float v = i + j < windows ? refl[i + j] * tint[pos[k]] * light * total : 0.0f;
+
+                if (v >= limit) {
+                    v = limit;
+                    unsat = 0;
+                }
+                out[k] = v * points + 0.5f;
+            }
+            counts[j] = unsat;
+        }
+        out = counts + 8;
+    }
+}
+
+static int simulate (const char * path, unsigned int frames, const struct aewb_params * p,
+                     unsigned int exposure, unsigned int gain)
+{
+struct record_header h;
+struct record rec;
+struct aewb_state st;
+struct cost c, c2;
+struct {
+    unsigned int exposure, gain;
+} *applied;
+uint16_t *in = NULL, *buf = NULL;
+unsigned long n, step = ~0UL;
+long first = -1;
+FILE *fp = NULL;
+
+    if (path) {
+        fp = fopen (path, "rb");
+        if (fp == NULL || fread (&h, sizeof (h), 1, fp) != 1 ||
+            memcmp (h.magic, RECORD_MAGIC, sizeof (h.magic))) {
+            fprintf (stderr, "%s: not a statistics recording\n", path);
+            return -1;
+        }
+    } else {
+        memset (&h, 0, sizeof (h));
+        aewb_config (&h.config, 2592, 1944);
+        h.buffer_size = aewb_buffer_size (&h.config);
+        h.order = BAYER_GRBG;
+        step = frames / 2;
+    }
+
+    in = malloc (h.buffer_size);
+    buf = malloc (h.buffer_size);
+    applied = calloc (frames + p->latency + 1, sizeof (*applied));
+    if (!in || !buf || !applied) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    aewb_init (&st, p, exposure, gain);
+    for (n = 0; n < p->latency; ++n) {
+        applied[n].exposure = st.exposure;
+        applied[n].gain = st.gain;
+    }
+    memset (&c, 0, sizeof (c));
+
+    for (n = 0; n < frames && !stop; ++n) {
+        float total = (float)applied[n].exposure * applied[n].gain;
+
+        if (fp) {
+            if (fread (&rec, sizeof (rec), 1, fp) != 1 ||
+                fread (in, h.buffer_size, 1, fp) != 1) {
+                // Loop the recording.
+                fseek (fp, sizeof (h), SEEK_SET);
+                if (fread (&rec, sizeof (rec), 1, fp) != 1 ||
+                    fread (in, h.buffer_size, 1, fp) != 1)
+                    break;
+            }
+            scale_stats (in, buf, &h.config,
+                         total / ((float)rec.exposure * rec.gain));
+        } else {
+            synth_stats (buf, &h.config, h.order, total, n, step);
+        }
+
+        if (n == step) {
+            first = convergence (&st, 0);
+            c2 = c;
+            memset (&c, 0, sizeof (c));
+        }
+
+        iterate (&st, buf, &h.config, h.order, &c);
+
+        // Settings programmed now are in effect latency frames later.
+        applied[n + p->latency].exposure = st.exposure;
+        applied[n + p->latency].gain = st.gain;
+    }
+
+    if (step != ~0UL && n > step) {
+        report ("start", first, &c2);
+        report ("8x brighter", convergence (&st, step), &c);
+    } else {
+        report (path ? path : "start", convergence (&st, 0), &c);
+    }
+    printf ("final: luma %.1f (target %.0f), exposure %u, gain %u, wb r %u b %u (/%u)\n",
+            st.luma, p->target, st.exposure, st.gain, st.wb_r, st.wb_b, AEWB_WB_ONE);
+
+    if (fp)
+        fclose (fp);
+    free (in);
+    free (buf);
+    free (applied);
+    return 0;
+}
+
+//***********************************************************************************
+// Live loop on the ISP.
+//
+static void program (int fd, int subdev, const struct aewb_state * st)
+{
+struct isph3a_aewb_data d;
+struct v4l2_control ctrl;
+
+    memset (&d, 0, sizeof (d));
+    d.update = SET_COLOR_GAINS;
+    d.wb_gain_r = st->wb_r;
+    d.wb_gain_b = st->wb_b;
+    d.wb_gain_gr = st->wb_g;
+    d.wb_gain_gb = st->wb_g;
+
+    if (subdev >= 0) {
+        ctrl.id = V4L2_CID_EXPOSURE;
+        ctrl.value = st->exposure;
+        if (xioctl (subdev, VIDIOC_S_CTRL, &ctrl) < 0)
+            perror ("V4L2_CID_EXPOSURE");
+        ctrl.id = V4L2_CID_GAIN;
+        ctrl.value = st->gain;
+        if (xioctl (subdev, VIDIOC_S_CTRL, &ctrl) < 0)
+            perror ("V4L2_CID_GAIN");
+    } else {
+        d.update |= SET_EXPOSURE | SET_ANALOG_GAIN;
+        d.shutter = st->exposure;
+        d.gain = st->gain;
+    }
+
+    if (xioctl (fd, VIDIOC_PRIVATE_ISP_AEWB_REQ, &d) < 0)
+        perror ("VIDIOC_PRIVATE_ISP_AEWB_REQ");
+}
+
+static int run (const char * dev, const char * subdev_name, const char * record,
+                enum bayer_order order, unsigned int frames, const struct aewb_params * p,
+                unsigned int exposure, unsigned int gain)
+{
+struct isph3a_aewb_config cfg;
+struct isph3a_aewb_data d;
+struct record_header h;
+struct aewb_state st;
+struct v4l2_format fmt;
+struct rusage ru;
+struct record rec;
+struct cost c;
+unsigned int next, size, n = 0;
+FILE *fp = NULL;
+void *buf;
+int fd, subdev = -1;
+double cpu;
+
+    fd = open (dev, O_RDWR);
+    if (fd < 0) {
+        perror (dev);
+        return -1;
+    }
+    if (subdev_name && (subdev = open (subdev_name, O_RDWR)) < 0) {
+        perror (subdev_name);
+        return -1;
+    }
+
+    memset (&fmt, 0, sizeof (fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl (fd, VIDIOC_G_FMT, &fmt) < 0) {
+        perror ("VIDIOC_G_FMT");
+        return -1;
+    }
+
+    aewb_config (&cfg, fmt.fmt.pix.width, fmt.fmt.pix.height);
+    if (xioctl (fd, VIDIOC_PRIVATE_ISP_AEWB_CFG, &cfg) < 0) {
+        perror ("VIDIOC_PRIVATE_ISP_AEWB_CFG");
+        return -1;
+    }
+    size = aewb_buffer_size (&cfg);
+    buf = malloc (size);
+    if (buf == NULL) {
+        fprintf (stderr, "Out of memory\n");
+        return -1;
+    }
+
+    if (record) {
+        fp = fopen (record, "wb");
+        memset (&h, 0, sizeof (h));
+        memcpy (h.magic, RECORD_MAGIC, sizeof (h.magic));
+        h.buffer_size = size;
+        h.order = order;
+        h.config = cfg;
+        if (fp == NULL || fwrite (&h, sizeof (h), 1, fp) != 1) {
+            perror (record);
+            return -1;
+        }
+    }
+
+    aewb_init (&st, p, exposure, gain);
+    program (fd, subdev, &st);
+    memset (&c, 0, sizeof (c));
+
+    // Ask where the ISP is, then follow frame by frame.  Requests for a
+    // frame a few ahead block until its statistics are ready.
+    memset (&d, 0, sizeof (d));
+    xioctl (fd, VIDIOC_PRIVATE_ISP_AEWB_REQ, &d);
+    next = (d.curr_frame + 1) & MAX_FRAME_COUNT;
+
+    printf ("%ux%u, %ux%u windows, %u byte statistics\n", fmt.fmt.pix.width,
+            fmt.fmt.pix.height, cfg.hor_win_count, cfg.ver_win_count, size);
+
+    while (!stop && (frames == 0 || n < frames)) {
+        memset (&d, 0, sizeof (d));
+        d.update = REQUEST_STATISTICS;
+        d.frame_number = next;
+        d.h3a_aewb_statistics_buf = buf;
+        if (xioctl (fd, VIDIOC_PRIVATE_ISP_AEWB_REQ, &d) < 0) {
+            if (EINVAL != errno) {
+                perror ("VIDIOC_PRIVATE_ISP_AEWB_REQ");
+                break;
+            }
+            // Fell behind (or too far ahead): resynchronise.
+            next = (d.curr_frame + 1) & MAX_FRAME_COUNT;
+            continue;
+        }
+
+        if (fp) {
+            rec.frame = next;
+            rec.exposure = st.exposure;
+            rec.gain = st.gain;
+            rec.reserved = 0;
+            rec.timestamp = (uint64_t)d.ts.tv_sec * 1000000 + d.ts.tv_usec;
+            if (fwrite (&rec, sizeof (rec), 1, fp) != 1 || fwrite (buf, size, 1, fp) != 1) {
+                perror (record);
+                fclose (fp);
+                fp = NULL;
+            }
+        }
+
+        if (iterate (&st, buf, &cfg, order, &c))
+            program (fd, subdev, &st);
+
+        next = (next + 1) & MAX_FRAME_COUNT;
+        n++;
+    }
+
+    report (dev, convergence (&st, 0), &c);
+    getrusage (RUSAGE_SELF, &ru);
+    cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+          (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    printf ("  %.1f ms process CPU per frame including ioctls\n", n ? cpu * 1e3 / n : 0.0);
+
+    if (fp)
+        fclose (fp);
+    free (buf);
+    if (subdev >= 0)
+        close (subdev);
+    close (fd);
+    return 0;
+}
+
+//***********************************************************************************
+static int parse_range (const char * s, unsigned int * lo, unsigned int * hi)
+{
+char *end;
+
+    *lo = strtoul (s, &end, 0);
+    if (*end != '-')
+        return -1;
+    *hi = strtoul (end + 1, &end, 0);
+    return *end == '\0' && *hi >= *lo && *lo > 0 ? 0 : -1;
+}
+
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options]\n\n Options:\n"
+        "-d | --device name ISP capture node to control\n"
+        "-s | --subdev name Program exposure and gain through this sensor subdev\n"
+        "-w | --write file Record the statistics of every frame\n"
+        "-r | --replay file Simulate on recorded statistics\n"
+        "-S | --synthetic Simulate on a synthetic scene\n"
+        "-b | --bayer rggb|grbg|gbrg|bggr Bayer order [grbg]\n"
+        "-n | --frames n Stop after n frames [0 = until interrupted, 200 when simulating]\n"
+        "-t | --target n Mean luma, 10-bit scale [180]\n"
+        "-e | --exposure min-max Exposure range, sensor units [1-2000]\n"
+        "-g | --gain min-max Analog gain range, sensor units [8-64]\n"
+        "-l | --latency n Frames before new settings take effect [2]\n"
+        "-k | --damping k Step exponent, 1 = full step [0.85]\n"
+        "-v | --verbose Print every iteration\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "device", required_argument, NULL, 'd' },
+    { "subdev", required_argument, NULL, 's' },
+    { "write", required_argument, NULL, 'w' },
+    { "replay", required_argument, NULL, 'r' },
+    { "synthetic", no_argument, NULL, 'S' },
+    { "bayer", required_argument, NULL, 'b' },
+    { "frames", required_argument, NULL, 'n' },
+    { "target", required_argument, NULL, 't' },
+    { "exposure", required_argument, NULL, 'e' },
+    { "gain", required_argument, NULL, 'g' },
+    { "latency", required_argument, NULL, 'l' },
+    { "damping", required_argument, NULL, 'k' },
+    { "verbose", no_argument, NULL, 'v' },
+    { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+static const char * const orders[] = { "rggb", "grbg", "gbrg", "bggr" };
+const char *dev = NULL, *subdev = NULL, *record = NULL, *replay = NULL;
+enum bayer_order order = BAYER_GRBG;
+struct aewb_params p;
+unsigned int frames = 0, i;
+int synthetic = 0;
+int c, ret;
+
+    p.target = 180.0f;
+    p.tolerance = 0.05f;
+    p.damping = 0.85f;
+    p.max_saturated = 0.02f;
+    p.exposure_min = 1;
+    p.exposure_max = 2000;
+    p.gain_min = 8;
+    p.gain_max = 64;
+    p.latency = 2;
+
+    while ((c = getopt_long (argc, argv, "d:s:w:r:Sb:n:t:e:g:l:k:vh", long_options,
+                             NULL)) != -1) {
+        switch (c) {
+            case 'd':
+                dev = optarg;
+                break;
+            case 's':
+                subdev = optarg;
+                break;
+            case 'w':
+                record = optarg;
+                break;
+            case 'r':
+                replay = optarg;
+                break;
+            case 'S':
+                synthetic = 1;
+                break;
+            case 'b':
+                for (i = 0; i < 4 && strcmp (optarg, orders[i]); ++i)
+                    ;
+                if (i == 4) {
+                    fprintf (stderr, "Unknown Bayer order %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                order = i;
+                break;
+            case 'n':
+                frames = atoi (optarg);
+                break;
+            case 't':
+                p.target = atof (optarg);
+                break;
+            case 'e':
+                if (parse_range (optarg, &p.exposure_min, &p.exposure_max) < 0) {
+                    fprintf (stderr, "Bad exposure range %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'g':
+                if (parse_range (optarg, &p.gain_min, &p.gain_max) < 0) {
+                    fprintf (stderr, "Bad gain range %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l':
+                p.latency = atoi (optarg);
+                if (p.latency < 1)
+                    p.latency = 1;
+                break;
+            case 'k':
+                p.damping = atof (optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                usage (argv[0]);
+                return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (!dev && !replay && !synthetic) {
+        usage (argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    signal (SIGINT, on_signal);
+    signal (SIGTERM, on_signal);
+
+    // Start dark, as after power up: exposure at the bottom of its range.
+    if (dev)
+        ret = run (dev, subdev, record, order, frames, &p, p.exposure_min, p.gain_min);
+    else
+        ret = simulate (replay, frames ? frames : 200, &p, p.exposure_min, p.gain_min);
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,346 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Bayer demosaic, see bayer.h.
+//
+// Edges are handled by mirroring (row -1 reads row 1, column -1 reads
+// column 1) which keeps the colour of every neighbour.  For each output
+// row the kernel computes, for all pixels at once,
+//
+//   hor   = avg (W, E)             ver  = avg (N, S)
+//   cross = avg (hor, ver)         diag = avg (avg (NW, NE), avg (SW, SE))
+//
+// and then picks per column parity:
+//
+//   red/blue site  (A = colour of the site, O = the other one)
+//       A = C      G = cross or edge directed     O = diag
+//   green site
+//       G = C      A = hor                        O = ver
+//
+// where A is the colour sharing the row with green.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <linux/videodev2.h>
+
+#include "bayer.h"
+#include "convert.h"
+#include "simd.h"
+
+#define BAYER_MAX_THREADS   16
+
+#define AVG(a, b)           (((a) + (b) + 1) >> 1)
+
+//***********************************************************************************
+int bayer_from_fourcc (unsigned int fourcc, enum bayer_order * order, unsigned int * bits)
+{
+static const struct {
+    unsigned int fourcc;
+    enum bayer_order order;
+    unsigned int bits;
+} formats[] = {
+    { v4l2_fourcc ('B', 'A', '8', '1'), BAYER_BGGR, 8 },
+    { v4l2_fourcc ('G', 'B', 'R', 'G'), BAYER_GBRG, 8 },
+    { v4l2_fourcc ('G', 'R', 'B', 'G'), BAYER_GRBG, 8 },
+    { v4l2_fourcc ('R', 'G', 'G', 'B'), BAYER_RGGB, 8 },
+    { v4l2_fourcc ('B', 'G', '1', '0'), BAYER_BGGR, 10 },
+    { v4l2_fourcc ('G', 'B', '1', '0'), BAYER_GBRG, 10 },
+    { v4l2_fourcc ('B', 'A', '1', '0'), BAYER_GRBG, 10 },
+    { v4l2_fourcc ('R', 'G', '1', '0'), BAYER_RGGB, 10 },
+    { v4l2_fourcc ('B', 'G', '1', '2'), BAYER_BGGR, 12 },
+    { v4l2_fourcc ('G', 'B', '1', '2'), BAYER_GBRG, 12 },
+    { v4l2_fourcc ('B', 'A', '1', '2'), BAYER_GRBG, 12 },
+    { v4l2_fourcc ('R', 'G', '1', '2'), BAYER_RGGB, 12 },
+    { v4l2_fourcc ('B', 'Y', 'R', '2'), BAYER_BGGR, 16 },
+};
+unsigned int i;
+
+    for (i = 0; i < sizeof (formats) / sizeof (formats[0]); ++i) {
+        if (formats[i].fourcc == fourcc) {
+            *order = formats[i].order;
+            *bits = formats[i].bits;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+//***********************************************************************************
+// Per row layout
+//
+struct row_layout {
+    int red_row;            // the row holds red (else blue) samples
+    unsigned int parity;    // column parity of the red/blue samples
+};
+
+static void row_layout (enum bayer_order order, unsigned int y, struct row_layout * rl)
+{
+unsigned int ry, rx;
+
+    // Position of the red sample in the 2x2 cell
+    ry = (order == BAYER_GBRG || order == BAYER_BGGR);
+    rx = (order == BAYER_GRBG || order == BAYER_BGGR);
+
+    rl->red_row = (y & 1) == ry;
+    rl->parity = rl->red_row ? rx : !rx;
+}
+
+//***********************************************************************************
+static inline void demosaic_px (const uint8_t * u, const uint8_t * c, const uint8_t * d,
+                                unsigned int x, unsigned int width,
+                                const struct row_layout * rl, enum bayer_method method,
+                                uint8_t * out)
+{
+unsigned int xm = x ? x - 1 : 1;
+unsigned int xp = x + 1 < width ? x + 1 : width - 2;
+unsigned int hor, ver, cross, diag, g, a, o;
+
+    hor = AVG (c[xm], c[xp]);
+    ver = AVG (u[x], d[x]);
+    cross = AVG (hor, ver);
+    diag = AVG (AVG (u[xm], u[xp]), AVG (d[xm], d[xp]));
+
+    if ((x & 1) == rl->parity) {
+        if (method == BAYER_EDGE) {
+            unsigned int dh = abs (c[xm] - c[xp]);
+            unsigned int dv = abs (u[x] - d[x]);
+
+            g = dh < dv ? hor : dv < dh ? ver : cross;
+        } else {
+            g = cross;
+        }
+        a = c[x];
+        o = diag;
+    } else {
+        g = c[x];
+        a = hor;
+        o = ver;
+    }
+
+    out[0] = rl->red_row ? a : o;
+    out[1] = g;
+    out[2] = rl->red_row ? o : a;
+}
+
+//***********************************************************************************
+static void demosaic_row (const uint8_t * u, const uint8_t * c, const uint8_t * d,
+                          unsigned int width, const struct row_layout * rl,
+                          enum bayer_method method, int vector, uint8_t * out)
+{
+unsigned int x = 1;
+
+    demosaic_px (u, c, d, 0, width, rl, method, out);
+
+#ifdef SIMD_VEC
+    if (vector) {
+        const vu8 even = vu8_mask_even ();
+        const vu8 odd = vu8_cmpeq (even, vu8_set1 (0));
+
+        // Lanes of x are W/E loads at x -/+ 1, keep x + VU8_LANES < width.
+        for (; x + VU8_LANES < width; x += VU8_LANES) {
+            vu8 site = ((x & 1) == rl->parity) ? even : odd;
+            vu8 w = vu8_load (c + x - 1);
+            vu8 e = vu8_load (c + x + 1);
+            vu8 n = vu8_load (u + x);
+            vu8 s = vu8_load (d + x);
+            vu8 cc = vu8_load (c + x);
+            vu8 hor = vu8_avg (w, e);
+            vu8 ver = vu8_avg (n, s);
+            vu8 cross = vu8_avg (hor, ver);
+            vu8 diag = vu8_avg (vu8_avg (vu8_load (u + x - 1), vu8_load (u + x + 1)),
+                                vu8_avg (vu8_load (d + x - 1), vu8_load (d + x + 1)));
+            vu8 g, a, o;
+
+            if (method == BAYER_EDGE) {
+                vu8 dh = vu8_absdiff (w, e);
+                vu8 dv = vu8_absdiff (n, s);
+
+                g = vu8_select (vu8_lt (dh, dv), hor,
+                                vu8_select (vu8_lt (dv, dh), ver, cross));
+            } else {
+                g = cross;
+            }
+
+            a = vu8_select (site, cc, hor);
+            g = vu8_select (site, g, cc);
+            o = vu8_select (site, diag, ver);
+
+            if (rl->red_row)
+                vu8_store3 (out + 3 * x, a, g, o);
+            else
+                vu8_store3 (out + 3 * x, o, g, a);
+        }
+    }
+#endif
+
+    for (; x < width; ++x)
+        demosaic_px (u, c, d, x, width, rl, method, out + 3 * x);
+}
+
+//***********************************************************************************
+struct band {
+    const struct bayer_image * src;
+    unsigned char * dst;
+    unsigned int dst_stride;
+    enum bayer_method method;
+    unsigned int y0, y1;
+    int vector;
+    int ret;
+    pthread_t thread;
+};
+
+static const uint8_t * src_row (const struct bayer_image * src, unsigned int y)
+{
+    return (const uint8_t *)src->data + (size_t)y * src->stride;
+}
+
+static unsigned int mirror_row (const struct bayer_image * src, int y)
+{
+    if (y < 0)
+        return 1;
+    if (y >= (int)src->height)
+        return src->height - 2;
+    return y;
+}
+
+static void * demosaic_band (void * arg)
+{
+struct band *b = arg;
+const struct bayer_image *src = b->src;
+const uint8_t *rows[3];
+uint8_t *ring = NULL;
+int ring_y[3] = { -1, -1, -1 };
+unsigned int y, i;
+
+    if (src->bits > 8) {
+        ring = malloc (3 * src->width);
+        if (ring == NULL) {
+            b->ret = -1;
+            return NULL;
+        }
+    }
+
+    for (y = b->y0; y < b->y1; ++y) {
+        struct row_layout rl;
+
+        for (i = 0; i < 3; ++i) {
+            unsigned int sy = mirror_row (src, (int)y + (int)i - 1);
+
+            if (ring == NULL) {
+                rows[i] = src_row (src, sy);
+                continue;
+            }
+
+            // Three consecutive rows always map to three distinct slots.
+            if (ring_y[sy % 3] != (int)sy) {
+                conv_raw16_to_raw8_row ((const uint16_t *)src_row (src, sy),
+                                        ring + (sy % 3) * src->width, src->width, src->bits);
+                ring_y[sy % 3] = sy;
+            }
+            rows[i] = ring + (sy % 3) * src->width;
+        }
+
+        row_layout (src->order, y, &rl);
+        demosaic_row (rows[0], rows[1], rows[2], src->width, &rl, b->method,
+                      b->vector, b->dst + (size_t)y * b->dst_stride);
+    }
+
+    free (ring);
+    b->ret = 0;
+    return NULL;
+}
+
+//***********************************************************************************
+static int check_args (const struct bayer_image * src, unsigned int dst_stride)
+{
+    if (src->width < 2 || src->height < 2 || dst_stride < src->width * 3)
+        return -1;
+    if (src->bits < 8 || src->bits > 16)
+        return -1;
+    if (src->stride < src->width * (src->bits > 8 ? 2 : 1))
+        return -1;
+    return 0;
+}
+
+int bayer_demosaic (const struct bayer_image * src, unsigned char * dst,
+                    unsigned int dst_stride, enum bayer_method method,
+                    unsigned int threads)
+{
+struct band bands[BAYER_MAX_THREADS];
+unsigned int i, started, rows;
+int ret = 0;
+
+    if (check_args (src, dst_stride) < 0)
+        return -1;
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > BAYER_MAX_THREADS)
+        threads = BAYER_MAX_THREADS;
+    if (threads > src->height / 2)
+        threads = src->height / 2;
+
+    rows = (src->height + threads - 1) / threads;
+
+    for (i = 0; i < threads; ++i) {
+        bands[i].src = src;
+        bands[i].dst = dst;
+        bands[i].dst_stride = dst_stride;
+        bands[i].method = method;
+        bands[i].vector = 1;
+        bands[i].y0 = i * rows < src->height ? i * rows : src->height;
+        bands[i].y1 = (i + 1) * rows < src->height && i + 1 < threads
+                    ? (i + 1) * rows : src->height;
+        bands[i].ret = 0;
+    }
+
+    // The calling thread takes the first band.
+    for (started = 1; started < threads; ++started) {
+        if (pthread_create (&bands[started].thread, NULL, demosaic_band, &bands[started]))
+            break;
+    }
+    demosaic_band (&bands[0]);
+    ret = bands[0].ret;
+
+    for (i = 1; i < started; ++i) {
+        pthread_join (bands[i].thread, NULL);
+        if (bands[i].ret < 0)
+            ret = -1;
+    }
+
+    // Bands whose thread could not be created are done here.
+    for (; started < threads; ++started) {
+        demosaic_band (&bands[started]);
+        if (bands[started].ret < 0)
+            ret = -1;
+    }
+
+    return ret;
+}
+
+//***********************************************************************************
+int bayer_demosaic_ref (const struct bayer_image * src, unsigned char * dst,
+                        unsigned int dst_stride, enum bayer_method method)
+{
+struct band b;
+
+    if (check_args (src, dst_stride) < 0)
+        return -1;
+
+    b.src = src;
+    b.dst = dst;
+    b.dst_stride = dst_stride;
+    b.method = method;
+    b.vector = 0;
+    b.y0 = 0;
+    b.y1 = src->height;
+    demosaic_band (&b);
+
+    return b.ret;
+}
@@ -0,0 +1,68 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Bayer demosaic to RGB24.
+//
+// Input is either 8-bit Bayer (SBGGR8 and friends) or 9 to 16-bit Bayer in
+// a little endian 16-bit container (SGRBG10); high bit depth input is
+// reduced to 8 bits before interpolation.  The output is packed R, G, B.
+//
+// Two interpolations are provided:
+//
+//   BAYER_BILINEAR  missing colours are the rounded average of the nearest
+//                   samples of that colour
+//   BAYER_EDGE      as bilinear, but green at red/blue sites is taken from
+//                   the direction (horizontal or vertical) with the smaller
+//                   gradient, which removes most zipper artefacts on edges
+//
+// The image is split into row bands processed by worker threads; the inner
+// loops use the vector layer in simd.h.  bayer_demosaic_ref() is the plain
+// C reference: bayer_demosaic() must match it bit for bit.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __BAYER_H
+#define __BAYER_H
+
+// Colour of the top-left 2x2 cell, in raster order
+enum bayer_order {
+    BAYER_RGGB,
+    BAYER_GRBG,
+    BAYER_GBRG,
+    BAYER_BGGR,
+};
+
+enum bayer_method {
+    BAYER_BILINEAR,
+    BAYER_EDGE,
+};
+
+struct bayer_image {
+    const void * data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int stride;            // bytes per line
+    unsigned int bits;              // 8, or 9..16 for 16-bit containers
+    enum bayer_order order;
+};
+
+//
+// Map a V4L2 Bayer fourcc to order and bit depth.  Returns 0, or -1 for
+// formats that are not (uncompressed) Bayer.
+//
+int bayer_from_fourcc (unsigned int fourcc, enum bayer_order * order, unsigned int * bits);
+
+//
+// Demosaic src into dst (width * 3 bytes per pixel, dst_stride bytes per
+// line) using up to threads threads.  The image must be at least 2x2.
+// Returns 0 or -1.
+//
+int bayer_demosaic (const struct bayer_image * src, unsigned char * dst,
+                    unsigned int dst_stride, enum bayer_method method,
+                    unsigned int threads);
+int bayer_demosaic_ref (const struct bayer_image * src, unsigned char * dst,
+                        unsigned int dst_stride, enum bayer_method method);
+
+#endif /* __BAYER_H */
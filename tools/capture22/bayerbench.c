@@ -0,0 +1,178 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Demosaic benchmark.
+//
+// Runs the scalar reference and the vector/threaded demosaic on a
+// synthetic frame for every method and input depth, reports Mpix/s and
+// checks that both produce the same bytes.  Exits non-zero on a mismatch.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "bayer.h"
+#include "simd.h"
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//***********************************************************************************
+// Smooth gradients plus noise and a few hard edges, so the edge directed
+// path takes every branch.
+//
+static void fill_frame (struct bayer_image * img, void * data)
+{
+unsigned int x, y, v, max = (1u << img->bits) - 1;
+
+    srand (1);
+    for (y = 0; y < img->height; ++y) {
+        for (x = 0; x < img->width; ++x) {
+            v = (x * 7 + y * 3) & max;
+            if ((x / 37 + y / 29) & 1)
+                v = max - v;
+            v ^= rand () & 0x1f;
+            v &= max;
+
+            if (img->bits > 8)
+                ((unsigned short *)data)[y * img->stride / 2 + x] = v;
+            else
+                ((unsigned char *)data)[y * img->stride + x] = v;
+        }
+    }
+}
+
+//***********************************************************************************
+static double mpix (const struct bayer_image * img, unsigned int iter, unsigned long long us)
+{
+    return us ? (double)img->width * img->height * iter / us : 0.0;
+}
+
+static int bench (unsigned int width, unsigned int height, unsigned int bits,
+                  enum bayer_method method, unsigned int threads, unsigned int iter)
+{
+struct bayer_image img;
+unsigned char *raw, *ref, *out;
+unsigned long long t;
+double mref, m1, mn;
+unsigned int i;
+int ret = 0;
+
+    img.width = width;
+    img.height = height;
+    img.bits = bits;
+    img.stride = width * (bits > 8 ? 2 : 1);
+    img.order = BAYER_GRBG;
+
+    raw = malloc ((size_t)img.stride * height);
+    ref = malloc ((size_t)width * height * 3);
+    out = malloc ((size_t)width * height * 3);
+    if (!raw || !ref || !out) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    fill_frame (&img, raw);
+    img.data = raw;
+
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        bayer_demosaic_ref (&img, ref, width * 3, method);
+    mref = mpix (&img, iter, mono_us () - t);
+
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        bayer_demosaic (&img, out, width * 3, method, 1);
+    m1 = mpix (&img, iter, mono_us () - t);
+    if (memcmp (ref, out, (size_t)width * height * 3)) {
+        printf ("MISMATCH: %u-bit %s, 1 thread\n", bits,
+                method == BAYER_EDGE ? "edge" : "bilinear");
+        ret = -1;
+    }
+
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        bayer_demosaic (&img, out, width * 3, method, threads);
+    mn = mpix (&img, iter, mono_us () - t);
+    if (memcmp (ref, out, (size_t)width * height * 3)) {
+        printf ("MISMATCH: %u-bit %s, %u threads\n", bits,
+                method == BAYER_EDGE ? "edge" : "bilinear", threads);
+        ret = -1;
+    }
+
+    printf ("%2u-bit %-9s %8.1f %8.1f %8.1f   %s\n", bits,
+            method == BAYER_EDGE ? "edge" : "bilinear", mref, m1, mn,
+            ret ? "FAIL" : "bit-exact");
+
+    free (raw);
+    free (ref);
+    free (out);
+    return ret;
+}
+
+//***********************************************************************************
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options]\n\n Options:\n"
+        "-w | --width n Frame width [2592]\n"
+        "-h | --height n Frame height [1944]\n"
+        "-t | --threads n Worker threads [4]\n"
+        "-i | --iterations n Frames per measurement [10]\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "width", required_argument, NULL, 'w' },
+    { "height", required_argument, NULL, 'h' },
+    { "threads", required_argument, NULL, 't' },
+    { "iterations", required_argument, NULL, 'i' },
+    { "help", no_argument, NULL, '?' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+unsigned int width = 2592, height = 1944, threads = 4, iter = 10;
+int c, ret = 0;
+
+    while ((c = getopt_long (argc, argv, "w:h:t:i:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'w':
+                width = atoi (optarg);
+                break;
+            case 'h':
+                height = atoi (optarg);
+                break;
+            case 't':
+                threads = atoi (optarg);
+                break;
+            case 'i':
+                iter = atoi (optarg);
+                break;
+            default:
+                usage (argv[0]);
+                return c == '?' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    printf ("demosaic %ux%u, %s, %u threads, %u iterations\n\n", width, height,
+            SIMD_NAME, threads, iter);
+    printf ("%-16s %8s %8s %8s\n", "Mpix/s", "scalar", "vector", "threads");
+
+    ret |= bench (width, height, 8, BAYER_BILINEAR, threads, iter);
+    ret |= bench (width, height, 8, BAYER_EDGE, threads, iter);
+    ret |= bench (width, height, 10, BAYER_BILINEAR, threads, iter);
+    ret |= bench (width, height, 10, BAYER_EDGE, threads, iter);
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// USERPTR buffer pool, see bufpool.h.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "bufpool.h"
+
+#define HUGEPAGE_DEFAULT    (2 * 1024 * 1024)
+
+#define ROUND_UP(x, a)      (((x) + (a) - 1) / (a) * (a))
+
+//***********************************************************************************
+static size_t hugepage_size (void)
+{
+static size_t size = 0;
+FILE *fp;
+char line[128];
+unsigned long kb;
+
+    if (size)
+        return size;
+
+    size = HUGEPAGE_DEFAULT;
+    fp = fopen ("/proc/meminfo", "r");
+    if (fp == NULL)
+        return size;
+
+    while (fgets (line, sizeof (line), fp)) {
+        if (sscanf (line, "Hugepagesize: %lu kB", &kb) == 1) {
+            size = kb * 1024;
+            break;
+        }
+    }
+    fclose (fp);
+
+    return size;
+}
+
+//***********************************************************************************
+// Map length bytes with the requested backing.  On success fills map/base
+// and returns 0.
+//
+static int pool_map (struct bufpool * pool, size_t length, enum bufpool_backing backing)
+{
+size_t huge = hugepage_size ();
+void *p;
+
+    switch (backing) {
+        case BUFPOOL_BACKING_HUGETLB:
+#ifdef MAP_HUGETLB
+            length = ROUND_UP (length, huge);
+            p = mmap (NULL, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+            if (p == MAP_FAILED)
+                return -1;
+            pool->map = p;
+            pool->base = p;
+            pool->map_length = length;
+            return 0;
+#else
+            return -1;
+#endif
+
+        case BUFPOOL_BACKING_THP:
+#ifdef MADV_HUGEPAGE
+            // Over-allocate so the usable range starts on a huge page
+            // boundary, khugepaged only collapses aligned ranges.
+            length = ROUND_UP (length, huge);
+            p = mmap (NULL, length + huge, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                return -1;
+            pool->map = p;
+            pool->map_length = length + huge;
+            pool->base = (void *) ROUND_UP ((unsigned long) p, huge);
+            if (madvise (pool->base, length, MADV_HUGEPAGE) == -1) {
+                munmap (pool->map, pool->map_length);
+                pool->map = NULL;
+                return -1;
+            }
+            return 0;
+#else
+            return -1;
+#endif
+
+        case BUFPOOL_BACKING_PAGES:
+            p = mmap (NULL, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                return -1;
+            pool->map = p;
+            pool->base = p;
+            pool->map_length = length;
+            return 0;
+
+        default:
+            return -1;
+    }
+}
+
+//***********************************************************************************
+int bufpool_get (struct bufpool * pool, unsigned int count, size_t size, int flags)
+{
+size_t page = sysconf (_SC_PAGESIZE);
+size_t stride = ROUND_UP (size, page);
+struct buffer *bufs;
+unsigned int i;
+
+    if (count == 0 || size == 0)
+        return -1;
+
+    if (pool->base && pool->flags == flags &&
+        count <= pool->capacity && stride <= pool->stride) {
+        for (i = 0; i < count; ++i)
+            pool->bufs[i].length = size;
+        pool->count = count;
+        pool->reuses++;
+        return 0;
+    }
+
+    bufpool_release (pool);
+
+    bufs = calloc (count, sizeof (*bufs));
+    if (bufs == NULL)
+        return -1;
+
+    pool->flags = flags;
+    pool->backing = BUFPOOL_BACKING_NONE;
+    if ((flags & BUFPOOL_HUGETLB) &&
+        pool_map (pool, stride * count, BUFPOOL_BACKING_HUGETLB) == 0)
+        pool->backing = BUFPOOL_BACKING_HUGETLB;
+    else if ((flags & BUFPOOL_THP) &&
+             pool_map (pool, stride * count, BUFPOOL_BACKING_THP) == 0)
+        pool->backing = BUFPOOL_BACKING_THP;
+    else if (pool_map (pool, stride * count, BUFPOOL_BACKING_PAGES) == 0)
+        pool->backing = BUFPOOL_BACKING_PAGES;
+
+    if (pool->backing == BUFPOOL_BACKING_NONE) {
+        free (bufs);
+        return -1;
+    }
+
+    // Fault everything in now rather than on the first DQBUF.
+    memset (pool->base, 0, stride * count);
+
+    for (i = 0; i < count; ++i) {
+        bufs[i].start = (char *) pool->base + i * stride;
+        bufs[i].length = size;
+    }
+
+    pool->bufs = bufs;
+    pool->count = count;
+    pool->capacity = count;
+    pool->stride = stride;
+    pool->allocs++;
+
+    return 0;
+}
+
+//***********************************************************************************
+void bufpool_release (struct bufpool * pool)
+{
+    if (pool->map)
+        munmap (pool->map, pool->map_length);
+    free (pool->bufs);
+
+    pool->bufs = NULL;
+    pool->map = NULL;
+    pool->base = NULL;
+    pool->map_length = 0;
+    pool->count = 0;
+    pool->capacity = 0;
+    pool->stride = 0;
+    pool->backing = BUFPOOL_BACKING_NONE;
+}
+
+//***********************************************************************************
+const char * bufpool_backing_name (enum bufpool_backing backing)
+{
+    switch (backing) {
+        case BUFPOOL_BACKING_PAGES:
+            return "4k pages";
+        case BUFPOOL_BACKING_THP:
+            return "transparent huge pages";
+        case BUFPOOL_BACKING_HUGETLB:
+            return "hugetlb";
+        default:
+            return "none";
+    }
+}
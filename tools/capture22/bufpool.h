@@ -0,0 +1,63 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// USERPTR buffer pool.
+//
+// All buffers of a pool are carved out of one anonymous mapping so that a
+// large frame (5 MP Bayer is ~10 MB) is covered by a handful of huge pages
+// instead of thousands of 4 KB pages.  Buffers start on a page boundary as
+// required by the OMAP3 ISP for USERPTR i/o.
+//
+// A pool survives stream restarts: asking for the same or a smaller
+// geometry hands back the existing buffers without touching the allocator.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __BUFPOOL_H
+#define __BUFPOOL_H
+
+#include "capture22.h"
+
+// Allocation flags for bufpool_get()
+#define BUFPOOL_HUGETLB     0x01    // Try a MAP_HUGETLB mapping (needs nr_hugepages)
+#define BUFPOOL_THP         0x02    // Try transparent huge pages (madvise)
+
+// Backing actually obtained
+enum bufpool_backing {
+    BUFPOOL_BACKING_NONE = 0,
+    BUFPOOL_BACKING_PAGES,
+    BUFPOOL_BACKING_THP,
+    BUFPOOL_BACKING_HUGETLB,
+};
+
+struct bufpool {
+    struct buffer * bufs;       // count valid entries
+    unsigned int count;         // buffers handed out by the last bufpool_get()
+    unsigned int capacity;      // buffers the mapping can hold
+    size_t stride;              // distance between buffers (page multiple)
+    void * base;                // start of the mapping (aligned)
+    void * map;                 // address returned by mmap()
+    size_t map_length;
+    int flags;
+    enum bufpool_backing backing;
+    unsigned int allocs;        // number of real allocations
+    unsigned int reuses;        // number of bufpool_get() served from the pool
+};
+
+//
+// Return count buffers of at least size bytes.  The pool is reused when it
+// is large enough and was created with the same flags, otherwise it is
+// released and reallocated.  Returns 0 on success, -1 on failure.
+//
+int bufpool_get (struct bufpool * pool, unsigned int count, size_t size, int flags);
+
+//
+// Unmap the pool.  The structure can be passed to bufpool_get() again.
+//
+void bufpool_release (struct bufpool * pool);
+
+const char * bufpool_backing_name (enum bufpool_backing backing);
+
+#endif /* __BUFPOOL_H */
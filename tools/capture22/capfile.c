@@ -0,0 +1,229 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Capture container, see capfile.h.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+// Recordings outgrow 2 GB quickly, use 64-bit file offsets on 32-bit ARM.
+#define _FILE_OFFSET_BITS 64
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "capfile.h"
+
+struct capfile_writer {
+    int fd;
+    struct capfile_header header;
+    struct capfile_entry * index;
+    unsigned int capacity;
+    uint64_t pos;                   // where the next payload goes
+};
+
+//***********************************************************************************
+static int write_at (int fd, const void * data, size_t size, uint64_t pos)
+{
+const char *p = data;
+ssize_t n;
+
+    while (size) {
+        n = pwrite (fd, p, size, pos);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        pos += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+static uint64_t align_up (uint64_t pos)
+{
+    return (pos + CAPFILE_ALIGN - 1) & ~(uint64_t)(CAPFILE_ALIGN - 1);
+}
+
+//***********************************************************************************
+struct capfile_writer * capfile_create (const char * path, unsigned int width,
+                                        unsigned int height, unsigned int pixelformat,
+                                        unsigned int bytesperline,
+                                        enum capfile_encoding encoding)
+{
+struct capfile_writer *w;
+
+    w = calloc (1, sizeof (*w));
+    if (w == NULL)
+        return NULL;
+
+    w->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        free (w);
+        return NULL;
+    }
+
+    memcpy (w->header.magic, CAPFILE_MAGIC, sizeof (w->header.magic));
+    w->header.version = CAPFILE_VERSION;
+    w->header.header_size = CAPFILE_HEADER_SIZE;
+    w->header.width = width;
+    w->header.height = height;
+    w->header.pixelformat = pixelformat;
+    w->header.bytesperline = bytesperline;
+    w->header.encoding = encoding;
+    w->header.entry_size = sizeof (struct capfile_entry);
+    w->pos = CAPFILE_ALIGN;
+
+    // index_offset 0 marks a recording in progress.
+    if (write_at (w->fd, &w->header, sizeof (w->header), 0) < 0) {
+        close (w->fd);
+        free (w);
+        return NULL;
+    }
+
+    return w;
+}
+
+int capfile_append (struct capfile_writer * w, const void * data, size_t size,
+                    struct capfile_entry * e)
+{
+    if (w->header.frame_count == w->capacity) {
+        unsigned int capacity = w->capacity ? 2 * w->capacity : 256;
+        struct capfile_entry *index = realloc (w->index, capacity * sizeof (*index));
+
+        if (index == NULL)
+            return -1;
+        w->index = index;
+        w->capacity = capacity;
+    }
+
+    if (write_at (w->fd, data, size, w->pos) < 0)
+        return -1;
+
+    e->offset = w->pos;
+    e->size = size;
+    w->index[w->header.frame_count++] = *e;
+    w->pos = align_up (w->pos + size);
+    return 0;
+}
+
+static int by_timestamp (const void * a, const void * b)
+{
+const struct capfile_entry *x = a, *y = b;
+
+    if (x->timestamp != y->timestamp)
+        return x->timestamp < y->timestamp ? -1 : 1;
+    return x->sequence < y->sequence ? -1 : x->sequence > y->sequence;
+}
+
+int capfile_close (struct capfile_writer * w)
+{
+int ret = 0;
+
+    // Parallel writers may append out of order, readers search by time.
+    qsort (w->index, w->header.frame_count, sizeof (*w->index), by_timestamp);
+
+    w->header.index_offset = w->pos;
+    if (write_at (w->fd, w->index, (size_t)w->header.frame_count * sizeof (*w->index),
+                  w->pos) < 0 ||
+        write_at (w->fd, &w->header, sizeof (w->header), 0) < 0)
+        ret = -1;
+
+    if (close (w->fd) < 0)
+        ret = -1;
+    free (w->index);
+    free (w);
+    return ret;
+}
+
+//***********************************************************************************
+int capfile_open (const char * path, struct capfile * cf)
+{
+const struct capfile_header *h;
+struct stat st;
+void *map;
+int fd;
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat (fd, &st) < 0) {
+        close (fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < CAPFILE_HEADER_SIZE) {
+        close (fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    h = map;
+    if (memcmp (h->magic, CAPFILE_MAGIC, sizeof (h->magic)) ||
+        h->version != CAPFILE_VERSION || h->header_size != CAPFILE_HEADER_SIZE ||
+        h->entry_size != sizeof (struct capfile_entry) || h->index_offset == 0 ||
+        h->index_offset > (uint64_t)st.st_size ||
+        (uint64_t)h->frame_count * h->entry_size > st.st_size - h->index_offset) {
+        munmap (map, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    cf->base = map;
+    cf->length = st.st_size;
+    cf->header = h;
+    cf->index = (const struct capfile_entry *)(cf->base + h->index_offset);
+    return 0;
+}
+
+void capfile_unmap (struct capfile * cf)
+{
+    munmap ((void *)cf->base, cf->length);
+    cf->base = NULL;
+}
+
+const void * capfile_frame (const struct capfile * cf, unsigned int i,
+                            const struct capfile_entry ** e)
+{
+const struct capfile_entry *ent;
+
+    if (i >= cf->header->frame_count)
+        return NULL;
+
+    ent = &cf->index[i];
+    if (ent->offset > cf->length || ent->size > cf->length - ent->offset)
+        return NULL;
+
+    if (e)
+        *e = ent;
+    return cf->base + ent->offset;
+}
+
+unsigned int capfile_find (const struct capfile * cf, uint64_t ts)
+{
+unsigned int lo = 0, hi = cf->header->frame_count;
+
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if (cf->index[mid].timestamp < ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
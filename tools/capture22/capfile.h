@@ -0,0 +1,116 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Capture container: many frames plus metadata in one seekable file.
+//
+//   offset 0        struct capfile_header (CAPFILE_HEADER_SIZE bytes)
+//   page aligned    frame 0 payload
+//   page aligned    frame 1 payload
+//   ...
+//   index_offset    struct capfile_entry[frame_count]
+//
+// The structs are stored as laid out here, in the byte order of the
+// (little endian) capture host.  Payloads start on CAPFILE_ALIGN
+// boundaries so a reader can mmap the file and use frames in place, and
+// the index has fixed size entries so frame i is found in O(1) without
+// reading the payloads.  The index is written, sorted by timestamp, when
+// the recording is closed; until then index_offset is 0.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __CAPFILE_H
+#define __CAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPFILE_MAGIC           "CAP22IDX"
+#define CAPFILE_VERSION         1
+#define CAPFILE_HEADER_SIZE     64
+#define CAPFILE_ALIGN           4096
+
+// capfile_header.encoding: how the payloads are stored
+enum capfile_encoding {
+    CAPFILE_RAW,                // as captured
+    CAPFILE_RAW10P,             // MIPI packed RAW10/RAW12 (convert.h)
+    CAPFILE_RAW12P,
+    CAPFILE_RBC,                // lossless codec stream (rawcodec.h)
+};
+
+struct capfile_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixelformat;       // V4L2 fourcc of the captured frames
+    uint32_t bytesperline;
+    uint32_t encoding;          // enum capfile_encoding
+    uint32_t entry_size;        // sizeof (struct capfile_entry)
+    uint64_t index_offset;
+    uint32_t frame_count;
+    uint32_t reserved[3];
+};
+
+struct capfile_entry {
+    uint64_t offset;            // payload position in the file
+    uint32_t size;              // payload bytes
+    uint32_t sequence;          // V4L2 sequence
+    uint64_t timestamp;         // V4L2 timestamp (us)
+    uint32_t exposure;          // exposure setting, 0 if unknown
+    uint32_t gain;              // analog gain setting, 0 if unknown
+    uint32_t pixelformat;
+    uint32_t flags;
+    uint32_t reserved[2];
+};
+
+//
+// Writer
+//
+struct capfile_writer;
+
+struct capfile_writer * capfile_create (const char * path, unsigned int width,
+                                        unsigned int height, unsigned int pixelformat,
+                                        unsigned int bytesperline,
+                                        enum capfile_encoding encoding);
+
+//
+// e->offset is filled in; the other fields are copied as given.  Returns 0
+// or -1 on a write error.
+//
+int capfile_append (struct capfile_writer * w, const void * data, size_t size,
+                    struct capfile_entry * e);
+
+//
+// Write the index and the final header.  Returns 0 or -1.
+//
+int capfile_close (struct capfile_writer * w);
+
+//
+// Reader (mmap based)
+//
+struct capfile {
+    const struct capfile_header * header;
+    const struct capfile_entry * index;
+    const uint8_t * base;
+    size_t length;
+};
+
+int capfile_open (const char * path, struct capfile * cf);
+void capfile_unmap (struct capfile * cf);
+
+//
+// Payload of frame i, or NULL if i is out of range.  e may be NULL.
+//
+const void * capfile_frame (const struct capfile * cf, unsigned int i,
+                            const struct capfile_entry ** e);
+
+//
+// First frame with a timestamp at or after ts (binary search), or
+// frame_count if there is none.
+//
+unsigned int capfile_find (const struct capfile * cf, uint64_t ts);
+
+#endif /* __CAPFILE_H */
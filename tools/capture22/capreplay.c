@@ -0,0 +1,501 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Replay a capture container (capfile.h) into a V4L2 output device such as
+// v4l2loopback or vivid, so capture22 and the processing pipeline can be
+// exercised on a host without a sensor.
+//
+//   capreplay -d /dev/video1 rec.cap          original frame timing
+//   capreplay -d /dev/video1 -s 2 rec.cap     twice as fast
+//   capreplay -d /dev/video1 -m -l 0 rec.cap  as fast as the device takes
+//                                             frames, looping until ^C
+//
+// Frames are paced against CLOCK_MONOTONIC from the recorded timestamps;
+// a frame that is already late is sent at once and counted, the schedule
+// is not shifted, so a slow consumer shows up in the report rather than as
+// a silently lower rate.  Packed and compressed payloads are expanded to
+// the recorded pixel format before they are queued.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+#include "capture22.h"
+#include "capfile.h"
+#include "bayer.h"
+#include "convert.h"
+#include "rawcodec.h"
+
+static char * dev_name = "/dev/video1";
+static int fd = -1;
+static struct buffer * buffers = NULL;
+static unsigned int n_buffers = 0;
+static unsigned int queued = 0;		// buffers handed to the driver so far
+static int use_write = 0;		// driver without streaming output
+static unsigned char * frame_buf = NULL;	// expanded frame for write ()
+static size_t frame_size = 0;
+static unsigned int out_stride = 0;	// bytesperline chosen by the driver
+static volatile sig_atomic_t stop = 0;
+
+static void errno_exit (const char * s)
+{
+    fprintf (stderr, "%s error %d, %s\n", s, errno, strerror (errno));
+    exit (EXIT_FAILURE);
+}
+
+// capture22.c's xioctl () does not report QBUF/DQBUF failures, which
+// send_frame () needs to see, so capreplay provides its own.
+//
+int xioctl (int fd, int request, void * arg)
+{
+int r;
+
+    do r = ioctl (fd, request, arg);
+    while (-1 == r && EINTR == errno);
+    return r;
+}
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_until (unsigned long long us)
+{
+struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stop)
+        ;
+}
+
+static void on_signal (int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+//***********************************************************************************
+// Device setup.  The output format is the recorded one; the driver may
+// only adjust bytesperline, which expand_frame () honours.
+//
+static void init_device (const struct capfile_header * h, unsigned int count)
+{
+struct v4l2_capability cap;
+struct v4l2_requestbuffers req;
+struct v4l2_format fmt;
+unsigned int i;
+
+    fd = open (dev_name, O_RDWR);
+    if (fd < 0)
+        errno_exit (dev_name);
+
+    if (xioctl (fd, VIDIOC_QUERYCAP, &cap) < 0)
+        errno_exit ("VIDIOC_QUERYCAP");
+    if (!(cap.capabilities & V4L2_CAP_VIDEO_OUTPUT)) {
+        fprintf (stderr, "%s is no video output device\n", dev_name);
+        exit (EXIT_FAILURE);
+    }
+
+    CLEAR (fmt);
+    fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    fmt.fmt.pix.width = h->width;
+    fmt.fmt.pix.height = h->height;
+    fmt.fmt.pix.pixelformat = h->pixelformat;
+    fmt.fmt.pix.bytesperline = h->bytesperline;
+    fmt.fmt.pix.sizeimage = h->bytesperline * h->height;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl (fd, VIDIOC_S_FMT, &fmt) < 0)
+        errno_exit ("VIDIOC_S_FMT");
+    if (fmt.fmt.pix.width != h->width || fmt.fmt.pix.height != h->height ||
+        fmt.fmt.pix.pixelformat != h->pixelformat ||
+        fmt.fmt.pix.bytesperline < h->bytesperline) {
+        fprintf (stderr, "%s does not take %ux%u frames in the recorded format\n",
+                 dev_name, h->width, h->height);
+        exit (EXIT_FAILURE);
+    }
+    frame_size = fmt.fmt.pix.sizeimage;
+    out_stride = fmt.fmt.pix.bytesperline;
+    if (frame_size < (size_t)out_stride * h->height)
+        frame_size = (size_t)out_stride * h->height;
+
+    if (!(cap.capabilities & V4L2_CAP_STREAMING)) {
+        use_write = 1;
+    } else {
+        CLEAR (req);
+        req.count = count;
+        req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        req.memory = V4L2_MEMORY_MMAP;
+        if (xioctl (fd, VIDIOC_REQBUFS, &req) < 0) {
+            if (EINVAL != errno)
+                errno_exit ("VIDIOC_REQBUFS");
+            use_write = 1;
+        }
+    }
+
+    if (use_write) {
+        if (!(cap.capabilities & V4L2_CAP_READWRITE)) {
+            fprintf (stderr, "%s supports neither streaming nor write\n", dev_name);
+            exit (EXIT_FAILURE);
+        }
+        frame_buf = malloc (frame_size);
+        if (frame_buf == NULL) {
+            fprintf (stderr, "Out of memory\n");
+            exit (EXIT_FAILURE);
+        }
+        return;
+    }
+
+    if (req.count < 2) {
+        fprintf (stderr, "Insufficient buffer memory on %s\n", dev_name);
+        exit (EXIT_FAILURE);
+    }
+
+    buffers = calloc (req.count, sizeof (*buffers));
+    if (buffers == NULL) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = 0; i < req.count; ++i) {
+        struct v4l2_buffer buf;
+
+        CLEAR (buf);
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (xioctl (fd, VIDIOC_QUERYBUF, &buf) < 0)
+            errno_exit ("VIDIOC_QUERYBUF");
+
+        buffers[i].length = buf.length;
+        buffers[i].start = mmap (NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                 fd, buf.m.offset);
+        if (MAP_FAILED == buffers[i].start)
+            errno_exit ("mmap");
+    }
+    n_buffers = req.count;
+}
+
+//
+// Let the consumer take the frames still queued, unless interrupted, so a
+// short recording is played completely.
+//
+static void uninit_device (void)
+{
+enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+struct v4l2_buffer buf;
+unsigned int i;
+
+    if (queued && queued < n_buffers && xioctl (fd, VIDIOC_STREAMON, &type) < 0)
+        errno_exit ("VIDIOC_STREAMON");
+    for (i = 0; i < queued && i < n_buffers && !stop; ++i) {
+        CLEAR (buf);
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (xioctl (fd, VIDIOC_DQBUF, &buf) < 0)
+            break;
+    }
+    if (queued)
+        xioctl (fd, VIDIOC_STREAMOFF, &type);
+    for (i = 0; i < n_buffers; ++i)
+        munmap (buffers[i].start, buffers[i].length);
+    free (buffers);
+    free (frame_buf);
+    close (fd);
+}
+
+//***********************************************************************************
+// Expand a recorded payload into a device buffer of the recorded format.
+// Returns the bytes used or -1.
+//
+static long expand_frame (const struct capfile_header * h, const void * data, size_t size,
+                          void * dst, size_t length, unsigned int threads)
+{
+unsigned int y;
+
+    if (length < (size_t)out_stride * h->height)
+        return -1;
+
+    switch (h->encoding) {
+        case CAPFILE_RAW:
+            if (out_stride == h->bytesperline) {
+                if (size > length)
+                    size = length;
+                memcpy (dst, data, size);
+                return size;
+            }
+            if (size < (size_t)h->bytesperline * h->height)
+                return -1;
+            for (y = 0; y < h->height; ++y)
+                memcpy ((uint8_t *)dst + (size_t)out_stride * y,
+                        (const uint8_t *)data + (size_t)h->bytesperline * y, h->bytesperline);
+            return (size_t)out_stride * h->height;
+
+        case CAPFILE_RAW10P:
+        case CAPFILE_RAW12P: {
+            size_t in = h->encoding == CAPFILE_RAW10P ? conv_raw10_packed_bytes (h->width)
+                                                      : conv_raw12_packed_bytes (h->width);
+
+            if (size < in * h->height || out_stride < h->width * 2)
+                return -1;
+            for (y = 0; y < h->height; ++y) {
+                const uint8_t *s = (const uint8_t *)data + in * y;
+                uint16_t *d = (uint16_t *)((uint8_t *)dst + (size_t)out_stride * y);
+
+                if (h->encoding == CAPFILE_RAW10P)
+                    conv_raw10p_to_raw16_row (s, d, h->width);
+                else
+                    conv_raw12p_to_raw16_row (s, d, h->width);
+            }
+            return (size_t)out_stride * h->height;
+        }
+
+        case CAPFILE_RBC: {
+            struct rawcodec_info info;
+            enum bayer_order order;
+            unsigned int bits;
+
+            // The stream carries its own geometry; it must match the header
+            // the device buffers were sized from.
+            if (bayer_from_fourcc (h->pixelformat, &order, &bits) < 0 ||
+                rawcodec_info (data, size, &info) < 0 ||
+                info.width != h->width || info.height != h->height || info.bits != bits ||
+                out_stride < h->width * (bits > 8 ? 2 : 1))
+                return -1;
+            if (rawcodec_decode (data, size, dst, out_stride, threads) < 0)
+                return -1;
+            return (size_t)out_stride * h->height;
+        }
+    }
+
+    return -1;
+}
+
+//***********************************************************************************
+// Hand one frame to the driver: a fresh buffer while the pool is being
+// filled, afterwards whichever buffer the driver has finished with.
+// Streaming starts once the pool is full.
+//
+static int send_frame (const struct capfile_header * h, const struct capfile_entry * e,
+                       const void * data, unsigned int threads)
+{
+struct v4l2_buffer buf;
+long used;
+
+    if (use_write) {
+        used = expand_frame (h, data, e->size, frame_buf, frame_size, threads);
+        if (used < 0)
+            return -1;
+        if (write (fd, frame_buf, used) < 0) {
+            if (EINTR == errno)
+                return 0;
+            errno_exit ("write");
+        }
+        return 0;
+    }
+
+    CLEAR (buf);
+    buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (queued < n_buffers) {
+        buf.index = queued;
+    } else if (xioctl (fd, VIDIOC_DQBUF, &buf) < 0) {
+        if (EINTR == errno && stop)
+            return 0;
+        errno_exit ("VIDIOC_DQBUF");
+    }
+
+    used = expand_frame (h, data, e->size, buffers[buf.index].start,
+                         buffers[buf.index].length, threads);
+    if (used < 0)
+        return -1;
+
+    buf.bytesused = used;
+    buf.field = V4L2_FIELD_NONE;
+    buf.sequence = e->sequence;
+    buf.timestamp.tv_sec = e->timestamp / 1000000;
+    buf.timestamp.tv_usec = e->timestamp % 1000000;
+    if (xioctl (fd, VIDIOC_QBUF, &buf) < 0)
+        errno_exit ("VIDIOC_QBUF");
+
+    if (++queued == n_buffers) {
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+
+        if (xioctl (fd, VIDIOC_STREAMON, &type) < 0)
+            errno_exit ("VIDIOC_STREAMON");
+    }
+    return 0;
+}
+
+//***********************************************************************************
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options] file\n\n Options:\n"
+        "-d | --device name Output device [/dev/video1]\n"
+        "-m | --max Send frames as fast as the device accepts them\n"
+        "-s | --speed x Rate multiplier on the recorded timing [1.0]\n"
+        "-l | --loops n Play the recording n times, 0 = until interrupted [1]\n"
+        "-n | --buffers n Output buffers to request [4]\n"
+        "-t | --threads n Decoder threads for compressed recordings [1]\n"
+        "-q | --quiet No per-pass report\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "device", required_argument, NULL, 'd' },
+    { "max", no_argument, NULL, 'm' },
+    { "speed", required_argument, NULL, 's' },
+    { "loops", required_argument, NULL, 'l' },
+    { "buffers", required_argument, NULL, 'n' },
+    { "threads", required_argument, NULL, 't' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+unsigned long long start, t, base = 0, span, late = 0, max_late = 0, bytes = 0, frames = 0;
+unsigned int count = 4, threads = 1, loops = 1, pass, i;
+const struct capfile_header *h;
+struct capfile cf;
+double speed = 1.0;
+int max_rate = 0, quiet = 0;
+int c;
+
+    while ((c = getopt_long (argc, argv, "d:ms:l:n:t:qh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'd':
+                dev_name = optarg;
+                break;
+            case 'm':
+                max_rate = 1;
+                break;
+            case 's':
+                speed = atof (optarg);
+                if (speed <= 0.0) {
+                    fprintf (stderr, "Bad speed %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l':
+                loops = atoi (optarg);
+                break;
+            case 'n':
+                count = atoi (optarg);
+                break;
+            case 't':
+                threads = atoi (optarg);
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                usage (argv[0]);
+                return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage (argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (capfile_open (argv[optind], &cf) < 0) {
+        perror (argv[optind]);
+        return EXIT_FAILURE;
+    }
+    h = cf.header;
+    if (h->frame_count == 0) {
+        fprintf (stderr, "%s holds no frames\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    // One recorded frame interval separates the last frame of a pass from
+    // the first of the next.
+    span = cf.index[h->frame_count - 1].timestamp - cf.index[0].timestamp;
+    if (h->frame_count > 1)
+        span += span / (h->frame_count - 1);
+
+    init_device (h, count);
+    signal (SIGINT, on_signal);
+    signal (SIGTERM, on_signal);
+
+    printf ("%s: %ux%u, %u frames, %s%s\n", dev_name, h->width, h->height, h->frame_count,
+            use_write ? "write, " : "", max_rate ? "max rate" : "recorded timing");
+
+    start = mono_us ();
+    for (pass = 0; !stop && (loops == 0 || pass < loops); ++pass) {
+        unsigned long long pass_start = mono_us (), pass_late = 0;
+
+        for (i = 0; i < h->frame_count && !stop; ++i) {
+            const struct capfile_entry *e;
+            const void *data = capfile_frame (&cf, i, &e);
+
+            if (data == NULL) {
+                fprintf (stderr, "frame %u: bad index entry\n", i);
+                stop = 1;
+                break;
+            }
+
+            if (!max_rate) {
+                unsigned long long due = start +
+                    (base + e->timestamp - cf.index[0].timestamp) / speed;
+
+                t = mono_us ();
+                if (t < due) {
+                    sleep_until (due);
+                } else if (t - due > 1000) {
+                    pass_late++;
+                    if (t - due > max_late)
+                        max_late = t - due;
+                }
+            }
+
+            if (send_frame (h, e, data, threads) < 0) {
+                fprintf (stderr, "frame %u: unable to expand the payload\n", i);
+                stop = 1;
+                break;
+            }
+            bytes += e->size;
+            frames++;
+        }
+        base += span;
+        late += pass_late;
+
+        if (!quiet) {
+            t = mono_us () - pass_start;
+            printf ("pass %u: %u frames in %.3f s, %.2f fps, %u late\n", pass + 1, i,
+                    t / 1e6, t ? i * 1e6 / t : 0.0, (unsigned int)pass_late);
+        }
+    }
+
+    t = mono_us () - start;
+    printf ("%llu frames in %.3f s: %.2f fps, %.1f MB/s read", frames, t / 1e6,
+            t ? frames * 1e6 / t : 0.0, t ? (double)bytes / t : 0.0);
+    if (!max_rate)
+        printf (", %llu late (max %.1f ms)", late, max_late / 1e3);
+    printf ("\n");
+
+    uninit_device ();
+    capfile_unmap (&cf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,320 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Capture container tool.
+//
+//   captool file                        header and frame index
+//   captool -x 10-19 -o part.cap file   copy frames 10..19 to a new file
+//   captool -t 5000000-6000000 -r img file
+//                                       frames in a timestamp range (us) as
+//                                       img_<sequence>.raw
+//   captool -D 12 -o events.cap file    keep only the frames around motion,
+//                                       as capture22 -D would have recorded
+//
+// Ranges are resolved through the index alone; only the selected payloads
+// are touched.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "capfile.h"
+#include "motion.h"
+
+static const char * const encodings[] = { "raw", "raw10p", "raw12p", "rbc" };
+
+//***********************************************************************************
+static void print_fourcc (unsigned int f)
+{
+    printf ("%c%c%c%c", f & 0xff, (f >> 8) & 0xff, (f >> 16) & 0xff, (f >> 24) & 0xff);
+}
+
+static void list (const struct capfile * cf, unsigned int first, unsigned int last)
+{
+const struct capfile_header *h = cf->header;
+unsigned int i;
+
+    printf ("%ux%u ", h->width, h->height);
+    print_fourcc (h->pixelformat);
+    printf (", %u bytes per line, %s, %u frames\n", h->bytesperline,
+            h->encoding < sizeof (encodings) / sizeof (encodings[0])
+            ? encodings[h->encoding] : "?", h->frame_count);
+    if (h->frame_count)
+        printf ("%.3f s\n\n", (cf->index[h->frame_count - 1].timestamp -
+                              cf->index[0].timestamp) / 1e6);
+
+    printf ("%8s %10s %16s %10s %8s %6s\n", "frame", "sequence", "timestamp", "bytes",
+            "exposure", "gain");
+    for (i = first; i <= last && i < h->frame_count; ++i) {
+        const struct capfile_entry *e = &cf->index[i];
+
+        printf ("%8u %10u %16llu %10u %8u %6u\n", i, e->sequence,
+                (unsigned long long)e->timestamp, e->size, e->exposure, e->gain);
+    }
+}
+
+//***********************************************************************************
+static int extract_cap (const struct capfile * cf, unsigned int first, unsigned int last,
+                        const char * out)
+{
+const struct capfile_header *h = cf->header;
+struct capfile_writer *w;
+unsigned int i;
+
+    w = capfile_create (out, h->width, h->height, h->pixelformat, h->bytesperline,
+                        h->encoding);
+    if (w == NULL) {
+        perror (out);
+        return -1;
+    }
+
+    for (i = first; i <= last && i < h->frame_count; ++i) {
+        const struct capfile_entry *e;
+        const void *data = capfile_frame (cf, i, &e);
+        struct capfile_entry copy;
+
+        if (data == NULL) {
+            fprintf (stderr, "frame %u: bad index entry\n", i);
+            capfile_close (w);
+            return -1;
+        }
+        copy = *e;
+        if (capfile_append (w, data, e->size, &copy) < 0) {
+            perror (out);
+            capfile_close (w);
+            return -1;
+        }
+    }
+
+    return capfile_close (w);
+}
+
+//
+// Run the motion detector over the selection and copy the frames
+// capture22 -D would have written.  The preroll is a range of the input
+// rather than a copy.
+//
+static int filter_motion (const struct capfile * cf, unsigned int first, unsigned int last,
+                          const char * out, unsigned int threshold)
+{
+const struct capfile_header *h = cf->header;
+unsigned long long bytes = 0, written = 0;
+struct capfile_writer *w;
+struct motion_config cfg;
+unsigned int i, next = first, frames = 0;
+struct motion m;
+int ret;
+
+    if (h->encoding != CAPFILE_RAW) {
+        fprintf (stderr, "Motion detection needs a raw recording\n");
+        return -1;
+    }
+
+    motion_defaults (&cfg);
+    cfg.threshold = threshold;
+    if (motion_init (&m, &cfg, h->width, h->height, h->pixelformat) < 0) {
+        fprintf (stderr, "No motion detection for this format\n");
+        return -1;
+    }
+
+    w = capfile_create (out, h->width, h->height, h->pixelformat, h->bytesperline,
+                        h->encoding);
+    if (w == NULL) {
+        perror (out);
+        motion_free (&m);
+        return -1;
+    }
+
+    for (i = first; i <= last && i < h->frame_count; ++i) {
+        const struct capfile_entry *e;
+        const void *data = capfile_frame (cf, i, &e);
+
+        if (data == NULL || e->size < (size_t)h->bytesperline * h->height) {
+            fprintf (stderr, "frame %u: bad index entry\n", i);
+            break;
+        }
+        bytes += e->size;
+        if (!motion_frame (&m, data, h->bytesperline))
+            continue;
+
+        if (next + cfg.preroll < i)
+            next = i - cfg.preroll;
+        for (; next <= i; ++next) {
+            struct capfile_entry copy;
+
+            data = capfile_frame (cf, next, &e);
+            copy = *e;
+            if (capfile_append (w, data, e->size, &copy) < 0) {
+                perror (out);
+                capfile_close (w);
+                motion_free (&m);
+                return -1;
+            }
+            written += e->size;
+            frames++;
+        }
+    }
+
+    printf ("%llu frames, %llu with motion, %llu events, detector %.0f us/frame\n",
+            m.frames, m.motion_frames, m.events,
+            m.frames ? (double)m.busy_us / m.frames : 0.0);
+    printf ("wrote %u frames, %.1f of %.1f MB (%.1f%% of the I/O)\n", frames,
+            written / 1e6, bytes / 1e6, bytes ? 100.0 * written / bytes : 0.0);
+
+    motion_free (&m);
+    ret = i <= last && i < h->frame_count ? -1 : 0;
+    if (capfile_close (w) < 0)
+        ret = -1;
+    return ret;
+}
+
+static int extract_raw (const struct capfile * cf, unsigned int first, unsigned int last,
+                        const char * prefix)
+{
+unsigned int i;
+
+    for (i = first; i <= last && i < cf->header->frame_count; ++i) {
+        const struct capfile_entry *e;
+        const void *data = capfile_frame (cf, i, &e);
+        char name[256];
+        FILE *fp;
+
+        if (data == NULL) {
+            fprintf (stderr, "frame %u: bad index entry\n", i);
+            return -1;
+        }
+
+        snprintf (name, sizeof (name), "%s_%06u.raw", prefix, e->sequence);
+        fp = fopen (name, "wb");
+        if (fp == NULL || fwrite (data, 1, e->size, fp) != e->size) {
+            perror (name);
+            if (fp)
+                fclose (fp);
+            return -1;
+        }
+        fclose (fp);
+    }
+
+    return 0;
+}
+
+//***********************************************************************************
+static int parse_range (const char * s, unsigned long long * first, unsigned long long * last)
+{
+char *end;
+
+    *first = strtoull (s, &end, 0);
+    if (*end == '\0') {
+        *last = *first;
+        return 0;
+    }
+    if (*end != '-')
+        return -1;
+    *last = end[1] ? strtoull (end + 1, &end, 0) : ~0ULL;
+    return *end == '\0' && *last >= *first ? 0 : -1;
+}
+
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options] file\n\n Options:\n"
+        "-x | --frames first[-last] Select frames by index (default all)\n"
+        "-t | --time first[-last] Select frames by timestamp (us)\n"
+        "-o | --output file Copy the selection to a new container\n"
+        "-r | --raw prefix Write the selection as prefix_<sequence>.raw\n"
+        "-D | --detect threshold With -o, copy only the frames around motion\n"
+        "Without -o or -r the header and the selected index entries are listed.\n",
+        argv0);
+}
+
+static const struct option long_options [] = {
+    { "frames", required_argument, NULL, 'x' },
+    { "time", required_argument, NULL, 't' },
+    { "output", required_argument, NULL, 'o' },
+    { "raw", required_argument, NULL, 'r' },
+    { "detect", required_argument, NULL, 'D' },
+    { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+unsigned long long first = 0, last = ~0ULL;
+const char *out = NULL, *raw = NULL;
+struct capfile cf;
+int by_time = 0, detect = -1;
+int c, ret;
+
+    while ((c = getopt_long (argc, argv, "x:t:o:r:D:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'x':
+            case 't':
+                if (parse_range (optarg, &first, &last) < 0) {
+                    fprintf (stderr, "Bad range %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                by_time = c == 't';
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            case 'r':
+                raw = optarg;
+                break;
+            case 'D':
+                detect = atoi (optarg);
+                break;
+            default:
+                usage (argv[0]);
+                return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage (argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (capfile_open (argv[optind], &cf) < 0) {
+        perror (argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    // Timestamps map to indexes by binary search in the index.
+    if (by_time) {
+        unsigned long long end = last;
+
+        first = capfile_find (&cf, first);
+        last = end == ~0ULL ? ~0ULL : capfile_find (&cf, end + 1);
+        if (last == first) {
+            fprintf (stderr, "No frames in the time range\n");
+            capfile_unmap (&cf);
+            return EXIT_FAILURE;
+        }
+        if (last != ~0ULL)
+            last--;
+    }
+
+    if (last >= cf.header->frame_count)
+        last = cf.header->frame_count ? cf.header->frame_count - 1 : 0;
+
+    if (out && detect >= 0)
+        ret = filter_motion (&cf, first, last, out, detect);
+    else if (out)
+        ret = extract_cap (&cf, first, last, out);
+    else if (raw)
+        ret = extract_raw (&cf, first, last, raw);
+    else {
+        list (&cf, first, last);
+        ret = 0;
+    }
+
+    capfile_unmap (&cf);
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -37,12 +37,23 @@
 #include <asm/types.h> /* for videodev2.h */
 #include <linux/videodev2.h>  //FIX THIS!
 #include <linux/types.h>
-#include </home/abhishek/Desktop/beagle-data/beagleboard-validation-linux/trunk/kernel-2.6.32/arch/arm/plat-omap/include/plat/isp_user.h> 
+#include "isp_user.h"
 
 //#include "videodev2.h"
 
+#include "capture22.h"
+#include "bufpool.h"
+#include "multicap.h"
+#include "pipeline.h"
+#include "convert.h"
+#include "rawcodec.h"
+#include "capfile.h"
+#include "shmring.h"
+#include "fstats.h"
+#include "motion.h"
+#include "scale.h"
+#include "bayer.h"
 
-#define CLEAR(x) memset (&(x), 0, sizeof (x))
 
 typedef enum {
     IO_METHOD_READ,
@@ -52,10 +63,6 @@ typedef enum {
     IO_METHOD_SETGAIN,
 } io_method;
 
-struct buffer {
-    void * start;
-    size_t length;
-};
 //The structure to set the gain or exposure
 
 
@@ -89,6 +96,9 @@ char save_buf[SIZEOFBUFFER];
 #define VDEVICENAME "/dev/video0"		// Video 4 for Apache, 0 for SDP
 
 #define CAPFILENAME "./capture_image.raw"
+#define RGBFILENAME "./capture_image.ppm"
+#define CONVFILENAME "./capture_image.%s"	// extension is the -X format name
+#define RBCFILENAME "./capture_image.rbc"
 
 static char * dev_name = NULL;
 static __u16 gain;
@@ -100,6 +110,64 @@ struct buffer * buffers = NULL;
 static unsigned int n_buffers = 0;
 static unsigned int n_actualbuffers = 0;
 
+static unsigned int req_count = 4;		// Buffers asked for in VIDIOC_REQBUFS
+static unsigned int capture_count = CAPCOUNT;	// Frames per streaming run
+static unsigned int restarts = 0;		// Extra stop/uninit/init/start cycles
+static int pool_flags = 0;			// BUFPOOL_* flags for USERPTR i/o
+static struct bufpool pool;			// USERPTR buffers, kept across restarts
+static unsigned int bytesperline = 0;
+static unsigned int image_height = 0;
+static unsigned int image_width = 0;
+static unsigned int pixelformat = 0;
+static int demosaic = -1;			// -C: enum bayer_method, -1 = off
+
+static int benchmark = 0;			// Compare MMAP against the USERPTR pool
+static unsigned long long bench_touch_us = 0;	// Time spent in consume_frame()
+static unsigned int bench_frames = 0;
+static volatile unsigned int bench_sink;
+
+static char * multi_names[MULTICAP_MAX_DEVICES];	// -M device list
+static unsigned int multi_count = 0;
+static unsigned int sync_tolerance = 1000;	// Pairing tolerance (us)
+
+static unsigned int pipe_workers = 0;		// -j: analysis threads, 0 = inline
+static struct pipeline * frame_pipe = NULL;
+static struct pipe_frame * pipe_frames = NULL;	// one per MMAP buffer
+static unsigned int last_mean = 0;
+static unsigned int last_over = 0;		// per mille of clipped samples
+static unsigned int last_under = 0;		// per mille of black samples
+static unsigned int stats_step = 4;		// -A: frame statistics subsampling
+static int convert_to = -1;			// -X: enum conv_format, -1 = off
+static unsigned char ** conv_bufs = NULL;	// converted frame, one per MMAP buffer
+static unsigned char * conv_save = NULL;	// converted copy of the saved frame
+static size_t conv_size = 0;
+static int packed_raw = 0;			// -P: save 10/12-bit frames MIPI packed
+static int compress_raw = 0;			// -Z: save Bayer frames losslessly compressed
+static char * record_name = NULL;		// -o: record every frame to a container
+static struct capfile_writer * recorder = NULL;
+static enum capfile_encoding record_enc = CAPFILE_RAW;
+static unsigned char * record_buf = NULL;	// packed / compressed frame
+static unsigned int record_threads = 1;		// codec workers, one per CPU
+static unsigned int record_frames = 0;
+static unsigned long long record_bytes = 0;	// payload bytes written
+static int motion_threshold = -1;		// -D: record only around motion
+static struct motion motion;
+static struct preroll preroll;
+static int preroll_frames = -1;			// -B: frames kept before motion, -1 = default
+static unsigned int preroll_slots = 0;		// preroll size that fits in memory
+static int motion_ready = 0;
+static unsigned long long motion_bytes = 0;	// bytes offered to the recorder
+static char * ring_name = NULL;			// -S: publish frames in shared memory
+static struct shmring_writer * ring = NULL;
+static char * preview_name = NULL;		// -V: publish a downscaled preview
+static unsigned int preview_factor = 4;		// -F: 2 or 4
+static struct shmring_writer * preview_ring = NULL;
+static struct scaler preview_scaler;
+static unsigned int read_sequence = 0;		// IO_METHOD_READ frame count
+
+#define FRAME_SAVE  0x01			// pipe_frame flag: save this frame
+#define RING_SLOTS  8				// frames kept in the shared memory ring
+
 //***********************************************************************************
 static void errno_exit (const char * s)
 {
@@ -139,7 +207,7 @@ unsigned char *pC, *pDest;
     fflush (stdout);
 
     // Copy the image to a local buffer
-    pC = (unsigned char *)buffers[0].start;
+    pC = (unsigned char *)p;
     pDest = (unsigned char *)save_buf;
 
     for (i=0; i < SIZEOFIMAGE; i++) {
@@ -150,6 +218,529 @@ unsigned char *pC, *pDest;
     return;
 }
 
+//***********************************************************************************
+static unsigned long long now_us (void)
+{
+struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+//***********************************************************************************
+// Benchmark consumer: walk the frame column by column touching one word per
+// cache line, the access pattern of a vertical filter.  Every row step lands
+// on a new 4 KB page, so the cost is dominated by TLB misses unless the
+// buffer is backed by huge pages.
+//
+static void consume_frame (const void * p, size_t length)
+{
+const unsigned char *base = p;
+unsigned int x, y, stride, rows;
+unsigned int sum = 0;
+unsigned long long start;
+
+    stride = bytesperline ? bytesperline : TARGETWIDTH * 2;
+    rows = image_height ? image_height : TARGETHEIGHT;
+    if ((size_t)stride * rows > length)
+        rows = length / stride;
+
+    start = now_us ();
+    for (x = 0; x + sizeof (unsigned int) <= stride; x += 64)
+        for (y = 0; y < rows; ++y)
+            sum += *(const unsigned int *)(base + (size_t)y * stride + x);
+    bench_touch_us += now_us () - start;
+    bench_frames++;
+    bench_sink = sum;
+}
+
+//***********************************************************************************
+// Recording.  The container is created on the first frame, when the format
+// is known.  -Z and -P select the payload encoding as for the saved frame.
+//
+static int open_recorder (void)
+{
+enum bayer_order order;
+unsigned int bits = 0;
+size_t size = 0;
+
+    bayer_from_fourcc (pixelformat, &order, &bits);
+    if (compress_raw && bits) {
+        long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+
+        record_enc = CAPFILE_RBC;
+        record_threads = ncpu > 0 ? ncpu : 1;
+        size = rawcodec_bound (image_width, image_height, bits, 16);
+    } else if (packed_raw && (bits == 10 || bits == 12)) {
+        record_enc = bits == 10 ? CAPFILE_RAW10P : CAPFILE_RAW12P;
+        size = conv_frame_size (bits == 10 ? CONV_RAW10P : CONV_RAW12P,
+                                image_width, image_height);
+    } else {
+        record_enc = CAPFILE_RAW;
+    }
+
+    if (size && (record_buf = malloc (size)) == NULL)
+        return -1;
+
+    recorder = capfile_create (record_name, image_width, image_height, pixelformat,
+                               bytesperline, record_enc);
+    return recorder ? 0 : -1;
+}
+
+static void close_recorder (void)
+{
+    if (recorder == NULL)
+        return;
+    if (capfile_close (recorder) < 0)
+        fprintf (stderr, "Unable to write the index of %s\n", record_name);
+    else
+        printf ("recorded %u frames to %s\n", record_frames, record_name);
+    recorder = NULL;
+    free (record_buf);
+    record_buf = NULL;
+}
+
+static void record_frame (const void * p, size_t length, unsigned int sequence,
+                          unsigned long long ts)
+{
+struct capfile_entry e;
+struct conv_image img;
+struct bayer_image bimg;
+const void *data = p;
+long size = length;
+
+    if (record_name == NULL)
+        return;
+    if (recorder == NULL && open_recorder () < 0) {
+        fprintf (stderr, "Unable to create %s, not recording\n", record_name);
+        record_name = NULL;
+        return;
+    }
+
+    img.data = p;
+    img.width = image_width;
+    img.height = image_height;
+    img.stride = bytesperline;
+    img.fourcc = pixelformat;
+
+    switch (record_enc) {
+        case CAPFILE_RAW10P:
+        case CAPFILE_RAW12P:
+            conv_frame (&img, record_enc == CAPFILE_RAW10P ? CONV_RAW10P : CONV_RAW12P,
+                        record_buf);
+            size = conv_frame_size (record_enc == CAPFILE_RAW10P ? CONV_RAW10P : CONV_RAW12P,
+                                    image_width, image_height);
+            data = record_buf;
+            break;
+        case CAPFILE_RBC:
+            bimg.data = p;
+            bimg.width = image_width;
+            bimg.height = image_height;
+            bimg.stride = bytesperline;
+            bayer_from_fourcc (pixelformat, &bimg.order, &bimg.bits);
+            size = rawcodec_encode (&bimg, record_buf, 16, record_threads);
+            data = record_buf;
+            break;
+        case CAPFILE_RAW:
+            break;
+    }
+
+    CLEAR (e);
+    e.sequence = sequence;
+    e.timestamp = ts;
+    e.exposure = exposure;
+    e.gain = gain;
+    e.pixelformat = pixelformat;
+    if (size < 0 || capfile_append (recorder, data, size, &e) < 0) {
+        fprintf (stderr, "Recording to %s failed, stopped\n", record_name);
+        close_recorder ();
+        record_name = NULL;
+        return;
+    }
+    record_frames++;
+    record_bytes += size;
+}
+
+//***********************************************************************************
+// Motion triggered recording.  Frames without motion go to the preroll
+// ring; an event writes the ring out, then the frames up to postroll after
+// the last motion.
+//
+static void motion_record (const void * p, size_t length, unsigned int sequence,
+                           unsigned long long ts)
+{
+struct motion_config cfg;
+struct preroll_frame f;
+
+    if (!motion_ready) {
+        motion_defaults (&cfg);
+        cfg.threshold = motion_threshold;
+        cfg.preroll = preroll_slots;
+        if (motion_init (&motion, &cfg, image_width, image_height, pixelformat) < 0) {
+            fprintf (stderr, "No motion detection for this format, recording every frame\n");
+            motion_free (&motion);
+            motion_threshold = -1;
+            record_frame (p, length, sequence, ts);
+            return;
+        }
+        if (preroll_init (&preroll, cfg.preroll, length) < 0) {
+            fprintf (stderr, "No memory for a %u frame preroll, recording every frame\n",
+                     cfg.preroll);
+            motion_free (&motion);
+            motion_threshold = -1;
+            record_frame (p, length, sequence, ts);
+            return;
+        }
+        motion_ready = 1;
+    }
+
+    motion_bytes += length;
+    if (!motion_frame (&motion, p, bytesperline)) {
+        preroll_push (&preroll, p, length, sequence, ts);
+        return;
+    }
+
+    while (preroll_pop (&preroll, &f) == 0)
+        record_frame (f.data, f.size, f.sequence, f.timestamp);
+    record_frame (p, length, sequence, ts);
+}
+
+//
+// The preroll holds full frames.  A size given with -B that does not fit in
+// memory is refused; the default is cut to what fits.
+//
+static void check_preroll (void)
+{
+struct motion_config cfg;
+size_t length = (size_t)bytesperline * image_height;
+unsigned int max;
+
+    if (motion_threshold < 0 || !record_name)
+        return;
+
+    max = preroll_max_slots (length);
+    if (preroll_frames >= 0) {
+        if ((unsigned int)preroll_frames > max) {
+            fprintf (stderr, "A %d frame preroll needs %.0f MB, %u frames of %.1f MB fit in memory\n",
+                     preroll_frames, (double)preroll_frames * length / 1e6, max, length / 1e6);
+            exit (EXIT_FAILURE);
+        }
+        preroll_slots = preroll_frames;
+        return;
+    }
+
+    motion_defaults (&cfg);
+    preroll_slots = cfg.preroll;
+    if (preroll_slots > max) {
+        printf ("preroll cut to %u frames of %.1f MB to fit in memory\n", max, length / 1e6);
+        preroll_slots = max;
+    }
+}
+
+static void close_motion (void)
+{
+    if (!motion_ready)
+        return;
+
+    printf ("motion: %llu frames, %llu with motion, %llu events, detector %.0f us/frame\n",
+            motion.frames, motion.motion_frames, motion.events,
+            motion.frames ? (double)motion.busy_us / motion.frames : 0.0);
+    printf ("motion: wrote %u of %llu frames, %.1f of %.1f MB (%.1f%% of the I/O)\n",
+            record_frames, motion.frames, record_bytes / 1e6, motion_bytes / 1e6,
+            motion_bytes ? 100.0 * record_bytes / motion_bytes : 0.0);
+
+    motion_free (&motion);
+    preroll_free (&preroll);
+    motion_ready = 0;
+}
+
+//***********************************************************************************
+// Shared memory publishing.  The ring is created on the first frame; the
+// frame is copied into it once and readers (shmcat, shmring.h clients) use
+// it in place.
+//
+static void publish_frame (const void * p, size_t length, unsigned int sequence,
+                           unsigned long long ts)
+{
+size_t slot_size = (size_t)bytesperline * image_height;
+
+    if (ring_name == NULL)
+        return;
+    if (ring == NULL) {
+        ring = shmring_create (ring_name, RING_SLOTS, length > slot_size ? length : slot_size,
+                               image_width, image_height, pixelformat, bytesperline);
+        if (ring == NULL) {
+            fprintf (stderr, "Unable to create ring %s, not publishing\n", ring_name);
+            ring_name = NULL;
+            return;
+        }
+        printf ("publishing frames in ring %s\n", ring_name);
+    }
+
+    if (shmring_write (ring, p, length, sequence, ts) < 0)
+        fprintf (stderr, "Frame of %u bytes does not fit ring %s\n", (unsigned int)length,
+                 ring_name);
+}
+
+//
+// The preview is scaled from the captured buffer straight into the ring
+// slot.
+//
+static void publish_preview (const void * p, unsigned int sequence, unsigned long long ts)
+{
+struct conv_image img;
+
+    if (preview_name == NULL)
+        return;
+    if (preview_ring == NULL) {
+        img.data = NULL;
+        img.width = image_width;
+        img.height = image_height;
+        img.stride = bytesperline;
+        img.fourcc = pixelformat;
+        if (scaler_init (&preview_scaler, &img, preview_factor) < 0) {
+            fprintf (stderr, "No 1/%u preview of this format and size\n", preview_factor);
+            preview_name = NULL;
+            return;
+        }
+        preview_ring = shmring_create (preview_name, RING_SLOTS, preview_scaler.size,
+                                       preview_scaler.dst.width, preview_scaler.dst.height,
+                                       preview_scaler.dst.fourcc, preview_scaler.dst.stride);
+        if (preview_ring == NULL) {
+            fprintf (stderr, "Unable to create ring %s, no preview\n", preview_name);
+            scaler_free (&preview_scaler);
+            preview_name = NULL;
+            return;
+        }
+        printf ("publishing %ux%u previews in ring %s\n", preview_scaler.dst.width,
+                preview_scaler.dst.height, preview_name);
+    }
+
+    scaler_run (&preview_scaler, p, shmring_begin (preview_ring));
+    shmring_commit (preview_ring, preview_scaler.size, sequence, ts);
+}
+
+static void output_frame (const void * p, size_t length, unsigned int sequence,
+                          unsigned long long ts)
+{
+    if (motion_threshold >= 0 && record_name)
+        motion_record (p, length, sequence, ts);
+    else
+        record_frame (p, length, sequence, ts);
+    publish_frame (p, length, sequence, ts);
+    publish_preview (p, sequence, ts);
+}
+
+//***********************************************************************************
+// Pipeline callbacks.  The capture thread only dequeues and submits, the
+// frame goes back to the driver from whichever thread drops the last
+// reference.
+//
+static void pipe_release (struct pipe_frame * frame, void * priv)
+{
+struct v4l2_buffer buf;
+
+    // The frame to save may have been shed by a drop-oldest stage.
+    if ((frame->flags & FRAME_SAVE) && !bok)
+        process_image (frame->data);
+
+    CLEAR (buf);
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = frame->index;
+    if (-1 == ioctl (fd, VIDIOC_QBUF, &buf))
+        fprintf (stderr, "pipe_release: VIDIOC_QBUF error %d, %s\n",
+                 errno, strerror (errno));
+}
+
+static int pipe_analyze (struct pipe_frame * frame, void * priv)
+{
+const unsigned char *p = frame->data;
+unsigned long long sum = 0;
+struct fstats_config cfg;
+struct conv_image img;
+struct fstats s;
+unsigned int n;
+size_t i;
+
+    // YUYV and Bayer get the real statistics, on the luma or green.
+    img.data = frame->data;
+    img.width = image_width;
+    img.height = image_height;
+    img.stride = bytesperline;
+    img.fourcc = pixelformat;
+    fstats_defaults (&cfg, pixelformat);
+    cfg.step_x = stats_step;
+    cfg.step_y = stats_step;
+    if (fstats_frame (&img, &cfg, &s) == 0) {
+        enum fstats_channel ch = s.channels & (1u << FSTATS_Y) ? FSTATS_Y : FSTATS_G;
+
+        n = s.samples[FSTATS_Y] + s.samples[FSTATS_R] + s.samples[FSTATS_G] +
+            s.samples[FSTATS_B];
+        last_mean = fstats_mean (&s, ch) + 0.5f;
+        last_over = n ? (unsigned long long)s.over * 1000 / n : 0;
+        last_under = n ? (unsigned long long)s.under * 1000 / n : 0;
+        return 0;
+    }
+
+    for (i = 0; i < frame->length; ++i)
+        sum += p[i];
+    if (frame->length)
+        last_mean = sum / frame->length;
+
+    return 0;
+}
+
+//***********************************************************************************
+// Convert into the buffer belonging to the frame's MMAP buffer.  A buffer
+// is in flight at most once, so the workers never share an output.
+//
+static int pipe_convert (struct pipe_frame * frame, void * priv)
+{
+struct conv_image img;
+
+    img.data = frame->data;
+    img.width = image_width;
+    img.height = image_height;
+    img.stride = bytesperline;
+    img.fourcc = pixelformat;
+    if (conv_frame (&img, convert_to, conv_bufs[frame->index]) < 0)
+        return -1;
+
+    frame->priv = conv_bufs[frame->index];
+    return 0;
+}
+
+//
+// Recording, motion detection and the shared memory rings need every frame
+// in capture order, they run on the first stage, before anything can shed.
+//
+static int pipe_output (struct pipe_frame * frame, void * priv)
+{
+    output_frame (frame->data, frame->length, frame->sequence, frame->ts);
+    return 0;
+}
+
+static int pipe_save (struct pipe_frame * frame, void * priv)
+{
+    if (frame->flags & FRAME_SAVE) {
+        process_image (frame->data);
+        if (frame->priv)
+            memcpy (conv_save, frame->priv, conv_size);
+    }
+    else {
+        fputc ('.', stdout);
+        fflush (stdout);
+    }
+
+    return 0;
+}
+
+//***********************************************************************************
+// Allocate the conversion outputs and check the conversion on the first
+// buffer, so an unsupported -X fails here rather than dropping every frame.
+//
+static void init_convert (void)
+{
+struct conv_image img;
+unsigned int i;
+
+    conv_size = conv_frame_size (convert_to, image_width, image_height);
+    img.data = buffers[0].start;
+    img.width = image_width;
+    img.height = image_height;
+    img.stride = bytesperline;
+    img.fourcc = pixelformat;
+
+    conv_bufs = calloc (n_buffers, sizeof (*conv_bufs));
+    if (conv_save == NULL)
+        conv_save = calloc (1, conv_size);
+    if (conv_bufs == NULL || conv_save == NULL) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < n_buffers; ++i) {
+        conv_bufs[i] = malloc (conv_size);
+        if (conv_bufs[i] == NULL) {
+            fprintf (stderr, "Out of memory\n");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    if (conv_size == 0 || conv_frame (&img, convert_to, conv_bufs[0]) < 0) {
+        fprintf (stderr, "Cannot convert format 0x%x %ux%u to %s\n", pixelformat,
+                 image_width, image_height, conv_format_name (convert_to));
+        exit (EXIT_FAILURE);
+    }
+}
+
+//***********************************************************************************
+static void init_pipeline (void)
+{
+unsigned int i;
+
+    if (io != IO_METHOD_MMAP) {
+        fprintf (stderr, "-j requires MMAP i/o\n");
+        exit (EXIT_FAILURE);
+    }
+
+    pipe_frames = calloc (n_buffers, sizeof (*pipe_frames));
+    frame_pipe = pipeline_create (pipe_release, NULL);
+    if (pipe_frames == NULL || frame_pipe == NULL) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = 0; i < n_buffers; ++i) {
+        pipe_frames[i].data = buffers[i].start;
+        pipe_frames[i].index = i;
+    }
+
+    if (convert_to >= 0)
+        init_convert ();
+
+    // The output stage has one worker and blocks, so the recorder and the
+    // rings get every frame in order; when it falls behind, frames wait in
+    // the driver.  The processing stages after it shed load rather than
+    // stalling DQBUF, the save sink must see the frames it is asked to save.
+    if (((record_name || ring_name || preview_name) &&
+         pipeline_add_stage (frame_pipe, "output", pipe_output, NULL, 1,
+                             n_buffers, PIPE_BLOCK) < 0) ||
+        (convert_to >= 0 &&
+         pipeline_add_stage (frame_pipe, "convert", pipe_convert, NULL, pipe_workers,
+                             n_buffers / 2, PIPE_DROP_OLDEST) < 0) ||
+        pipeline_add_stage (frame_pipe, "analyze", pipe_analyze, NULL, pipe_workers,
+                            n_buffers / 2, PIPE_DROP_OLDEST) < 0 ||
+        pipeline_add_sink (frame_pipe, "save", pipe_save, NULL, 1,
+                           2, PIPE_BLOCK) < 0 ||
+        pipeline_start (frame_pipe) < 0) {
+        fprintf (stderr, "Unable to set up the pipeline\n");
+        exit (EXIT_FAILURE);
+    }
+}
+
+//***********************************************************************************
+static void uninit_pipeline (void)
+{
+unsigned int i;
+
+    pipeline_stop (frame_pipe);
+    pipeline_report (frame_pipe, stdout);
+    printf ("last analyzed frame: mean %u, %u.%u%% clipped, %u.%u%% black\n", last_mean,
+            last_over / 10, last_over % 10, last_under / 10, last_under % 10);
+    pipeline_destroy (frame_pipe);
+    frame_pipe = NULL;
+    free (pipe_frames);
+    pipe_frames = NULL;
+
+    if (conv_bufs) {
+        for (i = 0; i < n_buffers; ++i)
+            free (conv_bufs[i]);
+        free (conv_bufs);
+        conv_bufs = NULL;
+    }
+}
+
 //***********************************************************************************
 int read_frame (int bprocess)
 {
@@ -182,6 +773,9 @@ unsigned int lock_flag;
                 }
             }
 
+            if (benchmark)
+                consume_frame (buffers[0].start, buffers[0].length);
+            output_frame (buffers[0].start, lret, read_sequence++, now_us ());
             if (bprocess) {
                 process_image (buffers[0].start);
             }
@@ -212,6 +806,25 @@ unsigned int lock_flag;
 	    if(buf_idx >= n_actualbuffers) buf_idx=0;
             assert (buf.index < n_buffers);
 
+            if (frame_pipe) {
+                struct pipe_frame *pf = &pipe_frames[buf.index];
+
+                pf->length = buf.bytesused ? buf.bytesused : buffers[buf.index].length;
+                pf->sequence = buf.sequence;
+                pf->ts = (unsigned long long)buf.timestamp.tv_sec * 1000000 +
+                         buf.timestamp.tv_usec;
+                pf->flags = bprocess ? FRAME_SAVE : 0;
+                pf->priv = NULL;
+                pipeline_submit (frame_pipe, pf);
+                break;
+            }
+
+            if (benchmark)
+                consume_frame (buffers[buf.index].start, buffers[buf.index].length);
+            output_frame (buffers[buf.index].start,
+                          buf.bytesused ? buf.bytesused : buffers[buf.index].length,
+                          buf.sequence, (unsigned long long)buf.timestamp.tv_sec * 1000000 +
+                          buf.timestamp.tv_usec);
             if (bprocess) {
                 process_image(buffers[buf.index].start);
             }
@@ -253,6 +866,11 @@ unsigned int lock_flag;
 
             assert (i < n_buffers);
 
+            if (benchmark)
+                consume_frame ((void *) buf.m.userptr, buf.length);
+            output_frame ((void *) buf.m.userptr, buf.bytesused ? buf.bytesused : buf.length,
+                          buf.sequence, (unsigned long long)buf.timestamp.tv_sec * 1000000 +
+                          buf.timestamp.tv_usec);
             if (bprocess) {
                 process_image ((void *) buf.m.userptr);
             }
@@ -275,7 +893,7 @@ unsigned int lock_flag;
 //
 void mainloop (void)
 {
-unsigned int count = CAPCOUNT;
+unsigned int count = capture_count;
 struct v4l2_control v4l2c;
 unsigned int val = 0x0000000;
 unsigned int btimeout = 0;
@@ -406,6 +1024,20 @@ enum v4l2_buf_type type;
     }
 }
 
+//***********************************************************************************
+static void free_driver_buffers (enum v4l2_memory memory)
+{
+struct v4l2_requestbuffers req;
+
+    // Release the driver side so that the next VIDIOC_REQBUFS may switch
+    // between MMAP and USERPTR.
+    CLEAR (req);
+    req.count = 0;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = memory;
+    xioctl (fd, VIDIOC_REQBUFS, &req);
+}
+
 //***********************************************************************************
 static void uninit_device (void)
 {
@@ -414,6 +1046,7 @@ unsigned int i;
     switch (io) {
         case IO_METHOD_READ:
             free (buffers[0].start);
+            free (buffers);
             break;
 
         case IO_METHOD_MMAP:
@@ -421,16 +1054,21 @@ unsigned int i;
                 if (-1 == munmap (buffers[i].start, buffers[i].length))
                     errno_exit ("munmap");
 
+            free (buffers);
+            free_driver_buffers (V4L2_MEMORY_MMAP);
             break;
 
         case IO_METHOD_USERPTR:
-            for (i = 0; i < n_buffers; ++i)
-                free (buffers[i].start);
+            // The memory stays in the pool for the next init_userp().
+            free_driver_buffers (V4L2_MEMORY_USERPTR);
             break;
 
+        default:
+            break;
     }
 
-    free (buffers);
+    buffers = NULL;
+    n_buffers = 0;
 }
 
 //***********************************************************************************
@@ -455,7 +1093,7 @@ static void init_mmap (void)
 struct v4l2_requestbuffers req;
 
     CLEAR (req);
-    req.count = 4;
+    req.count = req_count;
     req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_MMAP;
 
@@ -511,7 +1149,7 @@ static void init_userp (unsigned int buffer_size)
 struct v4l2_requestbuffers req;
 
     CLEAR (req);
-    req.count = 4;
+    req.count = req_count;
     req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_USERPTR;
 
@@ -524,20 +1162,22 @@ struct v4l2_requestbuffers req;
         }
     }
 
-    buffers = calloc (4, sizeof (*buffers));
-    if (!buffers) {
+    // The driver may have adjusted the count, use what it granted.
+    if (req.count == 0)
+        req.count = req_count;
+
+    if (-1 == bufpool_get (&pool, req.count, buffer_size, pool_flags)) {
         fprintf (stderr, "Out of memory\n");
         exit (EXIT_FAILURE);
     }
 
-    for (n_buffers = 0; n_buffers < 4; ++n_buffers) {
-        buffers[n_buffers].length = buffer_size;
-        buffers[n_buffers].start = malloc (buffer_size);
-        if (!buffers[n_buffers].start) {
-            fprintf (stderr, "Out of memory\n");
-            exit (EXIT_FAILURE);
-        }
-    }
+    printf ("USERPTR pool: %u x %u bytes, %s%s\n", pool.count, buffer_size,
+            bufpool_backing_name (pool.backing),
+            pool.reuses ? " (reused)" : "");
+
+    buffers = pool.bufs;
+    n_buffers = pool.count;
+    n_actualbuffers = pool.count;
 
     return;
 }
@@ -672,6 +1312,11 @@ unsigned int min;
         min = fmt.fmt.pix.bytesperline * fmt.fmt.pix.height;
         if (fmt.fmt.pix.sizeimage < min)
             fmt.fmt.pix.sizeimage = min;
+
+        bytesperline = fmt.fmt.pix.bytesperline;
+        image_width = fmt.fmt.pix.width;
+        pixelformat = fmt.fmt.pix.pixelformat;
+        image_height = fmt.fmt.pix.height;
         
         switch (io) {
             case IO_METHOD_READ:
@@ -724,11 +1369,181 @@ struct stat st;
 }
 
 
+//***********************************************************************************
+// Demosaic the saved Bayer frame and write it as a binary PPM.
+//
+static void save_rgb (void)
+{
+struct bayer_image img;
+unsigned char *rgb;
+FILE *hFile;
+long ncpu;
+
+    if (bayer_from_fourcc (pixelformat, &img.order, &img.bits) < 0) {
+        printf ("save_rgb: format 0x%x is not Bayer\n", pixelformat);
+        return;
+    }
+
+    img.data = save_buf;
+    img.width = image_width;
+    img.height = image_height;
+    img.stride = bytesperline;
+    if ((size_t)img.stride * img.height > SIZEOFIMAGE) {
+        printf ("save_rgb: frame larger than the saved image\n");
+        return;
+    }
+
+    rgb = malloc ((size_t)img.width * img.height * 3);
+    if (rgb == NULL) {
+        printf ("save_rgb: out of memory\n");
+        return;
+    }
+
+    ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+    if (bayer_demosaic (&img, rgb, img.width * 3, demosaic, ncpu > 0 ? ncpu : 1) < 0) {
+        printf ("save_rgb: demosaic failed\n");
+    } else if ((hFile = fopen (RGBFILENAME, "wb")) == NULL) {
+        printf ("save_rgb: unable to open the file\n");
+    } else {
+        fprintf (hFile, "P6\n%u %u\n255\n", img.width, img.height);
+        fwrite (rgb, 3, (size_t)img.width * img.height, hFile);
+        fclose (hFile);
+    }
+
+    free (rgb);
+}
+
+//***********************************************************************************
+static void save_converted (void)
+{
+char name[64];
+FILE *hFile;
+
+    snprintf (name, sizeof (name), CONVFILENAME, conv_format_name (convert_to));
+    if ((hFile = fopen (name, "wb")) == NULL) {
+        printf ("save_converted: unable to open the file\n");
+        return;
+    }
+    if (fwrite (conv_save, 1, conv_size, hFile) != conv_size)
+        printf ("save_converted: unable to write the file\n");
+    fclose (hFile);
+}
+
+//***********************************************************************************
+// Write a 10 or 12-bit frame MIPI packed instead of in 16-bit containers.
+// Returns -1 for other formats, the caller then saves the plain frame.
+//
+static int save_packed (void)
+{
+struct conv_image img;
+enum bayer_order order;
+enum conv_format fmt;
+unsigned int bits;
+unsigned char *out;
+char name[64];
+FILE *hFile;
+size_t size;
+
+    if (bayer_from_fourcc (pixelformat, &order, &bits) < 0 || (bits != 10 && bits != 12)) {
+        printf ("save_packed: format 0x%x is not 10 or 12-bit Bayer, saving unpacked\n",
+                pixelformat);
+        return -1;
+    }
+
+    fmt = bits == 10 ? CONV_RAW10P : CONV_RAW12P;
+    img.data = save_buf;
+    img.width = image_width;
+    img.height = image_height;
+    img.stride = bytesperline;
+    img.fourcc = pixelformat;
+    if ((size_t)img.stride * img.height > SIZEOFIMAGE) {
+        printf ("save_packed: frame larger than the saved image\n");
+        return -1;
+    }
+
+    size = conv_frame_size (fmt, img.width, img.height);
+    out = malloc (size);
+    if (out == NULL || conv_frame (&img, fmt, out) < 0) {
+        free (out);
+        return -1;
+    }
+
+    snprintf (name, sizeof (name), CONVFILENAME, conv_format_name (fmt));
+    if ((hFile = fopen (name, "wb")) == NULL) {
+        printf ("save_packed: unable to open the file\n");
+    } else {
+        if (fwrite (out, 1, size, hFile) != size)
+            printf ("save_packed: unable to write the file\n");
+        fclose (hFile);
+    }
+
+    free (out);
+    return 0;
+}
+
+//***********************************************************************************
+// Write a Bayer frame through the lossless codec, one tile per CPU.
+// Returns -1 for other formats, the caller then saves the plain frame.
+//
+static int save_compressed (void)
+{
+struct bayer_image img;
+unsigned char *out;
+FILE *hFile;
+long ncpu, size;
+
+    if (bayer_from_fourcc (pixelformat, &img.order, &img.bits) < 0) {
+        printf ("save_compressed: format 0x%x is not Bayer, saving uncompressed\n",
+                pixelformat);
+        return -1;
+    }
+
+    img.data = save_buf;
+    img.width = image_width;
+    img.height = image_height;
+    img.stride = bytesperline;
+    if ((size_t)img.stride * img.height > SIZEOFIMAGE) {
+        printf ("save_compressed: frame larger than the saved image\n");
+        return -1;
+    }
+
+    ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1)
+        ncpu = 1;
+    out = malloc (rawcodec_bound (img.width, img.height, img.bits, 4 * ncpu));
+    if (out == NULL)
+        return -1;
+
+    size = rawcodec_encode (&img, out, 4 * ncpu, ncpu);
+    if (size < 0) {
+        free (out);
+        return -1;
+    }
+
+    if ((hFile = fopen (RBCFILENAME, "wb")) == NULL) {
+        printf ("save_compressed: unable to open the file\n");
+    } else {
+        if (fwrite (out, 1, size, hFile) != (size_t)size)
+            printf ("save_compressed: unable to write the file\n");
+        fclose (hFile);
+        printf ("saved %ld bytes, %.2f:1\n", size,
+                (double)img.stride * img.height / size);
+    }
+
+    free (out);
+    return 0;
+}
+
 //***********************************************************************************
 void saveimage(void)
 {
 FILE *hFile;
 
+    if (compress_raw && save_compressed () == 0)
+        goto si_extra;
+    if (packed_raw && save_packed () == 0)
+        goto si_extra;
+
     if((hFile = fopen (CAPFILENAME, "wb")) == NULL) {
         printf("saveimage: unable to open the file\n");
         goto si_out;
@@ -741,11 +1556,122 @@ FILE *hFile;
 
     fclose (hFile);
 
+si_extra:
+    if (demosaic >= 0)
+        save_rgb ();
+    if (conv_save)
+        save_converted ();
+
 si_out:
     return;
 }
 
 
+//***********************************************************************************
+// Run the capture loop with io method m and report frame rate and consumer
+// cost.  restarts + 1 streaming runs are made, each with a full
+// uninit/init cycle so that buffer allocation cost shows up as well.
+//
+static void bench_run (io_method m, const char * label)
+{
+unsigned long long start, elapsed, setup = 0, t;
+unsigned int run, frames = 0;
+
+    io = m;
+    bench_touch_us = 0;
+    bench_frames = 0;
+
+    start = now_us ();
+    for (run = 0; run <= restarts; ++run) {
+        t = now_us ();
+        init_device ();
+        setup += now_us () - t;
+
+        start_capturing ();
+        mainloop ();
+        stop_capturing ();
+        frames += capture_count;
+
+        t = now_us ();
+        uninit_device ();
+        setup += now_us () - t;
+    }
+    elapsed = now_us () - start;
+
+    printf ("\n%-8s %u runs, %u frames in %llu ms (%.2f fps)\n", label,
+            restarts + 1, frames, elapsed / 1000,
+            elapsed ? frames * 1000000.0 / elapsed : 0.0);
+    printf ("%-8s buffer setup/teardown %llu us per run\n", label,
+            setup / (restarts + 1));
+    if (bench_frames)
+        printf ("%-8s consumer pass %llu us per frame (%u frames)\n", label,
+                bench_touch_us / bench_frames, bench_frames);
+}
+
+//***********************************************************************************
+static void run_benchmark (void)
+{
+    bench_run (IO_METHOD_MMAP, "mmap");
+    bench_run (IO_METHOD_USERPTR, "userptr");
+    if (pool.backing != BUFPOOL_BACKING_NONE)
+        printf ("userptr  pool backing: %s, %u allocation(s), %u reuse(s)\n",
+                bufpool_backing_name (pool.backing), pool.allocs, pool.reuses);
+}
+
+//***********************************************************************************
+// Matched set callback: the last set is written to one file per device,
+// straight from the mmap buffers.
+//
+static void multi_set (struct multicap * mc, unsigned int set,
+                       const struct multicap_frame * frames, void * priv)
+{
+char name[64];
+FILE *hFile;
+unsigned int i;
+
+    fputc ('.', stdout);
+    fflush (stdout);
+
+#ifdef SAVECAPFRAME
+    if (set + 1 != capture_count)
+        return;
+
+    for (i = 0; i < mc->count; ++i) {
+        snprintf (name, sizeof (name), "./capture_image_%u.raw", i);
+        if ((hFile = fopen (name, "wb")) == NULL) {
+            printf ("multi_set: unable to open %s\n", name);
+            continue;
+        }
+        if (fwrite (frames[i].start, 1, frames[i].bytesused, hFile) != frames[i].bytesused)
+            printf ("multi_set: unable to write %s\n", name);
+        fclose (hFile);
+    }
+#endif
+}
+
+//***********************************************************************************
+static void run_multi (void)
+{
+struct multicap mc;
+struct multicap_format format;
+
+    format.width = TARGETWIDTH;
+    format.height = TARGETHEIGHT;
+    format.pixelformat = PIXELFMT;
+    format.nbufs = req_count;
+
+    if (multicap_open (&mc, multi_names, multi_count, &format, sync_tolerance) < 0 ||
+        multicap_start (&mc) < 0) {
+        multicap_close (&mc);
+        exit (EXIT_FAILURE);
+    }
+
+    multicap_run (&mc, capture_count, multi_set, NULL);
+    multicap_stop (&mc);
+    multicap_report (&mc, stdout);
+    multicap_close (&mc);
+}
+
 //***********************************************************************************
 static void usage (FILE * fp, int argc, char ** argv)
 {
@@ -757,11 +1683,32 @@ static void usage (FILE * fp, int argc, char ** argv)
         "-r | --read Use read() calls\n"
         "-e | --exposure Set the exposure\n"
         "-g | --gain Set the Analog gain\n"
-        "-u | --userp Use application allocated buffers\n", argv[0]);
+        "-u | --userp Use application allocated buffers\n"
+        "-n | --nbufs count Number of buffers to request [4]\n"
+        "-H | --hugepages Back USERPTR buffers with huge pages (hugetlb, then THP)\n"
+        "-c | --count frames Frames to capture per run [%d]\n"
+        "-R | --restarts n Stop and restart streaming n times, reusing buffers\n"
+        "-b | --benchmark Compare MMAP buffers against the USERPTR pool\n"
+        "-M | --multi dev,dev,... Stream several devices, match frames by timestamp\n"
+        "-T | --tolerance us Timestamp tolerance for matched sets [1000]\n"
+        "-j | --jobs n Run frame analysis on n worker threads (MMAP only)\n"
+        "-C | --demosaic bilinear|edge Also save Bayer captures as RGB (" RGBFILENAME ")\n"
+        "-X | --convert fmt Convert frames on the pipeline workers and save the result\n"
+        "                   (i420, nv12, rgb24, raw8, raw10p, raw12p; MMAP only)\n"
+        "-P | --packed Save 10/12-bit Bayer frames MIPI packed (capture_image.raw10p)\n"
+        "-Z | --compress Save Bayer frames losslessly compressed (" RBCFILENAME ")\n"
+        "-o | --output file Record every frame with its metadata (see captool)\n"
+        "-S | --share name Publish every frame in shared memory ring name (see shmcat)\n"
+        "-A | --stats step Subsample the -j frame statistics every step pixels [4]\n"
+        "-D | --detect threshold With -o, record only around motion (threshold ~12)\n"
+        "-B | --preroll frames Frames kept in memory before motion [15, or what fits]\n"
+        "-V | --preview name Publish a downscaled preview in shared memory ring name\n"
+        "-F | --preview-scale 2|4 Preview downscale factor [4]\n",
+        argv[0], CAPCOUNT);
 }
 
 
-static const char short_options [] = "d:hmrue:g:";
+static const char short_options [] = "d:hmrue:g:n:Hc:R:bM:T:j:C:X:PZo:S:A:D:B:V:F:";
 
 static const struct option
 
@@ -773,6 +1720,25 @@ long_options [] = {
     { "userp", no_argument, NULL, 'u' },
     { "exposure", required_argument, NULL, 'e' },
     { "gain", required_argument, NULL, 'g'},
+    { "nbufs", required_argument, NULL, 'n' },
+    { "hugepages", no_argument, NULL, 'H' },
+    { "count", required_argument, NULL, 'c' },
+    { "restarts", required_argument, NULL, 'R' },
+    { "benchmark", no_argument, NULL, 'b' },
+    { "multi", required_argument, NULL, 'M' },
+    { "tolerance", required_argument, NULL, 'T' },
+    { "jobs", required_argument, NULL, 'j' },
+    { "demosaic", required_argument, NULL, 'C' },
+    { "convert", required_argument, NULL, 'X' },
+    { "packed", no_argument, NULL, 'P' },
+    { "compress", no_argument, NULL, 'Z' },
+    { "output", required_argument, NULL, 'o' },
+    { "share", required_argument, NULL, 'S' },
+    { "stats", required_argument, NULL, 'A' },
+    { "detect", required_argument, NULL, 'D' },
+    { "preroll", required_argument, NULL, 'B' },
+    { "preview", required_argument, NULL, 'V' },
+    { "preview-scale", required_argument, NULL, 'F' },
     { 0, 0, 0, 0 }
 };
 
@@ -828,18 +1794,136 @@ int i;
                 io = IO_METHOD_SETGAIN;
                 gain = atoi(optarg);
                 break;
+            case 'n':
+                req_count = atoi(optarg);
+                if (req_count < 1)
+                    req_count = 1;
+                break;
+            case 'H':
+                pool_flags = BUFPOOL_HUGETLB | BUFPOOL_THP;
+                break;
+            case 'c':
+                capture_count = atoi(optarg);
+                break;
+            case 'R':
+                restarts = atoi(optarg);
+                break;
+            case 'b':
+                benchmark = 1;
+                break;
+            case 'M':
+                for (multi_count = 0; multi_count < MULTICAP_MAX_DEVICES; ) {
+                    multi_names[multi_count++] = optarg;
+                    optarg = strchr (optarg, ',');
+                    if (optarg == NULL)
+                        break;
+                    *optarg++ = '\0';
+                }
+                break;
+            case 'T':
+                sync_tolerance = atoi(optarg);
+                break;
+            case 'C':
+                demosaic = strcmp (optarg, "edge") ? BAYER_BILINEAR : BAYER_EDGE;
+                break;
+            case 'j':
+                pipe_workers = atoi(optarg);
+                if (pipe_workers > PIPE_MAX_WORKERS)
+                    pipe_workers = PIPE_MAX_WORKERS;
+                // Queue depth + workers + sink may all hold buffers.
+                if (req_count < 2 * pipe_workers + 4)
+                    req_count = 2 * pipe_workers + 4;
+                break;
+            case 'P':
+                packed_raw = 1;
+                break;
+            case 'Z':
+                compress_raw = 1;
+                break;
+            case 'o':
+                record_name = optarg;
+                break;
+            case 'S':
+                ring_name = optarg;
+                break;
+            case 'A':
+                stats_step = atoi(optarg);
+                if (stats_step < 1)
+                    stats_step = 1;
+                break;
+            case 'D':
+                motion_threshold = atoi(optarg);
+                if (motion_threshold < 0)
+                    motion_threshold = 0;
+                break;
+            case 'B':
+                preroll_frames = atoi(optarg);
+                if (preroll_frames < 0)
+                    preroll_frames = 0;
+                break;
+            case 'V':
+                preview_name = optarg;
+                break;
+            case 'F':
+                preview_factor = atoi(optarg) == 2 ? 2 : 4;
+                break;
+            case 'X':
+                convert_to = conv_format_from_name (optarg);
+                if (convert_to < 0) {
+                    fprintf (stderr, "Unknown conversion %s\n", optarg);
+                    exit (EXIT_FAILURE);
+                }
+                break;
             default:
                 usage (stderr, argc, argv);
                 exit (EXIT_FAILURE);
         }
     }
 
+    // Conversion runs on the pipeline, one worker unless -j asked for more.
+    if (convert_to >= 0 && pipe_workers == 0) {
+        pipe_workers = 1;
+        if (req_count < 6)
+            req_count = 6;
+    }
+
+    if (multi_count) {
+        run_multi ();
+        printf("\n");
+        exit (EXIT_SUCCESS);
+    }
+
     open_device ();
-    init_device ();
-    start_capturing ();
-    mainloop ();
-    stop_capturing ();
+
+    if (benchmark) {
+        run_benchmark ();
+        bufpool_release (&pool);
+        close_device ();
+        printf("\n");
+        exit (EXIT_SUCCESS);
+    }
+
+    for (i = 0; i <= restarts; ++i) {
+        if (i)
+            uninit_device ();
+        init_device ();
+        check_preroll ();
+        if (pipe_workers)
+            init_pipeline ();
+        start_capturing ();
+        mainloop ();
+        if (frame_pipe)
+            uninit_pipeline ();
+        stop_capturing ();
+    }
+
+    close_recorder ();
+    close_motion ();
+    shmring_destroy (ring);
+    shmring_destroy (preview_ring);
+    scaler_free (&preview_scaler);
     uninit_device ();
+    bufpool_release (&pool);
     close_device ();
 
     if (bok) {
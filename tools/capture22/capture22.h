@@ -0,0 +1,25 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Definitions shared between capture22.c and its helper modules.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __CAPTURE22_H
+#define __CAPTURE22_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define CLEAR(x) memset (&(x), 0, sizeof (x))
+
+struct buffer {
+    void * start;
+    size_t length;
+};
+
+int xioctl (int fd, int request, void * arg);
+
+#endif /* __CAPTURE22_H */
@@ -0,0 +1,235 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Lossless Bayer codec benchmark.
+//
+// Encodes and decodes a synthetic frame at several bit depths with one
+// thread and with the requested number of threads, reports the
+// compression ratio and Mpix/s of both directions and checks that the
+// decoded frame equals the input.  The slowest encode and decode with one
+// thread are compared with the rate the sensor frame rate needs: the
+// BeagleBoard has a single core, more threads don't help it.  Exits non-zero
+// on a mismatch or when either direction falls short.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "rawcodec.h"
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//***********************************************************************************
+// Smooth gradients with a different gain per colour, sensor-like noise of
+// noise LSBs and a few hard edges.
+//
+static void fill_frame (struct bayer_image * img, void * data, unsigned int noise)
+{
+unsigned int x, y, v, max = (1u << img->bits) - 1;
+
+    srand (1);
+    for (y = 0; y < img->height; ++y) {
+        for (x = 0; x < img->width; ++x) {
+            v = ((x + y) << (img->bits - 8)) / 12 * (2 + (x & 1) + (y & 1)) / 2;
+            if ((x / 97 + y / 83) & 1)
+                v = v / 2 + (max >> 3);
+            v += noise ? rand () % noise : 0;
+            if (v > max)
+                v = max;
+
+            if (img->bits > 8)
+                ((unsigned short *)data)[y * img->stride / 2 + x] = v;
+            else
+                ((unsigned char *)data)[y * img->stride + x] = v;
+        }
+    }
+}
+
+//***********************************************************************************
+static double mpix (const struct bayer_image * img, unsigned int iter, unsigned long long us)
+{
+    return us ? (double)img->width * img->height * iter / us : 0.0;
+}
+
+//
+// Runs one frame type, lowers *enc and *dec to its one thread rates.
+//
+static int bench (unsigned int width, unsigned int height, unsigned int bits,
+                  unsigned int noise, unsigned int tiles, unsigned int threads,
+                  unsigned int iter, double * enc, double * dec)
+{
+struct bayer_image img;
+size_t frame, bound;
+unsigned char *raw, *stream, *out;
+unsigned long long t;
+double enc1, encn, dec1, decn;
+long size = 0;
+unsigned int i;
+int ret = 0;
+
+    img.width = width;
+    img.height = height;
+    img.bits = bits;
+    img.stride = width * (bits > 8 ? 2 : 1);
+    img.order = BAYER_GRBG;
+    frame = (size_t)img.stride * height;
+    bound = rawcodec_bound (width, height, bits, tiles);
+
+    raw = malloc (frame);
+    out = malloc (frame);
+    stream = malloc (bound);
+    if (!raw || !out || !stream) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    fill_frame (&img, raw, noise);
+    img.data = raw;
+
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        size = rawcodec_encode (&img, stream, tiles, 1);
+    enc1 = mpix (&img, iter, mono_us () - t);
+
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        size = rawcodec_encode (&img, stream, tiles, threads);
+    encn = mpix (&img, iter, mono_us () - t);
+
+    if (size < 0) {
+        printf ("%2u-bit encode failed\n", bits);
+        ret = -1;
+        goto out;
+    }
+
+    memset (out, 0, frame);
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        ret |= rawcodec_decode (stream, size, out, img.stride, 1);
+    dec1 = mpix (&img, iter, mono_us () - t);
+    if (memcmp (raw, out, frame))
+        ret = -1;
+
+    memset (out, 0, frame);
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        ret |= rawcodec_decode (stream, size, out, img.stride, threads);
+    decn = mpix (&img, iter, mono_us () - t);
+    if (memcmp (raw, out, frame))
+        ret = -1;
+
+    printf ("%2u-bit noise %-4u %6.2f %6.2f %8.1f %8.1f %8.1f %8.1f   %s\n", bits, noise,
+            (double)frame / size, (double)size * 8 / ((double)width * height),
+            enc1, encn, dec1, decn, ret ? "FAIL" : "lossless");
+
+    if (enc1 < *enc)
+        *enc = enc1;
+    if (dec1 < *dec)
+        *dec = dec1;
+
+out:
+    free (raw);
+    free (out);
+    free (stream);
+    return ret;
+}
+
+//***********************************************************************************
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options]\n\n Options:\n"
+        "-w | --width n Frame width [2592]\n"
+        "-h | --height n Frame height [1944]\n"
+        "-t | --threads n Worker threads [4]\n"
+        "-T | --tiles n Row tiles per frame [16]\n"
+        "-i | --iterations n Frames per measurement [5]\n"
+        "-f | --fps n Sensor frame rate to keep up with, 0 for none [14]\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "width", required_argument, NULL, 'w' },
+    { "height", required_argument, NULL, 'h' },
+    { "threads", required_argument, NULL, 't' },
+    { "tiles", required_argument, NULL, 'T' },
+    { "iterations", required_argument, NULL, 'i' },
+    { "fps", required_argument, NULL, 'f' },
+    { "help", no_argument, NULL, '?' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+unsigned int width = 2592, height = 1944, threads = 4, tiles = 16, iter = 5, fps = 14;
+double enc = 1e30, dec = 1e30, need;
+int c, ret = 0;
+
+    while ((c = getopt_long (argc, argv, "w:h:t:T:i:f:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'w':
+                width = atoi (optarg);
+                break;
+            case 'h':
+                height = atoi (optarg);
+                break;
+            case 't':
+                threads = atoi (optarg);
+                break;
+            case 'T':
+                tiles = atoi (optarg);
+                break;
+            case 'i':
+                iter = atoi (optarg);
+                break;
+            case 'f':
+                fps = atoi (optarg);
+                break;
+            default:
+                usage (argv[0]);
+                return c == '?' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    printf ("raw codec %ux%u, %u tiles, %u threads, %u iterations\n\n", width, height,
+            tiles, threads, iter);
+    printf ("%-15s %6s %6s %8s %8s %8s %8s\n", "", "ratio", "bpp", "enc 1", "enc n",
+            "dec 1", "dec n");
+
+    ret |= bench (width, height, 8, 4, tiles, threads, iter, &enc, &dec);
+    ret |= bench (width, height, 10, 4, tiles, threads, iter, &enc, &dec);
+    ret |= bench (width, height, 10, 32, tiles, threads, iter, &enc, &dec);
+    ret |= bench (width, height, 12, 16, tiles, threads, iter, &enc, &dec);
+    ret |= bench (width, height, 12, 4096, tiles, threads, iter, &enc, &dec);
+    ret |= bench (width, height, 16, 64, tiles, threads, iter, &enc, &dec);
+
+    if (fps == 0)
+        return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    // The codec has to keep up with the slowest frame type.
+    need = (double)width * height * fps / 1e6;
+    printf ("\n%ux%u at %u fps needs %.1f Mpix/s per direction\n", width, height, fps,
+            need);
+    printf ("slowest encode %8.1f Mpix/s, %5.1f fps   %s\n", enc,
+            enc * 1e6 / ((double)width * height), enc >= need ? "ok" : "TOO SLOW");
+    printf ("slowest decode %8.1f Mpix/s, %5.1f fps   %s\n", dec,
+            dec * 1e6 / ((double)width * height), dec >= need ? "ok" : "TOO SLOW");
+
+    if (enc < need || dec < need) {
+        printf ("one thread misses the frame rate by %.0f%%\n",
+                100.0 * (need - (enc < dec ? enc : dec)) / need);
+        ret = -1;
+    }
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
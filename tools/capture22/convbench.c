@@ -0,0 +1,263 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Format conversion benchmark.
+//
+// Runs every conversion kernel on a synthetic frame with the plain C path
+// and with the vector path, reports Mpix/s and output MB/s of both and
+// checks that they produce the same bytes.  The RAW10/RAW12 unpackers are
+// checked by packing and unpacking a frame.  Exits non-zero on a mismatch.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+#include "convert.h"
+#include "simd.h"
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//***********************************************************************************
+// Random bytes cover the clamping corners of the YUV matrix, 16-bit
+// containers get stray bits above the sample depth.
+//
+static void fill_frame (unsigned char * data, size_t length)
+{
+size_t i;
+
+    srand (1);
+    for (i = 0; i < length; ++i)
+        data[i] = rand ();
+}
+
+static unsigned long long run (const struct conv_image * src, enum conv_format fmt,
+                               void * dst, unsigned int iter)
+{
+unsigned long long t = mono_us ();
+unsigned int i;
+
+    for (i = 0; i < iter; ++i)
+        conv_frame (src, fmt, dst);
+    return mono_us () - t;
+}
+
+//***********************************************************************************
+static int bench (const char * name, unsigned int fourcc, unsigned int bpp,
+                  enum conv_format fmt, unsigned int width, unsigned int height,
+                  unsigned int iter)
+{
+struct conv_image img;
+unsigned char *raw, *ref, *out;
+unsigned long long tref, tvec;
+double pix = (double)width * height * iter;
+size_t size = conv_frame_size (fmt, width, height);
+int ret = 0;
+
+    img.width = width;
+    img.height = height;
+    img.stride = width * bpp;
+    img.fourcc = fourcc;
+
+    raw = malloc ((size_t)img.stride * height);
+    ref = malloc (size);
+    out = malloc (size);
+    if (!raw || !ref || !out) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    fill_frame (raw, (size_t)img.stride * height);
+    img.data = raw;
+    memset (ref, 0, size);
+    memset (out, 0xff, size);
+
+    conv_use_vector (0);
+    if (conv_frame (&img, fmt, ref) < 0) {
+        printf ("%-18s unsupported\n", name);
+        ret = -1;
+        goto out;
+    }
+    tref = run (&img, fmt, ref, iter);
+
+    conv_use_vector (1);
+    tvec = run (&img, fmt, out, iter);
+    if (memcmp (ref, out, size))
+        ret = -1;
+
+    printf ("%-18s %8.1f %8.1f %8.1f %8.1f   %s\n", name,
+            tref ? pix / tref : 0.0, tvec ? pix / tvec : 0.0,
+            tref ? (double)size * iter / tref : 0.0,
+            tvec ? (double)size * iter / tvec : 0.0,
+            ret ? "FAIL" : "bit-exact");
+
+out:
+    free (raw);
+    free (ref);
+    free (out);
+    return ret;
+}
+
+//***********************************************************************************
+// Pack a frame, unpack it with the plain C and the fast path and check that
+// both give back the original samples.  Reports the unpack rates.
+//
+static void unpack_frame (const uint8_t * packed, uint16_t * out, unsigned int width,
+                          unsigned int height, unsigned int bits)
+{
+size_t stride = bits == 10 ? conv_raw10_packed_bytes (width) : conv_raw12_packed_bytes (width);
+unsigned int y;
+
+    for (y = 0; y < height; ++y) {
+        if (bits == 10)
+            conv_raw10p_to_raw16_row (packed + stride * y, out + (size_t)width * y, width);
+        else
+            conv_raw12p_to_raw16_row (packed + stride * y, out + (size_t)width * y, width);
+    }
+}
+
+static int roundtrip (const char * name, unsigned int fourcc, unsigned int bits,
+                      unsigned int width, unsigned int height, unsigned int iter)
+{
+enum conv_format fmt = bits == 10 ? CONV_RAW10P : CONV_RAW12P;
+size_t pixels = (size_t)width * height;
+size_t size = conv_frame_size (fmt, width, height);
+struct conv_image img;
+unsigned long long tref, tvec;
+uint16_t *raw, *ref, *out;
+uint8_t *packed;
+unsigned int i;
+size_t n;
+int ret = 0;
+
+    raw = malloc (pixels * 2);
+    ref = malloc (pixels * 2);
+    out = malloc (pixels * 2);
+    packed = malloc (size);
+    if (!raw || !ref || !out || !packed) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    fill_frame ((unsigned char *)raw, pixels * 2);
+    img.data = raw;
+    img.width = width;
+    img.height = height;
+    img.stride = width * 2;
+    img.fourcc = fourcc;
+    conv_use_vector (1);
+    conv_frame (&img, fmt, packed);
+
+    conv_use_vector (0);
+    tref = mono_us ();
+    for (i = 0; i < iter; ++i)
+        unpack_frame (packed, ref, width, height, bits);
+    tref = mono_us () - tref;
+
+    conv_use_vector (1);
+    tvec = mono_us ();
+    for (i = 0; i < iter; ++i)
+        unpack_frame (packed, out, width, height, bits);
+    tvec = mono_us () - tvec;
+
+    for (n = 0; n < pixels; ++n) {
+        raw[n] &= (1u << bits) - 1;
+        if (ref[n] != raw[n] || out[n] != raw[n]) {
+            ret = -1;
+            break;
+        }
+    }
+
+    printf ("%-18s %8.1f %8.1f %8.1f %8.1f   %s\n", name,
+            tref ? (double)pixels * iter / tref : 0.0,
+            tvec ? (double)pixels * iter / tvec : 0.0,
+            tref ? (double)pixels * 2 * iter / tref : 0.0,
+            tvec ? (double)pixels * 2 * iter / tvec : 0.0,
+            ret ? "FAIL" : "round-trip ok");
+
+    free (raw);
+    free (ref);
+    free (out);
+    free (packed);
+    return ret;
+}
+
+//***********************************************************************************
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options]\n\n Options:\n"
+        "-w | --width n Frame width [2592]\n"
+        "-h | --height n Frame height [1944]\n"
+        "-i | --iterations n Frames per measurement [10]\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "width", required_argument, NULL, 'w' },
+    { "height", required_argument, NULL, 'h' },
+    { "iterations", required_argument, NULL, 'i' },
+    { "help", no_argument, NULL, '?' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+unsigned int width = 2592, height = 1944, iter = 10;
+int c, ret = 0;
+
+    while ((c = getopt_long (argc, argv, "w:h:i:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'w':
+                width = atoi (optarg);
+                break;
+            case 'h':
+                height = atoi (optarg);
+                break;
+            case 'i':
+                iter = atoi (optarg);
+                break;
+            default:
+                usage (argv[0]);
+                return c == '?' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if ((width | height) & 1) {
+        fprintf (stderr, "Width and height must be even\n");
+        return EXIT_FAILURE;
+    }
+
+    printf ("convert %ux%u, %s, %u iterations\n\n", width, height, SIMD_NAME, iter);
+    printf ("%-18s %8s %8s %8s %8s\n", "", "Mpix/s", "", "MB/s out", "");
+    printf ("%-18s %8s %8s %8s %8s\n", "", "scalar", "vector", "scalar", "vector");
+
+    ret |= bench ("yuyv -> i420", V4L2_PIX_FMT_YUYV, 2, CONV_I420, width, height, iter);
+    ret |= bench ("yuyv -> nv12", V4L2_PIX_FMT_YUYV, 2, CONV_NV12, width, height, iter);
+    ret |= bench ("yuyv -> rgb24", V4L2_PIX_FMT_YUYV, 2, CONV_RGB24, width, height, iter);
+    ret |= bench ("uyvy -> i420", V4L2_PIX_FMT_UYVY, 2, CONV_I420, width, height, iter);
+    ret |= bench ("uyvy -> nv12", V4L2_PIX_FMT_UYVY, 2, CONV_NV12, width, height, iter);
+    ret |= bench ("uyvy -> rgb24", V4L2_PIX_FMT_UYVY, 2, CONV_RGB24, width, height, iter);
+    ret |= bench ("rgb565x -> rgb24", V4L2_PIX_FMT_RGB565X, 2, CONV_RGB24, width, height, iter);
+    ret |= bench ("raw10 -> raw8", V4L2_PIX_FMT_SGRBG10, 2, CONV_RAW8, width, height, iter);
+    ret |= bench ("raw10 -> raw10p", V4L2_PIX_FMT_SGRBG10, 2, CONV_RAW10P, width, height, iter);
+    ret |= bench ("raw12 -> raw8", v4l2_fourcc ('B', 'A', '1', '2'), 2, CONV_RAW8,
+                  width, height, iter);
+    ret |= bench ("raw12 -> raw12p", v4l2_fourcc ('B', 'A', '1', '2'), 2, CONV_RAW12P,
+                  width, height, iter);
+    ret |= roundtrip ("raw10p -> raw10", V4L2_PIX_FMT_SGRBG10, 10, width, height, iter);
+    ret |= roundtrip ("raw12p -> raw12", v4l2_fourcc ('B', 'A', '1', '2'), 12,
+                      width, height, iter);
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,683 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Pixel format conversion, see convert.h.
+//
+// YUYV is loaded as 16-bit lanes Y | C << 8 where C alternates U and V, so
+// one AND and one shift give Y per pixel and the chroma in pixel order.
+// Swapping neighbouring lanes then puts U and V of the pair in every lane.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <string.h>
+#include <strings.h>
+#include <linux/videodev2.h>
+
+#include "convert.h"
+#include "bayer.h"
+#include "simd.h"
+
+#define AVG(a, b)           (((a) + (b) + 1) >> 1)
+
+static int conv_vector = 1;
+
+//***********************************************************************************
+void conv_use_vector (int enable)
+{
+    conv_vector = enable;
+}
+
+static inline uint8_t clamp8 (int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static inline void yuv_to_rgb (int y, int u, int v, uint8_t * out)
+{
+int y1 = (y - 16) * 74 + 32;
+
+    u -= 128;
+    v -= 128;
+    out[0] = clamp8 ((y1 + 102 * v) >> 6);
+    out[1] = clamp8 ((y1 - 25 * u - 52 * v) >> 6);
+    out[2] = clamp8 ((y1 + 129 * u) >> 6);
+}
+
+#ifdef SIMD_VEC
+//***********************************************************************************
+// Half a vector of YUYV pixels to 16-bit R, G, B.  y' + 129 u may exceed
+// 32767 only when B clamps to 255 anyway, hence the saturating add.
+//
+static inline void yuv_to_rgb_vec (vu16 px, int uyvy, vs16 * r, vs16 * g, vs16 * b)
+{
+const vu16 lo = vu16_set1 (0x00ff);
+vu16 y = uyvy ? vu16_shr (px, 8) : vu16_and (px, lo);
+vu16 c = uyvy ? vu16_and (px, lo) : vu16_shr (px, 8);
+vu16 cs = vu16_swap_pairs (c);
+vs16 u = vu16_as_s16 (vu16_select (vu16_mask_even (), c, cs));
+vs16 v = vu16_as_s16 (vu16_select (vu16_mask_even (), cs, c));
+vs16 y1;
+
+    y1 = vs16_add (vs16_mul (vs16_sub (vu16_as_s16 (y), vs16_set1 (16)), vs16_set1 (74)),
+                   vs16_set1 (32));
+    u = vs16_sub (u, vs16_set1 (128));
+    v = vs16_sub (v, vs16_set1 (128));
+
+    *r = vs16_sra (vs16_add (y1, vs16_mul (v, vs16_set1 (102))), 6);
+    *g = vs16_sra (vs16_sub (vs16_sub (y1, vs16_mul (u, vs16_set1 (25))),
+                             vs16_mul (v, vs16_set1 (52))), 6);
+    *b = vs16_sra (vs16_adds (y1, vs16_mul (u, vs16_set1 (129))), 6);
+}
+#endif
+
+//***********************************************************************************
+void conv_yuyv_to_rgb24_row (const uint8_t * src, uint8_t * dst, unsigned int width,
+                             int uyvy)
+{
+unsigned int yo = uyvy ? 1 : 0, co = uyvy ? 0 : 1;
+unsigned int x = 0;
+
+#ifdef SIMD_VEC
+    if (conv_vector) {
+        for (; x + VU8_LANES <= width; x += VU8_LANES) {
+            vs16 r0, g0, b0, r1, g1, b1;
+
+            yuv_to_rgb_vec (vu8_as_u16 (vu8_load (src + 2 * x)), uyvy, &r0, &g0, &b0);
+            yuv_to_rgb_vec (vu8_as_u16 (vu8_load (src + 2 * x + VU8_LANES)), uyvy,
+                            &r1, &g1, &b1);
+            vu8_store3 (dst + 3 * x, vs16_pack_u8 (r0, r1), vs16_pack_u8 (g0, g1),
+                        vs16_pack_u8 (b0, b1));
+        }
+    }
+#endif
+
+    for (; x + 1 < width; x += 2) {
+        const uint8_t *p = src + 2 * x;
+
+        yuv_to_rgb (p[yo], p[co], p[co + 2], dst + 3 * x);
+        yuv_to_rgb (p[yo + 2], p[co], p[co + 2], dst + 3 * x + 3);
+    }
+}
+
+//***********************************************************************************
+void conv_yuyv_to_i420_rows (const uint8_t * src0, const uint8_t * src1,
+                             uint8_t * y0, uint8_t * y1, uint8_t * u, uint8_t * v,
+                             unsigned int width, int uyvy)
+{
+unsigned int yo = uyvy ? 1 : 0, co = uyvy ? 0 : 1;
+unsigned int x = 0;
+
+#ifdef SIMD_VEC
+    if (conv_vector) {
+        for (; x + 2 * VU8_LANES <= width; x += 2 * VU8_LANES) {
+            vu8 ya0, ca0, yb0, cb0, ya1, ca1, yb1, cb1, cu, cv;
+
+            if (uyvy) {
+                vu8_load2 (src0 + 2 * x, &ca0, &ya0);
+                vu8_load2 (src0 + 2 * x + 2 * VU8_LANES, &cb0, &yb0);
+                vu8_load2 (src1 + 2 * x, &ca1, &ya1);
+                vu8_load2 (src1 + 2 * x + 2 * VU8_LANES, &cb1, &yb1);
+            } else {
+                vu8_load2 (src0 + 2 * x, &ya0, &ca0);
+                vu8_load2 (src0 + 2 * x + 2 * VU8_LANES, &yb0, &cb0);
+                vu8_load2 (src1 + 2 * x, &ya1, &ca1);
+                vu8_load2 (src1 + 2 * x + 2 * VU8_LANES, &yb1, &cb1);
+            }
+
+            vu8_store (y0 + x, ya0);
+            vu8_store (y0 + x + VU8_LANES, yb0);
+            vu8_store (y1 + x, ya1);
+            vu8_store (y1 + x + VU8_LANES, yb1);
+
+            vu8_unzip (vu8_avg (ca0, ca1), vu8_avg (cb0, cb1), &cu, &cv);
+            vu8_store (u + x / 2, cu);
+            vu8_store (v + x / 2, cv);
+        }
+    }
+#endif
+
+    for (; x + 1 < width; x += 2) {
+        const uint8_t *p = src0 + 2 * x, *q = src1 + 2 * x;
+
+        y0[x] = p[yo];
+        y0[x + 1] = p[yo + 2];
+        y1[x] = q[yo];
+        y1[x + 1] = q[yo + 2];
+        u[x / 2] = AVG (p[co], q[co]);
+        v[x / 2] = AVG (p[co + 2], q[co + 2]);
+    }
+}
+
+//***********************************************************************************
+void conv_yuyv_to_nv12_rows (const uint8_t * src0, const uint8_t * src1,
+                             uint8_t * y0, uint8_t * y1, uint8_t * uv,
+                             unsigned int width, int uyvy)
+{
+unsigned int yo = uyvy ? 1 : 0, co = uyvy ? 0 : 1;
+unsigned int x = 0;
+
+#ifdef SIMD_VEC
+    if (conv_vector) {
+        for (; x + VU8_LANES <= width; x += VU8_LANES) {
+            vu8 ya, ca, yb, cb;
+
+            if (uyvy) {
+                vu8_load2 (src0 + 2 * x, &ca, &ya);
+                vu8_load2 (src1 + 2 * x, &cb, &yb);
+            } else {
+                vu8_load2 (src0 + 2 * x, &ya, &ca);
+                vu8_load2 (src1 + 2 * x, &yb, &cb);
+            }
+
+            vu8_store (y0 + x, ya);
+            vu8_store (y1 + x, yb);
+            vu8_store (uv + x, vu8_avg (ca, cb));
+        }
+    }
+#endif
+
+    for (; x + 1 < width; x += 2) {
+        const uint8_t *p = src0 + 2 * x, *q = src1 + 2 * x;
+
+        y0[x] = p[yo];
+        y0[x + 1] = p[yo + 2];
+        y1[x] = q[yo];
+        y1[x + 1] = q[yo + 2];
+        uv[x] = AVG (p[co], q[co]);
+        uv[x + 1] = AVG (p[co + 2], q[co + 2]);
+    }
+}
+
+//***********************************************************************************
+// RGB565X is big endian: RRRRRGGG GGGBBBBB.  Components are widened by
+// replicating their top bits.
+//
+#ifdef SIMD_VEC
+static inline void rgb565x_vec (vu16 px, vu16 * r, vu16 * g, vu16 * b)
+{
+vu16 hi = vu16_and (px, vu16_set1 (0x00ff));
+vu16 lo = vu16_shr (px, 8);
+vu16 g6 = vu16_or (vu16_shl (vu16_and (hi, vu16_set1 (0x07)), 3), vu16_shr (lo, 5));
+vu16 b5 = vu16_and (lo, vu16_set1 (0x1f));
+
+    *r = vu16_or (vu16_and (hi, vu16_set1 (0xf8)), vu16_shr (hi, 5));
+    *g = vu16_or (vu16_shl (g6, 2), vu16_shr (g6, 4));
+    *b = vu16_or (vu16_shl (b5, 3), vu16_shr (b5, 2));
+}
+#endif
+
+void conv_rgb565x_to_rgb24_row (const uint8_t * src, uint8_t * dst, unsigned int width)
+{
+unsigned int x = 0;
+
+#ifdef SIMD_VEC
+    if (conv_vector) {
+        for (; x + VU8_LANES <= width; x += VU8_LANES) {
+            vu16 r0, g0, b0, r1, g1, b1;
+
+            rgb565x_vec (vu8_as_u16 (vu8_load (src + 2 * x)), &r0, &g0, &b0);
+            rgb565x_vec (vu8_as_u16 (vu8_load (src + 2 * x + VU8_LANES)), &r1, &g1, &b1);
+            vu8_store3 (dst + 3 * x, vu16_pack (r0, r1), vu16_pack (g0, g1),
+                        vu16_pack (b0, b1));
+        }
+    }
+#endif
+
+    for (; x < width; ++x) {
+        unsigned int hi = src[2 * x], lo = src[2 * x + 1];
+        unsigned int g6 = ((hi & 0x07) << 3) | (lo >> 5);
+        unsigned int b5 = lo & 0x1f;
+
+        dst[3 * x] = (hi & 0xf8) | (hi >> 5);
+        dst[3 * x + 1] = (g6 << 2) | (g6 >> 4);
+        dst[3 * x + 2] = (b5 << 3) | (b5 >> 2);
+    }
+}
+
+//***********************************************************************************
+void conv_raw16_to_raw8_row (const uint16_t * src, uint8_t * dst, unsigned int width,
+                             unsigned int bits)
+{
+unsigned int mask = bits >= 16 ? 0xffff : (1u << bits) - 1;
+unsigned int shift = bits - 8;
+unsigned int x = 0;
+
+#ifdef SIMD_VEC
+    if (conv_vector) {
+        const vu16 m = vu16_set1 (mask);
+
+        for (; x + 2 * VU16_LANES <= width; x += 2 * VU16_LANES) {
+            vu16 lo = vu16_shr (vu16_and (vu16_load (src + x), m), shift);
+            vu16 hi = vu16_shr (vu16_and (vu16_load (src + x + VU16_LANES), m), shift);
+
+            vu8_store (dst + x, vu16_pack (lo, hi));
+        }
+    }
+#endif
+
+    for (; x < width; ++x)
+        dst[x] = (src[x] & mask) >> shift;
+}
+
+//***********************************************************************************
+// Packers.  Where byte shuffles exist, 8 pixels at a time: the low bits of
+// pixel k are shifted to their place in the shared byte by a per-lane
+// multiply and ORed together by shifting lanes down, then two shuffles
+// pick the top bytes and the shared bytes into the packed order.  The
+// store writes 16 bytes, the next group overwrites the surplus.
+//
+#ifdef SIMD_SHUFFLE
+struct pack_tables {
+    uint16_t mult[8];
+    uint8_t down1[16];
+    uint8_t down2[16];
+    uint8_t msb[16];
+    uint8_t lsb[16];
+};
+
+static const struct pack_tables raw10_pack_tables = {
+    { 1, 4, 16, 64, 1, 4, 16, 64 },
+    { 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0xff, 0xff },
+    { 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0xff, 0xff, 0xff, 0xff },
+    { 0, 2, 4, 6, 0xff, 8, 10, 12, 14, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+    { 0xff, 0xff, 0xff, 0xff, 0, 0xff, 0xff, 0xff, 0xff, 8, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+};
+
+static const struct pack_tables raw12_pack_tables = {
+    { 1, 16, 1, 16, 1, 16, 1, 16 },
+    { 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0xff, 0xff },
+    { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+    { 0, 2, 0xff, 4, 6, 0xff, 8, 10, 0xff, 12, 14, 0xff, 0xff, 0xff, 0xff, 0xff },
+    { 0xff, 0xff, 0, 0xff, 0xff, 4, 0xff, 0xff, 8, 0xff, 0xff, 12, 0xff, 0xff, 0xff, 0xff },
+};
+
+// s = bits - 8, a constant
+#define PACK8(in, out, t, s)                                                    \
+    do {                                                                        \
+        v128 v = v128_and (v128_load (in), v128_set16 ((1 << ((s) + 8)) - 1));  \
+        v128 m = v128_shr16 (v, (s));                                           \
+        v128 l = v128_mul16 (v128_and (v, v128_set16 ((1 << (s)) - 1)),         \
+                             v128_load ((t)->mult));                            \
+                                                                                \
+        l = v128_or (l, v128_shuffle (l, v128_load ((t)->down1)));              \
+        l = v128_or (l, v128_shuffle (l, v128_load ((t)->down2)));              \
+        v128_store ((out), v128_or (v128_shuffle (m, v128_load ((t)->msb)),     \
+                                    v128_shuffle (l, v128_load ((t)->lsb))));   \
+    } while (0)
+#endif
+
+//***********************************************************************************
+// MIPI RAW10: the top 8 bits of pixels 0..3, then a byte holding the low 2
+// bits of each, pixel 0 in bits 1:0.
+//
+size_t conv_raw10_packed_bytes (unsigned int width)
+{
+    return (size_t)(width + 3) / 4 * 5;
+}
+
+static inline void raw10_pack4 (const uint16_t * p, uint8_t * out)
+{
+    out[0] = (p[0] & 0x3ff) >> 2;
+    out[1] = (p[1] & 0x3ff) >> 2;
+    out[2] = (p[2] & 0x3ff) >> 2;
+    out[3] = (p[3] & 0x3ff) >> 2;
+    out[4] = (p[0] & 3) | (p[1] & 3) << 2 | (p[2] & 3) << 4 | (p[3] & 3) << 6;
+}
+
+void conv_raw10_to_packed_row (const uint16_t * src, uint8_t * dst, unsigned int width)
+{
+unsigned int x = 0;
+uint16_t tail[4];
+
+#if defined(SIMD_SHUFFLE)
+    if (conv_vector) {
+        for (; (x + 8) / 4 * 5 + 6 <= conv_raw10_packed_bytes (width); x += 8)
+            PACK8 (src + x, dst + x / 4 * 5, &raw10_pack_tables, 2);
+    }
+#elif defined(SIMD_VEC)
+    if (conv_vector) {
+        const vu16 m = vu16_set1 (0x3ff);
+        uint8_t msb[VU8_LANES];
+
+        for (; x + 2 * VU16_LANES <= width; x += 2 * VU16_LANES) {
+            vu16 lo = vu16_shr (vu16_and (vu16_load (src + x), m), 2);
+            vu16 hi = vu16_shr (vu16_and (vu16_load (src + x + VU16_LANES), m), 2);
+            unsigned int i;
+
+            vu8_store (msb, vu16_pack (lo, hi));
+
+            // Gather the low bits of 4 pixels from one 64-bit word.
+            for (i = 0; i < VU8_LANES; i += 4) {
+                uint8_t *out = dst + (x + i) / 4 * 5;
+                uint64_t w;
+
+                memcpy (&w, src + x + i, sizeof (w));
+                w &= 0x0003000300030003ULL;
+                memcpy (out, msb + i, 4);
+                out[4] = w | w >> 14 | w >> 28 | w >> 42;
+            }
+        }
+    }
+#endif
+
+    for (; x + 4 <= width; x += 4)
+        raw10_pack4 (src + x, dst + x / 4 * 5);
+
+    if (x < width) {
+        memset (tail, 0, sizeof (tail));
+        memcpy (tail, src + x, (width - x) * sizeof (*src));
+        raw10_pack4 (tail, dst + x / 4 * 5);
+    }
+}
+
+//***********************************************************************************
+// MIPI RAW12: the top 8 bits of pixels 0 and 1, then a byte holding the low
+// 4 bits of each, pixel 0 in bits 3:0.
+//
+size_t conv_raw12_packed_bytes (unsigned int width)
+{
+    return (size_t)(width + 1) / 2 * 3;
+}
+
+static inline void raw12_pack2 (const uint16_t * p, uint8_t * out)
+{
+    out[0] = (p[0] & 0xfff) >> 4;
+    out[1] = (p[1] & 0xfff) >> 4;
+    out[2] = (p[0] & 0xf) | (p[1] & 0xf) << 4;
+}
+
+void conv_raw12_to_packed_row (const uint16_t * src, uint8_t * dst, unsigned int width)
+{
+unsigned int x = 0;
+uint16_t tail[2];
+
+#if defined(SIMD_SHUFFLE)
+    if (conv_vector) {
+        for (; (x + 8) / 2 * 3 + 4 <= conv_raw12_packed_bytes (width); x += 8)
+            PACK8 (src + x, dst + x / 2 * 3, &raw12_pack_tables, 4);
+    }
+#elif defined(SIMD_VEC)
+    if (conv_vector) {
+        const vu16 m = vu16_set1 (0xfff);
+        uint8_t msb[VU8_LANES];
+
+        for (; x + 2 * VU16_LANES <= width; x += 2 * VU16_LANES) {
+            vu16 lo = vu16_shr (vu16_and (vu16_load (src + x), m), 4);
+            vu16 hi = vu16_shr (vu16_and (vu16_load (src + x + VU16_LANES), m), 4);
+            unsigned int i;
+
+            vu8_store (msb, vu16_pack (lo, hi));
+
+            for (i = 0; i < VU8_LANES; i += 2) {
+                uint8_t *out = dst + (x + i) / 2 * 3;
+                uint32_t w;
+
+                memcpy (&w, src + x + i, sizeof (w));
+                w &= 0x000f000f;
+                out[0] = msb[i];
+                out[1] = msb[i + 1];
+                out[2] = w | w >> 12;
+            }
+        }
+    }
+#endif
+
+    for (; x + 2 <= width; x += 2)
+        raw12_pack2 (src + x, dst + x / 2 * 3);
+
+    if (x < width) {
+        tail[0] = src[x];
+        tail[1] = 0;
+        raw12_pack2 (tail, dst + x / 2 * 3);
+    }
+}
+
+//***********************************************************************************
+// Unpackers.  The vector path gathers 8 pixels at a time with two byte
+// shuffles: one puts each pixel's top byte in its 16-bit lane, the other
+// the byte holding its low bits.  A per-lane multiply then lines up the low
+// bits of pixel k at the same position in every lane.
+//
+#ifdef SIMD_SHUFFLE
+struct unpack_tables {
+    uint8_t msb[16];
+    uint8_t lsb[16];
+    uint16_t mult[8];
+};
+
+static const struct unpack_tables raw10_tables = {
+    { 0, 0xff, 1, 0xff, 2, 0xff, 3, 0xff, 5, 0xff, 6, 0xff, 7, 0xff, 8, 0xff },
+    { 4, 0xff, 4, 0xff, 4, 0xff, 4, 0xff, 9, 0xff, 9, 0xff, 9, 0xff, 9, 0xff },
+    { 64, 16, 4, 1, 64, 16, 4, 1 },
+};
+
+static const struct unpack_tables raw12_tables = {
+    { 0, 0xff, 1, 0xff, 3, 0xff, 4, 0xff, 6, 0xff, 7, 0xff, 9, 0xff, 10, 0xff },
+    { 2, 0xff, 2, 0xff, 5, 0xff, 5, 0xff, 8, 0xff, 8, 0xff, 11, 0xff, 11, 0xff },
+    { 16, 1, 16, 1, 16, 1, 16, 1 },
+};
+
+// s = bits - 8, a constant
+#define UNPACK8(in, out, t, s)                                                  \
+    do {                                                                        \
+        v128 v = v128_load (in);                                                \
+        v128 m = v128_shuffle (v, v128_load ((t)->msb));                        \
+        v128 l = v128_mul16 (v128_shuffle (v, v128_load ((t)->lsb)),            \
+                             v128_load ((t)->mult));                            \
+                                                                                \
+        l = v128_and (v128_shr16 (l, 8 - (s)), v128_set16 ((1 << (s)) - 1));    \
+        v128_store ((out), v128_or (v128_shl16 (m, (s)), l));                   \
+    } while (0)
+#endif
+
+static inline void raw10_unpack4 (const uint8_t * in, uint16_t * p)
+{
+    p[0] = in[0] << 2 | (in[4] & 3);
+    p[1] = in[1] << 2 | (in[4] >> 2 & 3);
+    p[2] = in[2] << 2 | (in[4] >> 4 & 3);
+    p[3] = in[3] << 2 | (in[4] >> 6);
+}
+
+void conv_raw10p_to_raw16_row (const uint8_t * src, uint16_t * dst, unsigned int width)
+{
+unsigned int x = 0;
+uint16_t tail[4];
+
+#ifdef SIMD_SHUFFLE
+    // 8 pixels use 10 bytes but the load reads 16, stay inside the row.
+    if (conv_vector) {
+        for (; (x + 8) / 4 * 5 + 6 <= conv_raw10_packed_bytes (width); x += 8)
+            UNPACK8 (src + x / 4 * 5, dst + x, &raw10_tables, 2);
+    }
+#endif
+
+    for (; x + 4 <= width; x += 4)
+        raw10_unpack4 (src + x / 4 * 5, dst + x);
+
+    if (x < width) {
+        raw10_unpack4 (src + x / 4 * 5, tail);
+        memcpy (dst + x, tail, (width - x) * sizeof (*dst));
+    }
+}
+
+static inline void raw12_unpack2 (const uint8_t * in, uint16_t * p)
+{
+    p[0] = in[0] << 4 | (in[2] & 0xf);
+    p[1] = in[1] << 4 | (in[2] >> 4);
+}
+
+void conv_raw12p_to_raw16_row (const uint8_t * src, uint16_t * dst, unsigned int width)
+{
+unsigned int x = 0;
+uint16_t tail[2];
+
+#ifdef SIMD_SHUFFLE
+    // 8 pixels use 12 bytes but the load reads 16.
+    if (conv_vector) {
+        for (; (x + 8) / 2 * 3 + 4 <= conv_raw12_packed_bytes (width); x += 8)
+            UNPACK8 (src + x / 2 * 3, dst + x, &raw12_tables, 4);
+    }
+#endif
+
+    for (; x + 2 <= width; x += 2)
+        raw12_unpack2 (src + x / 2 * 3, dst + x);
+
+    if (x < width) {
+        raw12_unpack2 (src + x / 2 * 3, tail);
+        dst[x] = tail[0];
+    }
+}
+
+//***********************************************************************************
+size_t conv_frame_size (enum conv_format fmt, unsigned int width, unsigned int height)
+{
+size_t pixels = (size_t)width * height;
+
+    switch (fmt) {
+        case CONV_I420:
+        case CONV_NV12:
+            return (width | height) & 1 ? 0 : pixels * 3 / 2;
+        case CONV_RGB24:
+            return pixels * 3;
+        case CONV_RAW8:
+            return pixels;
+        case CONV_RAW10P:
+            return conv_raw10_packed_bytes (width) * height;
+        case CONV_RAW12P:
+            return conv_raw12_packed_bytes (width) * height;
+    }
+
+    return 0;
+}
+
+//***********************************************************************************
+static int conv_yuv (const struct conv_image * src, enum conv_format fmt, uint8_t * dst,
+                     int uyvy)
+{
+unsigned int w = src->width, h = src->height, y;
+const uint8_t *in = src->data;
+uint8_t *cb = dst + (size_t)w * h;
+uint8_t *cr = cb + (size_t)w * h / 4;
+
+    if (w & 1)
+        return -1;
+
+    if (fmt == CONV_RGB24) {
+        for (y = 0; y < h; ++y)
+            conv_yuyv_to_rgb24_row (in + (size_t)y * src->stride,
+                                    dst + (size_t)y * w * 3, w, uyvy);
+        return 0;
+    }
+
+    if (h & 1)
+        return -1;
+
+    for (y = 0; y < h; y += 2) {
+        const uint8_t *s0 = in + (size_t)y * src->stride;
+        uint8_t *y0 = dst + (size_t)y * w;
+
+        if (fmt == CONV_I420)
+            conv_yuyv_to_i420_rows (s0, s0 + src->stride, y0, y0 + w,
+                                    cb + (size_t)y / 2 * w / 2, cr + (size_t)y / 2 * w / 2,
+                                    w, uyvy);
+        else if (fmt == CONV_NV12)
+            conv_yuyv_to_nv12_rows (s0, s0 + src->stride, y0, y0 + w,
+                                    cb + (size_t)y / 2 * w, w, uyvy);
+        else
+            return -1;
+    }
+
+    return 0;
+}
+
+static int conv_rgb565x (const struct conv_image * src, enum conv_format fmt, uint8_t * dst)
+{
+unsigned int y;
+
+    if (fmt != CONV_RGB24)
+        return -1;
+
+    for (y = 0; y < src->height; ++y)
+        conv_rgb565x_to_rgb24_row ((const uint8_t *)src->data + (size_t)y * src->stride,
+                                   dst + (size_t)y * src->width * 3, src->width);
+    return 0;
+}
+
+static int conv_raw (const struct conv_image * src, enum conv_format fmt, uint8_t * dst,
+                     unsigned int bits)
+{
+unsigned int y;
+
+    if (bits <= 8)
+        return -1;
+
+    for (y = 0; y < src->height; ++y) {
+        const uint16_t *row = (const uint16_t *)((const uint8_t *)src->data +
+                                                 (size_t)y * src->stride);
+
+        if (fmt == CONV_RAW8)
+            conv_raw16_to_raw8_row (row, dst + (size_t)y * src->width, src->width, bits);
+        else if (fmt == CONV_RAW10P && bits == 10)
+            conv_raw10_to_packed_row (row, dst + conv_raw10_packed_bytes (src->width) * y,
+                                      src->width);
+        else if (fmt == CONV_RAW12P && bits == 12)
+            conv_raw12_to_packed_row (row, dst + conv_raw12_packed_bytes (src->width) * y,
+                                      src->width);
+        else
+            return -1;
+    }
+
+    return 0;
+}
+
+int conv_frame (const struct conv_image * src, enum conv_format fmt, void * dst)
+{
+enum bayer_order order;
+unsigned int bits;
+
+    switch (src->fourcc) {
+        case V4L2_PIX_FMT_YUYV:
+            return conv_yuv (src, fmt, dst, 0);
+        case V4L2_PIX_FMT_UYVY:
+            return conv_yuv (src, fmt, dst, 1);
+        case V4L2_PIX_FMT_RGB565X:
+            return conv_rgb565x (src, fmt, dst);
+        case v4l2_fourcc ('Y', '1', '0', ' '):
+            return conv_raw (src, fmt, dst, 10);
+        case v4l2_fourcc ('Y', '1', '2', ' '):
+            return conv_raw (src, fmt, dst, 12);
+    }
+
+    if (bayer_from_fourcc (src->fourcc, &order, &bits) < 0)
+        return -1;
+    return conv_raw (src, fmt, dst, bits);
+}
+
+//***********************************************************************************
+static const char * const conv_names[] = {
+    [CONV_I420] = "i420",
+    [CONV_NV12] = "nv12",
+    [CONV_RGB24] = "rgb24",
+    [CONV_RAW8] = "raw8",
+    [CONV_RAW10P] = "raw10p",
+    [CONV_RAW12P] = "raw12p",
+};
+
+int conv_format_from_name (const char * name)
+{
+unsigned int i;
+
+    for (i = 0; i < sizeof (conv_names) / sizeof (conv_names[0]); ++i)
+        if (!strcasecmp (name, conv_names[i]))
+            return i;
+
+    return -1;
+}
+
+const char * conv_format_name (enum conv_format fmt)
+{
+    return (unsigned int)fmt < sizeof (conv_names) / sizeof (conv_names[0])
+           ? conv_names[fmt] : "?";
+}
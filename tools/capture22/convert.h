@@ -0,0 +1,109 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Pixel format conversion.
+//
+//   YUYV, UYVY      -> I420, NV12, RGB24
+//   RGB565X         -> RGB24
+//   RAW10 (16-bit)  -> RAW8, MIPI packed RAW10
+//   RAW12 (16-bit)  -> RAW8, MIPI packed RAW12
+//
+// plus unpackers from MIPI RAW10/RAW12 back to 16-bit containers.  Packed
+// storage takes 10 (12) bits per pixel instead of 16.
+//
+// The row functions convert one line (two lines for the 4:2:0 outputs, whose
+// chroma is the rounded average of both) so a caller can stream a frame
+// through a small buffer.  conv_frame() runs them over a whole frame with
+// tightly packed output planes.
+//
+// YUV to RGB uses BT.601 limited range in 6-bit fixed point:
+//
+//   y' = (Y - 16) * 74 + 32
+//   R  = (y' + 102 * (V - 128)) >> 6
+//   G  = (y' - 25 * (U - 128) - 52 * (V - 128)) >> 6
+//   B  = (y' + 129 * (U - 128)) >> 6          each clamped to 0..255
+//
+// The inner loops use the vector layer in simd.h.  conv_use_vector (0)
+// switches every kernel to its plain C path, which the vector path must
+// match bit for bit.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __CONVERT_H
+#define __CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum conv_format {
+    CONV_I420,              // Y plane, U plane, V plane (2x2 subsampled)
+    CONV_NV12,              // Y plane, interleaved UV plane
+    CONV_RGB24,             // packed R, G, B
+    CONV_RAW8,              // 8-bit Bayer/grey, the top bits of each sample
+    CONV_RAW10P,            // MIPI CSI-2 RAW10, 4 pixels in 5 bytes
+    CONV_RAW12P,            // MIPI CSI-2 RAW12, 2 pixels in 3 bytes
+};
+
+struct conv_image {
+    const void * data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int stride;            // bytes per line
+    unsigned int fourcc;            // V4L2_PIX_FMT_*
+};
+
+void conv_use_vector (int enable);
+
+//
+// uyvy selects UYVY instead of YUYV input.  width must be even.
+//
+void conv_yuyv_to_rgb24_row (const uint8_t * src, uint8_t * dst, unsigned int width,
+                             int uyvy);
+void conv_yuyv_to_i420_rows (const uint8_t * src0, const uint8_t * src1,
+                             uint8_t * y0, uint8_t * y1, uint8_t * u, uint8_t * v,
+                             unsigned int width, int uyvy);
+void conv_yuyv_to_nv12_rows (const uint8_t * src0, const uint8_t * src1,
+                             uint8_t * y0, uint8_t * y1, uint8_t * uv,
+                             unsigned int width, int uyvy);
+
+void conv_rgb565x_to_rgb24_row (const uint8_t * src, uint8_t * dst, unsigned int width);
+
+//
+// 16-bit container rows holding bits significant bits.  Packed rows are
+// padded with zero pixels to a multiple of 4 (RAW10) or 2 (RAW12).
+//
+void conv_raw16_to_raw8_row (const uint16_t * src, uint8_t * dst, unsigned int width,
+                             unsigned int bits);
+void conv_raw10_to_packed_row (const uint16_t * src, uint8_t * dst, unsigned int width);
+void conv_raw12_to_packed_row (const uint16_t * src, uint8_t * dst, unsigned int width);
+size_t conv_raw10_packed_bytes (unsigned int width);
+size_t conv_raw12_packed_bytes (unsigned int width);
+
+//
+// Unpack one packed row to width 16-bit pixels.
+//
+void conv_raw10p_to_raw16_row (const uint8_t * src, uint16_t * dst, unsigned int width);
+void conv_raw12p_to_raw16_row (const uint8_t * src, uint16_t * dst, unsigned int width);
+
+//
+// Size of a width x height frame in fmt, or 0 if the size is not valid for
+// the format.
+//
+size_t conv_frame_size (enum conv_format fmt, unsigned int width, unsigned int height);
+
+//
+// Convert a whole frame into dst (conv_frame_size () bytes).  Returns 0, or
+// -1 if the conversion is not supported.
+//
+int conv_frame (const struct conv_image * src, enum conv_format fmt, void * dst);
+
+//
+// Parse "i420", "nv12", "rgb24", "raw8", "raw10p" or "raw12p".  Returns -1
+// if unknown.
+//
+int conv_format_from_name (const char * name);
+const char * conv_format_name (enum conv_format fmt);
+
+#endif /* __CONVERT_H */
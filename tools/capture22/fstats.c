@@ -0,0 +1,468 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Per-frame statistics.  See fstats.h.
+//
+// A frame is walked in units: one row for YUYV, one row pair (a row of
+// 2x2 cells) for Bayer.  Each unit splits into planes of n samples, the
+// lumas of a YUYV row or the four colour positions of a cell row.  The
+// fast path gathers the sampled columns of every plane into a packed
+// buffer (the vector unzip does it when every column is taken), then runs
+// the zone sums and the clip counts on the packed samples a vector at a
+// time.  The histogram scatter can't be vectorised; it rotates through
+// four partial histograms so that runs of equal values don't serialise on
+// one counter.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <linux/videodev2.h>
+
+#include "fstats.h"
+#include "bayer.h"
+#include "simd.h"
+
+#define FSTATS_MAX_THREADS  16
+
+//
+// Frame geometry in units and planes.
+//
+struct layout {
+    const struct conv_image * img;
+    unsigned int planes;            // 1 (luma) or 4 (colour positions)
+    unsigned int channel[4];        // per plane
+    unsigned int n;                 // samples per plane and unit
+    unsigned int units;
+    unsigned int bits;              // Bayer sample depth, 0 for YUYV
+    unsigned int offset;            // byte of Y in a YUYV pair
+};
+
+static int get_layout (const struct conv_image * img, const struct fstats_config * cfg,
+                       struct layout * l)
+{
+enum bayer_order order;
+unsigned int p, r = 0, b = 3;
+
+    if (cfg->zones_x < 1 || cfg->zones_y < 1 ||
+        cfg->zones_x * cfg->zones_y > FSTATS_MAX_ZONES)
+        return -1;
+    if (cfg->step_x < 1 || cfg->step_y < 1 || cfg->low >= cfg->high || cfg->high > 255)
+        return -1;
+
+    memset (l, 0, sizeof (*l));
+    l->img = img;
+
+    if (img->fourcc == V4L2_PIX_FMT_YUYV || img->fourcc == V4L2_PIX_FMT_UYVY) {
+        if (img->width < 2 || img->width & 1 || img->stride < img->width * 2)
+            return -1;
+        l->planes = 1;
+        l->channel[0] = FSTATS_Y;
+        l->n = img->width;
+        l->units = img->height;
+        l->offset = img->fourcc == V4L2_PIX_FMT_UYVY;
+        return l->units ? 0 : -1;
+    }
+
+    if (bayer_from_fourcc (img->fourcc, &order, &l->bits) < 0)
+        return -1;
+    if (img->width < 2 || img->height < 2 ||
+        img->stride < img->width * (l->bits > 8 ? 2 : 1))
+        return -1;
+
+    switch (order) {
+        case BAYER_RGGB: r = 0; b = 3; break;
+        case BAYER_GRBG: r = 1; b = 2; break;
+        case BAYER_GBRG: r = 2; b = 1; break;
+        case BAYER_BGGR: r = 3; b = 0; break;
+    }
+    for (p = 0; p < 4; ++p)
+        l->channel[p] = p == r ? FSTATS_R : p == b ? FSTATS_B : FSTATS_G;
+
+    l->planes = 4;
+    l->n = img->width / 2;
+    l->units = img->height / 2;
+    return 0;
+}
+
+static void clear_stats (const struct layout * l, const struct fstats_config * cfg,
+                         struct fstats * s)
+{
+unsigned int p;
+
+    memset (s, 0, sizeof (*s));
+    s->zones_x = cfg->zones_x;
+    s->zones_y = cfg->zones_y;
+    for (p = 0; p < l->planes; ++p)
+        s->channels |= 1u << l->channel[p];
+}
+
+static const uint8_t * src_row (const struct conv_image * img, unsigned int y)
+{
+    return (const uint8_t *)img->data + (size_t)y * img->stride;
+}
+
+//***********************************************************************************
+// Reference: one sample at a time, straight from the definition.
+//
+static unsigned int sample (const struct layout * l, unsigned int unit, unsigned int p,
+                            unsigned int u)
+{
+const uint8_t *row;
+unsigned int x, mask;
+
+    if (l->bits == 0)
+        return src_row (l->img, unit)[2 * u + l->offset];
+
+    row = src_row (l->img, 2 * unit + (p >> 1));
+    x = 2 * u + (p & 1);
+    if (l->bits == 8)
+        return row[x];
+
+    mask = l->bits >= 16 ? 0xffff : (1u << l->bits) - 1;
+    return (((const uint16_t *)row)[x] & mask) >> (l->bits - 8);
+}
+
+int fstats_frame_ref (const struct conv_image * img, const struct fstats_config * cfg,
+                      struct fstats * s)
+{
+struct layout l;
+unsigned int unit, p, u, v, z, ch;
+
+    if (get_layout (img, cfg, &l) < 0)
+        return -1;
+    clear_stats (&l, cfg, s);
+
+    for (unit = 0; unit < l.units; unit += cfg->step_y) {
+        unsigned int zrow = unit * cfg->zones_y / l.units * cfg->zones_x;
+
+        for (p = 0; p < l.planes; ++p) {
+            ch = l.channel[p];
+            for (u = 0; u < l.n; u += cfg->step_x) {
+                v = sample (&l, unit, p, u);
+                z = zrow + u * cfg->zones_x / l.n;
+                s->hist[ch][v]++;
+                s->samples[ch]++;
+                s->zone_sum[z][ch] += v;
+                s->zone_samples[z][ch]++;
+                s->zone_under[z] += v <= cfg->low;
+                s->zone_over[z] += v >= cfg->high;
+            }
+        }
+    }
+
+    for (z = 0; z < cfg->zones_x * cfg->zones_y; ++z) {
+        s->under += s->zone_under[z];
+        s->over += s->zone_over[z];
+    }
+    return 0;
+}
+
+//***********************************************************************************
+// Fast path
+//
+struct band {
+    const struct layout * l;
+    const struct fstats_config * cfg;
+    const unsigned int * bounds;    // first packed index of every zone column
+    unsigned int u0, u1;            // units
+    struct fstats s;                // hist unused, see hist4
+    uint32_t hist4[FSTATS_CHANNELS][4][256];
+    int ret;
+    pthread_t thread;
+};
+
+//
+// Sampled columns of every plane of a unit into planes[p] (m bytes each).
+//
+static void gather (const struct layout * l, unsigned int step, unsigned int unit,
+                    uint8_t * planes[4], uint8_t * reduced)
+{
+unsigned int m = (l->n + step - 1) / step;
+unsigned int half, k;
+
+    if (l->bits == 0) {
+        const uint8_t *row = src_row (l->img, unit);
+
+        k = 0;
+#ifdef SIMD_VEC
+        if (step == 1) {
+            for (; k + VU8_LANES <= m; k += VU8_LANES) {
+                vu8 even, odd;
+
+                vu8_load2 (row + 2 * k, &even, &odd);
+                vu8_store (planes[0] + k, l->offset ? odd : even);
+            }
+        }
+#endif
+        for (; k < m; ++k)
+            planes[0][k] = row[2 * k * step + l->offset];
+        return;
+    }
+
+    for (half = 0; half < 2; ++half) {
+        const uint8_t *row = src_row (l->img, 2 * unit + half);
+        uint8_t *even = planes[2 * half], *odd = planes[2 * half + 1];
+
+        if (l->bits > 8 && step == 1) {
+            conv_raw16_to_raw8_row ((const uint16_t *)row, reduced, 2 * l->n, l->bits);
+            row = reduced;
+        } else if (l->bits > 8) {
+            const uint16_t *row16 = (const uint16_t *)row;
+            unsigned int mask = l->bits >= 16 ? 0xffff : (1u << l->bits) - 1;
+            unsigned int shift = l->bits - 8;
+
+            for (k = 0; k < m; ++k) {
+                even[k] = (row16[2 * k * step] & mask) >> shift;
+                odd[k] = (row16[2 * k * step + 1] & mask) >> shift;
+            }
+            continue;
+        }
+
+        k = 0;
+#ifdef SIMD_VEC
+        if (step == 1) {
+            for (; k + VU8_LANES <= m; k += VU8_LANES) {
+                vu8 e, o;
+
+                vu8_load2 (row + 2 * k, &e, &o);
+                vu8_store (even + k, e);
+                vu8_store (odd + k, o);
+            }
+        }
+#endif
+        for (; k < m; ++k) {
+            even[k] = row[2 * k * step];
+            odd[k] = row[2 * k * step + 1];
+        }
+    }
+}
+
+static void accumulate (struct band * b, const uint8_t * a, unsigned int ch,
+                        unsigned int zrow)
+{
+const struct fstats_config *cfg = b->cfg;
+unsigned int m = b->bounds[cfg->zones_x];
+uint32_t (*h)[256] = b->hist4[ch];
+unsigned int zx, k;
+
+    for (zx = 0; zx < cfg->zones_x; ++zx) {
+        unsigned int k1 = b->bounds[zx + 1];
+        unsigned int z = zrow + zx;
+        uint32_t sum = 0, under = 0, over = 0;
+
+        k = b->bounds[zx];
+#ifdef SIMD_VEC
+        {
+            // x <= low is x < low + 1, x >= high is high - 1 < x.
+            const vu8 lo = vu8_set1 (cfg->low + 1);
+            const vu8 hi = vu8_set1 (cfg->high - 1);
+            const vu8 one = vu8_set1 (1);
+
+            for (; k + VU8_LANES <= k1; k += VU8_LANES) {
+                vu8 v = vu8_load (a + k);
+
+                sum += vu8_hsum (v);
+                under += vu8_hsum (vu8_and (vu8_lt (v, lo), one));
+                over += vu8_hsum (vu8_and (vu8_lt (hi, v), one));
+            }
+        }
+#endif
+        for (; k < k1; ++k) {
+            sum += a[k];
+            under += a[k] <= cfg->low;
+            over += a[k] >= cfg->high;
+        }
+
+        b->s.zone_sum[z][ch] += sum;
+        b->s.zone_samples[z][ch] += k1 - b->bounds[zx];
+        b->s.zone_under[z] += under;
+        b->s.zone_over[z] += over;
+    }
+
+    for (k = 0; k + 4 <= m; k += 4) {
+        h[0][a[k]]++;
+        h[1][a[k + 1]]++;
+        h[2][a[k + 2]]++;
+        h[3][a[k + 3]]++;
+    }
+    for (; k < m; ++k)
+        h[0][a[k]]++;
+    b->s.samples[ch] += m;
+}
+
+static void * stats_band (void * arg)
+{
+struct band *b = arg;
+const struct layout *l = b->l;
+const struct fstats_config *cfg = b->cfg;
+unsigned int m = b->bounds[cfg->zones_x];
+uint8_t *buf, *planes[4];
+unsigned int unit, p;
+
+    // Packed planes, then room for one reduced 16-bit row.
+    buf = malloc ((size_t)4 * m + 2 * l->n);
+    if (buf == NULL) {
+        b->ret = -1;
+        return NULL;
+    }
+    for (p = 0; p < 4; ++p)
+        planes[p] = buf + (size_t)p * m;
+
+    for (unit = b->u0; unit < b->u1; unit += cfg->step_y) {
+        unsigned int zrow = unit * cfg->zones_y / l->units * cfg->zones_x;
+
+        gather (l, cfg->step_x, unit, planes, buf + (size_t)4 * m);
+        for (p = 0; p < l->planes; ++p)
+            accumulate (b, planes[p], l->channel[p], zrow);
+    }
+
+    free (buf);
+    b->ret = 0;
+    return NULL;
+}
+
+static void merge (struct fstats * s, const struct band * b)
+{
+unsigned int ch, z, i, v;
+
+    for (ch = 0; ch < FSTATS_CHANNELS; ++ch) {
+        for (v = 0; v < 256; ++v) {
+            for (i = 0; i < 4; ++i)
+                s->hist[ch][v] += b->hist4[ch][i][v];
+        }
+        s->samples[ch] += b->s.samples[ch];
+    }
+
+    for (z = 0; z < s->zones_x * s->zones_y; ++z) {
+        for (ch = 0; ch < FSTATS_CHANNELS; ++ch) {
+            s->zone_sum[z][ch] += b->s.zone_sum[z][ch];
+            s->zone_samples[z][ch] += b->s.zone_samples[z][ch];
+        }
+        s->zone_under[z] += b->s.zone_under[z];
+        s->zone_over[z] += b->s.zone_over[z];
+        s->under += b->s.zone_under[z];
+        s->over += b->s.zone_over[z];
+    }
+}
+
+int fstats_frame (const struct conv_image * img, const struct fstats_config * cfg,
+                  struct fstats * s)
+{
+unsigned int bounds[FSTATS_MAX_ZONES + 1];
+unsigned int threads = cfg->threads, sampled, per, i, zx, started;
+struct band *bands;
+struct layout l;
+int ret = 0;
+
+    if (get_layout (img, cfg, &l) < 0)
+        return -1;
+    clear_stats (&l, cfg, s);
+
+    // Zone column zx starts at sample ceil (zx * n / zones_x), i.e. at
+    // packed index ceil (that / step_x).
+    for (zx = 0; zx <= cfg->zones_x; ++zx) {
+        unsigned int u = (zx * l.n + cfg->zones_x - 1) / cfg->zones_x;
+
+        bounds[zx] = (u + cfg->step_x - 1) / cfg->step_x;
+    }
+
+    // Bands hold whole multiples of step_y units so every band samples
+    // the rows the reference does.
+    sampled = (l.units + cfg->step_y - 1) / cfg->step_y;
+    if (threads < 1)
+        threads = 1;
+    if (threads > FSTATS_MAX_THREADS)
+        threads = FSTATS_MAX_THREADS;
+    if (threads > sampled)
+        threads = sampled;
+    per = (sampled + threads - 1) / threads;
+
+    bands = calloc (threads, sizeof (*bands));
+    if (bands == NULL)
+        return -1;
+
+    for (i = 0; i < threads; ++i) {
+        bands[i].l = &l;
+        bands[i].cfg = cfg;
+        bands[i].bounds = bounds;
+        bands[i].u0 = i * per * cfg->step_y;
+        bands[i].u1 = (i + 1) * per * cfg->step_y;
+        if (bands[i].u0 > l.units)
+            bands[i].u0 = l.units;
+        if (bands[i].u1 > l.units || i + 1 == threads)
+            bands[i].u1 = l.units;
+    }
+
+    // The calling thread takes the first band.
+    for (started = 1; started < threads; ++started) {
+        if (pthread_create (&bands[started].thread, NULL, stats_band, &bands[started]))
+            break;
+    }
+    stats_band (&bands[0]);
+
+    for (i = 1; i < started; ++i)
+        pthread_join (bands[i].thread, NULL);
+
+    // Bands whose thread could not be created are done here.
+    for (; started < threads; ++started)
+        stats_band (&bands[started]);
+
+    for (i = 0; i < threads; ++i) {
+        if (bands[i].ret < 0)
+            ret = -1;
+        merge (s, &bands[i]);
+    }
+
+    free (bands);
+    return ret;
+}
+
+//***********************************************************************************
+void fstats_defaults (struct fstats_config * cfg, unsigned int fourcc)
+{
+    memset (cfg, 0, sizeof (*cfg));
+    cfg->zones_x = 8;
+    cfg->zones_y = 8;
+    cfg->step_x = 1;
+    cfg->step_y = 1;
+    cfg->low = 16;
+    cfg->high = fourcc == V4L2_PIX_FMT_YUYV || fourcc == V4L2_PIX_FMT_UYVY ? 235 : 250;
+    cfg->threads = 1;
+}
+
+float fstats_mean (const struct fstats * s, enum fstats_channel ch)
+{
+uint64_t sum = 0;
+unsigned int z;
+
+    if (s->samples[ch] == 0)
+        return 0.0f;
+    for (z = 0; z < s->zones_x * s->zones_y; ++z)
+        sum += s->zone_sum[z][ch];
+    return (float)sum / s->samples[ch];
+}
+
+float fstats_zone_mean (const struct fstats * s, unsigned int z, enum fstats_channel ch)
+{
+    if (z >= s->zones_x * s->zones_y || s->zone_samples[z][ch] == 0)
+        return 0.0f;
+    return (float)s->zone_sum[z][ch] / s->zone_samples[z][ch];
+}
+
+unsigned int fstats_percentile (const struct fstats * s, enum fstats_channel ch,
+                                float fraction)
+{
+uint64_t want = (uint64_t)(fraction * s->samples[ch] + 0.5f), seen = 0;
+unsigned int v;
+
+    for (v = 0; v < 255; ++v) {
+        seen += s->hist[ch][v];
+        if (seen >= want)
+            break;
+    }
+    return v;
+}
@@ -0,0 +1,96 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Per-frame statistics in software, for when the ISP statistics engine is
+// not in the path (YUYV from the sensor, Bayer captured raw).
+//
+//   YUYV, UYVY      luma histogram
+//   Bayer 8..16     red, green and blue histograms, 16-bit input reduced to
+//                   its top 8 bits like the demosaic does
+//
+// plus, over a grid of zones, the mean of every channel and the number of
+// samples at or below cfg.low (under exposed) and at or above cfg.high
+// (clipped).  Bayer statistics work on 2x2 cells: zones, strides and the
+// band split never cut a cell.
+//
+// step_x / step_y sample every n-th pixel (YUYV) or cell (Bayer) only; a
+// 5 MP frame at step 4 x 4 still gives 80000 samples per channel, plenty
+// for AE, in a sixteenth of the time.
+//
+// fstats_frame () splits the frame into row bands processed by worker
+// threads and uses the vector layer in simd.h; fstats_frame_ref () is the
+// plain C reference it must match exactly.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __FSTATS_H
+#define __FSTATS_H
+
+#include <stdint.h>
+
+#include "convert.h"
+
+#define FSTATS_MAX_ZONES    256             // zones_x * zones_y
+
+enum fstats_channel {
+    FSTATS_Y,
+    FSTATS_R,
+    FSTATS_G,
+    FSTATS_B,
+    FSTATS_CHANNELS,
+};
+
+struct fstats_config {
+    unsigned int zones_x;           // zone grid [8 x 8]
+    unsigned int zones_y;
+    unsigned int step_x;            // sample every step_x-th pixel / cell [1]
+    unsigned int step_y;            // on every step_y-th row / cell row [1]
+    unsigned int low;               // under exposed at or below [16]
+    unsigned int high;              // clipped at or above [235 YUYV, 250 Bayer]
+    unsigned int threads;           // worker threads [1]
+};
+
+struct fstats {
+    unsigned int channels;          // bit mask of the channels filled in
+    unsigned int zones_x;
+    unsigned int zones_y;
+    uint32_t hist[FSTATS_CHANNELS][256];
+    uint32_t samples[FSTATS_CHANNELS];
+    uint64_t zone_sum[FSTATS_MAX_ZONES][FSTATS_CHANNELS];
+    uint32_t zone_samples[FSTATS_MAX_ZONES][FSTATS_CHANNELS];
+    uint32_t zone_under[FSTATS_MAX_ZONES];      // all channels
+    uint32_t zone_over[FSTATS_MAX_ZONES];
+    uint32_t under;
+    uint32_t over;
+};
+
+//
+// Fill cfg with the defaults above for fourcc.
+//
+void fstats_defaults (struct fstats_config * cfg, unsigned int fourcc);
+
+//
+// Statistics of img.  Returns 0, or -1 when the format is not supported or
+// cfg is invalid (zones or steps out of range, low >= high).
+//
+int fstats_frame (const struct conv_image * img, const struct fstats_config * cfg,
+                  struct fstats * s);
+int fstats_frame_ref (const struct conv_image * img, const struct fstats_config * cfg,
+                      struct fstats * s);
+
+//
+// Mean of channel ch over the frame or over zone z, 0 without samples.
+//
+float fstats_mean (const struct fstats * s, enum fstats_channel ch);
+float fstats_zone_mean (const struct fstats * s, unsigned int z, enum fstats_channel ch);
+
+//
+// Smallest value v such that at least fraction of the samples of ch are
+// <= v.
+//
+unsigned int fstats_percentile (const struct fstats * s, enum fstats_channel ch,
+                                float fraction);
+
+#endif /* __FSTATS_H */
@@ -0,0 +1,378 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Motion detector and preroll ring.  See motion.h.
+//
+// The small plane is built while walking the frame once: every pair of
+// level 0 rows (luma, or Bayer reduced to 8 bits) is halved into a level 1
+// row, every pair of level 1 rows into a level 2 row and so on, with one
+// row per level waiting for its pair.  A halving is
+//
+//   out[x] = avg (avg (a[2x], b[2x]), avg (a[2x + 1], b[2x + 1]))
+//
+// with avg (p, q) = (p + q + 1) >> 1, which is vu8_avg () on the unzipped
+// columns.  Odd rows and columns left over at any level are dropped.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+#include "motion.h"
+#include "bayer.h"
+#include "convert.h"
+#include "simd.h"
+
+#define AVG(p, q)   (((p) + (q) + 1) >> 1)
+
+static int motion_vector = 1;
+
+void motion_use_vector (int enable)
+{
+    motion_vector = enable;
+}
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void motion_defaults (struct motion_config * cfg)
+{
+    cfg->shift = 3;
+    cfg->threshold = 12;
+    cfg->min_changed = 2;
+    cfg->learn = 4;
+    cfg->preroll = 15;
+    cfg->postroll = 30;
+}
+
+//***********************************************************************************
+// Kernels
+//
+static void halve_row (const uint8_t * a, const uint8_t * b, uint8_t * out, unsigned int n)
+{
+unsigned int x = 0;
+
+#ifdef SIMD_VEC
+    if (motion_vector) {
+        for (; x + VU8_LANES <= n; x += VU8_LANES) {
+            vu8 ae, ao, be, bo;
+
+            vu8_load2 (a + 2 * x, &ae, &ao);
+            vu8_load2 (b + 2 * x, &be, &bo);
+            vu8_store (out + x, vu8_avg (vu8_avg (ae, be), vu8_avg (ao, bo)));
+        }
+    }
+#endif
+
+    for (; x < n; ++x)
+        out[x] = AVG (AVG (a[2 * x], b[2 * x]), AVG (a[2 * x + 1], b[2 * x + 1]));
+}
+
+static void luma_row (const uint8_t * src, uint8_t * y, unsigned int width, int uyvy)
+{
+unsigned int x = 0;
+
+#ifdef SIMD_VEC
+    if (motion_vector) {
+        for (; x + VU8_LANES <= width; x += VU8_LANES) {
+            vu8 even, odd;
+
+            vu8_load2 (src + 2 * x, &even, &odd);
+            vu8_store (y + x, uyvy ? odd : even);
+        }
+    }
+#endif
+
+    for (; x < width; ++x)
+        y[x] = src[2 * x + uyvy];
+}
+
+static unsigned int count_changed (const uint8_t * cur, const uint8_t * bg, size_t n,
+                                   unsigned int threshold)
+{
+unsigned int changed = 0;
+size_t i = 0;
+
+#ifdef SIMD_VEC
+    if (motion_vector) {
+        const vu8 t = vu8_set1 (threshold);
+        const vu8 one = vu8_set1 (1);
+
+        for (; i + VU8_LANES <= n; i += VU8_LANES) {
+            vu8 d = vu8_absdiff (vu8_load (cur + i), vu8_load (bg + i));
+
+            changed += vu8_hsum (vu8_and (vu8_lt (t, d), one));
+        }
+    }
+#endif
+
+    for (; i < n; ++i)
+        changed += (unsigned int)abs (cur[i] - bg[i]) > threshold;
+    return changed;
+}
+
+static void blend (uint8_t * bg, const uint8_t * cur, size_t n)
+{
+size_t i = 0;
+
+#ifdef SIMD_VEC
+    if (motion_vector) {
+        for (; i + VU8_LANES <= n; i += VU8_LANES)
+            vu8_store (bg + i, vu8_avg (vu8_load (bg + i), vu8_load (cur + i)));
+    }
+#endif
+
+    for (; i < n; ++i)
+        bg[i] = AVG (bg[i], cur[i]);
+}
+
+//***********************************************************************************
+int motion_init (struct motion * m, const struct motion_config * cfg,
+                 unsigned int width, unsigned int height, unsigned int fourcc)
+{
+enum bayer_order order;
+unsigned int level;
+
+    memset (m, 0, sizeof (*m));
+    if (cfg->shift < 1 || cfg->shift > MOTION_MAX_SHIFT || cfg->threshold > 254)
+        return -1;
+
+    if (fourcc != V4L2_PIX_FMT_YUYV && fourcc != V4L2_PIX_FMT_UYVY &&
+        bayer_from_fourcc (fourcc, &order, &m->bits) < 0)
+        return -1;
+
+    m->cfg = *cfg;
+    if (m->cfg.learn < 1)
+        m->cfg.learn = 1;
+    m->fourcc = fourcc;
+    m->width = width;
+    m->height = height;
+    m->w = width >> cfg->shift;
+    m->h = height >> cfg->shift;
+    if (m->w == 0 || m->h == 0)
+        return -1;
+
+    m->cur = malloc ((size_t)m->w * m->h);
+    m->bg = malloc ((size_t)m->w * m->h);
+    // scratch[0] holds the two level 0 rows of a pair.
+    m->scratch[0] = malloc (2 * (size_t)width);
+    for (level = 1; level <= cfg->shift; ++level)
+        m->scratch[level] = malloc (width >> level);
+    for (level = 1; level < cfg->shift; ++level)
+        m->pending[level] = malloc (width >> level);
+
+    if (m->cur == NULL || m->bg == NULL || m->scratch[0] == NULL) {
+        motion_free (m);
+        return -1;
+    }
+    for (level = 1; level <= cfg->shift; ++level) {
+        if (m->scratch[level] == NULL || (level < cfg->shift && m->pending[level] == NULL)) {
+            motion_free (m);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void motion_free (struct motion * m)
+{
+unsigned int i;
+
+    free (m->cur);
+    free (m->bg);
+    for (i = 0; i <= MOTION_MAX_SHIFT; ++i)
+        free (m->scratch[i]);
+    for (i = 0; i < MOTION_MAX_SHIFT; ++i)
+        free (m->pending[i]);
+    memset (m, 0, sizeof (*m));
+}
+
+//***********************************************************************************
+// A row of level (level >= 1) is ready.
+//
+static void push_row (struct motion * m, unsigned int level, const uint8_t * row)
+{
+unsigned int n = m->width >> level;
+
+    if (level == m->cfg.shift) {
+        if (m->rows < m->h)
+            memcpy (m->cur + (size_t)m->rows++ * m->w, row, m->w);
+        return;
+    }
+
+    if (!m->have[level]) {
+        memcpy (m->pending[level], row, n);
+        m->have[level] = 1;
+        return;
+    }
+
+    halve_row (m->pending[level], row, m->scratch[level + 1], n / 2);
+    m->have[level] = 0;
+    push_row (m, level + 1, m->scratch[level + 1]);
+}
+
+//
+// Level 0 row y: luma, or Bayer samples as 8 bits.
+//
+static const uint8_t * level0_row (struct motion * m, const uint8_t * data,
+                                   unsigned int stride, unsigned int y, uint8_t * buf)
+{
+const uint8_t *src = data + (size_t)y * stride;
+
+    if (m->bits == 0) {
+        luma_row (src, buf, m->width, m->fourcc == V4L2_PIX_FMT_UYVY);
+        return buf;
+    }
+    if (m->bits > 8) {
+        conv_raw16_to_raw8_row ((const uint16_t *)src, buf, m->width, m->bits);
+        return buf;
+    }
+    return src;
+}
+
+int motion_frame (struct motion * m, const void * data, unsigned int stride)
+{
+unsigned long long t = mono_us ();
+size_t pixels = (size_t)m->w * m->h;
+unsigned int y;
+int record;
+
+    memset (m->have, 0, sizeof (m->have));
+    m->rows = 0;
+
+    for (y = 0; y + 1 < m->height && m->rows < m->h; y += 2) {
+        const uint8_t *a = level0_row (m, data, stride, y, m->scratch[0]);
+        const uint8_t *b = level0_row (m, data, stride, y + 1, m->scratch[0] + m->width);
+
+        halve_row (a, b, m->scratch[1], m->width / 2);
+        push_row (m, 1, m->scratch[1]);
+    }
+
+    if (m->frames == 0) {
+        memcpy (m->bg, m->cur, pixels);
+        m->changed = 0;
+    } else {
+        m->changed = count_changed (m->cur, m->bg, pixels, m->cfg.threshold);
+        if (m->frames % m->cfg.learn == 0)
+            blend (m->bg, m->cur, pixels);
+    }
+
+    m->detected = (unsigned long long)m->changed * 1000 >
+                  (unsigned long long)m->cfg.min_changed * pixels;
+    if (m->detected) {
+        m->motion_frames++;
+        if (m->hold == 0)
+            m->events++;
+        m->hold = m->cfg.postroll + 1;
+    }
+    record = m->hold > 0;
+    if (m->hold)
+        m->hold--;
+
+    m->frames++;
+    m->busy_us += mono_us () - t;
+    return record;
+}
+
+//***********************************************************************************
+// Preroll ring
+//
+unsigned int preroll_max_slots (size_t slot_size)
+{
+unsigned long long avail = 0, kb;
+char line[128];
+FILE *fp;
+
+    fp = fopen ("/proc/meminfo", "r");
+    if (fp != NULL) {
+        while (fgets (line, sizeof (line), fp) != NULL)
+            if (sscanf (line, "MemAvailable: %llu kB", &kb) == 1) {
+                avail = kb * 1024;
+                break;
+            }
+        fclose (fp);
+    }
+    // Kernels before 3.14 have no MemAvailable.
+    if (avail == 0)
+        avail = (unsigned long long)sysconf (_SC_AVPHYS_PAGES) * sysconf (_SC_PAGESIZE);
+
+    avail /= 2;
+    if (slot_size == 0 || avail / slot_size > UINT_MAX)
+        return UINT_MAX;
+    return avail / slot_size;
+}
+
+int preroll_init (struct preroll * p, unsigned int slots, size_t slot_size)
+{
+    memset (p, 0, sizeof (*p));
+    if (slots == 0)
+        return 0;
+    if (slots > preroll_max_slots (slot_size)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    p->data = malloc (slots * slot_size);
+    p->frames = calloc (slots, sizeof (*p->frames));
+    if (p->data == NULL || p->frames == NULL) {
+        preroll_free (p);
+        return -1;
+    }
+    p->slots = slots;
+    p->slot_size = slot_size;
+    return 0;
+}
+
+void preroll_free (struct preroll * p)
+{
+    free (p->data);
+    free (p->frames);
+    memset (p, 0, sizeof (*p));
+}
+
+void preroll_push (struct preroll * p, const void * data, size_t size,
+                   unsigned int sequence, unsigned long long timestamp)
+{
+struct preroll_frame *f;
+uint8_t *slot;
+
+    if (p->slots == 0)
+        return;
+
+    slot = p->data + (size_t)p->next * p->slot_size;
+    f = &p->frames[p->next];
+    if (size > p->slot_size)
+        size = p->slot_size;
+    memcpy (slot, data, size);
+    f->data = slot;
+    f->size = size;
+    f->sequence = sequence;
+    f->timestamp = timestamp;
+
+    p->next = (p->next + 1) % p->slots;
+    if (p->count < p->slots)
+        p->count++;
+}
+
+int preroll_pop (struct preroll * p, struct preroll_frame * f)
+{
+    if (p->count == 0)
+        return -1;
+    *f = p->frames[(p->next + p->slots - p->count) % p->slots];
+    p->count--;
+    return 0;
+}
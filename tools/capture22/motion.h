@@ -0,0 +1,130 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Motion detector for motion triggered recording.
+//
+// Every frame is reduced to a small luma plane, 1 / 2^shift of the frame
+// size each way (YUYV: the Y samples; Bayer: 2x2 cells, reduced to 8 bits
+// first), by repeated rounding 2x2 averages; averaging 64 pixels at the
+// default shift 3 takes most of the sensor noise out.  The plane is
+// compared with a background, the running average of every learn-th
+// plane: the frame has motion when more than min_changed per mille of the
+// small pixels differ from the background by more than threshold.
+//
+// motion_frame () also runs the trigger: a frame is recorded when it has
+// motion or one of the postroll frames before it had.  The frames before
+// an event come from a preroll ring the caller fills with the frames that
+// are not recorded.
+//
+// The reduction and the comparison use the vector layer in simd.h;
+// motion_use_vector (0) selects the plain C path, which gives the same
+// results.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __MOTION_H
+#define __MOTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOTION_MAX_SHIFT    5
+
+struct motion_config {
+    unsigned int shift;             // downscale by 2^shift, 1..MOTION_MAX_SHIFT [3]
+    unsigned int threshold;         // per pixel difference [12]
+    unsigned int min_changed;       // changed pixels, per mille [2]
+    unsigned int learn;             // background update interval, frames [4]
+    unsigned int preroll;           // frames kept before an event [15]
+    unsigned int postroll;          // frames recorded after the last motion [30]
+};
+
+struct motion {
+    struct motion_config cfg;
+    unsigned int fourcc;
+    unsigned int bits;              // Bayer sample depth, 0 for YUYV / UYVY
+    unsigned int width;             // frame
+    unsigned int height;
+    unsigned int w;                 // small plane
+    unsigned int h;
+
+    uint8_t * cur;                  // small plane of the current frame
+    uint8_t * bg;                   // background
+    uint8_t * pending[MOTION_MAX_SHIFT];    // per level: row waiting for its pair
+    uint8_t * scratch[MOTION_MAX_SHIFT + 1];
+    unsigned int have[MOTION_MAX_SHIFT];
+    unsigned int rows;              // small plane rows done
+
+    unsigned int changed;           // small pixels over threshold, last frame
+    int detected;                   // last frame had motion
+    unsigned int hold;              // frames still to record after the last motion
+
+    unsigned long long frames;
+    unsigned long long motion_frames;
+    unsigned long long events;      // idle to recording transitions
+    unsigned long long busy_us;     // time spent in motion_frame ()
+};
+
+void motion_defaults (struct motion_config * cfg);
+void motion_use_vector (int enable);
+
+//
+// Set up for width x height frames of fourcc (YUYV, UYVY or Bayer).
+// Returns 0, or -1 for other formats, invalid sizes or out of memory.
+//
+int motion_init (struct motion * m, const struct motion_config * cfg,
+                 unsigned int width, unsigned int height, unsigned int fourcc);
+void motion_free (struct motion * m);
+
+//
+// Run the detector on a frame.  Returns 1 when the frame is to be
+// recorded, 0 otherwise.
+//
+int motion_frame (struct motion * m, const void * data, unsigned int stride);
+
+//
+// Preroll ring: the last slots frames, copied.  Every frame is kept in
+// full, so the ring costs slots frames of memory and a frame copy per
+// frame without motion.
+//
+struct preroll_frame {
+    const void * data;
+    size_t size;
+    unsigned int sequence;
+    unsigned long long timestamp;
+};
+
+struct preroll {
+    unsigned int slots;
+    unsigned int count;             // frames held
+    unsigned int next;              // slot the next push goes to
+    size_t slot_size;
+    uint8_t * data;
+    struct preroll_frame * frames;
+};
+
+//
+// Frames of slot_size bytes that fit in half of the memory the kernel
+// reports available.  preroll_init () refuses larger rings with ENOMEM.
+//
+unsigned int preroll_max_slots (size_t slot_size);
+
+int preroll_init (struct preroll * p, unsigned int slots, size_t slot_size);
+void preroll_free (struct preroll * p);
+
+//
+// Keep a copy of the frame, dropping the oldest one when the ring is full.
+// Frames larger than the slots are cut.
+//
+void preroll_push (struct preroll * p, const void * data, size_t size,
+                   unsigned int sequence, unsigned long long timestamp);
+
+//
+// Oldest frame, removed from the ring; valid until the next push.  Returns
+// 0, or -1 when the ring is empty.
+//
+int preroll_pop (struct preroll * p, struct preroll_frame * f);
+
+#endif /* __MOTION_H */
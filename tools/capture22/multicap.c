@@ -0,0 +1,409 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Synchronized multi-device capture, see multicap.h.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "multicap.h"
+
+#define EPOLL_TIMEOUT_MS    2000
+
+//***********************************************************************************
+static unsigned long long buf_ts_us (const struct v4l2_buffer * buf)
+{
+    return (unsigned long long)buf->timestamp.tv_sec * 1000000 + buf->timestamp.tv_usec;
+}
+
+//***********************************************************************************
+static int capdev_arm (struct multicap * mc, unsigned int i, int arm)
+{
+struct epoll_event ev;
+
+    CLEAR (ev);
+    ev.events = arm ? EPOLLIN : 0;
+    ev.data.u32 = i;
+    if (-1 == epoll_ctl (mc->epfd, EPOLL_CTL_MOD, mc->devs[i].fd, &ev)) {
+        fprintf (stderr, "%s: epoll_ctl error %d, %s\n", mc->devs[i].name,
+                 errno, strerror (errno));
+        return -1;
+    }
+
+    mc->devs[i].armed = arm;
+    return 0;
+}
+
+//***********************************************************************************
+static int capdev_init (struct capdev * dev, const struct multicap_format * format)
+{
+struct v4l2_capability cap;
+struct v4l2_format fmt;
+struct v4l2_requestbuffers req;
+unsigned int i;
+
+    dev->fd = open (dev->name, O_RDWR | O_NONBLOCK, 0);
+    if (-1 == dev->fd) {
+        fprintf (stderr, "Cannot open %s: %d, %s\n", dev->name, errno, strerror (errno));
+        return -1;
+    }
+
+    if (-1 == xioctl (dev->fd, VIDIOC_QUERYCAP, &cap)) {
+        fprintf (stderr, "%s is no V4L2 device\n", dev->name);
+        return -1;
+    }
+    if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
+        !(cap.capabilities & V4L2_CAP_STREAMING)) {
+        fprintf (stderr, "%s is no streaming capture device\n", dev->name);
+        return -1;
+    }
+
+    CLEAR (fmt);
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = format->width;
+    fmt.fmt.pix.height = format->height;
+    fmt.fmt.pix.pixelformat = format->pixelformat;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (-1 == xioctl (dev->fd, VIDIOC_S_FMT, &fmt))
+        printf ("%s: VIDIOC_S_FMT failed, using current format\n", dev->name);
+    else
+        printf ("%s: %ux%u format 0x%x\n", dev->name, fmt.fmt.pix.width,
+                fmt.fmt.pix.height, fmt.fmt.pix.pixelformat);
+
+    CLEAR (req);
+    req.count = format->nbufs;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (-1 == xioctl (dev->fd, VIDIOC_REQBUFS, &req)) {
+        fprintf (stderr, "%s does not support memory mapping\n", dev->name);
+        return -1;
+    }
+    if (req.count < 2) {
+        fprintf (stderr, "Insufficient buffer memory on %s\n", dev->name);
+        return -1;
+    }
+
+    dev->buffers = calloc (req.count, sizeof (*dev->buffers));
+    if (!dev->buffers) {
+        fprintf (stderr, "Out of memory\n");
+        return -1;
+    }
+
+    for (i = 0; i < req.count; ++i) {
+        struct v4l2_buffer buf;
+
+        CLEAR (buf);
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (-1 == xioctl (dev->fd, VIDIOC_QUERYBUF, &buf)) {
+            fprintf (stderr, "%s: VIDIOC_QUERYBUF failed\n", dev->name);
+            return -1;
+        }
+
+        dev->buffers[i].length = buf.length;
+        dev->buffers[i].start = mmap (NULL, buf.length, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED, dev->fd, buf.m.offset);
+        if (MAP_FAILED == dev->buffers[i].start) {
+            dev->buffers[i].start = NULL;
+            fprintf (stderr, "%s: mmap failed\n", dev->name);
+            return -1;
+        }
+        dev->n_buffers++;
+    }
+
+    return 0;
+}
+
+//***********************************************************************************
+int multicap_open (struct multicap * mc, char * const names[], unsigned int count,
+                   const struct multicap_format * format, unsigned int tolerance_us)
+{
+struct epoll_event ev;
+unsigned int i;
+
+    memset (mc, 0, sizeof (*mc));
+    mc->epfd = -1;
+    mc->tolerance_us = tolerance_us;
+
+    if (count == 0 || count > MULTICAP_MAX_DEVICES) {
+        fprintf (stderr, "multicap: 1 to %d devices supported\n", MULTICAP_MAX_DEVICES);
+        return -1;
+    }
+
+    for (i = 0; i < count; ++i) {
+        mc->devs[i].name = names[i];
+        mc->devs[i].fd = -1;
+        mc->devs[i].held = -1;
+    }
+    mc->count = count;
+
+    mc->epfd = epoll_create (count);
+    if (-1 == mc->epfd) {
+        fprintf (stderr, "epoll_create error %d, %s\n", errno, strerror (errno));
+        return -1;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (capdev_init (&mc->devs[i], format) < 0)
+            return -1;
+
+        CLEAR (ev);
+        ev.events = 0;
+        ev.data.u32 = i;
+        if (-1 == epoll_ctl (mc->epfd, EPOLL_CTL_ADD, mc->devs[i].fd, &ev)) {
+            fprintf (stderr, "epoll_ctl error %d, %s\n", errno, strerror (errno));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+//***********************************************************************************
+int multicap_start (struct multicap * mc)
+{
+enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+unsigned int i, j;
+
+    for (i = 0; i < mc->count; ++i) {
+        struct capdev *dev = &mc->devs[i];
+
+        for (j = 0; j < dev->n_buffers; ++j) {
+            struct v4l2_buffer buf;
+
+            CLEAR (buf);
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = j;
+            if (-1 == ioctl (dev->fd, VIDIOC_QBUF, &buf)) {
+                fprintf (stderr, "%s: VIDIOC_QBUF error %d, %s\n", dev->name,
+                         errno, strerror (errno));
+                return -1;
+            }
+        }
+    }
+
+    // Start all devices back to back to keep the initial skew small.
+    for (i = 0; i < mc->count; ++i) {
+        if (-1 == xioctl (mc->devs[i].fd, VIDIOC_STREAMON, &type)) {
+            fprintf (stderr, "%s: VIDIOC_STREAMON failed\n", mc->devs[i].name);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < mc->count; ++i)
+        if (capdev_arm (mc, i, 1) < 0)
+            return -1;
+
+    return 0;
+}
+
+//***********************************************************************************
+// Dequeue one frame from device i and hold it for matching.
+//
+static int capdev_dequeue (struct multicap * mc, unsigned int i)
+{
+struct capdev *dev = &mc->devs[i];
+
+    CLEAR (dev->buf);
+    dev->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    dev->buf.memory = V4L2_MEMORY_MMAP;
+
+    if (-1 == ioctl (dev->fd, VIDIOC_DQBUF, &dev->buf)) {
+        if (errno == EAGAIN)
+            return 0;
+        fprintf (stderr, "%s: VIDIOC_DQBUF error %d, %s\n", dev->name,
+                 errno, strerror (errno));
+        return -1;
+    }
+
+    if (dev->buf.index >= dev->n_buffers) {
+        fprintf (stderr, "%s: bogus buffer index %u\n", dev->name, dev->buf.index);
+        return -1;
+    }
+
+    if (dev->seq_valid && dev->buf.sequence > dev->last_seq + 1)
+        dev->lost += dev->buf.sequence - dev->last_seq - 1;
+    dev->last_seq = dev->buf.sequence;
+    dev->seq_valid = 1;
+
+    dev->frames++;
+    dev->held = dev->buf.index;
+    dev->ts = buf_ts_us (&dev->buf);
+
+    // Nothing more to read from this device until the frame is released.
+    return capdev_arm (mc, i, 0);
+}
+
+//***********************************************************************************
+static int capdev_requeue (struct multicap * mc, unsigned int i)
+{
+struct capdev *dev = &mc->devs[i];
+
+    if (-1 == ioctl (dev->fd, VIDIOC_QBUF, &dev->buf)) {
+        fprintf (stderr, "%s: VIDIOC_QBUF error %d, %s\n", dev->name,
+                 errno, strerror (errno));
+        return -1;
+    }
+
+    dev->held = -1;
+    return capdev_arm (mc, i, 1);
+}
+
+//***********************************************************************************
+// Deliver a set if every device holds a frame.  Returns 1 if a set was
+// delivered, 0 if not, -1 on error.
+//
+static int multicap_match (struct multicap * mc, multicap_set_fn fn, void * priv)
+{
+struct multicap_frame frames[MULTICAP_MAX_DEVICES];
+unsigned long long lo = ~0ULL, hi = 0, skew;
+unsigned int i, oldest = 0;
+
+    for (i = 0; i < mc->count; ++i) {
+        if (mc->devs[i].held < 0)
+            return 0;
+        if (mc->devs[i].ts < lo) {
+            lo = mc->devs[i].ts;
+            oldest = i;
+        }
+        if (mc->devs[i].ts > hi)
+            hi = mc->devs[i].ts;
+    }
+
+    skew = hi - lo;
+    if (skew > mc->tolerance_us) {
+        // Every other device is already past this frame, it can't pair.
+        mc->devs[oldest].unmatched++;
+        return capdev_requeue (mc, oldest) < 0 ? -1 : 0;
+    }
+
+    for (i = 0; i < mc->count; ++i) {
+        struct capdev *dev = &mc->devs[i];
+
+        frames[i].start = dev->buffers[dev->held].start;
+        frames[i].bytesused = dev->buf.bytesused ? dev->buf.bytesused
+                                                 : dev->buffers[dev->held].length;
+        frames[i].ts = dev->ts;
+        frames[i].sequence = dev->buf.sequence;
+    }
+
+    if (fn)
+        fn (mc, mc->sets, frames, priv);
+
+    mc->sets++;
+    mc->skew_sum += skew;
+    if (skew > mc->skew_max)
+        mc->skew_max = skew;
+
+    for (i = 0; i < mc->count; ++i)
+        if (capdev_requeue (mc, i) < 0)
+            return -1;
+
+    return 1;
+}
+
+//***********************************************************************************
+int multicap_run (struct multicap * mc, unsigned int sets, multicap_set_fn fn, void * priv)
+{
+struct epoll_event events[MULTICAP_MAX_DEVICES];
+unsigned int delivered = 0;
+int n, i, ret;
+
+    while (delivered < sets) {
+        n = epoll_wait (mc->epfd, events, MULTICAP_MAX_DEVICES, EPOLL_TIMEOUT_MS);
+        if (-1 == n) {
+            if (EINTR == errno)
+                continue;
+            fprintf (stderr, "epoll_wait error %d, %s\n", errno, strerror (errno));
+            return -1;
+        }
+        if (0 == n) {
+            fprintf (stderr, "epoll timeout\n");
+            return delivered;
+        }
+
+        for (i = 0; i < n; ++i) {
+            unsigned int idx = events[i].data.u32;
+
+            if (mc->devs[idx].held < 0 && capdev_dequeue (mc, idx) < 0)
+                return -1;
+        }
+
+        ret = multicap_match (mc, fn, priv);
+        if (ret < 0)
+            return -1;
+        delivered += ret;
+    }
+
+    return delivered;
+}
+
+//***********************************************************************************
+void multicap_stop (struct multicap * mc)
+{
+enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+unsigned int i;
+
+    for (i = 0; i < mc->count; ++i) {
+        if (mc->devs[i].fd == -1)
+            continue;
+        if (mc->devs[i].armed)
+            capdev_arm (mc, i, 0);
+        xioctl (mc->devs[i].fd, VIDIOC_STREAMOFF, &type);
+        mc->devs[i].held = -1;
+    }
+}
+
+//***********************************************************************************
+void multicap_close (struct multicap * mc)
+{
+unsigned int i, j;
+
+    for (i = 0; i < mc->count; ++i) {
+        struct capdev *dev = &mc->devs[i];
+
+        for (j = 0; j < dev->n_buffers; ++j)
+            munmap (dev->buffers[j].start, dev->buffers[j].length);
+        free (dev->buffers);
+        dev->buffers = NULL;
+        dev->n_buffers = 0;
+
+        if (dev->fd != -1)
+            close (dev->fd);
+        dev->fd = -1;
+    }
+
+    if (mc->epfd != -1)
+        close (mc->epfd);
+    mc->epfd = -1;
+}
+
+//***********************************************************************************
+void multicap_report (struct multicap * mc, FILE * fp)
+{
+unsigned int i;
+
+    fprintf (fp, "\n%-20s %8s %8s %10s\n", "device", "frames", "lost", "unmatched");
+    for (i = 0; i < mc->count; ++i)
+        fprintf (fp, "%-20s %8u %8u %10u\n", mc->devs[i].name, mc->devs[i].frames,
+                 mc->devs[i].lost, mc->devs[i].unmatched);
+
+    fprintf (fp, "matched sets: %u, tolerance %u us", mc->sets, mc->tolerance_us);
+    if (mc->sets)
+        fprintf (fp, ", skew mean %llu us max %llu us",
+                 mc->skew_sum / mc->sets, mc->skew_max);
+    fprintf (fp, "\n");
+}
@@ -0,0 +1,95 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Synchronized capture from several video nodes (stereo and multi-sensor
+// rigs).
+//
+// All devices are streamed with MMAP buffers from a single epoll loop.  Each
+// device holds at most one dequeued frame; as soon as every device holds a
+// frame and the V4L2 timestamps agree within the tolerance, the set is
+// handed to the callback by pointer and all buffers are requeued.  When they
+// do not agree the oldest frame can no longer be matched and is requeued as
+// unmatched.  Frames are never copied.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __MULTICAP_H
+#define __MULTICAP_H
+
+#include <stdio.h>
+#include <linux/videodev2.h>
+
+#include "capture22.h"
+
+#define MULTICAP_MAX_DEVICES    8
+
+struct capdev {
+    const char * name;
+    int fd;
+    struct buffer * buffers;
+    unsigned int n_buffers;
+
+    int armed;                      // fd is in the epoll interest set
+    int held;                       // index of the held buffer, -1 if none
+    struct v4l2_buffer buf;         // held buffer as returned by DQBUF
+    unsigned long long ts;          // held buffer timestamp (us)
+
+    // Statistics
+    unsigned int frames;            // frames dequeued
+    unsigned int lost;              // frames dropped by the driver (sequence gaps)
+    unsigned int unmatched;         // frames discarded by the matcher
+    unsigned int last_seq;
+    int seq_valid;
+};
+
+// One frame of a matched set, pointing into the device mmap buffer
+struct multicap_frame {
+    const void * start;
+    size_t bytesused;
+    unsigned long long ts;          // V4L2 timestamp (us)
+    unsigned int sequence;
+};
+
+struct multicap {
+    struct capdev devs[MULTICAP_MAX_DEVICES];
+    unsigned int count;
+    int epfd;
+    unsigned int tolerance_us;
+
+    // Pair level statistics
+    unsigned int sets;
+    unsigned long long skew_sum;
+    unsigned long long skew_max;
+};
+
+struct multicap_format {
+    unsigned int width;
+    unsigned int height;
+    unsigned int pixelformat;
+    unsigned int nbufs;
+};
+
+//
+// Called for every matched set.  frames[i] belongs to mc->devs[i] and is
+// only valid until the callback returns.
+//
+typedef void (*multicap_set_fn) (struct multicap * mc, unsigned int set,
+                                 const struct multicap_frame * frames, void * priv);
+
+int multicap_open (struct multicap * mc, char * const names[], unsigned int count,
+                   const struct multicap_format * format, unsigned int tolerance_us);
+int multicap_start (struct multicap * mc);
+
+//
+// Run until sets matched sets have been delivered.  Returns the number of
+// sets delivered, or -1 on error.
+//
+int multicap_run (struct multicap * mc, unsigned int sets, multicap_set_fn fn, void * priv);
+
+void multicap_stop (struct multicap * mc);
+void multicap_close (struct multicap * mc);
+void multicap_report (struct multicap * mc, FILE * fp);
+
+#endif /* __MULTICAP_H */
@@ -0,0 +1,469 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Frame processing pipeline, see pipeline.h.
+//
+// The queues are bounded multi-producer/multi-consumer rings using a
+// per-cell sequence number (D. Vyukov's algorithm), so producers and
+// consumers never take a lock.  A counting semaphore per queue only serves
+// to put idle workers (and blocked producers) to sleep; it is touched on
+// every operation but does not enter the kernel unless somebody waits.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "pipeline.h"
+
+#define CACHE_LINE  64
+
+//***********************************************************************************
+// Lock-free bounded queue
+//
+struct pipe_cell {
+    volatile unsigned long seq;
+    struct pipe_frame * frame;
+};
+
+struct pipe_queue {
+    struct pipe_cell * cells;
+    unsigned long mask;
+    volatile unsigned long head __attribute__ ((aligned (CACHE_LINE)));
+    volatile unsigned long tail __attribute__ ((aligned (CACHE_LINE)));
+    sem_t items;            // posted once per pushed frame
+    sem_t space;            // free cells, PIPE_BLOCK only
+};
+
+static int queue_init (struct pipe_queue * q, unsigned int depth)
+{
+unsigned long size = 1, i;
+
+    while (size < depth)
+        size <<= 1;
+
+    q->cells = calloc (size, sizeof (*q->cells));
+    if (q->cells == NULL)
+        return -1;
+
+    for (i = 0; i < size; ++i)
+        q->cells[i].seq = i;
+    q->mask = size - 1;
+    q->head = 0;
+    q->tail = 0;
+    sem_init (&q->items, 0, 0);
+    sem_init (&q->space, 0, size);
+
+    return 0;
+}
+
+static void queue_free (struct pipe_queue * q)
+{
+    if (q->cells == NULL)
+        return;
+
+    sem_destroy (&q->items);
+    sem_destroy (&q->space);
+    free (q->cells);
+    q->cells = NULL;
+}
+
+// Returns 0 on success, -1 when the queue is full.
+static int queue_push (struct pipe_queue * q, struct pipe_frame * frame)
+{
+struct pipe_cell *cell;
+unsigned long pos = q->tail;
+long dif;
+
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        dif = (long)(cell->seq - pos);
+        __sync_synchronize ();
+        if (dif == 0) {
+            if (__sync_bool_compare_and_swap (&q->tail, pos, pos + 1))
+                break;
+            pos = q->tail;
+        } else if (dif < 0) {
+            return -1;
+        } else {
+            pos = q->tail;
+        }
+    }
+
+    cell->frame = frame;
+    __sync_synchronize ();
+    cell->seq = pos + 1;
+
+    return 0;
+}
+
+// Returns the oldest frame, or NULL when the queue is empty.
+static struct pipe_frame * queue_pop (struct pipe_queue * q)
+{
+struct pipe_frame *frame;
+struct pipe_cell *cell;
+unsigned long pos = q->head;
+long dif;
+
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        dif = (long)(cell->seq - (pos + 1));
+        __sync_synchronize ();
+        if (dif == 0) {
+            if (__sync_bool_compare_and_swap (&q->head, pos, pos + 1))
+                break;
+            pos = q->head;
+        } else if (dif < 0) {
+            return NULL;
+        } else {
+            pos = q->head;
+        }
+    }
+
+    frame = cell->frame;
+    __sync_synchronize ();
+    cell->seq = pos + q->mask + 1;
+
+    return frame;
+}
+
+//***********************************************************************************
+// Pipeline
+//
+struct pipe_stage;
+
+struct pipe_worker {
+    pthread_t thread;
+    struct pipe_stage * stage;
+    int running;
+    unsigned int processed;
+    unsigned int filtered;
+    unsigned long long busy_us;
+    unsigned long long max_us;
+};
+
+struct pipe_stage {
+    char name[32];
+    pipe_stage_fn fn;
+    void * priv;
+    enum pipe_policy policy;
+    int sink;
+    struct pipe_queue queue;
+    unsigned int nworkers;
+    struct pipe_worker workers[PIPE_MAX_WORKERS];
+    volatile int stop;
+    struct pipeline * pl;
+    unsigned int index;
+
+    // Producer side counters, updated atomically
+    volatile unsigned int queued;
+    volatile unsigned int dropped;
+    volatile unsigned int blocked;
+};
+
+struct pipeline {
+    struct pipe_stage stages[PIPE_MAX_STAGES];
+    unsigned int nstages;           // processing stages followed by sinks
+    unsigned int nsinks;
+    pipe_release_fn release;
+    void * priv;
+    int started;
+};
+
+//***********************************************************************************
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//***********************************************************************************
+// Drop one reference, give the frame back to the source on the last one.
+//
+static void frame_put (struct pipeline * pl, struct pipe_frame * frame)
+{
+    if (__sync_sub_and_fetch (&frame->refs, 1) == 0)
+        pl->release (frame, pl->priv);
+}
+
+//***********************************************************************************
+static void stage_push (struct pipe_stage * st, struct pipe_frame * frame)
+{
+struct pipe_frame *victim;
+
+    if (st->policy == PIPE_BLOCK) {
+        if (sem_trywait (&st->queue.space) == -1) {
+            __sync_fetch_and_add (&st->blocked, 1);
+            while (sem_wait (&st->queue.space) == -1 && errno == EINTR)
+                ;
+        }
+        queue_push (&st->queue, frame);
+    } else {
+        while (queue_push (&st->queue, frame) == -1) {
+            // The frame stolen here was counted in items, the consumer that
+            // wakes up for it simply finds the next frame or nothing.
+            victim = queue_pop (&st->queue);
+            if (victim) {
+                __sync_fetch_and_add (&st->dropped, 1);
+                frame_put (st->pl, victim);
+            }
+        }
+    }
+
+    __sync_fetch_and_add (&st->queued, 1);
+    sem_post (&st->queue.items);
+}
+
+//***********************************************************************************
+// Pass a frame that completed stage index to whatever comes next.
+//
+static void stage_forward (struct pipeline * pl, unsigned int index, struct pipe_frame * frame)
+{
+unsigned int first_sink = pl->nstages - pl->nsinks;
+unsigned int i;
+
+    if (index + 1 < first_sink) {
+        stage_push (&pl->stages[index + 1], frame);
+        return;
+    }
+
+    if (pl->nsinks == 0) {
+        frame_put (pl, frame);
+        return;
+    }
+
+    // Fan out: one reference per sink replaces the one we hold.
+    __sync_fetch_and_add (&frame->refs, pl->nsinks - 1);
+    for (i = first_sink; i < pl->nstages; ++i)
+        stage_push (&pl->stages[i], frame);
+}
+
+//***********************************************************************************
+static void * stage_worker (void * arg)
+{
+struct pipe_worker *w = arg;
+struct pipe_stage *st = w->stage;
+struct pipe_frame *frame;
+unsigned long long start, busy;
+int ret;
+
+    for (;;) {
+        while (sem_wait (&st->queue.items) == -1 && errno == EINTR)
+            ;
+
+        frame = queue_pop (&st->queue);
+        if (frame == NULL) {
+            if (st->stop)
+                break;
+            continue;
+        }
+        if (st->policy == PIPE_BLOCK)
+            sem_post (&st->queue.space);
+
+        start = mono_us ();
+        ret = st->fn (frame, st->priv);
+        busy = mono_us () - start;
+
+        w->processed++;
+        w->busy_us += busy;
+        if (busy > w->max_us)
+            w->max_us = busy;
+
+        if (ret < 0) {
+            w->filtered++;
+            frame_put (st->pl, frame);
+        } else if (st->sink) {
+            frame_put (st->pl, frame);
+        } else {
+            stage_forward (st->pl, st->index, frame);
+        }
+    }
+
+    return NULL;
+}
+
+//***********************************************************************************
+struct pipeline * pipeline_create (pipe_release_fn release, void * priv)
+{
+struct pipeline *pl;
+
+    pl = calloc (1, sizeof (*pl));
+    if (pl == NULL)
+        return NULL;
+
+    pl->release = release;
+    pl->priv = priv;
+    return pl;
+}
+
+//***********************************************************************************
+static int pipeline_add (struct pipeline * pl, const char * name, pipe_stage_fn fn,
+                         void * priv, unsigned int workers, unsigned int depth,
+                         enum pipe_policy policy, int sink)
+{
+struct pipe_stage *st;
+
+    if (pl->started || pl->nstages == PIPE_MAX_STAGES || fn == NULL)
+        return -1;
+    // Processing stages must come before the sinks.
+    if (!sink && pl->nsinks)
+        return -1;
+
+    if (workers == 0)
+        workers = 1;
+    if (workers > PIPE_MAX_WORKERS)
+        workers = PIPE_MAX_WORKERS;
+    if (depth == 0)
+        depth = 1;
+
+    st = &pl->stages[pl->nstages];
+    memset (st, 0, sizeof (*st));
+    strncpy (st->name, name, sizeof (st->name) - 1);
+    st->fn = fn;
+    st->priv = priv;
+    st->policy = policy;
+    st->sink = sink;
+    st->nworkers = workers;
+    st->pl = pl;
+    st->index = pl->nstages;
+
+    if (queue_init (&st->queue, depth) < 0)
+        return -1;
+
+    pl->nstages++;
+    if (sink)
+        pl->nsinks++;
+
+    return 0;
+}
+
+int pipeline_add_stage (struct pipeline * pl, const char * name, pipe_stage_fn fn,
+                        void * priv, unsigned int workers, unsigned int depth,
+                        enum pipe_policy policy)
+{
+    return pipeline_add (pl, name, fn, priv, workers, depth, policy, 0);
+}
+
+int pipeline_add_sink (struct pipeline * pl, const char * name, pipe_stage_fn fn,
+                       void * priv, unsigned int workers, unsigned int depth,
+                       enum pipe_policy policy)
+{
+    return pipeline_add (pl, name, fn, priv, workers, depth, policy, 1);
+}
+
+//***********************************************************************************
+int pipeline_start (struct pipeline * pl)
+{
+unsigned int i, j;
+
+    for (i = 0; i < pl->nstages; ++i) {
+        struct pipe_stage *st = &pl->stages[i];
+
+        for (j = 0; j < st->nworkers; ++j) {
+            st->workers[j].stage = st;
+            if (pthread_create (&st->workers[j].thread, NULL, stage_worker,
+                                &st->workers[j]) != 0) {
+                fprintf (stderr, "pipeline: unable to start %s worker %u\n",
+                         st->name, j);
+                pipeline_stop (pl);
+                return -1;
+            }
+            st->workers[j].running = 1;
+        }
+    }
+
+    pl->started = 1;
+    return 0;
+}
+
+//***********************************************************************************
+int pipeline_submit (struct pipeline * pl, struct pipe_frame * frame)
+{
+    frame->refs = 1;
+
+    if (pl->nstages == 0) {
+        frame_put (pl, frame);
+        return 0;
+    }
+
+    if (pl->nstages == pl->nsinks)
+        stage_forward (pl, (unsigned int)-1, frame);
+    else
+        stage_push (&pl->stages[0], frame);
+
+    return 0;
+}
+
+//***********************************************************************************
+void pipeline_stop (struct pipeline * pl)
+{
+unsigned int i, j;
+
+    // Stop in order so every stage sees the last output of its producer.
+    for (i = 0; i < pl->nstages; ++i) {
+        struct pipe_stage *st = &pl->stages[i];
+
+        st->stop = 1;
+        for (j = 0; j < st->nworkers; ++j)
+            sem_post (&st->queue.items);
+        for (j = 0; j < st->nworkers; ++j) {
+            if (st->workers[j].running)
+                pthread_join (st->workers[j].thread, NULL);
+            st->workers[j].running = 0;
+        }
+    }
+
+    pl->started = 0;
+}
+
+//***********************************************************************************
+void pipeline_report (struct pipeline * pl, FILE * fp)
+{
+unsigned int i, j;
+
+    fprintf (fp, "\n%-12s %4s %8s %8s %8s %8s %10s %10s\n", "stage", "thr",
+             "frames", "dropped", "filtered", "blocked", "avg us", "max us");
+
+    for (i = 0; i < pl->nstages; ++i) {
+        struct pipe_stage *st = &pl->stages[i];
+        unsigned long long busy = 0, max = 0;
+        unsigned int processed = 0, filtered = 0;
+
+        for (j = 0; j < st->nworkers; ++j) {
+            processed += st->workers[j].processed;
+            filtered += st->workers[j].filtered;
+            busy += st->workers[j].busy_us;
+            if (st->workers[j].max_us > max)
+                max = st->workers[j].max_us;
+        }
+
+        fprintf (fp, "%-12s %4u %8u %8u %8u %8u %10llu %10llu%s\n", st->name,
+                 st->nworkers, processed, st->dropped, filtered, st->blocked,
+                 processed ? busy / processed : 0, max, st->sink ? " (sink)" : "");
+    }
+}
+
+//***********************************************************************************
+void pipeline_destroy (struct pipeline * pl)
+{
+unsigned int i;
+
+    if (pl == NULL)
+        return;
+
+    if (pl->started)
+        pipeline_stop (pl);
+
+    for (i = 0; i < pl->nstages; ++i)
+        queue_free (&pl->stages[i].queue);
+    free (pl);
+}
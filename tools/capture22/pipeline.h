@@ -0,0 +1,85 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Frame processing pipeline: source -> processing stages -> sinks.
+//
+// The source (the capture loop) submits frames which then travel through
+// the processing stages in order and are finally handed to every sink.
+// Each stage has its own pool of worker threads and a bounded lock-free
+// input queue.  When a queue is full the stage policy decides whether the
+// producer blocks (PIPE_BLOCK) or the oldest queued frame is dropped
+// (PIPE_DROP_OLDEST).  Once a frame has left the last sink, or has been
+// dropped or filtered out, the release callback gives it back to the source
+// (typically VIDIOC_QBUF).
+//
+// With more than one worker a stage may complete frames out of order.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+#include <stdio.h>
+
+#define PIPE_MAX_STAGES     8
+#define PIPE_MAX_WORKERS    8
+
+enum pipe_policy {
+    PIPE_BLOCK,             // producer waits for room
+    PIPE_DROP_OLDEST,       // oldest queued frame is released to make room
+};
+
+struct pipe_frame {
+    void * data;
+    size_t length;
+    unsigned int index;             // source buffer index
+    unsigned int sequence;
+    unsigned long long ts;          // capture timestamp (us)
+    unsigned int flags;             // set by the source
+    void * priv;                    // free for stages to annotate the frame
+    volatile int refs;              // owned by the pipeline
+};
+
+//
+// Stage and sink callback.  Return 0 to pass the frame on, a negative value
+// to drop it (it is released without reaching later stages).
+//
+typedef int (*pipe_stage_fn) (struct pipe_frame * frame, void * priv);
+typedef void (*pipe_release_fn) (struct pipe_frame * frame, void * priv);
+
+struct pipeline;
+
+struct pipeline * pipeline_create (pipe_release_fn release, void * priv);
+
+//
+// Add a processing stage (or a sink) with workers threads and an input
+// queue of depth frames (rounded up to a power of two).  Stages run in the
+// order they are added; sinks run after the last stage, each on its own
+// copy of the frame reference.  Returns 0 or -1.
+//
+int pipeline_add_stage (struct pipeline * pl, const char * name, pipe_stage_fn fn,
+                        void * priv, unsigned int workers, unsigned int depth,
+                        enum pipe_policy policy);
+int pipeline_add_sink (struct pipeline * pl, const char * name, pipe_stage_fn fn,
+                       void * priv, unsigned int workers, unsigned int depth,
+                       enum pipe_policy policy);
+
+int pipeline_start (struct pipeline * pl);
+
+//
+// Hand a frame to the first stage.  Returns 0 once queued (the frame may
+// still be dropped later), -1 on error.
+//
+int pipeline_submit (struct pipeline * pl, struct pipe_frame * frame);
+
+//
+// Drain all queues stage by stage and join the workers.
+//
+void pipeline_stop (struct pipeline * pl);
+
+void pipeline_report (struct pipeline * pl, FILE * fp);
+void pipeline_destroy (struct pipeline * pl);
+
+#endif /* __PIPELINE_H */
@@ -0,0 +1,570 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Lossless Bayer codec, see rawcodec.h.
+//
+// Residuals e, taken modulo 2^bits, are folded to u = 2e (e >= 0) or
+// -2e - 1.  Each row is cut into blocks of BLOCK samples, written as the
+// bit length b of the largest u of the block in BLOCK_BITS bits followed by
+// the BLOCK values in b bits each, MSB first.  b is at most bits, so the
+// worst case is bits + BLOCK_BITS / BLOCK bits per sample.
+//
+// Prediction and folding need no state from the previous sample, so they
+// run over whole rows and the coder only packs bits: no unary codes and no
+// adaptive parameter, which an adaptive Rice coder of the residuals spends
+// most of its time on.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "rawcodec.h"
+#include "simd.h"
+
+#define BLOCK               16
+#define BLOCK_BITS          5
+
+#define HEADER_WORDS        5
+#define MAGIC               0x32434252      // "RBC2"
+
+struct bitw {
+    uint8_t * p;
+    uint64_t acc;
+    unsigned int n;                 // pending bits in acc, < 32 between calls
+};
+
+struct bitr {
+    const uint8_t * p;
+    const uint8_t * end;
+    uint64_t acc;                   // next bits, MSB first
+    unsigned int n;                 // valid bits in acc
+    size_t pad;                     // zero bytes read past the end
+};
+
+//***********************************************************************************
+static inline void put_be32 (uint8_t * p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint64_t get_be64 (const uint8_t * p)
+{
+    return (uint64_t)p[0] << 56 | (uint64_t)p[1] << 48 | (uint64_t)p[2] << 40 |
+           (uint64_t)p[3] << 32 | (uint64_t)p[4] << 24 | (uint64_t)p[5] << 16 |
+           (uint64_t)p[6] << 8 | p[7];
+}
+
+// nb <= 32; a word is stored once 32 bits are pending.
+static inline void put_bits (struct bitw * w, uint32_t v, unsigned int nb)
+{
+    w->acc = (w->acc << nb) | v;
+    w->n += nb;
+    if (w->n >= 32) {
+        w->n -= 32;
+        put_be32 (w->p, w->acc >> w->n);
+        w->p += 4;
+    }
+}
+
+static inline void flush_bits (struct bitw * w)
+{
+    while (w->n >= 8) {
+        w->n -= 8;
+        *w->p++ = w->acc >> w->n;
+    }
+    if (w->n)
+        *w->p++ = w->acc << (8 - w->n);
+    w->n = 0;
+}
+
+// Leaves at least 56 bits in acc.  Away from the end of the tile the bytes
+// are read 8 at a time; the bits past n are the following ones of the
+// stream, so or-ing them in again on the next refill is harmless.
+static inline void refill (struct bitr * r)
+{
+    if (r->n > 56)
+        return;
+    if (r->end - r->p >= 8) {
+        r->acc |= get_be64 (r->p) >> r->n;
+        r->p += (63 - r->n) >> 3;
+        r->n |= 56;
+        return;
+    }
+    while (r->n <= 56) {
+        if (r->p < r->end)
+            r->acc |= (uint64_t)*r->p++ << (56 - r->n);
+        else
+            r->pad++;
+        r->n += 8;
+    }
+}
+
+//***********************************************************************************
+// Residual of cur against pred modulo 2^bits, folded.
+//
+static inline uint16_t fold (int cur, int pred, int half)
+{
+int e = ((cur - pred + half) & (2 * half - 1)) - half;
+
+    return e >= 0 ? 2 * e : -2 * e - 1;
+}
+
+static inline int unfold (unsigned int u)
+{
+    return (int)(u >> 1) ^ -(int)(u & 1);
+}
+
+//
+// Residuals of one row.  The first two rows of a tile are predicted from
+// the same-colour sample to the left (W), the first two samples from
+// mid-range, and the other rows from the same-colour sample two rows up (N).
+// The vector paths compute the same values modulo 2^16.
+//
+static void fold_row (const uint16_t * cur, const uint16_t * up, uint16_t * res,
+                      unsigned int w, int half)
+{
+unsigned int x = 0;
+
+    if (up == NULL) {
+        res[0] = fold (cur[0], half, half);
+        res[1] = fold (cur[1], half, half);
+        for (x = 2; x < w; ++x)
+            res[x] = fold (cur[x], cur[x - 2], half);
+        return;
+    }
+
+#ifdef SIMD_VEC
+    {
+    const vs16 vh = vs16_set1 (half);
+    const vu16 vm = vu16_set1 (2 * half - 1);
+
+    for (; x + VU16_LANES <= w; x += VU16_LANES) {
+        vs16 d = vs16_sub (vu16_as_s16 (vu16_load (cur + x)), vu16_as_s16 (vu16_load (up + x)));
+        vs16 e = vs16_sub (vu16_as_s16 (vu16_and (vs16_as_u16 (vs16_add (d, vh)), vm)), vh);
+
+        vu16_store (res + x, vu16_xor (vs16_as_u16 (vs16_add (e, e)),
+                                       vs16_as_u16 (vs16_sra (e, 15))));
+    }
+    }
+#endif
+    for (; x < w; ++x)
+        res[x] = fold (cur[x], up[x], half);
+}
+
+static void unfold_row (uint16_t * cur, const uint16_t * up, const uint16_t * res,
+                        unsigned int w, int half, unsigned int mask)
+{
+unsigned int x = 0;
+
+    if (up == NULL) {
+        cur[0] = (half + unfold (res[0])) & mask;
+        cur[1] = (half + unfold (res[1])) & mask;
+        for (x = 2; x < w; ++x)
+            cur[x] = (cur[x - 2] + unfold (res[x])) & mask;
+        return;
+    }
+
+#ifdef SIMD_VEC
+    {
+    const vu16 vm = vu16_set1 (mask), one = vu16_set1 (1);
+
+    for (; x + VU16_LANES <= w; x += VU16_LANES) {
+        vu16 u = vu16_load (res + x);
+        vs16 sign = vs16_sub (vs16_set1 (0), vu16_as_s16 (vu16_and (u, one)));
+        vu16 e = vu16_xor (vu16_shr (u, 1), vs16_as_u16 (sign));
+
+        vu16_store (cur + x, vu16_and (vs16_as_u16 (vs16_add (vu16_as_s16 (vu16_load (up + x)),
+                                                              vu16_as_s16 (e))), vm));
+    }
+    }
+#endif
+    for (; x < w; ++x)
+        cur[x] = (up[x] + unfold (res[x])) & mask;
+}
+
+//***********************************************************************************
+static void put_row (struct bitw * bw, const uint16_t * res, unsigned int w)
+{
+unsigned int x, i, n, b, all;
+
+    for (x = 0; x < w; x += BLOCK) {
+        n = w - x < BLOCK ? w - x : BLOCK;
+        for (i = 0, all = 0; i < n; ++i)
+            all |= res[x + i];
+        b = all ? 32 - __builtin_clz (all) : 0;
+
+        put_bits (bw, b, BLOCK_BITS);
+        if (b == 0)
+            continue;
+        for (i = 0; i + 1 < n; i += 2)
+            put_bits (bw, (uint32_t)res[x + i] << b | res[x + i + 1], 2 * b);
+        if (i < n)
+            put_bits (bw, res[x + i], b);
+    }
+}
+
+// Returns -1 on a block wider than the samples.
+static int get_row (struct bitr * br, uint16_t * res, unsigned int w, unsigned int bits)
+{
+unsigned int x, i, n, b;
+
+    for (x = 0; x < w; x += BLOCK) {
+        n = w - x < BLOCK ? w - x : BLOCK;
+        refill (br);
+        b = br->acc >> (64 - BLOCK_BITS);
+        br->acc <<= BLOCK_BITS;
+        br->n -= BLOCK_BITS;
+
+        if (b == 0) {
+            memset (res + x, 0, n * sizeof (*res));
+            continue;
+        }
+        if (b > bits)
+            return -1;
+
+        for (i = 0; i + 1 < n; i += 2) {
+            uint32_t v;
+
+            refill (br);
+            v = br->acc >> (64 - 2 * b);
+            br->acc <<= 2 * b;
+            br->n -= 2 * b;
+            res[x + i] = v >> b;
+            res[x + i + 1] = v & ((1u << b) - 1);
+        }
+        if (i < n) {
+            refill (br);
+            res[x + i] = br->acc >> (64 - b);
+            br->acc <<= b;
+            br->n -= b;
+        }
+    }
+
+    return 0;
+}
+
+//***********************************************************************************
+struct tile_job {
+    const struct bayer_image * src;     // encoder input
+    uint8_t * dst;                      // decoder output
+    unsigned int dst_stride;
+    unsigned int width, height, bits;
+    unsigned int y0, y1;
+    uint8_t * data;                     // tile stream
+    size_t size;                        // bytes used / available
+    int ret;
+};
+
+static void load_row (const struct bayer_image * src, unsigned int y, uint16_t * row,
+                      unsigned int mask)
+{
+const uint8_t *p = (const uint8_t *)src->data + (size_t)y * src->stride;
+unsigned int x = 0;
+
+    if (src->bits > 8) {
+#ifdef SIMD_VEC
+        const vu16 vm = vu16_set1 (mask);
+
+        for (; x + VU16_LANES <= src->width; x += VU16_LANES)
+            vu16_store (row + x, vu16_and (vu16_load ((const uint16_t *)p + x), vm));
+#endif
+        for (; x < src->width; ++x)
+            row[x] = ((const uint16_t *)p)[x] & mask;
+    } else {
+#ifdef SIMD_VEC
+        const vu8 zero = vu8_set1 (0);
+
+        // Interleaving with zero bytes widens to little endian 16-bit lanes.
+        for (; x + VU8_LANES <= src->width; x += VU8_LANES) {
+            vu8 lo, hi;
+
+            vu8_zip (vu8_load (p + x), zero, &lo, &hi);
+            vu16_store (row + x, vu8_as_u16 (lo));
+            vu16_store (row + x + VU16_LANES, vu8_as_u16 (hi));
+        }
+#endif
+        for (; x < src->width; ++x)
+            row[x] = p[x];
+    }
+}
+
+static void encode_tile (struct tile_job * t)
+{
+unsigned int w = t->width, bits = t->bits, mask = (1u << bits) - 1;
+int half = 1 << (bits - 1);
+struct bitw bw;
+uint16_t *ring, *rows[3], *res;
+unsigned int y;
+
+    ring = malloc (4 * w * sizeof (*ring));
+    if (ring == NULL) {
+        t->ret = -1;
+        return;
+    }
+    res = ring + 3 * w;
+
+    bw.p = t->data;
+    bw.acc = 0;
+    bw.n = 0;
+
+    for (y = t->y0; y < t->y1; ++y) {
+        unsigned int ty = y - t->y0;
+
+        rows[ty % 3] = ring + (ty % 3) * w;
+        load_row (t->src, y, rows[ty % 3], mask);
+        fold_row (rows[ty % 3], ty >= 2 ? rows[(ty - 2) % 3] : NULL, res, w, half);
+        put_row (&bw, res, w);
+    }
+
+    flush_bits (&bw);
+    t->size = bw.p - t->data;
+    t->ret = 0;
+    free (ring);
+}
+
+static void decode_tile (struct tile_job * t)
+{
+unsigned int w = t->width, bits = t->bits, mask = (1u << bits) - 1;
+int half = 1 << (bits - 1);
+struct bitr br;
+uint16_t *ring, *rows[3], *res;
+unsigned int x, y;
+
+    ring = malloc (4 * w * sizeof (*ring));
+    if (ring == NULL) {
+        t->ret = -1;
+        return;
+    }
+    res = ring + 3 * w;
+
+    br.p = t->data;
+    br.end = t->data + t->size;
+    br.acc = 0;
+    br.n = 0;
+    br.pad = 0;
+    t->ret = -1;
+
+    for (y = t->y0; y < t->y1; ++y) {
+        unsigned int ty = y - t->y0;
+        uint8_t *out = t->dst + (size_t)y * t->dst_stride;
+        uint16_t *cur;
+
+        if (get_row (&br, res, w, bits) < 0)
+            goto done;
+
+        cur = rows[ty % 3] = ring + (ty % 3) * w;
+        unfold_row (cur, ty >= 2 ? rows[(ty - 2) % 3] : NULL, res, w, half, mask);
+
+        if (bits > 8)
+            memcpy (out, cur, w * sizeof (*cur));
+        else
+            for (x = 0; x < w; ++x)
+                out[x] = cur[x];
+    }
+
+    // Reading into the padding means the tile was truncated.
+    t->ret = br.pad * 8 > br.n ? -1 : 0;
+done:
+    free (ring);
+}
+
+//***********************************************************************************
+// Workers claim tiles until none are left; the calling thread joins in.
+//
+struct tile_pool {
+    struct tile_job * jobs;
+    unsigned int count;
+    volatile unsigned int next;
+    void (*fn) (struct tile_job *);
+};
+
+static void * tile_worker (void * arg)
+{
+struct tile_pool *tp = arg;
+unsigned int i;
+
+    while ((i = __sync_fetch_and_add (&tp->next, 1)) < tp->count)
+        tp->fn (&tp->jobs[i]);
+    return NULL;
+}
+
+static int run_tiles (struct tile_job * jobs, unsigned int count, unsigned int threads,
+                      void (*fn) (struct tile_job *))
+{
+struct tile_pool tp;
+pthread_t tid[RAWCODEC_MAX_TILES];
+unsigned int i, started;
+
+    tp.jobs = jobs;
+    tp.count = count;
+    tp.next = 0;
+    tp.fn = fn;
+
+    if (threads > count)
+        threads = count;
+    for (started = 0; started + 1 < threads; ++started)
+        if (pthread_create (&tid[started], NULL, tile_worker, &tp))
+            break;
+    tile_worker (&tp);
+    for (i = 0; i < started; ++i)
+        pthread_join (tid[i], NULL);
+
+    for (i = 0; i < count; ++i)
+        if (jobs[i].ret < 0)
+            return -1;
+    return 0;
+}
+
+//***********************************************************************************
+static unsigned int tile_rows (unsigned int height, unsigned int tiles)
+{
+unsigned int rows;
+
+    if (tiles < 1)
+        tiles = 1;
+    if (tiles > RAWCODEC_MAX_TILES)
+        tiles = RAWCODEC_MAX_TILES;
+    rows = (height + tiles - 1) / tiles;
+    return (rows + 1) & ~1u;
+}
+
+static size_t tile_bound (unsigned int width, unsigned int rows, unsigned int bits)
+{
+    return ((size_t)rows * (width * bits + (width + BLOCK - 1) / BLOCK * BLOCK_BITS) + 7) / 8;
+}
+
+static void put_le32 (uint8_t * p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get_le32 (const uint8_t * p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t rawcodec_bound (unsigned int width, unsigned int height, unsigned int bits,
+                       unsigned int tiles)
+{
+unsigned int rows = tile_rows (height, tiles);
+unsigned int n = (height + rows - 1) / rows;
+
+    return (HEADER_WORDS + n) * 4 + n * tile_bound (width, rows, bits);
+}
+
+//***********************************************************************************
+long rawcodec_encode (const struct bayer_image * src, void * dst, unsigned int tiles,
+                      unsigned int threads)
+{
+struct tile_job jobs[RAWCODEC_MAX_TILES];
+uint8_t *out = dst, *p;
+unsigned int rows, n, i;
+size_t bound;
+
+    if (src->width < 2 || src->height < 2 || src->bits < 8 || src->bits > 16)
+        return -1;
+
+    rows = tile_rows (src->height, tiles);
+    n = (src->height + rows - 1) / rows;
+    bound = tile_bound (src->width, rows, src->bits);
+    p = out + (HEADER_WORDS + n) * 4;
+
+    for (i = 0; i < n; ++i) {
+        jobs[i].src = src;
+        jobs[i].width = src->width;
+        jobs[i].height = src->height;
+        jobs[i].bits = src->bits;
+        jobs[i].y0 = i * rows;
+        jobs[i].y1 = (i + 1) * rows < src->height ? (i + 1) * rows : src->height;
+        jobs[i].data = p + i * bound;
+        jobs[i].ret = -1;
+    }
+
+    if (run_tiles (jobs, n, threads ? threads : 1, encode_tile) < 0)
+        return -1;
+
+    put_le32 (out, MAGIC);
+    put_le32 (out + 4, src->width);
+    put_le32 (out + 8, src->height);
+    put_le32 (out + 12, src->bits);
+    put_le32 (out + 16, n);
+
+    // Close the gaps between the worst case slots.
+    for (i = 0; i < n; ++i) {
+        put_le32 (out + (HEADER_WORDS + i) * 4, jobs[i].size);
+        if (p != jobs[i].data)
+            memmove (p, jobs[i].data, jobs[i].size);
+        p += jobs[i].size;
+    }
+
+    return p - out;
+}
+
+//***********************************************************************************
+int rawcodec_info (const void * src, size_t size, struct rawcodec_info * info)
+{
+const uint8_t *p = src;
+
+    if (size < HEADER_WORDS * 4 || get_le32 (p) != MAGIC)
+        return -1;
+
+    info->width = get_le32 (p + 4);
+    info->height = get_le32 (p + 8);
+    info->bits = get_le32 (p + 12);
+    info->tiles = get_le32 (p + 16);
+
+    if (info->width < 2 || info->height < 2 || info->bits < 8 || info->bits > 16 ||
+        info->tiles < 1 || info->tiles > RAWCODEC_MAX_TILES ||
+        size < (HEADER_WORDS + info->tiles) * 4)
+        return -1;
+
+    return 0;
+}
+
+int rawcodec_decode (const void * src, size_t size, void * dst, unsigned int dst_stride,
+                     unsigned int threads)
+{
+struct tile_job jobs[RAWCODEC_MAX_TILES];
+struct rawcodec_info info;
+const uint8_t *in = src, *p;
+unsigned int rows, i;
+
+    if (rawcodec_info (src, size, &info) < 0)
+        return -1;
+    if (dst_stride < info.width * (info.bits > 8 ? 2 : 1))
+        return -1;
+
+    rows = tile_rows (info.height, info.tiles);
+    if ((info.height + rows - 1) / rows != info.tiles)
+        return -1;
+
+    p = in + (HEADER_WORDS + info.tiles) * 4;
+    for (i = 0; i < info.tiles; ++i) {
+        jobs[i].dst = dst;
+        jobs[i].dst_stride = dst_stride;
+        jobs[i].width = info.width;
+        jobs[i].height = info.height;
+        jobs[i].bits = info.bits;
+        jobs[i].y0 = i * rows;
+        jobs[i].y1 = (i + 1) * rows < info.height ? (i + 1) * rows : info.height;
+        jobs[i].data = (uint8_t *)p;
+        jobs[i].size = get_le32 (in + (HEADER_WORDS + i) * 4);
+        jobs[i].ret = -1;
+        if (jobs[i].size > size - (p - in))
+            return -1;
+        p += jobs[i].size;
+    }
+
+    return run_tiles (jobs, info.tiles, threads ? threads : 1, decode_tile);
+}
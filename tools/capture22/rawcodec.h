@@ -0,0 +1,62 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Lossless Bayer codec.
+//
+// Each sample is predicted from the nearest sample of the same colour two
+// rows up; the residual, taken modulo 2^bits, is bit packed in blocks of
+// 16 samples, each block in the width of its largest residual.  Prediction
+// and packing are cheap enough to keep up with the sensor on one core.
+//
+// The frame is cut into row tiles that are coded independently, so both
+// encoder and decoder run one tile per worker thread.  Stream layout, all
+// fields 32-bit little endian:
+//
+//   "RBC2", width, height, bits, tiles, tile size[tiles], tile data ...
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __RAWCODEC_H
+#define __RAWCODEC_H
+
+#include <stddef.h>
+
+#include "bayer.h"
+
+#define RAWCODEC_MAX_TILES      256
+
+struct rawcodec_info {
+    unsigned int width;
+    unsigned int height;
+    unsigned int bits;
+    unsigned int tiles;
+};
+
+//
+// Worst case stream size for a frame cut in tiles tiles.
+//
+size_t rawcodec_bound (unsigned int width, unsigned int height, unsigned int bits,
+                       unsigned int tiles);
+
+//
+// Encode src (8-bit, or 9..16 bits in 16-bit containers; bits above the
+// depth are ignored) into dst, which must hold rawcodec_bound () bytes.
+// tiles is rounded so every tile holds an even number of rows.  Returns the
+// stream size or -1.
+//
+long rawcodec_encode (const struct bayer_image * src, void * dst, unsigned int tiles,
+                      unsigned int threads);
+
+int rawcodec_info (const void * src, size_t size, struct rawcodec_info * info);
+
+//
+// Decode into dst, dst_stride bytes per line, 8-bit samples for 8-bit
+// streams and 16-bit containers otherwise.  Returns 0, or -1 on a corrupt
+// stream.
+//
+int rawcodec_decode (const void * src, size_t size, void * dst, unsigned int dst_stride,
+                     unsigned int threads);
+
+#endif /* __RAWCODEC_H */
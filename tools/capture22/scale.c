@@ -0,0 +1,312 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// 2x / 4x downscaler.  See scale.h.
+//
+// Every 2x step works on pairs of input rows and comes down to two kinds
+// of row:
+//
+//   luma    out[i] = avg (r[2i], r[2i + 1])
+//   pairs   two interleaved channels (UV, or the two colours of a Bayer
+//           row): out[2i] = avg (r[4i], r[4i + 2]),
+//           out[2i + 1] = avg (r[4i + 1], r[4i + 3])
+//
+// where r = avg (row a, row b).  A YUYV row is a luma row and a pairs row
+// interleaved.  The vector code unzips, averages and zips back; averaging
+// the rows first, then the columns, in the same order as the C code keeps
+// the rounding identical.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include <linux/videodev2.h>
+
+#include "scale.h"
+#include "bayer.h"
+#include "simd.h"
+
+#define AVG(p, q)   (((p) + (q) + 1) >> 1)
+
+static int scale_vector = 1;
+
+void scale_use_vector (int enable)
+{
+    scale_vector = enable;
+}
+
+//***********************************************************************************
+// Row kernels.  n counts output bytes.
+//
+#ifdef SIMD_VEC
+static inline vu8 vavg (const uint8_t * a, const uint8_t * b)
+{
+    return vu8_avg (vu8_load (a), vu8_load (b));
+}
+
+static inline vu8 vhalve (vu8 v0, vu8 v1)
+{
+vu8 even, odd;
+
+    vu8_unzip (v0, v1, &even, &odd);
+    return vu8_avg (even, odd);
+}
+
+//
+// Pairs of four vectors into two.
+//
+static inline void vpairs (vu8 v0, vu8 v1, vu8 v2, vu8 v3, vu8 * lo, vu8 * hi)
+{
+vu8 e0, o0, e1, o1;
+
+    vu8_unzip (v0, v1, &e0, &o0);
+    vu8_unzip (v2, v3, &e1, &o1);
+    vu8_zip (vhalve (e0, e1), vhalve (o0, o1), lo, hi);
+}
+#endif
+
+static void luma_row (const uint8_t * a, const uint8_t * b, uint8_t * out, unsigned int n)
+{
+unsigned int i = 0;
+
+#ifdef SIMD_VEC
+    if (scale_vector) {
+        for (; i + VU8_LANES <= n; i += VU8_LANES) {
+            const uint8_t *pa = a + 2 * i, *pb = b + 2 * i;
+
+            vu8_store (out + i, vhalve (vavg (pa, pb), vavg (pa + VU8_LANES, pb + VU8_LANES)));
+        }
+    }
+#endif
+
+    for (; i < n; ++i)
+        out[i] = AVG (AVG (a[2 * i], b[2 * i]), AVG (a[2 * i + 1], b[2 * i + 1]));
+}
+
+static void pairs_row (const uint8_t * a, const uint8_t * b, uint8_t * out, unsigned int n)
+{
+unsigned int i = 0;
+
+#ifdef SIMD_VEC
+    if (scale_vector) {
+        for (; i + 2 * VU8_LANES <= n; i += 2 * VU8_LANES) {
+            const uint8_t *pa = a + 2 * i, *pb = b + 2 * i;
+            vu8 lo, hi;
+
+            vpairs (vavg (pa, pb), vavg (pa + VU8_LANES, pb + VU8_LANES),
+                    vavg (pa + 2 * VU8_LANES, pb + 2 * VU8_LANES),
+                    vavg (pa + 3 * VU8_LANES, pb + 3 * VU8_LANES), &lo, &hi);
+            vu8_store (out + i, lo);
+            vu8_store (out + i + VU8_LANES, hi);
+        }
+    }
+#endif
+
+    // n is even
+    for (; i < n; i += 2) {
+        out[i] = AVG (AVG (a[2 * i], b[2 * i]), AVG (a[2 * i + 2], b[2 * i + 2]));
+        out[i + 1] = AVG (AVG (a[2 * i + 1], b[2 * i + 1]), AVG (a[2 * i + 3], b[2 * i + 3]));
+    }
+}
+
+//
+// n output bytes (n / 2 pixels); luma at byte y of every pair, 0 for YUYV,
+// 1 for UYVY.
+//
+static void yuyv_row (const uint8_t * a, const uint8_t * b, uint8_t * out, unsigned int n,
+                      unsigned int y)
+{
+unsigned int i = 0, c = y ^ 1;
+
+#ifdef SIMD_VEC
+    if (scale_vector) {
+        for (; i + 4 * VU8_LANES <= n; i += 4 * VU8_LANES) {
+            const uint8_t *pa = a + 2 * i, *pb = b + 2 * i;
+            vu8 r[8], l[4], ch[4], y0, y1, c0, c1;
+            unsigned int k;
+
+            for (k = 0; k < 8; ++k)
+                r[k] = vavg (pa + k * VU8_LANES, pb + k * VU8_LANES);
+            for (k = 0; k < 4; ++k) {
+                if (y)
+                    vu8_unzip (r[2 * k], r[2 * k + 1], &ch[k], &l[k]);
+                else
+                    vu8_unzip (r[2 * k], r[2 * k + 1], &l[k], &ch[k]);
+            }
+
+            y0 = vhalve (l[0], l[1]);
+            y1 = vhalve (l[2], l[3]);
+            vpairs (ch[0], ch[1], ch[2], ch[3], &c0, &c1);
+
+            if (y) {
+                vu8_zip (c0, y0, &r[0], &r[1]);
+                vu8_zip (c1, y1, &r[2], &r[3]);
+            } else {
+                vu8_zip (y0, c0, &r[0], &r[1]);
+                vu8_zip (y1, c1, &r[2], &r[3]);
+            }
+            for (k = 0; k < 4; ++k)
+                vu8_store (out + i + k * VU8_LANES, r[k]);
+        }
+    }
+#endif
+
+    // Four output bytes from eight input bytes of each row.
+    for (; i < n; i += 4) {
+        const uint8_t *pa = a + 2 * i, *pb = b + 2 * i;
+
+        out[i + y] = AVG (AVG (pa[y], pb[y]), AVG (pa[y + 2], pb[y + 2]));
+        out[i + y + 2] = AVG (AVG (pa[y + 4], pb[y + 4]), AVG (pa[y + 6], pb[y + 6]));
+        out[i + c] = AVG (AVG (pa[c], pb[c]), AVG (pa[c + 4], pb[c + 4]));
+        out[i + c + 2] = AVG (AVG (pa[c + 2], pb[c + 2]), AVG (pa[c + 6], pb[c + 6]));
+    }
+}
+
+//***********************************************************************************
+// One 2x step
+//
+static unsigned int bayer8_fourcc (enum bayer_order order)
+{
+    switch (order) {
+        case BAYER_RGGB: return V4L2_PIX_FMT_SRGGB8;
+        case BAYER_GRBG: return V4L2_PIX_FMT_SGRBG8;
+        case BAYER_GBRG: return V4L2_PIX_FMT_SGBRG8;
+        case BAYER_BGGR: return V4L2_PIX_FMT_SBGGR8;
+    }
+    return 0;
+}
+
+static int half_format (const struct conv_image * src, struct conv_image * dst)
+{
+enum bayer_order order;
+unsigned int bits;
+
+    dst->data = NULL;
+    dst->width = src->width / 2;
+    dst->height = src->height / 2;
+    dst->fourcc = src->fourcc;
+    if (src->width % 4 || src->height < 2)
+        return -1;
+
+    switch (src->fourcc) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+            dst->stride = dst->width * 2;
+            return src->stride < src->width * 2 ? -1 : 0;
+        case V4L2_PIX_FMT_NV12:
+            dst->stride = dst->width;
+            return src->height % 4 || src->stride < src->width ? -1 : 0;
+    }
+
+    if (bayer_from_fourcc (src->fourcc, &order, &bits) < 0)
+        return -1;
+    dst->fourcc = bayer8_fourcc (order);
+    dst->stride = dst->width;
+    return src->height % 4 || src->stride < src->width * (bits > 8 ? 2 : 1) ? -1 : 0;
+}
+
+static size_t image_size (const struct conv_image * img)
+{
+size_t size = (size_t)img->stride * img->height;
+
+    return img->fourcc == V4L2_PIX_FMT_NV12 ? size + size / 2 : size;
+}
+
+static void half_frame (const struct conv_image * src, const uint8_t * in,
+                        const struct conv_image * dst, uint8_t * out, uint8_t * scratch)
+{
+enum bayer_order order;
+unsigned int bits, r;
+
+    switch (src->fourcc) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+            for (r = 0; r < dst->height; ++r)
+                yuyv_row (in + (size_t)2 * r * src->stride, in + (size_t)(2 * r + 1) * src->stride,
+                          out + (size_t)r * dst->stride, dst->width * 2,
+                          src->fourcc == V4L2_PIX_FMT_UYVY);
+            return;
+
+        case V4L2_PIX_FMT_NV12: {
+            const uint8_t *uv = in + (size_t)src->stride * src->height;
+            uint8_t *out_uv = out + (size_t)dst->stride * dst->height;
+
+            for (r = 0; r < dst->height; ++r)
+                luma_row (in + (size_t)2 * r * src->stride, in + (size_t)(2 * r + 1) * src->stride,
+                          out + (size_t)r * dst->stride, dst->width);
+            for (r = 0; r < dst->height / 2; ++r)
+                pairs_row (uv + (size_t)2 * r * src->stride, uv + (size_t)(2 * r + 1) * src->stride,
+                           out_uv + (size_t)r * dst->stride, dst->width);
+            return;
+        }
+    }
+
+    // Bayer: output row r bins input rows 4 (r / 2) + r % 2 and the next
+    // row of the same colours, two below.
+    bayer_from_fourcc (src->fourcc, &order, &bits);
+    for (r = 0; r < dst->height; ++r) {
+        unsigned int y = (r / 2) * 4 + r % 2;
+        const uint8_t *a = in + (size_t)y * src->stride;
+        const uint8_t *b = in + (size_t)(y + 2) * src->stride;
+
+        if (bits > 8) {
+            conv_raw16_to_raw8_row ((const uint16_t *)a, scratch, src->width, bits);
+            conv_raw16_to_raw8_row ((const uint16_t *)b, scratch + src->width, src->width, bits);
+            a = scratch;
+            b = scratch + src->width;
+        }
+        pairs_row (a, b, out + (size_t)r * dst->stride, dst->width);
+    }
+}
+
+//***********************************************************************************
+int scaler_init (struct scaler * s, const struct conv_image * src, unsigned int factor)
+{
+    memset (s, 0, sizeof (*s));
+    if (factor != 2 && factor != 4)
+        return -1;
+
+    s->src = *src;
+    s->src.data = NULL;
+    s->factor = factor;
+    if (half_format (&s->src, &s->dst) < 0)
+        return -1;
+
+    if (factor == 4) {
+        s->half = s->dst;
+        if (half_format (&s->half, &s->dst) < 0)
+            return -1;
+        s->half_data = malloc (image_size (&s->half));
+        if (s->half_data == NULL)
+            return -1;
+    }
+
+    s->size = image_size (&s->dst);
+    s->scratch = malloc (2 * (size_t)src->width);
+    if (s->scratch == NULL) {
+        scaler_free (s);
+        return -1;
+    }
+    return 0;
+}
+
+void scaler_free (struct scaler * s)
+{
+    free (s->half_data);
+    free (s->scratch);
+    s->half_data = NULL;
+    s->scratch = NULL;
+}
+
+void scaler_run (struct scaler * s, const void * src, void * dst)
+{
+    if (s->factor == 2) {
+        half_frame (&s->src, src, &s->dst, dst, s->scratch);
+        return;
+    }
+
+    half_frame (&s->src, src, &s->half, s->half_data, s->scratch);
+    half_frame (&s->half, s->half_data, &s->dst, dst, s->scratch);
+}
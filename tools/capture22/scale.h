@@ -0,0 +1,60 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// 2x / 4x downscaler for preview streams.
+//
+//   YUYV, UYVY      -> same format, luma and chroma 2x2 box filtered
+//   NV12            -> NV12, both planes 2x2 box filtered
+//   Bayer 8..16     -> 8-bit Bayer of the same order, 2x2 binning: every
+//                      output sample is the mean of the four samples of its
+//                      colour in the 4x4 input block
+//
+// A 2x step averages with rounding, avg (p, q) = (p + q + 1) >> 1, first
+// the two rows, then the two columns; 4x is two 2x steps through a half
+// size intermediate.  16-bit Bayer is reduced to its top 8 bits first.
+//
+// The scaler reads the captured buffer in place and writes the preview
+// straight to dst, e.g. a shared memory ring slot: the full frame is never
+// copied.  The inner loops use the vector layer in simd.h;
+// scale_use_vector (0) selects the plain C path, which gives the same
+// bytes.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __SCALE_H
+#define __SCALE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "convert.h"
+
+struct scaler {
+    struct conv_image src;          // geometry, data unused
+    struct conv_image dst;          // preview geometry, tightly packed
+    unsigned int factor;            // 2 or 4
+    size_t size;                    // preview bytes
+    struct conv_image half;         // intermediate for 4x
+    uint8_t * half_data;
+    uint8_t * scratch;
+};
+
+void scale_use_vector (int enable);
+
+//
+// Set up a scaler for frames of src's geometry.  The width must be a
+// multiple of 2 * factor (and the height of NV12 and Bayer too).  Returns
+// 0, or -1 for unsupported formats and sizes.
+//
+int scaler_init (struct scaler * s, const struct conv_image * src, unsigned int factor);
+void scaler_free (struct scaler * s);
+
+//
+// Scale one frame (src geometry as given to scaler_init ()) into dst,
+// s->size bytes.
+//
+void scaler_run (struct scaler * s, const void * src, void * dst);
+
+#endif /* __SCALE_H */
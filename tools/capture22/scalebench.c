@@ -0,0 +1,167 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Downscaler benchmark.
+//
+// Runs the 2x and 4x preview scaler (scale.h) on a synthetic frame for
+// every input format with the plain C and the vector path, reports input
+// Mpix/s and ms per frame of both and checks that they produce the same
+// bytes.  Exits non-zero on a mismatch.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+#include "scale.h"
+#include "simd.h"
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void fill_frame (unsigned char * data, size_t length)
+{
+size_t i;
+
+    srand (1);
+    for (i = 0; i < length; ++i)
+        data[i] = rand ();
+}
+
+static unsigned long long run (struct scaler * s, const void * src, void * dst,
+                               unsigned int iter)
+{
+unsigned long long t = mono_us ();
+unsigned int i;
+
+    for (i = 0; i < iter; ++i)
+        scaler_run (s, src, dst);
+    return mono_us () - t;
+}
+
+//***********************************************************************************
+static int bench (const char * name, unsigned int fourcc, unsigned int bpp,
+                  unsigned int factor, unsigned int width, unsigned int height,
+                  unsigned int iter)
+{
+double pix = (double)width * height * iter;
+unsigned long long tref, tvec;
+struct conv_image img;
+unsigned char *raw, *ref, *out;
+struct scaler s;
+size_t length;
+int ret = 0;
+
+    img.data = NULL;
+    img.width = width;
+    img.height = height;
+    img.stride = width * bpp;
+    img.fourcc = fourcc;
+    if (scaler_init (&s, &img, factor) < 0) {
+        printf ("%-10s /%u  unsupported size\n", name, factor);
+        return -1;
+    }
+
+    length = (size_t)img.stride * height;
+    if (fourcc == V4L2_PIX_FMT_NV12)
+        length += length / 2;
+    raw = malloc (length);
+    ref = malloc (s.size);
+    out = malloc (s.size);
+    if (!raw || !ref || !out) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+    fill_frame (raw, length);
+    memset (ref, 0, s.size);
+    memset (out, 0xff, s.size);
+
+    scale_use_vector (0);
+    tref = run (&s, raw, ref, iter);
+    scale_use_vector (1);
+    tvec = run (&s, raw, out, iter);
+    if (memcmp (ref, out, s.size))
+        ret = -1;
+
+    printf ("%-10s /%u  %4ux%-4u %8.1f %8.1f %8.2f %8.2f   %s\n", name, factor,
+            s.dst.width, s.dst.height, tref ? pix / tref : 0.0, tvec ? pix / tvec : 0.0,
+            tref / 1000.0 / iter, tvec / 1000.0 / iter, ret ? "FAIL" : "bit-exact");
+
+    scaler_free (&s);
+    free (raw);
+    free (ref);
+    free (out);
+    return ret;
+}
+
+//***********************************************************************************
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options]\n\n Options:\n"
+        "-w | --width n Frame width [2592]\n"
+        "-h | --height n Frame height [1944]\n"
+        "-i | --iterations n Frames per measurement [10]\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "width", required_argument, NULL, 'w' },
+    { "height", required_argument, NULL, 'h' },
+    { "iterations", required_argument, NULL, 'i' },
+    { "help", no_argument, NULL, '?' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+static const unsigned int factors[] = { 2, 4 };
+unsigned int width = 2592, height = 1944, iter = 10, i;
+int c, ret = 0;
+
+    while ((c = getopt_long (argc, argv, "w:h:i:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'w':
+                width = atoi (optarg);
+                break;
+            case 'h':
+                height = atoi (optarg);
+                break;
+            case 'i':
+                iter = atoi (optarg);
+                break;
+            default:
+                usage (argv[0]);
+                return c == '?' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (width % 8 || height % 8) {
+        fprintf (stderr, "Width and height must be multiples of 8\n");
+        return EXIT_FAILURE;
+    }
+
+    printf ("scale %ux%u, %s, %u iterations\n\n", width, height, SIMD_NAME, iter);
+    printf ("%-15s %9s %8s %8s %8s %8s\n", "", "", "Mpix/s", "", "ms/frame", "");
+    printf ("%-15s %9s %8s %8s %8s %8s\n", "", "output", "scalar", "vector", "scalar",
+            "vector");
+
+    for (i = 0; i < sizeof (factors) / sizeof (factors[0]); ++i) {
+        ret |= bench ("yuyv", V4L2_PIX_FMT_YUYV, 2, factors[i], width, height, iter);
+        ret |= bench ("uyvy", V4L2_PIX_FMT_UYVY, 2, factors[i], width, height, iter);
+        ret |= bench ("nv12", V4L2_PIX_FMT_NV12, 1, factors[i], width, height, iter);
+        ret |= bench ("bayer8", V4L2_PIX_FMT_SGRBG8, 1, factors[i], width, height, iter);
+        ret |= bench ("bayer10", V4L2_PIX_FMT_SGRBG10, 2, factors[i], width, height, iter);
+    }
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
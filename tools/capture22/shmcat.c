@@ -0,0 +1,163 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Shared memory ring client (shmring.h).
+//
+//   shmcat cam0                     count frames published by capture22 -S cam0
+//   shmcat -o - cam0 | encoder      pass the frames on
+//   shmcat -d 100 cam0              a slow reader: shows dropped frames
+//
+// Any number of shmcat instances can attach to the same ring.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shmring.h"
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal (int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//***********************************************************************************
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options] name\n\n Options:\n"
+        "-n | --count n Stop after n frames [0 = until interrupted]\n"
+        "-o | --output file Append every frame to file (- for stdout)\n"
+        "-d | --delay ms Hold each frame for ms, to emulate a slow reader\n"
+        "-t | --timeout ms Give up when no frame arrives for ms [5000]\n"
+        "-q | --quiet No per-second report\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "count", required_argument, NULL, 'n' },
+    { "output", required_argument, NULL, 'o' },
+    { "delay", required_argument, NULL, 'd' },
+    { "timeout", required_argument, NULL, 't' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+unsigned long long start, last, count = 0, bytes = 0, now;
+unsigned long long last_frames = 0, last_dropped = 0;
+unsigned int delay = 0, timeout = 5000;
+const char *out = NULL;
+struct shmring_reader r;
+struct shmring_frame f;
+FILE *fp = NULL;
+int quiet = 0;
+int c;
+
+    while ((c = getopt_long (argc, argv, "n:o:d:t:qh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'n':
+                count = strtoull (optarg, NULL, 0);
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            case 'd':
+                delay = atoi (optarg);
+                break;
+            case 't':
+                timeout = atoi (optarg);
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                usage (argv[0]);
+                return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage (argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (shmring_open (argv[optind], &r) < 0) {
+        perror (argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (out) {
+        fp = strcmp (out, "-") ? fopen (out, "wb") : stdout;
+        if (fp == NULL) {
+            perror (out);
+            return EXIT_FAILURE;
+        }
+        // Reports go to stderr when the frames go to stdout.
+        quiet |= fp == stdout;
+    }
+
+    signal (SIGINT, on_signal);
+    signal (SIGTERM, on_signal);
+
+    fprintf (stderr, "%s: %ux%u %.4s, %u slots of %u bytes\n", argv[optind],
+             r.header->width, r.header->height, (const char *)&r.header->pixelformat,
+             r.header->slots, r.header->slot_size);
+
+    start = last = mono_us ();
+    while (!stop && (count == 0 || r.frames < count)) {
+        if (shmring_next (&r, &f, timeout) < 0) {
+            fprintf (stderr, "No frame for %u ms\n", timeout);
+            break;
+        }
+
+        if (fp && fwrite (f.data, 1, f.size, fp) != f.size) {
+            perror (out);
+            break;
+        }
+        if (delay)
+            usleep (delay * 1000);
+
+        // A torn frame has already been written out; the count says so.
+        shmring_done (&r, &f);
+        bytes += f.size;
+
+        now = mono_us ();
+        if (!quiet && now - last >= 1000000) {
+            printf ("%6.2f fps, %llu dropped, %llu torn\n",
+                    (r.frames - last_frames) * 1e6 / (now - last),
+                    r.dropped - last_dropped, r.torn);
+            last_frames = r.frames;
+            last_dropped = r.dropped;
+            last = now;
+        }
+    }
+
+    now = mono_us () - start;
+    fprintf (stderr, "%llu frames, %.2f fps, %.1f MB/s, %llu dropped, %llu torn\n",
+             r.frames, now ? r.frames * 1e6 / now : 0.0, now ? (double)bytes / now : 0.0,
+             r.dropped, r.torn);
+
+    if (fp && fp != stdout)
+        fclose (fp);
+    shmring_close (&r);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,311 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Shared memory frame ring.  See shmring.h for the layout and protocol.
+//
+// Ordering: the writer stores SHMRING_BUSY in the slot stamp before it
+// touches the payload and the frame number after, each behind a full
+// barrier, then publishes head.  A reader loads head, then the stamp, uses
+// the payload and loads the stamp again; a changed stamp means the payload
+// may be torn.  Readers sleep on head with a futex, the writer wakes them
+// on every commit.  Where the kernel refuses FUTEX_WAIT on the read only
+// mapping, readers fall back to rechecking head every POLL_MS.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "shmring.h"
+
+#define POLL_MS         2
+
+#define PAGE_ALIGN(x)   (((x) + 4095) & ~(size_t)4095)
+
+struct shmring_writer {
+    struct shmring_header * header;
+    struct shmring_slot * slots;
+    uint8_t * data;
+    size_t length;
+    uint32_t next;                  // frame being written
+    char name[NAME_MAX];
+};
+
+//***********************************************************************************
+// Names are given without the leading slash shm_open () wants.
+//
+static void shm_name (char * dst, const char * name)
+{
+    snprintf (dst, NAME_MAX, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+static size_t ring_length (unsigned int slots, size_t slot_size, size_t * data_offset)
+{
+    *data_offset = PAGE_ALIGN (sizeof (struct shmring_header) +
+                               slots * sizeof (struct shmring_slot));
+    return *data_offset + slots * slot_size;
+}
+
+//***********************************************************************************
+// Writer
+//
+struct shmring_writer * shmring_create (const char * name, unsigned int slots,
+                                        size_t slot_size, unsigned int width,
+                                        unsigned int height, unsigned int pixelformat,
+                                        unsigned int bytesperline)
+{
+struct shmring_writer *w;
+size_t data_offset;
+void *map;
+int fd;
+
+    if (slots < 2 || slot_size == 0)
+        return NULL;
+
+    w = calloc (1, sizeof (*w));
+    if (w == NULL)
+        return NULL;
+
+    shm_name (w->name, name);
+    slot_size = PAGE_ALIGN (slot_size);
+    w->length = ring_length (slots, slot_size, &data_offset);
+
+    // A stale ring of another size may still exist, start from scratch.
+    shm_unlink (w->name);
+    fd = shm_open (w->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        free (w);
+        return NULL;
+    }
+    if (ftruncate (fd, w->length) < 0) {
+        close (fd);
+        shm_unlink (w->name);
+        free (w);
+        return NULL;
+    }
+
+    map = mmap (NULL, w->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        shm_unlink (w->name);
+        free (w);
+        return NULL;
+    }
+
+    w->header = map;
+    w->slots = (struct shmring_slot *)(w->header + 1);
+    w->data = (uint8_t *)map + data_offset;
+
+    // The file is zero filled: mark every slot busy so that no reader
+    // mistakes slot 0 for frame 0 before it is written.
+    memset (w->slots, 0xff, slots * sizeof (struct shmring_slot));
+    w->header->version = SHMRING_VERSION;
+    w->header->slots = slots;
+    w->header->slot_size = slot_size;
+    w->header->data_offset = data_offset;
+    w->header->width = width;
+    w->header->height = height;
+    w->header->pixelformat = pixelformat;
+    w->header->bytesperline = bytesperline;
+    w->header->head = 0;
+    __sync_synchronize ();
+    memcpy (w->header->magic, SHMRING_MAGIC, sizeof (w->header->magic));
+
+    return w;
+}
+
+void * shmring_begin (struct shmring_writer * w)
+{
+unsigned int i = w->next % w->header->slots;
+
+    w->slots[i].stamp = SHMRING_BUSY;
+    __sync_synchronize ();
+    return w->data + (size_t)i * w->header->slot_size;
+}
+
+void shmring_commit (struct shmring_writer * w, size_t size, unsigned int sequence,
+                     unsigned long long timestamp)
+{
+struct shmring_slot *s = &w->slots[w->next % w->header->slots];
+
+    s->size = size;
+    s->sequence = sequence;
+    s->flags = 0;
+    s->timestamp = timestamp;
+    __sync_synchronize ();
+    s->stamp = w->next;
+    __sync_synchronize ();
+    w->header->head = ++w->next;
+
+    syscall (SYS_futex, &w->header->head, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+int shmring_write (struct shmring_writer * w, const void * data, size_t size,
+                   unsigned int sequence, unsigned long long timestamp)
+{
+    if (size > w->header->slot_size)
+        return -1;
+    memcpy (shmring_begin (w), data, size);
+    shmring_commit (w, size, sequence, timestamp);
+    return 0;
+}
+
+void shmring_destroy (struct shmring_writer * w)
+{
+    if (w == NULL)
+        return;
+    munmap (w->header, w->length);
+    shm_unlink (w->name);
+    free (w);
+}
+
+//***********************************************************************************
+// Reader
+//
+int shmring_open (const char * name, struct shmring_reader * r)
+{
+const struct shmring_header *h;
+char path[NAME_MAX];
+size_t data_offset;
+struct stat st;
+void *map;
+int fd;
+
+    shm_name (path, name);
+    fd = shm_open (path, O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+    if (fstat (fd, &st) < 0) {
+        close (fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof (*h)) {
+        close (fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    h = map;
+    if (memcmp (h->magic, SHMRING_MAGIC, sizeof (h->magic)) ||
+        h->version != SHMRING_VERSION || h->slots < 2 ||
+        ring_length (h->slots, h->slot_size, &data_offset) > (size_t)st.st_size ||
+        data_offset != h->data_offset) {
+        munmap (map, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset (r, 0, sizeof (*r));
+    r->header = h;
+    r->slots = (const struct shmring_slot *)(h + 1);
+    r->data = (const uint8_t *)map + data_offset;
+    r->length = st.st_size;
+    r->cursor = h->head ? h->head - 1 : 0;
+    return 0;
+}
+
+void shmring_close (struct shmring_reader * r)
+{
+    munmap ((void *)r->header, r->length);
+    r->header = NULL;
+}
+
+static int wait_head (struct shmring_reader * r, uint32_t seen, int timeout_ms)
+{
+struct timespec ts, *tp = NULL;
+int waited;
+
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        tp = &ts;
+    }
+
+    if (!r->poll) {
+        if (syscall (SYS_futex, &r->header->head, FUTEX_WAIT, seen, tp, NULL, 0) == 0 ||
+            errno == EAGAIN || errno == EINTR)
+            return 0;
+        if (errno == ETIMEDOUT)
+            return -1;
+        // EFAULT, ENOSYS, EINVAL: no futex on this mapping.
+        r->poll = 1;
+    }
+
+    for (waited = 0; r->header->head == seen; waited += POLL_MS) {
+        if (timeout_ms >= 0 && waited >= timeout_ms)
+            return -1;
+        ts.tv_sec = 0;
+        ts.tv_nsec = POLL_MS * 1000000L;
+        nanosleep (&ts, NULL);
+    }
+    return 0;
+}
+
+int shmring_next (struct shmring_reader * r, struct shmring_frame * f, int timeout_ms)
+{
+uint32_t slots = r->header->slots;
+const struct shmring_slot *s;
+uint32_t head;
+
+    for (;;) {
+        head = r->header->head;
+        __sync_synchronize ();
+
+        if ((int32_t)(head - r->cursor) <= 0) {
+            if (wait_head (r, head, timeout_ms) < 0)
+                return -1;
+            continue;
+        }
+
+        // The writer may be filling the slot of frame head - slots.
+        if (head - r->cursor > slots - 1) {
+            r->dropped += head - (slots - 1) - r->cursor;
+            r->cursor = head - (slots - 1);
+        }
+
+        s = &r->slots[r->cursor % slots];
+        if (s->stamp != r->cursor) {
+            // Overtaken between the head and stamp loads.
+            r->dropped++;
+            r->cursor++;
+            continue;
+        }
+
+        __sync_synchronize ();
+        f->data = r->data + (size_t)(r->cursor % slots) * r->header->slot_size;
+        f->size = s->size;
+        f->sequence = s->sequence;
+        f->timestamp = s->timestamp;
+        f->number = r->cursor++;
+        if (f->size > r->header->slot_size)
+            f->size = r->header->slot_size;
+        r->frames++;
+        return 0;
+    }
+}
+
+int shmring_done (struct shmring_reader * r, const struct shmring_frame * f)
+{
+    __sync_synchronize ();
+    if (r->slots[f->number % r->header->slots].stamp == f->number)
+        return 0;
+    r->torn++;
+    return -1;
+}
@@ -0,0 +1,130 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Shared memory frame ring: one capture process publishes frames, any
+// number of other processes read them.
+//
+//   /dev/shm/<name>:  struct shmring_header
+//                     struct shmring_slot[slots]
+//                     page aligned payloads, slot_size bytes each
+//
+// Frames are numbered by the writer; frame n lives in slot n % slots.  The
+// writer never waits for readers: it marks the slot busy, fills it, stamps
+// it with n and advances head.  Every reader keeps its own cursor (the next
+// frame number it wants) in private memory, so readers never write to the
+// ring and never slow down the writer or each other.
+//
+// A reader that falls more than slots - 1 frames behind skips to the oldest
+// frame still in the ring and counts the frames it lost.  Frames are read
+// in place; the slot stamp is checked again when the reader is done, which
+// tells whether the writer came round and overwrote the slot meanwhile.
+//
+// Frame numbers are 32 bits and wrap after 2^32 frames.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __SHMRING_H
+#define __SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHMRING_MAGIC           "CAP22RNG"
+#define SHMRING_VERSION         1
+#define SHMRING_BUSY            0xffffffffu     // slot stamp while written
+
+struct shmring_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_size;             // payload bytes per slot
+    uint32_t data_offset;           // first payload
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixelformat;
+    uint32_t bytesperline;
+    uint32_t reserved[6];
+    volatile uint32_t head;         // frames published, futex word
+};
+
+struct shmring_slot {
+    volatile uint32_t stamp;        // frame number, SHMRING_BUSY while written
+    uint32_t size;
+    uint32_t sequence;              // V4L2 sequence
+    uint32_t flags;
+    uint64_t timestamp;             // us
+    uint32_t reserved[2];
+};
+
+struct shmring_frame {
+    const void * data;
+    uint32_t size;
+    uint32_t sequence;
+    uint64_t timestamp;
+    uint32_t number;                // ring frame number
+};
+
+//
+// Writer
+//
+struct shmring_writer;
+
+struct shmring_writer * shmring_create (const char * name, unsigned int slots,
+                                        size_t slot_size, unsigned int width,
+                                        unsigned int height, unsigned int pixelformat,
+                                        unsigned int bytesperline);
+
+//
+// Two step publish: shmring_begin () returns the slot to fill (up to
+// slot_size bytes), shmring_commit () makes it visible and wakes readers.
+// shmring_write () copies data in one call.
+//
+void * shmring_begin (struct shmring_writer * w);
+void shmring_commit (struct shmring_writer * w, size_t size, unsigned int sequence,
+                     unsigned long long timestamp);
+int shmring_write (struct shmring_writer * w, const void * data, size_t size,
+                   unsigned int sequence, unsigned long long timestamp);
+
+//
+// Unmaps and removes the ring; attached readers keep their mapping.
+//
+void shmring_destroy (struct shmring_writer * w);
+
+//
+// Reader
+//
+struct shmring_reader {
+    const struct shmring_header * header;
+    const struct shmring_slot * slots;
+    const uint8_t * data;
+    size_t length;
+    uint32_t cursor;                // next frame wanted
+    unsigned long long frames;      // frames returned
+    unsigned long long dropped;     // skipped because the reader fell behind
+    unsigned long long torn;        // overwritten while being read
+    int poll;                       // futex refused, sleep and recheck head
+};
+
+//
+// Attach read only.  The reader starts at the newest frame.  Returns 0 or
+// -1 with errno set.
+//
+int shmring_open (const char * name, struct shmring_reader * r);
+void shmring_close (struct shmring_reader * r);
+
+//
+// Next frame, waiting up to timeout_ms (-1 forever).  Returns 0, or -1 on
+// timeout.  f->data points into the ring and stays valid until the writer
+// comes round again: call shmring_done () after using it.
+//
+int shmring_next (struct shmring_reader * r, struct shmring_frame * f, int timeout_ms);
+
+//
+// 0 if the frame was intact while it was used, -1 if it was overwritten
+// and must be discarded.
+//
+int shmring_done (struct shmring_reader * r, const struct shmring_frame * f);
+
+#endif /* __SHMRING_H */
@@ -0,0 +1,444 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Minimal portable vector layer for the image kernels.
+//
+// One of the following back ends is picked at compile time:
+//
+//   NEON   (-mfpu=neon on the BeagleBoard)   16 lanes of 8 bits
+//   AVX2   (-mavx2 on x86 hosts)             32 lanes of 8 bits
+//   SSE2   (x86-64 baseline)                 16 lanes of 8 bits
+//
+// SIMD_VEC is defined when a back end is available.  Without one the
+// kernels only build their scalar reference paths.  Every operation here is
+// exact integer arithmetic so vector and scalar paths produce bit identical
+// results as long as the scalar code uses the same formulas:
+//
+//   vu8_avg (a, b)      (a + b + 1) >> 1
+//   vu8_absdiff (a, b)  |a - b|
+//   vu8_select (m, a, b)  m ? a : b   (m lanes are all ones or all zeros)
+//   vs16_adds (a, b)    a + b saturated to [-32768, 32767]
+//   vs16_pack_u8 (a, b) a, b saturated to [0, 255] and narrowed
+//
+// vu16 and vs16 share their storage with vu8; the vu8_as_u16 () style
+// casts are free.  Shift counts of vs16_sra () must be constants.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#ifndef __SIMD_H
+#define __SIMD_H
+
+#include <stdint.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+#define SIMD_VEC
+#define SIMD_NAME       "neon"
+#define VU8_LANES       16
+#define VU16_LANES      8
+
+typedef uint8x16_t vu8;
+typedef uint16x8_t vu16;
+typedef int16x8_t vs16;
+
+#define vu8_load(p)             vld1q_u8 (p)
+#define vu8_store(p, v)         vst1q_u8 ((p), (v))
+#define vu8_set1(x)             vdupq_n_u8 (x)
+#define vu8_avg(a, b)           vrhaddq_u8 ((a), (b))
+#define vu8_max(a, b)           vmaxq_u8 ((a), (b))
+#define vu8_min(a, b)           vminq_u8 ((a), (b))
+#define vu8_and(a, b)           vandq_u8 ((a), (b))
+#define vu8_or(a, b)            vorrq_u8 ((a), (b))
+#define vu8_cmpeq(a, b)         vceqq_u8 ((a), (b))
+#define vu8_lt(a, b)            vcltq_u8 ((a), (b))
+#define vu8_absdiff(a, b)       vabdq_u8 ((a), (b))
+#define vu8_select(m, a, b)     vbslq_u8 ((m), (a), (b))
+
+static inline vu8 vu8_mask_even (void)
+{
+    return vreinterpretq_u8_u16 (vdupq_n_u16 (0x00ff));
+}
+
+// Split the bytes of a:b into even and odd bytes
+static inline void vu8_unzip (vu8 a, vu8 b, vu8 * even, vu8 * odd)
+{
+uint8x16x2_t v = vuzpq_u8 (a, b);
+
+    *even = v.val[0];
+    *odd = v.val[1];
+}
+
+static inline void vu8_load2 (const uint8_t * p, vu8 * even, vu8 * odd)
+{
+uint8x16x2_t v = vld2q_u8 (p);
+
+    *even = v.val[0];
+    *odd = v.val[1];
+}
+
+static inline void vu8_store3 (uint8_t * p, vu8 a, vu8 b, vu8 c)
+{
+uint8x16x3_t v;
+
+    v.val[0] = a;
+    v.val[1] = b;
+    v.val[2] = c;
+    vst3q_u8 (p, v);
+}
+
+// Sum of all lanes
+static inline uint32_t vu8_hsum (vu8 v)
+{
+uint64x2_t s = vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (v)));
+
+    return vgetq_lane_u64 (s, 0) + vgetq_lane_u64 (s, 1);
+}
+
+// Interleave a and b: lo = a0 b0 a1 b1 ..., hi = the upper halves
+static inline void vu8_zip (vu8 a, vu8 b, vu8 * lo, vu8 * hi)
+{
+uint8x16x2_t z = vzipq_u8 (a, b);
+
+    *lo = z.val[0];
+    *hi = z.val[1];
+}
+
+#define vu16_load(p)            vld1q_u16 (p)
+#define vu16_store(p, v)        vst1q_u16 ((p), (v))
+#define vu16_set1(x)            vdupq_n_u16 (x)
+#define vu16_and(a, b)          vandq_u16 ((a), (b))
+#define vu16_shr(a, n)          vshlq_u16 ((a), vdupq_n_s16 (-(int)(n)))
+#define vu16_shl(a, n)          vshlq_u16 ((a), vdupq_n_s16 (n))
+#define vu16_or(a, b)           vorrq_u16 ((a), (b))
+#define vu16_xor(a, b)          veorq_u16 ((a), (b))
+#define vu16_select(m, a, b)    vbslq_u16 ((m), (a), (b))
+#define vu16_swap_pairs(a)      vrev32q_u16 (a)
+#define vu16_mask_even()        vreinterpretq_u16_u32 (vdupq_n_u32 (0x0000ffff))
+
+// Narrow two vectors of values below 256 to one vector of bytes
+#define vu16_pack(a, b)         vcombine_u8 (vmovn_u16 (a), vmovn_u16 (b))
+
+#define vu8_as_u16(a)           vreinterpretq_u16_u8 (a)
+#define vu16_as_u8(a)           vreinterpretq_u8_u16 (a)
+#define vu16_as_s16(a)          vreinterpretq_s16_u16 (a)
+#define vs16_as_u16(a)          vreinterpretq_u16_s16 (a)
+
+#define vs16_set1(x)            vdupq_n_s16 (x)
+#define vs16_add(a, b)          vaddq_s16 ((a), (b))
+#define vs16_adds(a, b)         vqaddq_s16 ((a), (b))
+#define vs16_sub(a, b)          vsubq_s16 ((a), (b))
+#define vs16_mul(a, b)          vmulq_s16 ((a), (b))
+#define vs16_sra(a, n)          vshrq_n_s16 ((a), (n))
+#define vs16_pack_u8(a, b)      vcombine_u8 (vqmovun_s16 (a), vqmovun_s16 (b))
+
+#elif defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define SIMD_VEC
+#define SIMD_NAME       "avx2"
+#define VU8_LANES       32
+#define VU16_LANES      16
+
+typedef __m256i vu8;
+typedef __m256i vu16;
+typedef __m256i vs16;
+
+#define vu8_load(p)             _mm256_loadu_si256 ((const __m256i *)(p))
+#define vu8_store(p, v)         _mm256_storeu_si256 ((__m256i *)(p), (v))
+#define vu8_set1(x)             _mm256_set1_epi8 ((char)(x))
+#define vu8_avg(a, b)           _mm256_avg_epu8 ((a), (b))
+#define vu8_max(a, b)           _mm256_max_epu8 ((a), (b))
+#define vu8_min(a, b)           _mm256_min_epu8 ((a), (b))
+#define vu8_and(a, b)           _mm256_and_si256 ((a), (b))
+#define vu8_or(a, b)            _mm256_or_si256 ((a), (b))
+#define vu8_cmpeq(a, b)         _mm256_cmpeq_epi8 ((a), (b))
+#define vu8_select(m, a, b)     _mm256_blendv_epi8 ((b), (a), (m))
+
+static inline vu8 vu8_lt (vu8 a, vu8 b)
+{
+    return _mm256_xor_si256 (_mm256_cmpeq_epi8 (_mm256_max_epu8 (a, b), a),
+                             _mm256_set1_epi8 (-1));
+}
+
+static inline vu8 vu8_absdiff (vu8 a, vu8 b)
+{
+    return _mm256_or_si256 (_mm256_subs_epu8 (a, b), _mm256_subs_epu8 (b, a));
+}
+
+static inline vu8 vu8_mask_even (void)
+{
+    return _mm256_set1_epi16 (0x00ff);
+}
+
+#define SIMD_SSSE3_STORE3
+#define vu16_load(p)            _mm256_loadu_si256 ((const __m256i *)(p))
+#define vu16_store(p, v)        _mm256_storeu_si256 ((__m256i *)(p), (v))
+#define vu16_set1(x)            _mm256_set1_epi16 ((short)(x))
+#define vu16_and(a, b)          _mm256_and_si256 ((a), (b))
+#define vu16_shr(a, n)          _mm256_srli_epi16 ((a), (n))
+
+#define vu16_shl(a, n)          _mm256_slli_epi16 ((a), (n))
+#define vu16_or(a, b)           _mm256_or_si256 ((a), (b))
+#define vu16_xor(a, b)          _mm256_xor_si256 ((a), (b))
+#define vu16_select(m, a, b)    _mm256_blendv_epi8 ((b), (a), (m))
+#define vu16_swap_pairs(a)      _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 ((a), 0xb1), 0xb1)
+#define vu16_mask_even()        _mm256_set1_epi32 (0x0000ffff)
+
+// packus works within 128-bit halves, restore the lane order afterwards
+#define vu16_pack(a, b)         _mm256_permute4x64_epi64 (_mm256_packus_epi16 ((a), (b)), 0xd8)
+
+#define vu8_as_u16(a)           (a)
+#define vu16_as_u8(a)           (a)
+#define vu16_as_s16(a)          (a)
+#define vs16_as_u16(a)          (a)
+
+#define vs16_set1(x)            _mm256_set1_epi16 (x)
+#define vs16_add(a, b)          _mm256_add_epi16 ((a), (b))
+#define vs16_adds(a, b)         _mm256_adds_epi16 ((a), (b))
+#define vs16_sub(a, b)          _mm256_sub_epi16 ((a), (b))
+#define vs16_mul(a, b)          _mm256_mullo_epi16 ((a), (b))
+#define vs16_sra(a, n)          _mm256_srai_epi16 ((a), (n))
+#define vs16_pack_u8(a, b)      vu16_pack ((a), (b))
+
+static inline void vu8_unzip (vu8 a, vu8 b, vu8 * even, vu8 * odd)
+{
+const __m256i m = _mm256_set1_epi16 (0x00ff);
+
+    *even = vu16_pack (_mm256_and_si256 (a, m), _mm256_and_si256 (b, m));
+    *odd = vu16_pack (_mm256_srli_epi16 (a, 8), _mm256_srli_epi16 (b, 8));
+}
+
+#define vu8_load2(p, even, odd) vu8_unzip (vu8_load (p), vu8_load ((p) + VU8_LANES), (even), (odd))
+
+static inline uint32_t vu8_hsum (vu8 v)
+{
+__m256i s = _mm256_sad_epu8 (v, _mm256_setzero_si256 ());
+__m128i t = _mm_add_epi64 (_mm256_castsi256_si128 (s), _mm256_extracti128_si256 (s, 1));
+
+    return _mm_cvtsi128_si32 (t) + _mm_cvtsi128_si32 (_mm_srli_si128 (t, 8));
+}
+
+// The unpacks interleave within 128-bit lanes, the permutes put the halves in order.
+static inline void vu8_zip (vu8 a, vu8 b, vu8 * lo, vu8 * hi)
+{
+__m256i l = _mm256_unpacklo_epi8 (a, b);
+__m256i h = _mm256_unpackhi_epi8 (a, b);
+
+    *lo = _mm256_permute2x128_si256 (l, h, 0x20);
+    *hi = _mm256_permute2x128_si256 (l, h, 0x31);
+}
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#define SIMD_SSSE3_STORE3
+#endif
+
+#define SIMD_VEC
+#define SIMD_NAME       "sse2"
+#define VU8_LANES       16
+#define VU16_LANES      8
+
+typedef __m128i vu8;
+typedef __m128i vu16;
+typedef __m128i vs16;
+
+#define vu8_load(p)             _mm_loadu_si128 ((const __m128i *)(p))
+#define vu8_store(p, v)         _mm_storeu_si128 ((__m128i *)(p), (v))
+#define vu8_set1(x)             _mm_set1_epi8 ((char)(x))
+#define vu8_avg(a, b)           _mm_avg_epu8 ((a), (b))
+#define vu8_max(a, b)           _mm_max_epu8 ((a), (b))
+#define vu8_min(a, b)           _mm_min_epu8 ((a), (b))
+#define vu8_and(a, b)           _mm_and_si128 ((a), (b))
+#define vu8_or(a, b)            _mm_or_si128 ((a), (b))
+#define vu8_cmpeq(a, b)         _mm_cmpeq_epi8 ((a), (b))
+
+static inline vu8 vu8_select (vu8 m, vu8 a, vu8 b)
+{
+    return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));
+}
+
+static inline vu8 vu8_lt (vu8 a, vu8 b)
+{
+    return _mm_xor_si128 (_mm_cmpeq_epi8 (_mm_max_epu8 (a, b), a), _mm_set1_epi8 (-1));
+}
+
+static inline vu8 vu8_absdiff (vu8 a, vu8 b)
+{
+    return _mm_or_si128 (_mm_subs_epu8 (a, b), _mm_subs_epu8 (b, a));
+}
+
+static inline vu8 vu8_mask_even (void)
+{
+    return _mm_set1_epi16 (0x00ff);
+}
+
+#define vu16_load(p)            _mm_loadu_si128 ((const __m128i *)(p))
+#define vu16_store(p, v)        _mm_storeu_si128 ((__m128i *)(p), (v))
+#define vu16_set1(x)            _mm_set1_epi16 ((short)(x))
+#define vu16_and(a, b)          _mm_and_si128 ((a), (b))
+#define vu16_shr(a, n)          _mm_srli_epi16 ((a), (n))
+#define vu16_shl(a, n)          _mm_slli_epi16 ((a), (n))
+#define vu16_or(a, b)           _mm_or_si128 ((a), (b))
+#define vu16_xor(a, b)          _mm_xor_si128 ((a), (b))
+#define vu16_select(m, a, b)    vu8_select ((m), (a), (b))
+#define vu16_swap_pairs(a)      _mm_shufflehi_epi16 (_mm_shufflelo_epi16 ((a), 0xb1), 0xb1)
+#define vu16_mask_even()        _mm_set1_epi32 (0x0000ffff)
+#define vu16_pack(a, b)         _mm_packus_epi16 ((a), (b))
+
+#define vu8_as_u16(a)           (a)
+#define vu16_as_u8(a)           (a)
+#define vu16_as_s16(a)          (a)
+#define vs16_as_u16(a)          (a)
+
+#define vs16_set1(x)            _mm_set1_epi16 (x)
+#define vs16_add(a, b)          _mm_add_epi16 ((a), (b))
+#define vs16_adds(a, b)         _mm_adds_epi16 ((a), (b))
+#define vs16_sub(a, b)          _mm_sub_epi16 ((a), (b))
+#define vs16_mul(a, b)          _mm_mullo_epi16 ((a), (b))
+#define vs16_sra(a, n)          _mm_srai_epi16 ((a), (n))
+#define vs16_pack_u8(a, b)      _mm_packus_epi16 ((a), (b))
+
+static inline void vu8_unzip (vu8 a, vu8 b, vu8 * even, vu8 * odd)
+{
+const __m128i m = _mm_set1_epi16 (0x00ff);
+
+    *even = _mm_packus_epi16 (_mm_and_si128 (a, m), _mm_and_si128 (b, m));
+    *odd = _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8));
+}
+
+#define vu8_load2(p, even, odd) vu8_unzip (vu8_load (p), vu8_load ((p) + VU8_LANES), (even), (odd))
+
+static inline uint32_t vu8_hsum (vu8 v)
+{
+__m128i s = _mm_sad_epu8 (v, _mm_setzero_si128 ());
+
+    return _mm_cvtsi128_si32 (s) + _mm_cvtsi128_si32 (_mm_srli_si128 (s, 8));
+}
+
+static inline void vu8_zip (vu8 a, vu8 b, vu8 * lo, vu8 * hi)
+{
+    *lo = _mm_unpacklo_epi8 (a, b);
+    *hi = _mm_unpackhi_epi8 (a, b);
+}
+
+#endif
+
+#ifdef SIMD_SSSE3_STORE3
+//
+// Interleave 16 bytes from each of a, b, c into 48 bytes a0 b0 c0 a1 ...
+//
+static inline void simd_store3_128 (uint8_t * p, __m128i a, __m128i b, __m128i c)
+{
+const __m128i a0 = _mm_setr_epi8 (0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+const __m128i b0 = _mm_setr_epi8 (-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+const __m128i c0 = _mm_setr_epi8 (-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+const __m128i a1 = _mm_setr_epi8 (-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+const __m128i b1 = _mm_setr_epi8 (5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+const __m128i c1 = _mm_setr_epi8 (-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+const __m128i a2 = _mm_setr_epi8 (-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+const __m128i b2 = _mm_setr_epi8 (-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+const __m128i c2 = _mm_setr_epi8 (10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+    _mm_storeu_si128 ((__m128i *)p,
+        _mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (a, a0), _mm_shuffle_epi8 (b, b0)),
+                      _mm_shuffle_epi8 (c, c0)));
+    _mm_storeu_si128 ((__m128i *)(p + 16),
+        _mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (a, a1), _mm_shuffle_epi8 (b, b1)),
+                      _mm_shuffle_epi8 (c, c1)));
+    _mm_storeu_si128 ((__m128i *)(p + 32),
+        _mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (a, a2), _mm_shuffle_epi8 (b, b2)),
+                      _mm_shuffle_epi8 (c, c2)));
+}
+#endif
+
+#if defined(__AVX2__) && !defined(__ARM_NEON__) && !defined(__ARM_NEON)
+static inline void vu8_store3 (uint8_t * p, vu8 a, vu8 b, vu8 c)
+{
+    simd_store3_128 (p, _mm256_castsi256_si128 (a), _mm256_castsi256_si128 (b),
+                     _mm256_castsi256_si128 (c));
+    simd_store3_128 (p + 48, _mm256_extracti128_si256 (a, 1),
+                     _mm256_extracti128_si256 (b, 1), _mm256_extracti128_si256 (c, 1));
+}
+#elif defined(__SSE2__) && !defined(__ARM_NEON__) && !defined(__ARM_NEON)
+static inline void vu8_store3 (uint8_t * p, vu8 a, vu8 b, vu8 c)
+{
+#ifdef SIMD_SSSE3_STORE3
+    simd_store3_128 (p, a, b, c);
+#else
+uint8_t ta[16], tb[16], tc[16];
+int i;
+
+    _mm_storeu_si128 ((__m128i *)ta, a);
+    _mm_storeu_si128 ((__m128i *)tb, b);
+    _mm_storeu_si128 ((__m128i *)tc, c);
+    for (i = 0; i < 16; ++i) {
+        p[3 * i] = ta[i];
+        p[3 * i + 1] = tb[i];
+        p[3 * i + 2] = tc[i];
+    }
+#endif
+}
+#endif
+
+//
+// 128-bit byte table lookup, for regrouping packed samples.  Only built
+// where the ISA has one (SSSE3 and AVX2 hosts, NEON):
+//
+//   v128_shuffle (v, idx)   lane i = v[idx[i]], 0 where idx[i] is 0xff
+//
+// v128_load () and v128_store () take any pointer; the 16-bit operations
+// mirror their vu16 counterparts.
+//
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define SIMD_SHUFFLE
+
+typedef uint8x16_t v128;
+
+#define v128_load(p)            vld1q_u8 ((const uint8_t *)(p))
+#define v128_store(p, v)        vst1q_u8 ((uint8_t *)(p), (v))
+#define v128_set16(x)           vreinterpretq_u8_u16 (vdupq_n_u16 (x))
+#define v128_and(a, b)          vandq_u8 ((a), (b))
+#define v128_or(a, b)           vorrq_u8 ((a), (b))
+#define v128_mul16(a, b)        vreinterpretq_u8_u16 (vmulq_u16 (vreinterpretq_u16_u8 (a), \
+                                                                 vreinterpretq_u16_u8 (b)))
+#define v128_shl16(a, n)        vreinterpretq_u8_u16 (vshlq_n_u16 (vreinterpretq_u16_u8 (a), (n)))
+#define v128_shr16(a, n)        vreinterpretq_u8_u16 (vshrq_n_u16 (vreinterpretq_u16_u8 (a), (n)))
+
+static inline v128 v128_shuffle (v128 v, v128 idx)
+{
+uint8x8x2_t t;
+
+    // Indices past the table give 0, as 0xff does on x86.
+    t.val[0] = vget_low_u8 (v);
+    t.val[1] = vget_high_u8 (v);
+    return vcombine_u8 (vtbl2_u8 (t, vget_low_u8 (idx)), vtbl2_u8 (t, vget_high_u8 (idx)));
+}
+#elif defined(SIMD_SSSE3_STORE3)
+#define SIMD_SHUFFLE
+
+typedef __m128i v128;
+
+#define v128_load(p)            _mm_loadu_si128 ((const __m128i *)(p))
+#define v128_store(p, v)        _mm_storeu_si128 ((__m128i *)(p), (v))
+#define v128_set16(x)           _mm_set1_epi16 ((short)(x))
+#define v128_and(a, b)          _mm_and_si128 ((a), (b))
+#define v128_or(a, b)           _mm_or_si128 ((a), (b))
+#define v128_mul16(a, b)        _mm_mullo_epi16 ((a), (b))
+#define v128_shl16(a, n)        _mm_slli_epi16 ((a), (n))
+#define v128_shr16(a, n)        _mm_srli_epi16 ((a), (n))
+#define v128_shuffle(v, idx)    _mm_shuffle_epi8 ((v), (idx))
+#endif
+
+#ifndef SIMD_VEC
+#define SIMD_NAME       "scalar"
+#endif
+
+#endif /* __SIMD_H */
@@ -0,0 +1,206 @@
+//**************************************************************************
+// Copyright 2012 Aptina Imaging Corporation. All rights reserved.
+//
+// Frame statistics benchmark.
+//
+// Runs the scalar reference and the vector/threaded statistics (fstats.h)
+// on a synthetic frame for YUYV, 8-bit and 10-bit Bayer at several
+// subsampling steps, reports ms per frame against the frame period at the
+// given rate and checks that both produce the same statistics.  Exits
+// non-zero on a mismatch.
+//
+//  This software and any associated documentation are provided AS IS and
+//  without warranty of any kind.
+//**************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+#include "fstats.h"
+#include "simd.h"
+
+static unsigned long long mono_us (void)
+{
+struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//***********************************************************************************
+// Gradients plus noise, with a blown out and a black patch so both clip
+// counters and the ends of the histograms see samples.
+//
+static void fill_frame (const struct conv_image * img, unsigned int bits, void * data)
+{
+unsigned int x, y, v, max = (1u << bits) - 1;
+unsigned int w = bits ? img->width : img->width * 2;
+
+    srand (1);
+    for (y = 0; y < img->height; ++y) {
+        for (x = 0; x < w; ++x) {
+            v = ((x * 5 + y * 3) << (bits > 8 ? bits - 8 : 0)) & max;
+            v ^= rand () & 0x1f;
+            if (x < w / 8 && y < img->height / 8)
+                v = max;
+            else if (x > w - w / 8 && y > img->height - img->height / 8)
+                v = rand () & 7;
+            v &= max;
+
+            if (bits > 8)
+                ((unsigned short *)data)[y * img->stride / 2 + x] = v;
+            else
+                ((unsigned char *)data)[y * img->stride + x] = v;
+        }
+    }
+}
+
+static double ms (unsigned long long us, unsigned int iter)
+{
+    return us / 1000.0 / iter;
+}
+
+//***********************************************************************************
+static int bench (const char * name, unsigned int fourcc, unsigned int bits,
+                  unsigned int width, unsigned int height, unsigned int step,
+                  unsigned int threads, unsigned int iter, double budget)
+{
+struct fstats *ref, *out;
+struct fstats_config cfg;
+struct conv_image img;
+unsigned long long t;
+double tref, t1, tn;
+unsigned char *raw;
+unsigned int i;
+int ret = 0;
+
+    img.width = width;
+    img.height = height;
+    img.stride = width * (bits == 0 || bits > 8 ? 2 : 1);
+    img.fourcc = fourcc;
+
+    raw = malloc ((size_t)img.stride * height);
+    ref = malloc (sizeof (*ref));
+    out = malloc (sizeof (*out));
+    if (!raw || !ref || !out) {
+        fprintf (stderr, "Out of memory\n");
+        exit (EXIT_FAILURE);
+    }
+
+    fill_frame (&img, bits, raw);
+    img.data = raw;
+    fstats_defaults (&cfg, fourcc);
+    cfg.step_x = step;
+    cfg.step_y = step;
+
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        fstats_frame_ref (&img, &cfg, ref);
+    tref = ms (mono_us () - t, iter);
+
+    cfg.threads = 1;
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        fstats_frame (&img, &cfg, out);
+    t1 = ms (mono_us () - t, iter);
+    if (memcmp (ref, out, sizeof (*ref))) {
+        printf ("MISMATCH: %s step %u, 1 thread\n", name, step);
+        ret = -1;
+    }
+
+    cfg.threads = threads;
+    t = mono_us ();
+    for (i = 0; i < iter; ++i)
+        fstats_frame (&img, &cfg, out);
+    tn = ms (mono_us () - t, iter);
+    if (memcmp (ref, out, sizeof (*ref))) {
+        printf ("MISMATCH: %s step %u, %u threads\n", name, step, threads);
+        ret = -1;
+    }
+
+    printf ("%-10s %4u %8.2f %8.2f %8.2f %7.0f%%   %s\n", name, step, tref, t1, tn,
+            100.0 * (tn < t1 ? tn : t1) / budget, ret ? "FAIL" : "bit-exact");
+
+    free (raw);
+    free (ref);
+    free (out);
+    return ret;
+}
+
+//***********************************************************************************
+static void usage (const char * argv0)
+{
+    printf ("Usage: %s [options]\n\n Options:\n"
+        "-w | --width n Frame width [2592]\n"
+        "-h | --height n Frame height [1944]\n"
+        "-r | --rate fps Frame rate the budget is computed for [15]\n"
+        "-t | --threads n Worker threads [4]\n"
+        "-i | --iterations n Frames per measurement [10]\n", argv0);
+}
+
+static const struct option long_options [] = {
+    { "width", required_argument, NULL, 'w' },
+    { "height", required_argument, NULL, 'h' },
+    { "rate", required_argument, NULL, 'r' },
+    { "threads", required_argument, NULL, 't' },
+    { "iterations", required_argument, NULL, 'i' },
+    { "help", no_argument, NULL, '?' },
+    { 0, 0, 0, 0 }
+};
+
+int main (int argc, char ** argv)
+{
+static const unsigned int steps[] = { 1, 2, 4 };
+unsigned int width = 2592, height = 1944, threads = 4, iter = 10, i;
+double rate = 15.0, budget;
+int c, ret = 0;
+
+    while ((c = getopt_long (argc, argv, "w:h:r:t:i:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'w':
+                width = atoi (optarg);
+                break;
+            case 'h':
+                height = atoi (optarg);
+                break;
+            case 'r':
+                rate = atof (optarg);
+                break;
+            case 't':
+                threads = atoi (optarg);
+                break;
+            case 'i':
+                iter = atoi (optarg);
+                break;
+            default:
+                usage (argv[0]);
+                return c == '?' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if ((width | height) & 1 || rate <= 0.0) {
+        fprintf (stderr, "Width and height must be even, the rate positive\n");
+        return EXIT_FAILURE;
+    }
+    budget = 1000.0 / rate;
+
+    printf ("statistics %ux%u, %s, %u threads, %u iterations, %.1f ms budget (%.1f fps)\n\n",
+            width, height, SIMD_NAME, threads, iter, budget, rate);
+    printf ("%-10s %4s %8s %8s %8s %8s\n", "ms/frame", "step", "scalar", "vector",
+            "threads", "budget");
+
+    for (i = 0; i < sizeof (steps) / sizeof (steps[0]); ++i) {
+        ret |= bench ("yuyv", V4L2_PIX_FMT_YUYV, 0, width, height, steps[i],
+                      threads, iter, budget);
+        ret |= bench ("bayer8", V4L2_PIX_FMT_SGRBG8, 8, width, height, steps[i],
+                      threads, iter, budget);
+        ret |= bench ("bayer10", V4L2_PIX_FMT_SGRBG10, 10, width, height, steps[i],
+                      threads, iter, budget);
+    }
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
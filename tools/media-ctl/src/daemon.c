@@ -0,0 +1,355 @@
+/*
+ * Media controller daemon mode
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * Keeps the media device open and the graph enumerated between media-ctl
+ * invocations: commands sent by clients over a UNIX socket run against the
+ * already opened device.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#include "media.h"
+
+/* Clients served at the same time, further connections wait in the backlog. */
+#define MEDIA_DAEMON_MAX_CLIENTS	16
+/* Longest command line, longer ones drop the client. */
+#define MEDIA_DAEMON_LINE_MAX		4096
+/* A client that doesn't read its output for that long loses it. */
+#define MEDIA_DAEMON_SEND_TIMEOUT	5
+
+struct media_daemon_client {
+	int fd;
+	size_t length;
+	char line[MEDIA_DAEMON_LINE_MAX];
+};
+
+static volatile sig_atomic_t media_daemon_stop;
+
+static void media_daemon_signal(int sig)
+{
+	(void)sig;
+
+	media_daemon_stop = 1;
+}
+
+static int media_daemon_address(const char *path, struct sockaddr_un *addr)
+{
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		printf("%s: Socket path %s too long\n", __func__, path);
+		return -ENAMETOOLONG;
+	}
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+/*
+ * Run one command line with standard output redirected to the client. Return
+ * 1 if the daemon must stop.
+ */
+static int media_daemon_command(struct media_device *media, int fd,
+				char *line, media_command_fn fn)
+{
+	char status[32];
+	char *arg;
+	int stdout_fd;
+	int ret;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	if (line[0] == '\0')
+		return 0;
+
+	arg = strchr(line, ' ');
+	if (arg != NULL)
+		*arg++ = '\0';
+
+	if (strcmp(line, "quit") == 0) {
+		ret = 0;
+		media_daemon_stop = 1;
+	} else {
+		fflush(stdout);
+		stdout_fd = dup(STDOUT_FILENO);
+		dup2(fd, STDOUT_FILENO);
+
+		ret = fn(media, line, arg);
+
+		fflush(stdout);
+		dup2(stdout_fd, STDOUT_FILENO);
+		close(stdout_fd);
+	}
+
+	snprintf(status, sizeof(status), MEDIA_DAEMON_STATUS "%d\n", ret);
+	if (write(fd, status, strlen(status)) < 0)
+		return -errno;
+
+	return media_daemon_stop;
+}
+
+/*
+ * Read what the client sent and run the complete lines. Commands of all
+ * clients run one at a time, but a client only holds the daemon for the
+ * duration of a command: partial lines are buffered until the rest arrives.
+ * Return 1 if the daemon must stop, a negative value to drop the client.
+ */
+static int media_daemon_client(struct media_device *media,
+			       struct media_daemon_client *client,
+			       media_command_fn fn)
+{
+	size_t length = client->length;
+	char *start = client->line;
+	char *end;
+	ssize_t size;
+	int ret = 0;
+
+	size = read(client->fd, client->line + length,
+		    sizeof(client->line) - 1 - length);
+	if (size < 0 && (errno == EINTR || errno == EAGAIN))
+		return 0;
+	if (size < 0)
+		return -errno;
+
+	length += size;
+	client->line[length] = '\0';
+
+	while ((end = memchr(start, '\n', length - (start - client->line)))) {
+		*end = '\0';
+		ret = media_daemon_command(media, client->fd, start, fn);
+		start = end + 1;
+		if (ret != 0)
+			return ret;
+	}
+
+	length -= start - client->line;
+	memmove(client->line, start, length);
+	client->length = length;
+
+	/* End of file, run the last unterminated line. */
+	if (size == 0) {
+		if (length)
+			ret = media_daemon_command(media, client->fd,
+						   client->line, fn);
+		return ret ? ret : -ECONNRESET;
+	}
+
+	if (length == sizeof(client->line) - 1) {
+		printf("%s: command line too long\n", __func__);
+		return -ENOBUFS;
+	}
+
+	return 0;
+}
+
+static int media_daemon_accept(int fd, struct media_daemon_client *client)
+{
+	struct timeval timeout = { MEDIA_DAEMON_SEND_TIMEOUT, 0 };
+
+	client->fd = accept(fd, NULL, NULL);
+	if (client->fd < 0)
+		return -errno;
+
+	/* Don't let a client that stopped reading block the others. */
+	setsockopt(client->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+		   sizeof(timeout));
+	client->length = 0;
+	return 0;
+}
+
+int media_daemon_run(struct media_device *media, const char *path,
+		     media_command_fn fn)
+{
+	struct media_daemon_client *clients;
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	unsigned int count = 0;
+	int ret;
+	int fd;
+
+	ret = media_daemon_address(path, &addr);
+	if (ret < 0)
+		return ret;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		ret = -errno;
+		printf("%s: Unable to create socket (%s)\n", __func__, strerror(-ret));
+		return ret;
+	}
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, 8) < 0) {
+		ret = -errno;
+		printf("%s: Unable to listen on %s (%s)\n", __func__, path,
+			strerror(-ret));
+		close(fd);
+		return ret;
+	}
+
+	/* No SA_RESTART, poll() must return on a termination signal. */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = media_daemon_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Serving %u entities on %s\n", media->entities_count, path);
+	fflush(stdout);
+
+	clients = calloc(MEDIA_DAEMON_MAX_CLIENTS, sizeof(*clients));
+	if (clients == NULL) {
+		close(fd);
+		unlink(path);
+		return -ENOMEM;
+	}
+
+	/* pfds[0] is the listening socket, pfds[i + 1] clients[i]. */
+	while (!media_daemon_stop) {
+		struct pollfd pfds[MEDIA_DAEMON_MAX_CLIENTS + 1];
+		unsigned int i;
+
+		pfds[0].fd = fd;
+		pfds[0].events = count < MEDIA_DAEMON_MAX_CLIENTS ? POLLIN : 0;
+		for (i = 0; i < count; ++i) {
+			pfds[i + 1].fd = clients[i].fd;
+			pfds[i + 1].events = POLLIN;
+		}
+
+		if (poll(pfds, count + 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			printf("%s: poll failed (%s)\n", __func__, strerror(-ret));
+			break;
+		}
+
+		/* Walk backwards, dropped clients are replaced by the last one. */
+		for (i = count; i > 0 && !media_daemon_stop; --i) {
+			struct media_daemon_client *client = &clients[i - 1];
+
+			if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+
+			if (media_daemon_client(media, client, fn) >= 0)
+				continue;
+
+			close(client->fd);
+			*client = clients[--count];
+		}
+
+		if (media_daemon_stop || !(pfds[0].revents & POLLIN))
+			continue;
+
+		ret = media_daemon_accept(fd, &clients[count]);
+		if (ret == 0) {
+			count++;
+		} else if (ret != -EINTR && ret != -ECONNABORTED) {
+			printf("%s: accept failed (%s)\n", __func__, strerror(-ret));
+			break;
+		}
+		ret = 0;
+	}
+
+	while (count--)
+		close(clients[count].fd);
+	free(clients);
+
+	close(fd);
+	unlink(path);
+	return ret;
+}
+
+int media_daemon_send(const char *path, char * const *commands,
+		      unsigned int count)
+{
+	struct sockaddr_un addr;
+	unsigned int i;
+	size_t size = 0;
+	char *line = NULL;
+	FILE *out;
+	FILE *in;
+	int status = 0;
+	int fd;
+	int ret;
+
+	ret = media_daemon_address(path, &addr);
+	if (ret < 0)
+		return ret;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -errno;
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		ret = -errno;
+		printf("Unable to connect to %s (%s)\n", path, strerror(-ret));
+		close(fd);
+		return ret;
+	}
+
+	/* Send the whole batch at once, then collect the answers. */
+	out = fdopen(dup(fd), "w");
+	in = fdopen(fd, "r");
+	if (out == NULL || in == NULL) {
+		if (out)
+			fclose(out);
+		if (in)
+			fclose(in);
+		else
+			close(fd);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < count; ++i)
+		fprintf(out, "%s\n", commands[i]);
+	fclose(out);
+
+	for (i = 0; i < count && getline(&line, &size, in) >= 0; ) {
+		if (strncmp(line, MEDIA_DAEMON_STATUS,
+			    strlen(MEDIA_DAEMON_STATUS)) == 0) {
+			ret = atoi(line + strlen(MEDIA_DAEMON_STATUS));
+			if (ret < 0 && status == 0)
+				status = ret;
+			i++;
+			continue;
+		}
+
+		fputs(line, stdout);
+	}
+
+	if (i < count && status == 0)
+		status = -ECONNRESET;
+
+	free(line);
+	fclose(in);
+	return status;
+}
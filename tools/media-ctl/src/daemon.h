@@ -0,0 +1,54 @@
+/*
+ * Media controller daemon mode
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __DAEMON_H__
+#define __DAEMON_H__
+
+struct media_device;
+
+/*
+ * Protocol: the client sends one command per line, a command name optionally
+ * followed by a space and an argument. The daemon answers every command with
+ * the command output followed by a status line made of MEDIA_DAEMON_STATUS
+ * and the command return value (0 or a negative error code).
+ */
+#define MEDIA_DAEMON_STATUS	"@@ "
+
+typedef int (*media_command_fn)(struct media_device *media,
+				const char *command, const char *arg);
+
+/*
+ * Serve commands on the UNIX socket at path until a "quit" command or a
+ * termination signal. Up to 16 clients are connected at the same time, each
+ * command line runs as soon as it is complete, through fn with standard output
+ * redirected to its client. An idle client doesn't hold up the others.
+ */
+int media_daemon_run(struct media_device *media, const char *path,
+		     media_command_fn fn);
+
+/*
+ * Send a batch of command lines to the daemon at path and copy the output to
+ * standard output. Return 0 if all commands succeeded, the first error
+ * otherwise.
+ */
+int media_daemon_send(const char *path, char * const *commands,
+		      unsigned int count);
+
+#endif /* __DAEMON_H__ */
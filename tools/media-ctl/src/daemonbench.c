@@ -0,0 +1,311 @@
+/*
+ * Media controller daemon benchmark
+ *
+ * Copyright (C) 2010 Ideas on board SPRL <laurent.pinchart@ideasonboard.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ */
+
+/*
+ * Times one media-ctl command, run
+ *
+ * - one-shot:	media-ctl -d device --command=argument, which opens the device
+ *		and enumerates the topology every time,
+ * - client:	media-ctl --connect socket --command=argument, a new process and
+ *		connection per command, as a shell script would use the daemon,
+ * - session:	one command at a time on a single connection,
+ * - batch:	all commands sent at once on a single connection.
+ *
+ * The daemon is started on the given device and socket and stopped at the
+ * end. Exits non-zero when a command fails.
+ */
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "daemon.h"
+
+static const char *media_ctl = "./media-ctl";
+
+static unsigned long long mono_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Run media-ctl with its output discarded, return its exit status. */
+static int run(char * const *argv, int wait_exit)
+{
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	if (pid < 0)
+		return -errno;
+
+	if (pid == 0) {
+		int fd = open("/dev/null", O_WRONLY);
+
+		dup2(fd, STDOUT_FILENO);
+		execv(media_ctl, argv);
+		_exit(127);
+	}
+
+	if (!wait_exit)
+		return pid;
+
+	if (waitpid(pid, &status, 0) < 0)
+		return -errno;
+
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int daemon_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -errno;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	return fd;
+}
+
+/*
+ * Read answers until count status lines have been seen, return the number of
+ * failed commands or a negative error code.
+ */
+static int daemon_wait(int fd, unsigned int count)
+{
+	static char buffer[65536];
+	static size_t fill;
+	unsigned int failed = 0;
+	const size_t len = strlen(MEDIA_DAEMON_STATUS);
+
+	while (count) {
+		char *nl;
+		ssize_t ret;
+
+		nl = memchr(buffer, '\n', fill);
+		if (nl == NULL) {
+			if (fill == sizeof(buffer))
+				fill = 0;
+			ret = read(fd, buffer + fill, sizeof(buffer) - fill);
+			if (ret <= 0)
+				return ret < 0 ? -errno : -ECONNRESET;
+			fill += ret;
+			continue;
+		}
+
+		*nl = '\0';
+		if (strncmp(buffer, MEDIA_DAEMON_STATUS, len) == 0) {
+			failed += atoi(buffer + len) != 0;
+			count--;
+		}
+
+		fill -= nl + 1 - buffer;
+		memmove(buffer, nl + 1, fill);
+	}
+
+	return failed;
+}
+
+static void report(const char *what, unsigned long long ns, unsigned int count,
+		   unsigned long long reference)
+{
+	printf("%-10s %12.1f %9.1fx\n", what, (double)ns / count / 1000,
+	       ns ? (double)reference / ns : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long t, oneshot, elapsed;
+	unsigned int count = 100;
+	const char *device, *socket_path, *command, *arg = NULL;
+	char option[4096], line[4096];
+	char *oneshot_argv[5], *client_argv[5], *daemon_argv[6];
+	unsigned int i;
+	int failed = 0;
+	pid_t pid;
+	int opt;
+	int fd;
+	int ret;
+
+	while ((opt = getopt(argc, argv, "m:n:")) != -1) {
+		switch (opt) {
+		case 'm':
+			media_ctl = optarg;
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			count = 0;
+			break;
+		}
+	}
+
+	if (count == 0 || argc - optind < 3) {
+		printf("Usage: %s [-m media-ctl] [-n count] device socket command [argument]\n",
+		       argv[0]);
+		printf("command is a daemon command, such as get-format or links\n");
+		return EXIT_FAILURE;
+	}
+
+	device = argv[optind];
+	socket_path = argv[optind + 1];
+	command = argv[optind + 2];
+	if (argc - optind > 3)
+		arg = argv[optind + 3];
+
+	snprintf(option, sizeof(option), "--%s%s%s", command, arg ? "=" : "",
+		 arg ? arg : "");
+	snprintf(line, sizeof(line), "%s%s%s\n", command, arg ? " " : "",
+		 arg ? arg : "");
+
+	oneshot_argv[0] = "media-ctl";
+	oneshot_argv[1] = "-d";
+	oneshot_argv[2] = (char *)device;
+	oneshot_argv[3] = option;
+	oneshot_argv[4] = NULL;
+
+	client_argv[0] = "media-ctl";
+	client_argv[1] = "--connect";
+	client_argv[2] = (char *)socket_path;
+	client_argv[3] = option;
+	client_argv[4] = NULL;
+
+	daemon_argv[0] = "media-ctl";
+	daemon_argv[1] = "-d";
+	daemon_argv[2] = (char *)device;
+	daemon_argv[3] = "--daemon";
+	daemon_argv[4] = (char *)socket_path;
+	daemon_argv[5] = NULL;
+
+	unlink(socket_path);
+	pid = run(daemon_argv, 0);
+	if (pid < 0) {
+		printf("Unable to start the daemon (%s)\n", strerror(-pid));
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < 200; ++i) {
+		fd = daemon_connect(socket_path);
+		if (fd >= 0)
+			break;
+		usleep(10000);
+	}
+
+	if (fd < 0) {
+		printf("Unable to connect to the daemon (%s)\n", strerror(-fd));
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+		return EXIT_FAILURE;
+	}
+
+	printf("%u x %s\n\n", count, option);
+	printf("%-10s %12s %10s\n", "", "us/command", "speedup");
+
+	t = mono_ns();
+	for (i = 0; i < count; ++i)
+		failed += run(oneshot_argv, 1) != 0;
+	oneshot = mono_ns() - t;
+	report("one-shot", oneshot, count, oneshot);
+
+	/* The daemon serves one client at a time, free it for media-ctl. */
+	close(fd);
+
+	t = mono_ns();
+	for (i = 0; i < count; ++i)
+		failed += run(client_argv, 1) != 0;
+	elapsed = mono_ns() - t;
+	report("client", elapsed, count, oneshot);
+
+	fd = daemon_connect(socket_path);
+	if (fd < 0) {
+		printf("Unable to connect to the daemon (%s)\n", strerror(-fd));
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+		return EXIT_FAILURE;
+	}
+
+	t = mono_ns();
+	for (i = 0; i < count; ++i) {
+		if (write(fd, line, strlen(line)) < 0)
+			break;
+		ret = daemon_wait(fd, 1);
+		if (ret < 0)
+			break;
+		failed += ret;
+	}
+	elapsed = mono_ns() - t;
+	failed += count - i;
+	report("session", elapsed, count, oneshot);
+
+	/* Batch, the socket buffer holds a few hundred commands. */
+	t = mono_ns();
+	for (i = 0; i < count; i += ret) {
+		unsigned int batch = count - i < 128 ? count - i : 128;
+		unsigned int j;
+
+		for (j = 0; j < batch; ++j) {
+			if (write(fd, line, strlen(line)) < 0)
+				break;
+		}
+
+		ret = daemon_wait(fd, j);
+		if (ret < 0)
+			break;
+		failed += ret;
+		ret = j;
+	}
+	elapsed = mono_ns() - t;
+	failed += count - i;
+	report("batch", elapsed, count, oneshot);
+
+	if (write(fd, "quit\n", 5) < 0 || daemon_wait(fd, 1) < 0)
+		kill(pid, SIGTERM);
+	close(fd);
+	waitpid(pid, NULL, 0);
+
+	if (failed) {
+		printf("\n%d commands failed\n", failed);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
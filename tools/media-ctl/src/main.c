@@ -36,6 +36,7 @@
 #include <linux/v4l2-subdev.h>
 #include <linux/videodev2.h>
 
+#include "daemon.h"
 #include "media.h"
 #include "options.h"
 #include "subdev.h"
@@ -48,28 +49,29 @@
 static struct {
 	const char *name;
 	enum v4l2_mbus_pixelcode code;
+	unsigned int bits;		/* per pixel on the bus */
 } mbus_formats[] = {
-	{ "Y8", V4L2_MBUS_FMT_Y8_1X8},
-	{ "Y10", V4L2_MBUS_FMT_Y10_1X10 },
-	{ "Y12", V4L2_MBUS_FMT_Y12_1X12 },
-	{ "YUYV", V4L2_MBUS_FMT_YUYV8_1X16 },
-	{ "UYVY", V4L2_MBUS_FMT_UYVY8_1X16 },
-	{ "SBGGR8", V4L2_MBUS_FMT_SBGGR8_1X8 },
-	{ "SGBRG8", V4L2_MBUS_FMT_SGBRG8_1X8 },
-	{ "SGRBG8", V4L2_MBUS_FMT_SGRBG8_1X8 },
-	{ "SRGGB8", V4L2_MBUS_FMT_SRGGB8_1X8 },
-	{ "SBGGR10", V4L2_MBUS_FMT_SBGGR10_1X10 },
-	{ "SGBRG10", V4L2_MBUS_FMT_SGBRG10_1X10 },
-	{ "SGRBG10", V4L2_MBUS_FMT_SGRBG10_1X10 },
-	{ "SRGGB10", V4L2_MBUS_FMT_SRGGB10_1X10 },
-	{ "SBGGR10_DPCM8", V4L2_MBUS_FMT_SBGGR10_DPCM8_1X8 },
-	{ "SGBRG10_DPCM8", V4L2_MBUS_FMT_SGBRG10_DPCM8_1X8 },
-	{ "SGRBG10_DPCM8", V4L2_MBUS_FMT_SGRBG10_DPCM8_1X8 },
-	{ "SRGGB10_DPCM8", V4L2_MBUS_FMT_SRGGB10_DPCM8_1X8 },
-	{ "SBGGR12", V4L2_MBUS_FMT_SBGGR12_1X12 },
-	{ "SGBRG12", V4L2_MBUS_FMT_SGBRG12_1X12 },
-	{ "SGRBG12", V4L2_MBUS_FMT_SGRBG12_1X12 },
-	{ "SRGGB12", V4L2_MBUS_FMT_SRGGB12_1X12 },
+	{ "Y8", V4L2_MBUS_FMT_Y8_1X8, 8 },
+	{ "Y10", V4L2_MBUS_FMT_Y10_1X10, 10 },
+	{ "Y12", V4L2_MBUS_FMT_Y12_1X12, 12 },
+	{ "YUYV", V4L2_MBUS_FMT_YUYV8_1X16, 16 },
+	{ "UYVY", V4L2_MBUS_FMT_UYVY8_1X16, 16 },
+	{ "SBGGR8", V4L2_MBUS_FMT_SBGGR8_1X8, 8 },
+	{ "SGBRG8", V4L2_MBUS_FMT_SGBRG8_1X8, 8 },
+	{ "SGRBG8", V4L2_MBUS_FMT_SGRBG8_1X8, 8 },
+	{ "SRGGB8", V4L2_MBUS_FMT_SRGGB8_1X8, 8 },
+	{ "SBGGR10", V4L2_MBUS_FMT_SBGGR10_1X10, 10 },
+	{ "SGBRG10", V4L2_MBUS_FMT_SGBRG10_1X10, 10 },
+	{ "SGRBG10", V4L2_MBUS_FMT_SGRBG10_1X10, 10 },
+	{ "SRGGB10", V4L2_MBUS_FMT_SRGGB10_1X10, 10 },
+	{ "SBGGR10_DPCM8", V4L2_MBUS_FMT_SBGGR10_DPCM8_1X8, 8 },
+	{ "SGBRG10_DPCM8", V4L2_MBUS_FMT_SGBRG10_DPCM8_1X8, 8 },
+	{ "SGRBG10_DPCM8", V4L2_MBUS_FMT_SGRBG10_DPCM8_1X8, 8 },
+	{ "SRGGB10_DPCM8", V4L2_MBUS_FMT_SRGGB10_DPCM8_1X8, 8 },
+	{ "SBGGR12", V4L2_MBUS_FMT_SBGGR12_1X12, 12 },
+	{ "SGBRG12", V4L2_MBUS_FMT_SGBRG12_1X12, 12 },
+	{ "SGRBG12", V4L2_MBUS_FMT_SGRBG12_1X12, 12 },
+	{ "SRGGB12", V4L2_MBUS_FMT_SRGGB12_1X12, 12 },
 };
 
 static const char *pixelcode_to_string(enum v4l2_mbus_pixelcode code)
@@ -84,6 +86,18 @@ static const char *pixelcode_to_string(enum v4l2_mbus_pixelcode code)
 	return "unknown";
 }
 
+static unsigned int pixelcode_to_bits(enum v4l2_mbus_pixelcode code)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(mbus_formats); ++i) {
+		if (mbus_formats[i].code == code)
+			return mbus_formats[i].bits;
+	}
+
+	return 0;
+}
+
 static enum v4l2_mbus_pixelcode string_to_pixelcode(const char *string,
 					     unsigned int length)
 {
@@ -100,24 +114,20 @@ static enum v4l2_mbus_pixelcode string_to_pixelcode(const char *string,
 	return mbus_formats[i].code;
 }
 
-static void v4l2_subdev_print_format(struct media_entity *entity,
-	unsigned int pad, enum v4l2_subdev_format_whence which)
+static void v4l2_subdev_print_format(const struct v4l2_subdev_pad_state *state)
 {
-	struct v4l2_mbus_framefmt format;
-	struct v4l2_rect rect;
-	int ret;
+	const struct v4l2_mbus_framefmt *format = &state->format;
+	const struct v4l2_rect *rect = &state->crop;
 
-	ret = v4l2_subdev_get_format(entity, &format, pad, which);
-	if (ret != 0)
+	if (!(state->valid & V4L2_SUBDEV_STATE_FORMAT))
 		return;
 
-	printf("[%s %ux%u", pixelcode_to_string(format.code),
-	       format.width, format.height);
+	printf("[%s %ux%u", pixelcode_to_string(format->code),
+	       format->width, format->height);
 
-	ret = v4l2_subdev_get_crop(entity, &rect, pad, which);
-	if (ret == 0)
-		printf(" (%u,%u)/%ux%u", rect.left, rect.top,
-		       rect.width, rect.height);
+	if (state->valid & V4L2_SUBDEV_STATE_CROP)
+		printf(" (%u,%u)/%ux%u", rect->left, rect->top,
+		       rect->width, rect->height);
 	printf("]");
 }
 
@@ -196,7 +206,23 @@ static const char *media_pad_type_to_string(unsigned flag)
 	return "Unknown";
 }
 
-static void media_print_topology_dot(struct media_device *media)
+/* Active format under the pad number, if known. */
+static void media_print_pad_dot(struct v4l2_subdev_state *state,
+				struct media_pad *pad)
+{
+	struct v4l2_subdev_pad_state *pstate;
+
+	if (state == NULL)
+		return;
+
+	pstate = v4l2_subdev_state_pad(state, pad);
+	if (pstate->valid & V4L2_SUBDEV_STATE_FORMAT)
+		printf("\\n%s %ux%u", pixelcode_to_string(pstate->format.code),
+		       pstate->format.width, pstate->format.height);
+}
+
+static void media_print_topology_dot(struct media_device *media,
+				     struct v4l2_subdev_state *state)
 {
 	unsigned int i, j;
 
@@ -222,6 +248,7 @@ static void media_print_topology_dot(struct media_device *media)
 					continue;
 
 				printf("%s<port%u> %u", npads ? " | " : "", j, j);
+				media_print_pad_dot(state, &entity->pads[j]);
 				npads++;
 			}
 
@@ -235,6 +262,7 @@ static void media_print_topology_dot(struct media_device *media)
 					continue;
 
 				printf("%s<port%u> %u", npads ? " | " : "", j, j);
+				media_print_pad_dot(state, &entity->pads[j]);
 				npads++;
 			}
 
@@ -270,7 +298,8 @@ static void media_print_topology_dot(struct media_device *media)
 	printf("}\n");
 }
 
-static void media_print_topology_text(struct media_device *media)
+static void media_print_topology_text(struct media_device *media,
+				      struct v4l2_subdev_state *state)
 {
 	unsigned int i, j, k;
 	unsigned int padding;
@@ -295,8 +324,8 @@ static void media_print_topology_text(struct media_device *media)
 
 			printf("\tpad%u: %s ", j, media_pad_type_to_string(pad->flags));
 
-			if (media_entity_type(entity) == MEDIA_ENT_T_V4L2_SUBDEV)
-				v4l2_subdev_print_format(entity, j, V4L2_SUBDEV_FORMAT_ACTIVE);
+			if (state)
+				v4l2_subdev_print_format(v4l2_subdev_state_pad(state, pad));
 
 			printf("\n");
 
@@ -328,10 +357,17 @@ static void media_print_topology_text(struct media_device *media)
 
 void media_print_topology(struct media_device *media, int dot)
 {
+	struct v4l2_subdev_state *state;
+
+	/* Formats are left out if the state can't be allocated. */
+	state = v4l2_subdev_get_state(media, V4L2_SUBDEV_FORMAT_ACTIVE);
+
 	if (dot)
-		media_print_topology_dot(media);
+		media_print_topology_dot(media, state);
 	else
-		media_print_topology_text(media);
+		media_print_topology_text(media, state);
+
+	v4l2_subdev_free_state(state);
 }
 
 /* -----------------------------------------------------------------------------
@@ -383,10 +419,8 @@ static struct media_pad *parse_pad(struct media_device *media, const char *p, ch
 
 static struct media_link *parse_link(struct media_device *media, const char *p, char **endp)
 {
-	struct media_link *link;
 	struct media_pad *source;
 	struct media_pad *sink;
-	unsigned int i;
 	char *end;
 
 	source = parse_pad(media, p, &end);
@@ -403,44 +437,49 @@ static struct media_link *parse_link(struct media_device *media, const char *p,
 
 	*endp = end;
 
-	for (i = 0; i < source->entity->num_links; i++) {
-		link = &source->entity->links[i];
-
-		if (link->source == source && link->sink == sink)
-			return link;
-	}
-
-	return NULL;
+	return media_find_link(media, source, sink);
 }
 
-static int setup_link(struct media_device *media, const char *p, char **endp)
+static struct media_link *parse_link_flags(struct media_device *media,
+	__u32 *flags, const char *p, char **endp)
 {
 	struct media_link *link;
-	__u32 flags;
 	char *end;
 
 	link = parse_link(media, p, &end);
 	if (link == NULL) {
 		printf("Unable to parse link\n");
-		return -EINVAL;
+		return NULL;
 	}
 
 	p = end;
 	if (*p++ != '[') {
 		printf("Unable to parse link flags\n");
-		return -EINVAL;
+		return NULL;
 	}
 
-	flags = strtoul(p, &end, 10);
+	*flags = strtoul(p, &end, 10);
 	for (p = end; isspace(*p); p++);
 	if (*p++ != ']') {
 		printf("Unable to parse link flags\n");
-		return -EINVAL;
+		return NULL;
 	}
 
 	for (; isspace(*p); p++);
 	*endp = (char *)p;
 
+	return link;
+}
+
+static int setup_link(struct media_device *media, const char *p, char **endp)
+{
+	struct media_link *link;
+	__u32 flags;
+
+	link = parse_link_flags(media, &flags, p, endp);
+	if (link == NULL)
+		return -EINVAL;
+
 	printf("Setting up link %u:%u -> %u:%u [%u]\n",
 		link->source->entity->info.id, link->source->index,
 		link->sink->entity->info.id, link->sink->index,
@@ -746,6 +785,1042 @@ static int setup_formats(struct media_device *media, const char *p)
 	return *end ? -EINVAL : 0;
 }
 
+/*
+ * Let libv4l2subdev work out the formats between two pads, given the format
+ * at the start (optional) and the end of the pipeline.
+ */
+static int setup_pipeline(struct media_device *media, const char *p)
+{
+	struct v4l2_mbus_framefmt input = { 0, 0, 0 };
+	struct v4l2_mbus_framefmt output = { 0, 0, 0 };
+	struct v4l2_rect crop = { -1, -1, -1, -1 };
+	struct v4l2_fract interval = { 0, 0 };
+	struct media_pad *start;
+	struct media_pad *end;
+	char *endp;
+	int ret;
+
+	start = parse_pad_format(media, &input, &crop, &interval, p, &endp);
+	if (start == NULL) {
+		printf("Unable to parse pipeline start\n");
+		return -EINVAL;
+	}
+
+	for (p = endp; isspace(*p); ++p);
+	if (p[0] != '-' || p[1] != '>') {
+		printf("Unable to parse pipeline\n");
+		return -EINVAL;
+	}
+
+	end = parse_pad_format(media, &output, &crop, &interval, p + 2, &endp);
+	if (end == NULL || output.width == 0 || output.height == 0) {
+		printf("Unable to parse pipeline end\n");
+		return -EINVAL;
+	}
+
+	printf("Setting up pipeline %s/%u -> %s/%u, output %s %ux%u\n",
+		start->entity->info.name, start->index,
+		end->entity->info.name, end->index,
+		pixelcode_to_string(output.code), output.width, output.height);
+
+	ret = v4l2_subdev_setup_pipeline(media, start, &input, end, &output, 1);
+	if (ret < 0) {
+		printf("Unable to set up pipeline: %s (%d)\n", strerror(-ret), ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Pipeline snapshot
+ *
+ * A snapshot is a text file in the links and formats syntax, one link or pad
+ * format per line, '#' starts a comment. It holds all links that aren't
+ * immutable and the active format, crop rectangle and frame interval of all
+ * subdev pads.
+ *
+ * Restoring a snapshot compares it with the live state and only sets what
+ * differs. Links are disabled before others get enabled, as a pad may accept
+ * a single active link. Formats are then applied from the start of the
+ * pipeline downwards and, as subdevs propagate formats from their sink pads
+ * to their source pads, sink pads first within an entity.
+ */
+
+struct snapshot_link {
+	struct media_link *link;
+	__u32 flags;
+};
+
+struct snapshot_pad {
+	struct media_pad *pad;
+	unsigned int depth;
+	struct v4l2_mbus_framefmt format;
+	struct v4l2_rect crop;
+	struct v4l2_fract interval;
+};
+
+struct snapshot {
+	struct snapshot_link *links;
+	unsigned int num_links;
+	unsigned int max_links;
+	struct snapshot_pad *pads;
+	unsigned int num_pads;
+	unsigned int max_pads;
+
+	struct v4l2_subdev_state *state;	/* live state being compared */
+	unsigned int settings;
+	unsigned int changes;
+};
+
+static int save_snapshot(struct media_device *media, const char *filename)
+{
+	struct v4l2_subdev_state *state;
+	unsigned int i, j;
+	FILE *file;
+	int ret;
+
+	state = v4l2_subdev_get_state(media, V4L2_SUBDEV_FORMAT_ACTIVE);
+	if (state == NULL)
+		return -ENOMEM;
+
+	file = fopen(filename, "w");
+	if (file == NULL) {
+		ret = -errno;
+		printf("Unable to open %s: %s\n", filename, strerror(-ret));
+		v4l2_subdev_free_state(state);
+		return ret;
+	}
+
+	fprintf(file, "# Pipeline snapshot of %s\n", media_opts.devname);
+
+	fprintf(file, "\n# Links\n");
+	for (i = 0; i < media->entities_count; ++i) {
+		struct media_entity *entity = &media->entities[i];
+
+		for (j = 0; j < entity->num_links; ++j) {
+			struct media_link *link = &entity->links[j];
+
+			if (link->source->entity != entity ||
+			    link->flags & MEDIA_LNK_FL_IMMUTABLE)
+				continue;
+
+			fprintf(file, "\"%s\":%u -> \"%s\":%u [%u]\n",
+				entity->info.name, link->source->index,
+				link->sink->entity->info.name, link->sink->index,
+				link->flags & MEDIA_LNK_FL_ENABLED ? 1 : 0);
+		}
+	}
+
+	fprintf(file, "\n# Formats\n");
+	for (i = 0; i < media->entities_count; ++i) {
+		struct v4l2_subdev_entity_state *estate = &state->entities[i];
+		struct media_entity *entity = &media->entities[i];
+		int interval_done = 0;
+
+		for (j = 0; j < entity->info.pads; ++j) {
+			struct v4l2_subdev_pad_state *pstate = &estate->pads[j];
+			const struct v4l2_mbus_framefmt *format = &pstate->format;
+			const struct v4l2_rect *rect = &pstate->crop;
+			const char *code;
+
+			if (!(pstate->valid & V4L2_SUBDEV_STATE_FORMAT) ||
+			    format->width == 0)
+				continue;
+
+			code = pixelcode_to_string(format->code);
+			if (string_to_pixelcode(code, strlen(code)) != format->code) {
+				fprintf(file, "# \"%s\":%u has unknown format 0x%04x\n",
+					entity->info.name, j, format->code);
+				continue;
+			}
+
+			fprintf(file, "\"%s\":%u [%s %ux%u", entity->info.name, j,
+				code, format->width, format->height);
+
+			if (pstate->valid & V4L2_SUBDEV_STATE_CROP)
+				fprintf(file, " (%d,%d)/%ux%u", rect->left, rect->top,
+					rect->width, rect->height);
+
+			/* The frame interval belongs to the entity, save it
+			 * once.
+			 */
+			if (!interval_done &&
+			    estate->valid & V4L2_SUBDEV_STATE_INTERVAL &&
+			    estate->interval.numerator != 0)
+				fprintf(file, " @%u/%u", estate->interval.numerator,
+					estate->interval.denominator);
+			interval_done = 1;
+
+			fprintf(file, "]\n");
+		}
+	}
+
+	v4l2_subdev_free_state(state);
+
+	ret = ferror(file) ? -EIO : 0;
+	if (fclose(file) != 0 && ret == 0)
+		ret = -errno;
+	if (ret < 0) {
+		printf("Unable to write %s: %s\n", filename, strerror(-ret));
+		return ret;
+	}
+
+	printf("Pipeline saved to %s\n", filename);
+	return 0;
+}
+
+static void *snapshot_grow(void *array, unsigned int count, unsigned int *max,
+			   size_t size)
+{
+	unsigned int grown = *max ? *max * 2 : 16;
+
+	if (count < *max)
+		return array;
+
+	array = realloc(array, grown * size);
+	if (array != NULL)
+		*max = grown;
+
+	return array;
+}
+
+static int load_snapshot(struct media_device *media, const char *filename,
+			 struct snapshot *snap)
+{
+	unsigned int line_number = 0;
+	size_t size = 0;
+	char *line = NULL;
+	FILE *file;
+	int ret = 0;
+
+	file = fopen(filename, "r");
+	if (file == NULL) {
+		ret = -errno;
+		printf("Unable to open %s: %s\n", filename, strerror(-ret));
+		return ret;
+	}
+
+	while (getline(&line, &size, file) >= 0) {
+		const char *p = line;
+		char *end;
+
+		line_number++;
+
+		for (; isspace(*p); ++p);
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		if (strstr(p, "->") != NULL) {
+			struct snapshot_link *link;
+
+			link = snapshot_grow(snap->links, snap->num_links,
+					     &snap->max_links, sizeof(*link));
+			if (link == NULL) {
+				ret = -ENOMEM;
+				break;
+			}
+			snap->links = link;
+			link = &snap->links[snap->num_links];
+
+			link->link = parse_link_flags(media, &link->flags, p, &end);
+			if (link->link == NULL || *end != '\0') {
+				ret = -EINVAL;
+				break;
+			}
+
+			snap->num_links++;
+		} else {
+			struct snapshot_pad *pad;
+
+			pad = snapshot_grow(snap->pads, snap->num_pads,
+					    &snap->max_pads, sizeof(*pad));
+			if (pad == NULL) {
+				ret = -ENOMEM;
+				break;
+			}
+			snap->pads = pad;
+			pad = &snap->pads[snap->num_pads];
+
+			memset(pad, 0, sizeof(*pad));
+			pad->crop.left = -1;
+			pad->crop.top = -1;
+
+			pad->pad = parse_pad_format(media, &pad->format, &pad->crop,
+						    &pad->interval, p, &end);
+			if (pad->pad == NULL) {
+				ret = -EINVAL;
+				break;
+			}
+
+			for (; isspace(*end); ++end);
+			if (*end != '\0') {
+				ret = -EINVAL;
+				break;
+			}
+
+			snap->num_pads++;
+		}
+	}
+
+	if (ret == -EINVAL)
+		printf("%s:%u: unable to parse line\n", filename, line_number);
+
+	free(line);
+	fclose(file);
+	return ret;
+}
+
+static int restore_links(struct media_device *media, struct snapshot *snap)
+{
+	unsigned int enable;
+	unsigned int i;
+	int ret;
+
+	snap->settings += snap->num_links;
+
+	/* Disable first, then enable. */
+	for (enable = 0; enable <= 1; ++enable) {
+		for (i = 0; i < snap->num_links; ++i) {
+			struct media_link *link = snap->links[i].link;
+			__u32 flags = snap->links[i].flags;
+
+			if (!!(flags & MEDIA_LNK_FL_ENABLED) != enable)
+				continue;
+			if (!((link->flags ^ flags) & MEDIA_LNK_FL_ENABLED))
+				continue;
+
+			printf("Setting up link %u:%u -> %u:%u [%u]\n",
+				link->source->entity->info.id, link->source->index,
+				link->sink->entity->info.id, link->sink->index,
+				flags);
+
+			ret = media_setup_link(media, link->source, link->sink, flags);
+			if (ret < 0)
+				return ret;
+
+			snap->changes++;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Distance of all entities from the start of the pipeline along active links.
+ * The graph is acyclic, every pass settles the depth of at least one more
+ * entity.
+ */
+static void snapshot_depths(struct media_device *media, unsigned int *depth)
+{
+	unsigned int pass, i, j;
+	int changed = 1;
+
+	memset(depth, 0, media->entities_count * sizeof(*depth));
+
+	for (pass = 0; pass < media->entities_count && changed; ++pass) {
+		changed = 0;
+
+		for (i = 0; i < media->entities_count; ++i) {
+			struct media_entity *entity = &media->entities[i];
+
+			for (j = 0; j < entity->num_links; ++j) {
+				struct media_link *link = &entity->links[j];
+				unsigned int sink;
+
+				if (link->source->entity != entity ||
+				    !(link->flags & MEDIA_LNK_FL_ENABLED))
+					continue;
+
+				sink = link->sink->entity - media->entities;
+				if (depth[sink] < depth[i] + 1) {
+					depth[sink] = depth[i] + 1;
+					changed = 1;
+				}
+			}
+		}
+	}
+}
+
+static int snapshot_pad_cmp(const void *a, const void *b)
+{
+	const struct snapshot_pad *pa = a;
+	const struct snapshot_pad *pb = b;
+	__u32 sink_a = pa->pad->flags & MEDIA_PAD_FL_SINK;
+	__u32 sink_b = pb->pad->flags & MEDIA_PAD_FL_SINK;
+
+	if (pa->depth != pb->depth)
+		return pa->depth < pb->depth ? -1 : 1;
+	if (pa->pad->entity != pb->pad->entity)
+		return pa->pad->entity->info.id < pb->pad->entity->info.id ? -1 : 1;
+	if (sink_a != sink_b)
+		return sink_a ? -1 : 1;
+	if (pa->pad->index != pb->pad->index)
+		return pa->pad->index < pb->pad->index ? -1 : 1;
+
+	/* Keep the file order for duplicates, the last one wins. */
+	return pa < pb ? -1 : 1;
+}
+
+/*
+ * The live state is captured once, the entity is queried again after every
+ * change as the driver may propagate it to other pads.
+ */
+static int restore_format(struct snapshot *snap, struct snapshot_pad *spad)
+{
+	struct v4l2_subdev_pad_state *live;
+	struct v4l2_mbus_framefmt format;
+	int ret;
+
+	if (spad->format.width == 0 || spad->format.height == 0)
+		return 0;
+
+	snap->settings++;
+	live = v4l2_subdev_state_pad(snap->state, spad->pad);
+	if (live->valid & V4L2_SUBDEV_STATE_FORMAT &&
+	    live->format.code == spad->format.code &&
+	    live->format.width == spad->format.width &&
+	    live->format.height == spad->format.height)
+		return 0;
+
+	format = spad->format;
+	snap->changes++;
+	ret = set_format(spad->pad, &format);
+	v4l2_subdev_update_state(snap->state, spad->pad->entity);
+	return ret;
+}
+
+static int restore_crop(struct snapshot *snap, struct snapshot_pad *spad)
+{
+	struct v4l2_subdev_pad_state *live;
+	struct v4l2_rect crop;
+	int ret;
+
+	if (spad->crop.left == -1 || spad->crop.top == -1)
+		return 0;
+
+	snap->settings++;
+	live = v4l2_subdev_state_pad(snap->state, spad->pad);
+	if (live->valid & V4L2_SUBDEV_STATE_CROP &&
+	    memcmp(&live->crop, &spad->crop, sizeof(crop)) == 0)
+		return 0;
+
+	crop = spad->crop;
+	snap->changes++;
+	ret = set_crop(spad->pad, &crop);
+	v4l2_subdev_update_state(snap->state, spad->pad->entity);
+	return ret;
+}
+
+static int restore_frame_interval(struct snapshot *snap,
+				  struct snapshot_pad *spad)
+{
+	struct v4l2_subdev_entity_state *live;
+	struct v4l2_fract interval;
+	int ret;
+
+	if (spad->interval.numerator == 0)
+		return 0;
+
+	snap->settings++;
+	live = v4l2_subdev_state_entity(snap->state, spad->pad->entity);
+	if (live->valid & V4L2_SUBDEV_STATE_INTERVAL &&
+	    live->interval.numerator == spad->interval.numerator &&
+	    live->interval.denominator == spad->interval.denominator)
+		return 0;
+
+	interval = spad->interval;
+	snap->changes++;
+	ret = set_frame_interval(spad->pad->entity, &interval);
+	if (ret == 0) {
+		live->interval = interval;
+		live->valid |= V4L2_SUBDEV_STATE_INTERVAL;
+	}
+
+	return ret;
+}
+
+static int restore_formats(struct media_device *media, struct snapshot *snap)
+{
+	unsigned int *depth;
+	unsigned int i, j, next;
+	int ret;
+
+	depth = malloc((media->entities_count + 1) * sizeof(*depth));
+	if (depth == NULL)
+		return -ENOMEM;
+
+	snapshot_depths(media, depth);
+	for (i = 0; i < snap->num_pads; ++i)
+		snap->pads[i].depth = depth[snap->pads[i].pad->entity - media->entities];
+	free(depth);
+
+	qsort(snap->pads, snap->num_pads, sizeof(*snap->pads), snapshot_pad_cmp);
+
+	snap->state = v4l2_subdev_get_state(media, V4L2_SUBDEV_FORMAT_ACTIVE);
+	if (snap->state == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < snap->num_pads; i = next) {
+		struct media_entity *entity = snap->pads[i].pad->entity;
+
+		for (next = i; next < snap->num_pads &&
+		     snap->pads[next].pad->entity == entity; ++next) {
+			struct snapshot_pad *spad = &snap->pads[next];
+
+			/* Same order as the -f option. */
+			if (spad->pad->flags & MEDIA_PAD_FL_SOURCE) {
+				ret = restore_crop(snap, spad);
+				if (ret == 0)
+					ret = restore_format(snap, spad);
+			} else {
+				ret = restore_format(snap, spad);
+				if (ret == 0)
+					ret = restore_crop(snap, spad);
+			}
+			if (ret < 0)
+				return ret;
+		}
+
+		/* Frame intervals last, a format change may reset them. */
+		for (j = i; j < next; ++j) {
+			ret = restore_frame_interval(snap, &snap->pads[j]);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int restore_snapshot(struct media_device *media, const char *filename)
+{
+	struct snapshot snap;
+	int ret;
+
+	memset(&snap, 0, sizeof(snap));
+
+	ret = load_snapshot(media, filename, &snap);
+	if (ret == 0)
+		ret = restore_links(media, &snap);
+	if (ret == 0)
+		ret = restore_formats(media, &snap);
+
+	free(snap.links);
+	free(snap.pads);
+	v4l2_subdev_free_state(snap.state);
+
+	if (ret < 0) {
+		printf("Unable to restore pipeline from %s (%s)\n", filename,
+			strerror(-ret));
+		return ret;
+	}
+
+	printf("Pipeline restored from %s: %u of %u settings changed\n",
+		filename, snap.changes, snap.settings);
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Bandwidth estimation
+ *
+ * Every path of active links from a source subdev (one without sink pads,
+ * usually a sensor) to a video node is reported pad by pad: active pixel
+ * rate, bus bandwidth and, at the video node, memory write bandwidth.
+ * Blanking isn't known here, so rates are for active pixels only. The frame
+ * rate comes from the frame interval of the source subdev unless given on
+ * the command line.
+ *
+ * An entity with a limit is checked against the highest pixel rate and width
+ * of its pads on the path. The default limits are nominal figures for the
+ * OMAP3 ISP on a 200 MHz L3 clock, where the processing blocks handle a pixel
+ * every two cycles, the CCDC with a 10% margin. Other clocks and ISPs need a
+ * limits file with lines of
+ *
+ *	"entity name" <Mpixel/s> [<max width>]
+ *	memory <MB/s>
+ */
+
+struct bandwidth_limit {
+	char name[32];
+	double rate;			/* pixel/s, 0 if unlimited */
+	unsigned int width;		/* pixels, 0 if unlimited */
+};
+
+static const struct bandwidth_limit omap3isp_limits[] = {
+	{ "OMAP3 ISP CCDC", 90e6, 0 },
+	{ "OMAP3 ISP preview", 100e6, 4096 },
+	{ "OMAP3 ISP resizer", 100e6, 4096 },
+};
+
+struct bandwidth {
+	struct bandwidth_limit *limits;
+	unsigned int num_limits;
+	double memory;			/* bytes/s, 0 if unlimited */
+	double fps;			/* 0 to read the source frame interval */
+	struct v4l2_subdev_state *state;
+
+	double memory_total;
+	unsigned int paths;
+	unsigned int exceeded;
+};
+
+static int load_bandwidth_limits(struct bandwidth *bw, const char *filename)
+{
+	unsigned int line_number = 0;
+	size_t size = 0;
+	char *line = NULL;
+	FILE *file;
+	int ret = 0;
+
+	file = fopen(filename, "r");
+	if (file == NULL) {
+		ret = -errno;
+		printf("Unable to open %s: %s\n", filename, strerror(-ret));
+		return ret;
+	}
+
+	while (getline(&line, &size, file) >= 0) {
+		struct bandwidth_limit *limit;
+		char *p = line;
+		char *end;
+
+		line_number++;
+
+		for (; isspace(*p); ++p);
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		if (strncmp(p, "memory", 6) == 0 && isspace(p[6])) {
+			bw->memory = strtod(p + 6, &end) * 1e6;
+			continue;
+		}
+
+		end = strchr(p + 1, '"');
+		if (*p != '"' || end == NULL || end - p - 1 >= (int)sizeof(limit->name)) {
+			ret = -EINVAL;
+			break;
+		}
+
+		limit = realloc(bw->limits, (bw->num_limits + 1) * sizeof(*limit));
+		if (limit == NULL) {
+			ret = -ENOMEM;
+			break;
+		}
+		bw->limits = limit;
+		limit = &bw->limits[bw->num_limits++];
+
+		memset(limit, 0, sizeof(*limit));
+		memcpy(limit->name, p + 1, end - p - 1);
+		limit->rate = strtod(end + 1, &end) * 1e6;
+		limit->width = strtoul(end, &end, 10);
+	}
+
+	if (ret == -EINVAL)
+		printf("%s:%u: unable to parse line\n", filename, line_number);
+
+	free(line);
+	fclose(file);
+	return ret;
+}
+
+static const struct bandwidth_limit *
+bandwidth_limit(struct bandwidth *bw, struct media_entity *entity)
+{
+	unsigned int i;
+
+	for (i = 0; i < bw->num_limits; ++i) {
+		if (strcmp(bw->limits[i].name, entity->info.name) == 0)
+			return &bw->limits[i];
+	}
+
+	return NULL;
+}
+
+static void bandwidth_check(struct bandwidth *bw, struct media_entity *entity,
+			    double rate, unsigned int width)
+{
+	const struct bandwidth_limit *limit = bandwidth_limit(bw, entity);
+
+	if (limit == NULL)
+		return;
+
+	if (limit->rate && rate > limit->rate) {
+		printf("\t!! %s: %.1f Mpixel/s exceeds the %.1f Mpixel/s limit\n",
+			entity->info.name, rate / 1e6, limit->rate / 1e6);
+		bw->exceeded++;
+	}
+
+	if (limit->width && width > limit->width) {
+		printf("\t!! %s: %u pixels wide exceeds the %u pixels limit\n",
+			entity->info.name, width, limit->width);
+		bw->exceeded++;
+	}
+}
+
+/*
+ * path alternates source and sink pads, from the source entity to the video
+ * node sink pad.
+ */
+static void bandwidth_report(struct bandwidth *bw, struct media_pad **path,
+			     unsigned int length)
+{
+	struct media_entity *source = path[0]->entity;
+	struct media_entity *node = path[length - 1]->entity;
+	struct v4l2_mbus_framefmt format = { 0, 0, 0 };
+	struct media_entity *stage = NULL;
+	unsigned int stage_width = 0;
+	double stage_rate = 0;
+	struct v4l2_subdev_entity_state *estate;
+	double fps = bw->fps;
+	unsigned int i;
+
+	estate = v4l2_subdev_state_entity(bw->state, source);
+	if (fps == 0 && estate->valid & V4L2_SUBDEV_STATE_INTERVAL &&
+	    estate->interval.numerator != 0)
+		fps = (double)estate->interval.denominator
+		    / estate->interval.numerator;
+
+	bw->paths++;
+	printf("- %s -> %s", source->info.name, node->info.name);
+	if (fps)
+		printf(", %.2f fps\n", fps);
+	else
+		printf(", unknown frame rate (use --estimate=fps)\n");
+
+	printf("\t%-28s %-22s %-22s %10s %10s\n", "pad", "format", "crop",
+		"Mpixel/s", "MB/s");
+
+	for (i = 0; i < length - 1; ++i) {
+		struct media_pad *pad = path[i];
+		struct media_entity *entity = pad->entity;
+		struct v4l2_subdev_pad_state *pstate;
+		char name[48], fmt[32], crop[32];
+		const struct v4l2_rect *rect;
+		double rate;
+
+		if (entity != stage) {
+			if (stage)
+				bandwidth_check(bw, stage, stage_rate, stage_width);
+			stage = entity;
+			stage_rate = 0;
+			stage_width = 0;
+		}
+
+		pstate = v4l2_subdev_state_pad(bw->state, pad);
+		if (!(pstate->valid & V4L2_SUBDEV_STATE_FORMAT)) {
+			printf("\t%s/%u: unable to get format\n",
+				entity->info.name, pad->index);
+			memset(&format, 0, sizeof(format));
+			continue;
+		}
+
+		format = pstate->format;
+		rect = &pstate->crop;
+
+		snprintf(name, sizeof(name), "%s/%u", entity->info.name, pad->index);
+		snprintf(fmt, sizeof(fmt), "%s %ux%u", pixelcode_to_string(format.code),
+			 format.width, format.height);
+		crop[0] = '\0';
+		if (pstate->valid & V4L2_SUBDEV_STATE_CROP)
+			snprintf(crop, sizeof(crop), "(%d,%d)/%ux%u", rect->left,
+				 rect->top, rect->width, rect->height);
+
+		rate = (double)format.width * format.height * fps;
+		if (rate > stage_rate)
+			stage_rate = rate;
+		if (format.width > stage_width)
+			stage_width = format.width;
+
+		if (fps)
+			printf("\t%-28s %-22s %-22s %10.1f %10.1f\n", name, fmt, crop,
+				rate / 1e6,
+				rate * pixelcode_to_bits(format.code) / 8 / 1e6);
+		else
+			printf("\t%-28s %-22s %-22s %10s %10s\n", name, fmt, crop,
+				"-", "-");
+	}
+
+	if (stage)
+		bandwidth_check(bw, stage, stage_rate, stage_width);
+
+	/* Samples wider than 8 bits are stored on 16 bits. */
+	if (fps && format.width) {
+		double bytes = (double)format.width * format.height * fps
+			     * ((pixelcode_to_bits(format.code) + 7) / 8);
+
+		printf("\tmemory write at %s: %.1f MB/s\n", node->info.name,
+			bytes / 1e6);
+		bw->memory_total += bytes;
+	}
+
+	printf("\n");
+}
+
+static void bandwidth_walk(struct bandwidth *bw, struct media_pad **path,
+			   unsigned int n, unsigned int max)
+{
+	struct media_entity *entity = path[n]->entity;
+	unsigned int i, j;
+
+	if (n + 2 >= max)
+		return;
+
+	for (i = 0; i < entity->num_links; ++i) {
+		struct media_link *link = &entity->links[i];
+		struct media_entity *sink = link->sink->entity;
+
+		if (link->source != path[n] ||
+		    !(link->flags & MEDIA_LNK_FL_ENABLED))
+			continue;
+
+		path[n + 1] = link->sink;
+
+		if (media_entity_type(sink) == MEDIA_ENT_T_DEVNODE) {
+			bandwidth_report(bw, path, n + 2);
+			continue;
+		}
+
+		if (media_entity_type(sink) != MEDIA_ENT_T_V4L2_SUBDEV)
+			continue;
+
+		for (j = 0; j < sink->info.pads; ++j) {
+			if (!(sink->pads[j].flags & MEDIA_PAD_FL_SOURCE))
+				continue;
+
+			path[n + 2] = &sink->pads[j];
+			bandwidth_walk(bw, path, n + 2, max);
+		}
+	}
+}
+
+static int media_has_sink_pads(struct media_entity *entity)
+{
+	unsigned int i;
+
+	for (i = 0; i < entity->info.pads; ++i) {
+		if (entity->pads[i].flags & MEDIA_PAD_FL_SINK)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int estimate_bandwidth(struct media_device *media, const char *fps,
+			      const char *limits)
+{
+	struct media_pad **path;
+	struct bandwidth bw;
+	unsigned int max = 2 * media->entities_count + 1;
+	unsigned int i, j;
+	int ret = 0;
+
+	memset(&bw, 0, sizeof(bw));
+	if (fps)
+		bw.fps = strtod(fps, NULL);
+
+	if (limits) {
+		ret = load_bandwidth_limits(&bw, limits);
+	} else {
+		bw.limits = malloc(sizeof(omap3isp_limits));
+		if (bw.limits != NULL) {
+			memcpy(bw.limits, omap3isp_limits, sizeof(omap3isp_limits));
+			bw.num_limits = ARRAY_SIZE(omap3isp_limits);
+		} else {
+			ret = -ENOMEM;
+		}
+	}
+
+	path = malloc(max * sizeof(*path));
+	bw.state = v4l2_subdev_get_state(media, V4L2_SUBDEV_FORMAT_ACTIVE);
+	if (ret == 0 && (path == NULL || bw.state == NULL))
+		ret = -ENOMEM;
+	if (ret < 0)
+		goto done;
+
+	printf("Bandwidth estimate\n");
+
+	for (i = 0; i < media->entities_count; ++i) {
+		struct media_entity *entity = &media->entities[i];
+
+		if (media_entity_type(entity) != MEDIA_ENT_T_V4L2_SUBDEV ||
+		    media_has_sink_pads(entity))
+			continue;
+
+		for (j = 0; j < entity->info.pads; ++j) {
+			if (!(entity->pads[j].flags & MEDIA_PAD_FL_SOURCE))
+				continue;
+
+			path[0] = &entity->pads[j];
+			bandwidth_walk(&bw, path, 0, max);
+		}
+	}
+
+	if (bw.paths == 0)
+		printf("No active path to a video node\n");
+	else
+		printf("Total memory write: %.1f MB/s\n", bw.memory_total / 1e6);
+
+	if (bw.memory && bw.memory_total > bw.memory) {
+		printf("!! memory write exceeds the %.1f MB/s limit\n", bw.memory / 1e6);
+		bw.exceeded++;
+	}
+
+	if (bw.exceeded) {
+		printf("%u limit%s exceeded\n", bw.exceeded, bw.exceeded > 1 ? "s" : "");
+		ret = -ERANGE;
+	}
+
+done:
+	v4l2_subdev_free_state(bw.state);
+	free(path);
+	free(bw.limits);
+	return ret;
+}
+
+/* -----------------------------------------------------------------------------
+ * Daemon
+ *
+ * In daemon mode the media device stays open: the topology is enumerated
+ * once, subdev nodes stay open after their first use and entity, pad and
+ * topology queries are answered from the enumerated graph without a single
+ * ioctl. Commands are named after the long options and take the same
+ * argument, see daemon.h for the protocol.
+ */
+
+static int print_entity_devname(struct media_device *media, const char *name)
+{
+	struct media_entity *entity;
+
+	entity = media_get_entity_by_name(media, name, strlen(name));
+	if (entity == NULL) {
+		printf("Entity '%s' not found\n", name);
+		return -ENOENT;
+	}
+
+	printf("%s\n", entity->devname);
+	return 0;
+}
+
+static int print_pad_format(struct media_device *media, const char *name)
+{
+	struct v4l2_subdev_pad_state state;
+	struct media_pad *pad;
+
+	pad = parse_pad(media, name, NULL);
+	if (pad == NULL) {
+		printf("Pad '%s' not found\n", name);
+		return -ENOENT;
+	}
+
+	v4l2_subdev_get_pad_state(pad, V4L2_SUBDEV_FORMAT_ACTIVE, &state);
+	v4l2_subdev_print_format(&state);
+	printf("\n");
+	return 0;
+}
+
+static int run_command(struct media_device *media, const char *command,
+		       const char *arg)
+{
+	static const char * const with_arg[] = {
+		"entity", "get-format", "links", "set-format", "solve",
+		"save-pipeline", "restore-pipeline",
+	};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(with_arg); ++i) {
+		if (strcmp(command, with_arg[i]) == 0 && arg == NULL) {
+			printf("%s: missing argument\n", command);
+			return -EINVAL;
+		}
+	}
+
+	if (strcmp(command, "entity") == 0)
+		return print_entity_devname(media, arg);
+	if (strcmp(command, "get-format") == 0)
+		return print_pad_format(media, arg);
+	if (strcmp(command, "print-topology") == 0 ||
+	    strcmp(command, "print-dot") == 0) {
+		media_print_topology(media, command[6] == 'd');
+		return 0;
+	}
+	if (strcmp(command, "reset") == 0) {
+		printf("Resetting all links to inactive\n");
+		return media_reset_links(media);
+	}
+	if (strcmp(command, "links") == 0)
+		return setup_links(media, arg);
+	if (strcmp(command, "set-format") == 0)
+		return setup_formats(media, arg);
+	if (strcmp(command, "solve") == 0)
+		return setup_pipeline(media, arg);
+	if (strcmp(command, "save-pipeline") == 0)
+		return save_snapshot(media, arg);
+	if (strcmp(command, "restore-pipeline") == 0)
+		return restore_snapshot(media, arg);
+	if (strcmp(command, "estimate") == 0)
+		return estimate_bandwidth(media, arg, media_opts.limits);
+
+	printf("Unknown command '%s'\n", command);
+	return -EINVAL;
+}
+
+static void client_command(char **commands, unsigned int *count,
+			   const char *name, const char *arg)
+{
+	size_t size = strlen(name) + (arg ? strlen(arg) + 1 : 0) + 1;
+	char *command;
+
+	command = malloc(size);
+	if (command == NULL)
+		return;
+
+	snprintf(command, size, "%s%s%s", name, arg ? " " : "", arg ? arg : "");
+	commands[(*count)++] = command;
+}
+
+/*
+ * Turn the command line options into daemon commands, in the order main()
+ * runs them, and send them as a single batch.
+ */
+static int run_client(const char *path)
+{
+	char *commands[10];
+	unsigned int count = 0;
+	unsigned int i;
+	int ret;
+
+	if (media_opts.entity)
+		client_command(commands, &count, "entity", media_opts.entity);
+	if (media_opts.pad)
+		client_command(commands, &count, "get-format", media_opts.pad);
+	if (media_opts.print || media_opts.print_dot)
+		client_command(commands, &count, media_opts.print_dot ?
+			       "print-dot" : "print-topology", NULL);
+	if (media_opts.reset)
+		client_command(commands, &count, "reset", NULL);
+	if (media_opts.restore)
+		client_command(commands, &count, "restore-pipeline",
+			       media_opts.restore);
+	if (media_opts.links)
+		client_command(commands, &count, "links", media_opts.links);
+	if (media_opts.solve)
+		client_command(commands, &count, "solve", media_opts.solve);
+	if (media_opts.formats)
+		client_command(commands, &count, "set-format", media_opts.formats);
+	if (media_opts.save)
+		client_command(commands, &count, "save-pipeline", media_opts.save);
+	if (media_opts.estimate)
+		client_command(commands, &count, "estimate", media_opts.fps);
+
+	ret = media_daemon_send(path, commands, count);
+
+	for (i = 0; i < count; ++i)
+		free(commands[i]);
+
+	return ret;
+}
+
 int main(int argc, char **argv)
 {
 	struct media_device *media;
@@ -754,37 +1829,25 @@ int main(int argc, char **argv)
 	if (parse_cmdline(argc, argv))
 		return EXIT_FAILURE;
 
+	if (media_opts.connect)
+		return run_client(media_opts.connect) ? EXIT_FAILURE : EXIT_SUCCESS;
+
 	/* Open the media device and enumerate entities, pads and links. */
 	media = media_open(media_opts.devname, media_opts.verbose);
 	if (media == NULL)
 		goto out;
 
-	if (media_opts.entity) {
-		struct media_entity *entity;
-
-		entity = media_get_entity_by_name(media, media_opts.entity,
-						  strlen(media_opts.entity));
-		if (entity == NULL) {
-			printf("Entity '%s' not found\n", media_opts.entity);
-			goto out;
-		}
-
-		printf("%s\n", entity->devname);
+	if (media_opts.daemon) {
+		ret = media_daemon_run(media, media_opts.daemon, run_command);
+		goto out;
 	}
 
-	if (media_opts.pad) {
-		struct media_pad *pad;
-
-		pad = parse_pad(media, media_opts.pad, NULL);
-		if (pad == NULL) {
-			printf("Pad '%s' not found\n", media_opts.pad);
-			goto out;
-		}
+	if (media_opts.entity &&
+	    print_entity_devname(media, media_opts.entity) < 0)
+		goto out;
 
-		v4l2_subdev_print_format(pad->entity, pad->index,
-					 V4L2_SUBDEV_FORMAT_ACTIVE);
-		printf("\n");
-	}
+	if (media_opts.pad && print_pad_format(media, media_opts.pad) < 0)
+		goto out;
 
 	if (media_opts.print || media_opts.print_dot) {
 		media_print_topology(media, media_opts.print_dot);
@@ -796,12 +1859,25 @@ int main(int argc, char **argv)
 		media_reset_links(media);
 	}
 
+	if (media_opts.restore && restore_snapshot(media, media_opts.restore) < 0)
+		goto out;
+
 	if (media_opts.links)
 		setup_links(media, media_opts.links);
 
+	if (media_opts.solve && setup_pipeline(media, media_opts.solve) < 0)
+		goto out;
+
 	if (media_opts.formats)
 		setup_formats(media, media_opts.formats);
 
+	if (media_opts.save && save_snapshot(media, media_opts.save) < 0)
+		goto out;
+
+	if (media_opts.estimate &&
+	    estimate_bandwidth(media, media_opts.fps, media_opts.limits) < 0)
+		goto out;
+
 	if (media_opts.interactive) {
 		while (1) {
 			char buffer[32];
@@ -22,6 +22,9 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifdef MAJOR_IN_SYSMACROS
+#include <sys/sysmacros.h>
+#endif
 
 #include <unistd.h>
 #include <stdio.h>
@@ -56,11 +59,215 @@ struct media_pad *media_entity_remote_source(struct media_pad *pad)
 	return NULL;
 }
 
+/* -----------------------------------------------------------------------------
+ * Lookup tables
+ *
+ * Entities are indexed by ID in a direct array (kernel IDs are small and
+ * dense, the array is only used when there are no more than 4 slots per
+ * entity) and by name in an open addressing hash table. Links are indexed by
+ * their source and sink pads, each link once through its copy in the source
+ * entity; entities with few links are still scanned. Tables are sized to a
+ * power of two at least twice the number of keys, so probe sequences stay
+ * short. Without tables (allocation failure) the lookups fall back to linear
+ * scans.
+ *
+ * The tables live in a private wrapper around the media_device allocated by
+ * media_open(), the public structure keeps its size and layout.
+ */
+
+/* Below about 16 links (forward and back) hashing doesn't beat the scan. */
+#define MEDIA_LINK_SCAN_MAX	16
+
+struct media_index {
+	struct media_entity **by_id;
+	unsigned int max_id;
+	struct media_entity **by_name;
+	unsigned int name_mask;
+	struct media_link **links;
+	unsigned int link_mask;
+};
+
+struct media_device_private {
+	struct media_device media;	/* must be first */
+	struct media_index *index;
+};
+
+static inline struct media_index *media_index(struct media_device *media)
+{
+	return ((struct media_device_private *)media)->index;
+}
+
+static unsigned int media_hash_name(const char *name, size_t length)
+{
+	unsigned int hash = 2166136261U;
+
+	/* FNV-1a */
+	while (length--)
+		hash = (hash ^ (unsigned char)*name++) * 16777619U;
+	return hash;
+}
+
+/* Pads are never reallocated once enumerated, their addresses are the key. */
+static unsigned int media_hash_link(const struct media_pad *source,
+				    const struct media_pad *sink)
+{
+	unsigned long key = (unsigned long)source ^ ((unsigned long)sink << 7);
+
+	return (unsigned int)((key >> 4) * 2654435761U) ^ (unsigned int)(key >> 20);
+}
+
+static unsigned int media_table_size(unsigned int keys)
+{
+	unsigned int size = 16;
+
+	while (size < 2 * keys)
+		size *= 2;
+	return size;
+}
+
+static size_t media_name_length(const struct media_entity *entity)
+{
+	const char *end = memchr(entity->info.name, '\0', sizeof entity->info.name);
+
+	return end ? (size_t)(end - entity->info.name) : sizeof entity->info.name;
+}
+
+static int media_index_entities(struct media_device *media)
+{
+	struct media_index *index;
+	unsigned int size;
+	unsigned int i;
+
+	index = calloc(1, sizeof(*index));
+	if (index == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < media->entities_count; ++i) {
+		if (media->entities[i].info.id > index->max_id)
+			index->max_id = media->entities[i].info.id;
+	}
+
+	if (index->max_id <= 4 * media->entities_count + 16) {
+		index->by_id = calloc(index->max_id + 1, sizeof(*index->by_id));
+		if (index->by_id == NULL)
+			goto error;
+
+		for (i = 0; i < media->entities_count; ++i)
+			index->by_id[media->entities[i].info.id] = &media->entities[i];
+	}
+
+	size = media_table_size(media->entities_count);
+	index->by_name = calloc(size, sizeof(*index->by_name));
+	if (index->by_name == NULL)
+		goto error;
+	index->name_mask = size - 1;
+
+	for (i = 0; i < media->entities_count; ++i) {
+		struct media_entity *entity = &media->entities[i];
+		unsigned int h = media_hash_name(entity->info.name,
+						 media_name_length(entity));
+
+		/* Duplicate names keep the first entity, as the scan did. */
+		for (h &= index->name_mask; index->by_name[h] != NULL;
+		     h = (h + 1) & index->name_mask) {
+			if (strncmp(index->by_name[h]->info.name, entity->info.name,
+				    sizeof entity->info.name) == 0)
+				break;
+		}
+		if (index->by_name[h] == NULL)
+			index->by_name[h] = entity;
+	}
+
+	((struct media_device_private *)media)->index = index;
+	return 0;
+
+error:
+	free(index->by_id);
+	free(index);
+	return -ENOMEM;
+}
+
+static int media_index_links(struct media_device *media)
+{
+	struct media_index *index = media_index(media);
+	unsigned int count = 0;
+	unsigned int size;
+	unsigned int i, j;
+
+	if (index == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < media->entities_count; ++i) {
+		struct media_entity *entity = &media->entities[i];
+
+		for (j = 0; j < entity->num_links; ++j)
+			count += entity->links[j].source->entity == entity;
+	}
+
+	size = media_table_size(count);
+	index->links = calloc(size, sizeof(*index->links));
+	if (index->links == NULL)
+		return -ENOMEM;
+	index->link_mask = size - 1;
+
+	for (i = 0; i < media->entities_count; ++i) {
+		struct media_entity *entity = &media->entities[i];
+
+		for (j = 0; j < entity->num_links; ++j) {
+			struct media_link *link = &entity->links[j];
+			unsigned int h;
+
+			if (link->source->entity != entity)
+				continue;
+
+			h = media_hash_link(link->source, link->sink);
+			for (h &= index->link_mask; index->links[h] != NULL;
+			     h = (h + 1) & index->link_mask)
+				;
+			index->links[h] = link;
+		}
+	}
+
+	return 0;
+}
+
+static void media_free_index(struct media_device *media)
+{
+	struct media_index *index = media_index(media);
+
+	if (index == NULL)
+		return;
+
+	free(index->by_id);
+	free(index->by_name);
+	free(index->links);
+	free(index);
+	((struct media_device_private *)media)->index = NULL;
+}
+
 struct media_entity *media_get_entity_by_name(struct media_device *media,
 					      const char *name, size_t length)
 {
+	struct media_index *index = media_index(media);
+	const char *end;
 	unsigned int i;
 
+	if (index != NULL) {
+		end = memchr(name, '\0', length);
+		if (end != NULL)
+			length = end - name;
+
+		for (i = media_hash_name(name, length) & index->name_mask;
+		     index->by_name[i] != NULL; i = (i + 1) & index->name_mask) {
+			struct media_entity *entity = index->by_name[i];
+
+			if (media_name_length(entity) == length &&
+			    memcmp(entity->info.name, name, length) == 0)
+				return entity;
+		}
+	}
+
+	/* Prefix match */
 	for (i = 0; i < media->entities_count; ++i) {
 		struct media_entity *entity = &media->entities[i];
 
@@ -74,8 +281,12 @@ struct media_entity *media_get_entity_by_name(struct media_device *media,
 struct media_entity *media_get_entity_by_id(struct media_device *media,
 					    __u32 id)
 {
+	struct media_index *index = media_index(media);
 	unsigned int i;
 
+	if (index != NULL && index->by_id != NULL)
+		return id <= index->max_id ? index->by_id[id] : NULL;
+
 	for (i = 0; i < media->entities_count; ++i) {
 		struct media_entity *entity = &media->entities[i];
 
@@ -86,27 +297,49 @@ struct media_entity *media_get_entity_by_id(struct media_device *media,
 	return NULL;
 }
 
-int media_setup_link(struct media_device *media,
-		     struct media_pad *source,
-		     struct media_pad *sink,
-		     __u32 flags)
+struct media_link *media_find_link(struct media_device *media,
+				   struct media_pad *source,
+				   struct media_pad *sink)
 {
+	struct media_index *index = media_index(media);
 	struct media_link *link;
-	struct media_link_desc ulink;
 	unsigned int i;
-	int ret;
+
+	/* A handful of links is faster to scan than to hash. */
+	if (source->entity->num_links > MEDIA_LINK_SCAN_MAX &&
+	    index != NULL && index->links != NULL) {
+		for (i = media_hash_link(source, sink) & index->link_mask;
+		     index->links[i] != NULL; i = (i + 1) & index->link_mask) {
+			link = index->links[i];
+
+			if (link->source == source && link->sink == sink)
+				return link;
+		}
+
+		return NULL;
+	}
 
 	for (i = 0; i < source->entity->num_links; i++) {
 		link = &source->entity->links[i];
 
-		if (link->source->entity == source->entity &&
-		    link->source->index == source->index &&
-		    link->sink->entity == sink->entity &&
-		    link->sink->index == sink->index)
-			break;
+		if (link->source == source && link->sink == sink)
+			return link;
 	}
 
-	if (i == source->entity->num_links) {
+	return NULL;
+}
+
+int media_setup_link(struct media_device *media,
+		     struct media_pad *source,
+		     struct media_pad *sink,
+		     __u32 flags)
+{
+	struct media_link *link;
+	struct media_link_desc ulink;
+	int ret;
+
+	link = media_find_link(media, source, sink);
+	if (link == NULL) {
 		printf("%s: Link not found\n", __func__);
 		return -EINVAL;
 	}
@@ -350,7 +583,7 @@ static int media_enum_entities(struct media_device *media, int verbose)
 {
 	struct media_entity *entity;
 	struct udev *udev;
-	unsigned int size;
+	unsigned int max_entities = 0;
 	__u32 id;
 	int ret;
 
@@ -359,8 +592,21 @@ static int media_enum_entities(struct media_device *media, int verbose)
 		printf("%s: Can't get udev context\n", __func__);
 
 	for (id = 0, ret = 0; ; id = entity->info.id) {
-		size = (media->entities_count + 1) * sizeof(*media->entities);
-		media->entities = realloc(media->entities, size);
+		/* Grow geometrically, the entities array is reallocated
+		 * O(log n) times.
+		 */
+		if (media->entities_count == max_entities) {
+			struct media_entity *entities;
+
+			max_entities = max_entities ? max_entities * 2 : 16;
+			entities = realloc(media->entities,
+					   max_entities * sizeof(*entities));
+			if (entities == NULL) {
+				ret = -ENOMEM;
+				break;
+			}
+			media->entities = entities;
+		}
 
 		entity = &media->entities[media->entities_count];
 		memset(entity, 0, sizeof(*entity));
@@ -382,6 +628,8 @@ static int media_enum_entities(struct media_device *media, int verbose)
 		entity->pads = malloc(entity->info.pads * sizeof(*entity->pads));
 		entity->links = malloc(entity->max_links * sizeof(*entity->links));
 		if (entity->pads == NULL || entity->links == NULL) {
+			free(entity->pads);
+			free(entity->links);
 			ret = -ENOMEM;
 			break;
 		}
@@ -407,15 +655,18 @@ static int media_enum_entities(struct media_device *media, int verbose)
 
 struct media_device *media_open(const char *name, int verbose)
 {
+	struct media_device_private *priv;
 	struct media_device *media;
 	int ret;
 
-	media = calloc(1, sizeof(*media));
-	if (media == NULL) {
+	priv = calloc(1, sizeof(*priv));
+	if (priv == NULL) {
 		printf("%s: unable to allocate memory\n", __func__);
 		return NULL;
 	}
 
+	media = &priv->media;
+
 	if (verbose)
 		printf("Opening media device %s\n", name);
 	media->fd = open(name, O_RDWR);
@@ -442,6 +693,10 @@ struct media_device *media_open(const char *name, int verbose)
 		printf("Enumerating pads and links\n");
 	}
 
+	/* The lookups work without the tables, only slower. */
+	if (media_index_entities(media) < 0)
+		printf("%s: Unable to allocate lookup tables\n", __func__);
+
 	ret = media_enum_links(media);
 	if (ret < 0) {
 		printf("%s: Unable to enumerate pads and linksfor device %s\n",
@@ -450,6 +705,9 @@ struct media_device *media_open(const char *name, int verbose)
 		return NULL;
 	}
 
+	if (media_index(media) != NULL && media_index_links(media) < 0)
+		printf("%s: Unable to allocate link lookup table\n", __func__);
+
 	return media;
 }
 
@@ -469,6 +727,7 @@ void media_close(struct media_device *media)
 			close(entity->fd);
 	}
 
+	media_free_index(media);
 	free(media->entities);
 	free(media);
 }
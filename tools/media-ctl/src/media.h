@@ -109,7 +109,9 @@ static inline unsigned int media_entity_type(struct media_entity *entity)
  * @param name - entity name.
  * @param length - size of @a name.
  *
- * Search for an entity with a name equal to @a name.
+ * Search for an entity with a name equal to @a name. The lookup goes through
+ * a hash table. When no name matches exactly, the first entity whose name
+ * starts with the @a length characters of @a name is returned.
  *
  * @return A pointer to the entity if found, or NULL otherwise.
  */
@@ -121,13 +123,30 @@ struct media_entity *media_get_entity_by_name(struct media_device *media,
  * @param media - media device.
  * @param id - entity ID.
  *
- * Search for an entity with an ID equal to @a id.
+ * Search for an entity with an ID equal to @a id. The lookup is a direct
+ * array access unless entity IDs are sparse.
  *
  * @return A pointer to the entity if found, or NULL otherwise.
  */
 struct media_entity *media_get_entity_by_id(struct media_device *media,
 	__u32 id);
 
+/**
+ * @brief Find the link between two pads.
+ * @param media - media device.
+ * @param source - source pad at the link origin.
+ * @param sink - sink pad at the link target.
+ *
+ * Links of entities with many links are looked up in a hash table keyed by
+ * both pads, the others are scanned. The pads must be those of @a media, they
+ * are compared by address.
+ *
+ * @return A pointer to the link, as stored in the source entity's links
+ * array, or NULL if the pads are not linked.
+ */
+struct media_link *media_find_link(struct media_device *media,
+	struct media_pad *source, struct media_pad *sink);
+
 /**
  * @brief Configure a link.
  * @param media - media device.
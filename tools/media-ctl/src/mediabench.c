@@ -0,0 +1,290 @@
+/*
+ * Media controller lookup benchmark
+ *
+ * Copyright (C) 2010 Ideas on board SPRL <laurent.pinchart@ideasonboard.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ */
+
+/*
+ * Opens a synthetic media graph served by mediamock through libmediactl and
+ * times the entity and link lookups against plain linear scans, which is what
+ * the library did before it had lookup tables, as well as link setup and
+ * format propagation along the longest path of enabled links. Exits non-zero
+ * when a lookup returns a different object than the scan or when the format
+ * doesn't reach the end of the path.
+ *
+ * The reference scans are inlined here, on sparse graphs (chain, tree, mesh
+ * below a fanout of about 8) the links are scanned by the library too and
+ * "find link" only measures the cost of the function call.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/types.h>
+#include <linux/media.h>
+#include <linux/v4l2-subdev.h>
+
+#include "media.h"
+#include "mediamock.h"
+#include "subdev.h"
+
+/* -----------------------------------------------------------------------------
+ * Reference scans
+ */
+
+static struct media_entity *scan_by_name(struct media_device *media,
+					 const char *name, size_t length)
+{
+	unsigned int i;
+
+	for (i = 0; i < media->entities_count; ++i) {
+		if (strncmp(media->entities[i].info.name, name, length) == 0)
+			return &media->entities[i];
+	}
+
+	return NULL;
+}
+
+static struct media_entity *scan_by_id(struct media_device *media, __u32 id)
+{
+	unsigned int i;
+
+	for (i = 0; i < media->entities_count; ++i) {
+		if (media->entities[i].info.id == id)
+			return &media->entities[i];
+	}
+
+	return NULL;
+}
+
+static struct media_link *scan_link(struct media_pad *source,
+				    struct media_pad *sink)
+{
+	unsigned int i;
+
+	for (i = 0; i < source->entity->num_links; ++i) {
+		struct media_link *link = &source->entity->links[i];
+
+		if (link->source == source && link->sink == sink)
+			return link;
+	}
+
+	return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ * Benchmark
+ */
+
+static unsigned long long mono_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void report(const char *what, unsigned long long indexed,
+		   unsigned long long scan, unsigned int count)
+{
+	if (count == 0)
+		return;
+
+	printf("%-16s %10.1f %10.1f %8.1fx\n", what, (double)indexed / count,
+	       (double)scan / count, indexed ? (double)scan / indexed : 0.0);
+}
+
+/* Source pad of the last subdev, the end of the longest path from entity 1. */
+static struct media_pad *last_source_pad(struct media_device *media)
+{
+	unsigned int i;
+
+	for (i = media->entities_count; i > 1; --i) {
+		struct media_entity *entity = &media->entities[i - 1];
+
+		if (media_entity_type(entity) == MEDIA_ENT_T_V4L2_SUBDEV &&
+		    entity->info.pads == 2)
+			return &entity->pads[1];
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct v4l2_mbus_framefmt input, output, format;
+	struct mediamock_graph graph;
+	struct mediamock_stats stats;
+	struct media_device *media;
+	struct media_link **links;
+	struct media_pad *end;
+	unsigned long long t, indexed, scan;
+	unsigned int rounds = 20;
+	unsigned int count = 0;
+	unsigned int i, j, r;
+	char (*names)[32];
+	int errors = 0;
+	int ret;
+
+	if (mediamock_parse(&graph, argc > 1 ? argv[1] : "mesh:500:3") < 0 ||
+	    mediamock_setup(&graph) < 0) {
+		printf("Usage: %s [shape:entities[:fanout]]\n", argv[0]);
+		printf("shape is chain, mesh or tree (default: mesh:500:3)\n");
+		return EXIT_FAILURE;
+	}
+
+	t = mono_ns();
+	media = media_open("/dev/null", 0);
+	t = mono_ns() - t;
+	if (media == NULL)
+		return EXIT_FAILURE;
+
+	mediamock_stats(&stats);
+
+	/* Names and forward links to look up, in graph order. */
+	names = malloc(media->entities_count * sizeof(*names));
+	links = malloc((graph.entities * graph.fanout + 1) * sizeof(*links));
+	if (names == NULL || links == NULL) {
+		printf("Unable to allocate memory\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < media->entities_count; ++i) {
+		struct media_entity *entity = &media->entities[i];
+
+		snprintf(names[i], sizeof(names[i]), "entity %u", i + 1);
+		for (j = 0; j < entity->num_links; ++j) {
+			if (entity->links[j].source->entity == entity)
+				links[count++] = &entity->links[j];
+		}
+	}
+
+	printf("%u entities, %u links, media_open %.1f ms, %u ioctls\n\n",
+	       media->entities_count, count, t / 1000000.0,
+	       stats.enum_entities + stats.enum_links);
+	printf("%-16s %10s %10s %9s\n", "ns/lookup", "indexed", "scan", "speedup");
+	/* By ID */
+	t = mono_ns();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 1; i <= media->entities_count; ++i)
+			errors += media_get_entity_by_id(media, i)->info.id != i;
+	}
+	indexed = mono_ns() - t;
+
+	t = mono_ns();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 1; i <= media->entities_count; ++i)
+			errors += scan_by_id(media, i)->info.id != i;
+	}
+	scan = mono_ns() - t;
+	report("by id", indexed, scan, rounds * media->entities_count);
+
+	/* By name, the scan compares the terminating NUL too to find exact
+	 * matches.
+	 */
+	t = mono_ns();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < media->entities_count; ++i)
+			errors += media_get_entity_by_name(media, names[i], strlen(names[i]))
+				!= &media->entities[i];
+	}
+	indexed = mono_ns() - t;
+
+	t = mono_ns();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < media->entities_count; ++i)
+			errors += scan_by_name(media, names[i], strlen(names[i]) + 1)
+				!= &media->entities[i];
+	}
+	scan = mono_ns() - t;
+	report("by name", indexed, scan, rounds * media->entities_count);
+
+	/* Links */
+	t = mono_ns();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < count; ++i)
+			errors += media_find_link(media, links[i]->source,
+						  links[i]->sink) != links[i];
+	}
+	indexed = mono_ns() - t;
+
+	t = mono_ns();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < count; ++i)
+			errors += scan_link(links[i]->source, links[i]->sink)
+				!= links[i];
+	}
+	scan = mono_ns() - t;
+	report("find link", indexed, scan, rounds * count);
+
+	/* Setup link, the ioctl is a no-op. */
+	t = mono_ns();
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < count; ++i)
+			errors += media_setup_link(media, links[i]->source,
+						   links[i]->sink,
+						   links[i]->flags) < 0;
+	}
+	indexed = mono_ns() - t;
+	if (count)
+		printf("%-16s %10.1f\n", "setup link",
+		       (double)indexed / (rounds * count));
+
+	/* Format propagation, TRY negotiation and ACTIVE replay over the
+	 * whole path.
+	 */
+	end = last_source_pad(media);
+	if (end) {
+		memset(&input, 0, sizeof(input));
+		input.code = V4L2_MBUS_FMT_SGRBG10_1X10;
+		input.width = 2592;
+		input.height = 1944;
+		output = input;
+
+		mediamock_stats(&stats);
+		t = mono_ns();
+		ret = v4l2_subdev_setup_pipeline(media, &media->entities[0].pads[0],
+						 &input, end, &output, 0);
+		t = mono_ns() - t;
+		mediamock_stats(&stats);
+
+		ret = ret ? ret : v4l2_subdev_get_format(end->entity, &format,
+					end->index, V4L2_SUBDEV_FORMAT_ACTIVE);
+		if (ret < 0 || format.width != input.width ||
+		    format.height != input.height) {
+			printf("Format didn't reach %s (%d)\n", end->entity->info.name,
+			       ret);
+			errors++;
+		}
+
+		printf("%-16s %10.1f us, %u get, %u set format\n", "setup pipeline",
+		       t / 1000.0, stats.get_format, stats.set_format);
+	}
+
+	free(names);
+	free(links);
+	media_close(media);
+
+	if (errors) {
+		printf("\n%d lookups differ from the scan\n", errors);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,551 @@
+/*
+ * Synthetic media device
+ *
+ * Copyright (C) 2010 Ideas on board SPRL <laurent.pinchart@ideasonboard.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/types.h>
+#include <linux/media.h>
+#include <linux/v4l2-subdev.h>
+
+#include "mediamock.h"
+
+/* Device numbers are V4L2 ones, the minor is the entity ID. */
+#define MOCK_MAJOR		81
+
+/* Power-on format and frame interval, those of an MT9M034 at full size. */
+#define MOCK_DEFAULT_CODE	V4L2_MBUS_FMT_SGRBG10_1X10
+#define MOCK_DEFAULT_WIDTH	1280
+#define MOCK_DEFAULT_HEIGHT	960
+#define MOCK_DEFAULT_FPS	30
+
+static struct mediamock_graph mock_graph;
+static struct mediamock_stats mock_stats;
+
+/* Source entity of the enabled link to each entity sink pad, 0 if none. */
+static __u32 *mock_active;
+/* Formats, indexed by mock_format(). */
+static struct v4l2_mbus_framefmt *mock_formats;
+static struct v4l2_fract mock_interval;
+
+/* Entity ID of the subdev opened on each file descriptor, 0 if none. */
+static __u32 *mock_fds;
+static unsigned int mock_num_fds;
+
+/* -----------------------------------------------------------------------------
+ * Graph
+ */
+
+static __u32 mock_first_child(__u32 id)
+{
+	if (mock_graph.shape == MEDIAMOCK_TREE)
+		return mock_graph.fanout * (id - 1) + 2;
+	return id + 1;
+}
+
+static unsigned int mock_num_links(__u32 id)
+{
+	__u32 first = mock_first_child(id);
+	__u32 last = first + mock_graph.fanout - 1;
+
+	if (first > mock_graph.entities)
+		return 0;
+	if (last > mock_graph.entities)
+		last = mock_graph.entities;
+	return last - first + 1;
+}
+
+/* Source entity of the default link to an entity. */
+static __u32 mock_parent(__u32 id)
+{
+	if (mock_graph.shape == MEDIAMOCK_TREE)
+		return (id - 2) / mock_graph.fanout + 1;
+	return id - 1;
+}
+
+static int mock_has_link(__u32 source, __u32 sink)
+{
+	if (source == 0 || sink <= source || sink > mock_graph.entities)
+		return 0;
+	if (mock_graph.shape == MEDIAMOCK_TREE)
+		return mock_parent(sink) == source;
+	return sink - source <= mock_graph.fanout;
+}
+
+static int mock_is_video(__u32 id)
+{
+	return id > 1 && mock_num_links(id) == 0;
+}
+
+static unsigned int mock_num_pads(__u32 id)
+{
+	return id == 1 || mock_is_video(id) ? 1 : 2;
+}
+
+static unsigned int mock_source_pad(__u32 id)
+{
+	return id == 1 ? 0 : 1;
+}
+
+static struct v4l2_mbus_framefmt *mock_format(__u32 id, unsigned int pad,
+					      enum v4l2_subdev_format_whence which)
+{
+	return &mock_formats[(id * 2 + pad) * 2 + which];
+}
+
+int mediamock_parse(struct mediamock_graph *graph, const char *spec)
+{
+	const char *p = strchr(spec, ':');
+	char *end;
+
+	if (p == NULL)
+		return -EINVAL;
+
+	memset(graph, 0, sizeof(*graph));
+	graph->fanout = 3;
+
+	if (strncmp(spec, "chain", p - spec) == 0)
+		graph->fanout = 1;
+	else if (strncmp(spec, "tree", p - spec) == 0)
+		graph->shape = MEDIAMOCK_TREE;
+	else if (strncmp(spec, "mesh", p - spec) != 0)
+		return -EINVAL;
+
+	graph->entities = strtoul(p + 1, &end, 10);
+	if (*end == ':' && graph->fanout != 1)
+		graph->fanout = strtoul(end + 1, &end, 10);
+
+	if (*end != '\0' || graph->entities == 0 || graph->fanout == 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+int mediamock_setup(const struct mediamock_graph *graph)
+{
+	unsigned int entities = graph->entities;
+	unsigned int i;
+	__u32 id;
+
+	free(mock_active);
+	free(mock_formats);
+	mock_active = calloc(entities + 1, sizeof(*mock_active));
+	mock_formats = calloc((entities + 1) * 4, sizeof(*mock_formats));
+	if (mock_active == NULL || mock_formats == NULL) {
+		free(mock_active);
+		free(mock_formats);
+		mock_active = NULL;
+		mock_formats = NULL;
+		mock_graph.entities = 0;
+		return -ENOMEM;
+	}
+
+	mock_graph = *graph;
+	memset(&mock_stats, 0, sizeof(mock_stats));
+	mock_interval.numerator = 1;
+	mock_interval.denominator = MOCK_DEFAULT_FPS;
+
+	for (i = 0; i < (entities + 1) * 4; ++i) {
+		mock_formats[i].code = MOCK_DEFAULT_CODE;
+		mock_formats[i].width = MOCK_DEFAULT_WIDTH;
+		mock_formats[i].height = MOCK_DEFAULT_HEIGHT;
+		mock_formats[i].field = V4L2_FIELD_NONE;
+		mock_formats[i].colorspace = V4L2_COLORSPACE_SRGB;
+	}
+
+	for (id = 2; id <= entities; ++id)
+		mock_active[id] = mock_parent(id);
+
+	return 0;
+}
+
+void mediamock_stats(struct mediamock_stats *stats)
+{
+	*stats = mock_stats;
+	memset(&mock_stats, 0, sizeof(mock_stats));
+}
+
+/* -----------------------------------------------------------------------------
+ * Media device ioctls
+ */
+
+static int mock_enum_entities(struct media_entity_desc *desc)
+{
+	__u32 id = desc->id & MEDIA_ENT_ID_FLAG_NEXT
+		 ? (desc->id & ~MEDIA_ENT_ID_FLAG_NEXT) + 1 : desc->id;
+
+	mock_stats.enum_entities++;
+
+	if (id == 0 || id > mock_graph.entities) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(desc, 0, sizeof(*desc));
+	desc->id = id;
+	snprintf(desc->name, sizeof(desc->name), "entity %u", id);
+	desc->type = mock_is_video(id) ? MEDIA_ENT_T_DEVNODE_V4L
+		   : MEDIA_ENT_T_V4L2_SUBDEV;
+	desc->pads = mock_num_pads(id);
+	desc->links = mock_num_links(id);
+	desc->v4l.major = MOCK_MAJOR;
+	desc->v4l.minor = id;
+	return 0;
+}
+
+static int mock_enum_links(struct media_links_enum *links)
+{
+	__u32 id = links->entity;
+	__u32 sink;
+	unsigned int i;
+
+	mock_stats.enum_links++;
+
+	if (id == 0 || id > mock_graph.entities) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; links->pads && i < mock_num_pads(id); ++i) {
+		links->pads[i].entity = id;
+		links->pads[i].index = i;
+		links->pads[i].flags = i == mock_source_pad(id) && !mock_is_video(id)
+				     ? MEDIA_PAD_FL_SOURCE : MEDIA_PAD_FL_SINK;
+	}
+
+	sink = mock_first_child(id);
+	for (i = 0; links->links && i < mock_num_links(id); ++i, ++sink) {
+		struct media_link_desc *link = &links->links[i];
+
+		memset(link, 0, sizeof(*link));
+		link->source.entity = id;
+		link->source.index = mock_source_pad(id);
+		link->source.flags = MEDIA_PAD_FL_SOURCE;
+		link->sink.entity = sink;
+		link->sink.index = 0;
+		link->sink.flags = MEDIA_PAD_FL_SINK;
+		link->flags = mock_active[sink] == id ? MEDIA_LNK_FL_ENABLED : 0;
+	}
+
+	return 0;
+}
+
+static int mock_setup_link(struct media_link_desc *link)
+{
+	__u32 source = link->source.entity;
+	__u32 sink = link->sink.entity;
+
+	mock_stats.setup_link++;
+
+	if (!mock_has_link(source, sink) ||
+	    link->source.index != mock_source_pad(source) ||
+	    link->sink.index != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (link->flags & MEDIA_LNK_FL_ENABLED) {
+		if (mock_active[sink] != 0 && mock_active[sink] != source) {
+			errno = EBUSY;
+			return -1;
+		}
+		mock_active[sink] = source;
+	} else if (mock_active[sink] == source) {
+		mock_active[sink] = 0;
+	}
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Subdev ioctls
+ *
+ * Every size is accepted. Formats set on a sink pad are propagated to the
+ * source pad, the source pad format can't be changed.
+ */
+
+static int mock_check_pad(__u32 id, __u32 pad, __u32 which)
+{
+	if (pad >= mock_num_pads(id) || which > V4L2_SUBDEV_FORMAT_ACTIVE) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int mock_get_format(__u32 id, struct v4l2_subdev_format *fmt)
+{
+	mock_stats.get_format++;
+
+	if (mock_check_pad(id, fmt->pad, fmt->which) < 0)
+		return -1;
+
+	fmt->format = *mock_format(id, fmt->pad, fmt->which);
+	return 0;
+}
+
+static int mock_set_format(__u32 id, struct v4l2_subdev_format *fmt)
+{
+	mock_stats.set_format++;
+
+	if (mock_check_pad(id, fmt->pad, fmt->which) < 0)
+		return -1;
+
+	if (fmt->pad == 1) {
+		fmt->format = *mock_format(id, 0, fmt->which);
+		return 0;
+	}
+
+	*mock_format(id, 0, fmt->which) = fmt->format;
+	if (mock_num_pads(id) == 2)
+		*mock_format(id, 1, fmt->which) = fmt->format;
+
+	return 0;
+}
+
+static int mock_frame_interval(__u32 id, struct v4l2_subdev_frame_interval *fi,
+			       int set)
+{
+	if (id != 1 || fi->pad != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (set)
+		mock_interval = fi->interval;
+	else
+		fi->interval = mock_interval;
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * C library overrides
+ */
+
+static int mock_subdev_id(const char *path, __u32 *id)
+{
+	unsigned int n;
+
+	if (sscanf(path, "/dev/v4l-subdev%u", &n) != 1 &&
+	    sscanf(path, "/dev/video%u", &n) != 1)
+		return 0;
+
+	if (n == 0 || n > mock_graph.entities)
+		return 0;
+
+	*id = n;
+	return 1;
+}
+
+int open(const char *path, int flags, ...)
+{
+	static int (*real_open)(const char *, int, ...);
+	mode_t mode = 0;
+	__u32 id;
+	int fd;
+
+	if (flags & O_CREAT) {
+		va_list ap;
+
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+
+	if (real_open == NULL)
+		real_open = dlsym(RTLD_NEXT, "open");
+
+	if (!mock_subdev_id(path, &id))
+		return real_open(path, flags, mode);
+
+	fd = real_open("/dev/null", O_RDWR);
+	if (fd < 0)
+		return fd;
+
+	if ((unsigned int)fd >= mock_num_fds) {
+		unsigned int num = fd * 2 + 16;
+		__u32 *fds;
+
+		fds = realloc(mock_fds, num * sizeof(*fds));
+		if (fds == NULL) {
+			close(fd);
+			errno = ENOMEM;
+			return -1;
+		}
+
+		memset(fds + mock_num_fds, 0, (num - mock_num_fds) * sizeof(*fds));
+		mock_fds = fds;
+		mock_num_fds = num;
+	}
+
+	mock_fds[fd] = id;
+	return fd;
+}
+
+ssize_t readlink(const char *path, char *buf, size_t size)
+{
+	static ssize_t (*real_readlink)(const char *, char *, size_t);
+	unsigned int major, minor;
+
+	if (sscanf(path, "/sys/dev/char/%u:%u", &major, &minor) == 2 &&
+	    major == MOCK_MAJOR && minor > 0 && minor <= mock_graph.entities) {
+		int ret;
+
+		ret = snprintf(buf, size, "../../devices/mediamock/%s%u",
+			       mock_is_video(minor) ? "video" : "v4l-subdev",
+			       minor);
+		return ret < (int)size ? ret : (ssize_t)size;
+	}
+
+	if (real_readlink == NULL)
+		real_readlink = dlsym(RTLD_NEXT, "readlink");
+
+	return real_readlink(path, buf, size);
+}
+
+static int mock_stat(const char *path, struct stat *buf)
+{
+	__u32 id;
+
+	if (!mock_subdev_id(path, &id))
+		return 1;
+
+	memset(buf, 0, sizeof(*buf));
+	buf->st_mode = S_IFCHR | 0666;
+	buf->st_rdev = makedev(MOCK_MAJOR, id);
+	return 0;
+}
+
+int stat(const char *path, struct stat *buf)
+{
+	static int (*real_stat)(const char *, struct stat *);
+	int ret;
+
+	ret = mock_stat(path, buf);
+	if (ret <= 0)
+		return ret;
+
+	if (real_stat == NULL)
+		real_stat = dlsym(RTLD_NEXT, "stat");
+
+	return real_stat(path, buf);
+}
+
+/* C libraries older than glibc 2.33 implement stat() with __xstat(). */
+int __xstat(int ver, const char *path, struct stat *buf)
+{
+	static int (*real_xstat)(int, const char *, struct stat *);
+	int ret;
+
+	ret = mock_stat(path, buf);
+	if (ret <= 0)
+		return ret;
+
+	if (real_xstat == NULL)
+		real_xstat = dlsym(RTLD_NEXT, "__xstat");
+
+	return real_xstat(ver, path, buf);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	static int (*real_ioctl)(int, unsigned long, ...);
+	__u32 id = fd >= 0 && (unsigned int)fd < mock_num_fds ? mock_fds[fd] : 0;
+	va_list ap;
+	void *arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	switch (mock_graph.entities ? request : 0) {
+	case MEDIA_IOC_ENUM_ENTITIES:
+		return mock_enum_entities(arg);
+	case MEDIA_IOC_ENUM_LINKS:
+		return mock_enum_links(arg);
+	case MEDIA_IOC_SETUP_LINK:
+		return mock_setup_link(arg);
+	}
+
+	if (id != 0) {
+		switch (request) {
+		case VIDIOC_SUBDEV_G_FMT:
+			return mock_get_format(id, arg);
+		case VIDIOC_SUBDEV_S_FMT:
+			return mock_set_format(id, arg);
+		case VIDIOC_SUBDEV_G_FRAME_INTERVAL:
+			return mock_frame_interval(id, arg, 0);
+		case VIDIOC_SUBDEV_S_FRAME_INTERVAL:
+			return mock_frame_interval(id, arg, 1);
+		default:
+			errno = ENOTTY;
+			return -1;
+		}
+	}
+
+	if (real_ioctl == NULL)
+		real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+
+	return real_ioctl(fd, request, arg);
+}
+
+/*
+ * When preloaded, create the graph described by MEDIAMOCK_GRAPH and print the
+ * ioctl counters at exit if MEDIAMOCK_STATS is set.
+ */
+static void mock_report(void)
+{
+	fprintf(stderr, "mediamock: %u enum entities, %u enum links, "
+		"%u setup link, %u get format, %u set format\n",
+		mock_stats.enum_entities, mock_stats.enum_links,
+		mock_stats.setup_link, mock_stats.get_format,
+		mock_stats.set_format);
+}
+
+__attribute__((constructor)) static void mock_init(void)
+{
+	const char *spec = getenv("MEDIAMOCK_GRAPH");
+	struct mediamock_graph graph;
+
+	if (spec == NULL)
+		return;
+
+	if (mediamock_parse(&graph, spec) < 0 || mediamock_setup(&graph) < 0) {
+		fprintf(stderr, "mediamock: invalid graph '%s'\n", spec);
+		return;
+	}
+
+	if (getenv("MEDIAMOCK_STATS"))
+		atexit(mock_report);
+}
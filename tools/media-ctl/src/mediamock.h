@@ -0,0 +1,89 @@
+/*
+ * Synthetic media device
+ *
+ * Copyright (C) 2010 Ideas on board SPRL <laurent.pinchart@ideasonboard.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ */
+
+#ifndef __MEDIAMOCK_H__
+#define __MEDIAMOCK_H__
+
+/*
+ * The mock replaces open(), stat(), readlink() and ioctl() to serve a
+ * synthetic graph to libmediactl and libv4l2subdev: media_open() on any path
+ * enumerates it, subdev nodes accept the format and frame interval ioctls.
+ * Link it into a program, or preload mediamock.so with the graph in the
+ * MEDIAMOCK_GRAPH environment variable, see mediamock_parse().
+ *
+ * Entities are numbered from 1. Entity 1 only has a source pad, entities
+ * without outbound links are video nodes with a sink pad, all others are
+ * subdevs with sink pad 0 and source pad 1. A sink pad accepts a single
+ * enabled link.
+ */
+
+enum mediamock_shape {
+	/* Every entity links to the next fanout entities, the links to
+	 * the next entity are enabled.
+	 */
+	MEDIAMOCK_MESH,
+	/* Every entity links to fanout children, all links are enabled. */
+	MEDIAMOCK_TREE,
+};
+
+struct mediamock_graph {
+	enum mediamock_shape shape;
+	unsigned int entities;
+	unsigned int fanout;
+};
+
+struct mediamock_stats {
+	unsigned int enum_entities;
+	unsigned int enum_links;
+	unsigned int setup_link;
+	unsigned int get_format;
+	unsigned int set_format;
+};
+
+/**
+ * @brief Parse a graph description.
+ * @param graph - graph to fill.
+ * @param spec - description, "shape:entities[:fanout]".
+ *
+ * The shape is one of "chain" (a mesh with fanout 1), "mesh" and "tree", the
+ * fanout defaults to 3.
+ *
+ * @return Zero on success or -EINVAL if the description can't be parsed.
+ */
+int mediamock_parse(struct mediamock_graph *graph, const char *spec);
+
+/**
+ * @brief Create the graph served by the mock.
+ * @param graph - graph description.
+ *
+ * Replace the current graph, if any, with a new one with the default links
+ * enabled. All pads start at SGRBG10 1280x960 and the source at 30 fps, so
+ * printing and estimating an unconfigured graph reports real formats.
+ *
+ * @return Zero on success or a negative error code on failure.
+ */
+int mediamock_setup(const struct mediamock_graph *graph);
+
+/**
+ * @brief Get and reset the ioctl counters.
+ * @param stats - counters since the previous call or the graph creation.
+ */
+void mediamock_stats(struct mediamock_stats *stats);
+
+#endif /* __MEDIAMOCK_H__ */
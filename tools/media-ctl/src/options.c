@@ -33,16 +33,23 @@ struct media_options media_opts = {
 static void usage(const char *argv0, int verbose)
 {
 	printf("%s [options] device\n", argv0);
+	printf("    --connect socket	Send the commands to a media-ctl daemon instead of the device\n");
 	printf("-d, --device dev	Media device name (default: %s)\n", MEDIA_DEVNAME_DEFAULT);
+	printf("    --daemon socket	Keep the device open and serve commands on a UNIX socket\n");
 	printf("-e, --entity name	Print the device name associated with the given entity\n");
+	printf("    --estimate[=fps]	Report pixel rates and bandwidth along the active paths\n");
 	printf("-f, --set-format	Comma-separated list of formats to setup\n");
 	printf("    --get-format pad	Print the active format on a given pad\n");
 	printf("-h, --help		Show verbose help and exit\n");
 	printf("-i, --interactive	Modify links interactively\n");
 	printf("-l, --links		Comma-separated list of links descriptors to setup\n");
+	printf("    --limits file	Pixel rate and width limits for --estimate (default: OMAP3 ISP)\n");
 	printf("-p, --print-topology	Print the device topology (implies -v)\n");
 	printf("    --print-dot		Print the device topology as a dot graph (implies -v)\n");
 	printf("-r, --reset		Reset all links to inactive\n");
+	printf("    --restore-pipeline file	Apply the differences between a saved pipeline and the device\n");
+	printf("    --save-pipeline file	Save links, formats, crop rectangles and frame intervals\n");
+	printf("    --solve pipeline	Configure all formats along the active links of a pipeline\n");
 	printf("-v, --verbose		Be verbose\n");
 
 	if (!verbose)
@@ -57,6 +64,7 @@ static void usage(const char *argv0, int verbose)
 	printf("\tsize            = width, 'x', height ;\n");
 	printf("\tcrop            = '(', left, ',', top, ')', '/', size ;\n");
 	printf("\tframe interval  = numerator, '/', denominator ;\n");
+	printf("\tpipeline        = pad, '[', [ fcc, ' ', size ], ']', '->', pad, '[', fcc, ' ', size, ']' ;\n");
 	printf("where the fields are\n");
 	printf("\tentity number   Entity numeric identifier\n");
 	printf("\tentity name     Entity name (string) \n");
@@ -71,18 +79,32 @@ static void usage(const char *argv0, int verbose)
 
 #define OPT_PRINT_DOT		256
 #define OPT_GET_FORMAT		257
+#define OPT_SAVE_PIPELINE	258
+#define OPT_RESTORE_PIPELINE	259
+#define OPT_SOLVE		260
+#define OPT_ESTIMATE		261
+#define OPT_LIMITS		262
+#define OPT_DAEMON		263
+#define OPT_CONNECT		264
 
 static struct option opts[] = {
+	{"connect", 1, 0, OPT_CONNECT},
+	{"daemon", 1, 0, OPT_DAEMON},
 	{"device", 1, 0, 'd'},
 	{"entity", 1, 0, 'e'},
+	{"estimate", 2, 0, OPT_ESTIMATE},
 	{"set-format", 1, 0, 'f'},
 	{"get-format", 1, 0, OPT_GET_FORMAT},
 	{"help", 0, 0, 'h'},
 	{"interactive", 0, 0, 'i'},
+	{"limits", 1, 0, OPT_LIMITS},
 	{"links", 1, 0, 'l'},
 	{"print-dot", 0, 0, OPT_PRINT_DOT},
 	{"print-topology", 0, 0, 'p'},
 	{"reset", 0, 0, 'r'},
+	{"restore-pipeline", 1, 0, OPT_RESTORE_PIPELINE},
+	{"save-pipeline", 1, 0, OPT_SAVE_PIPELINE},
+	{"solve", 1, 0, OPT_SOLVE},
 	{"verbose", 0, 0, 'v'},
 };
 
@@ -143,6 +165,35 @@ int parse_cmdline(int argc, char **argv)
 			media_opts.pad = optarg;
 			break;
 
+		case OPT_SAVE_PIPELINE:
+			media_opts.save = optarg;
+			break;
+
+		case OPT_RESTORE_PIPELINE:
+			media_opts.restore = optarg;
+			break;
+
+		case OPT_SOLVE:
+			media_opts.solve = optarg;
+			break;
+
+		case OPT_ESTIMATE:
+			media_opts.estimate = 1;
+			media_opts.fps = optarg;
+			break;
+
+		case OPT_LIMITS:
+			media_opts.limits = optarg;
+			break;
+
+		case OPT_DAEMON:
+			media_opts.daemon = optarg;
+			break;
+
+		case OPT_CONNECT:
+			media_opts.connect = optarg;
+			break;
+
 		default:
 			printf("Invalid option -%c\n", opt);
 			printf("Run %s -h for help.\n", argv[0]);
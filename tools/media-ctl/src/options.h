@@ -27,11 +27,19 @@ struct media_options
 		     print:1,
 		     print_dot:1,
 		     reset:1,
-		     verbose:1;
+		     verbose:1,
+		     estimate:1;
 	const char *entity;
 	const char *formats;
 	const char *links;
 	const char *pad;
+	const char *save;
+	const char *restore;
+	const char *solve;
+	const char *fps;
+	const char *limits;
+	const char *daemon;
+	const char *connect;
 };
 
 extern struct media_options media_opts;
@@ -24,6 +24,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -186,3 +187,509 @@ int v4l2_subdev_set_frame_interval(struct media_entity *entity,
 	*interval = ival.interval;
 	return 0;
 }
+
+/* -----------------------------------------------------------------------------
+ * Sub-devices state
+ */
+
+static int v4l2_subdev_query_pad(struct media_entity *entity, unsigned int pad,
+	enum v4l2_subdev_format_whence which, struct v4l2_subdev_pad_state *state,
+	int crop)
+{
+	struct v4l2_subdev_format fmt;
+	struct v4l2_subdev_crop rect;
+
+	state->pad = &entity->pads[pad];
+	state->valid = 0;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.pad = pad;
+	fmt.which = which;
+	if (ioctl(entity->fd, VIDIOC_SUBDEV_G_FMT, &fmt) == 0) {
+		state->format = fmt.format;
+		state->valid |= V4L2_SUBDEV_STATE_FORMAT;
+	}
+
+	if (!crop)
+		return 0;
+
+	memset(&rect, 0, sizeof(rect));
+	rect.pad = pad;
+	rect.which = which;
+	if (ioctl(entity->fd, VIDIOC_SUBDEV_G_CROP, &rect) < 0)
+		return errno == ENOTTY ? -ENOTTY : 0;
+
+	state->crop = rect.rect;
+	state->valid |= V4L2_SUBDEV_STATE_CROP;
+	return 0;
+}
+
+int v4l2_subdev_get_pad_state(struct media_pad *pad,
+	enum v4l2_subdev_format_whence which, struct v4l2_subdev_pad_state *state)
+{
+	int ret;
+
+	memset(state, 0, sizeof(*state));
+	state->pad = pad;
+
+	ret = v4l2_subdev_open(pad->entity);
+	if (ret < 0)
+		return ret;
+
+	v4l2_subdev_query_pad(pad->entity, pad->index, which, state, 1);
+	return 0;
+}
+
+int v4l2_subdev_update_state(struct v4l2_subdev_state *state,
+	struct media_entity *entity)
+{
+	struct v4l2_subdev_entity_state *estate;
+	struct v4l2_subdev_frame_interval ival;
+	unsigned int i;
+	int crop = 1;
+	int ret;
+
+	estate = v4l2_subdev_state_entity(state, entity);
+	estate->valid = 0;
+	for (i = 0; i < entity->info.pads; ++i)
+		estate->pads[i].valid = 0;
+
+	if (media_entity_type(entity) != MEDIA_ENT_T_V4L2_SUBDEV)
+		return 0;
+
+	ret = v4l2_subdev_open(entity);
+	if (ret < 0)
+		return ret;
+
+	/* A sub-device without crop support fails with ENOTTY on every pad,
+	 * don't ask again.
+	 */
+	for (i = 0; i < entity->info.pads; ++i) {
+		if (v4l2_subdev_query_pad(entity, i, state->which,
+					  &estate->pads[i], crop) < 0)
+			crop = 0;
+	}
+
+	memset(&ival, 0, sizeof(ival));
+	if (ioctl(entity->fd, VIDIOC_SUBDEV_G_FRAME_INTERVAL, &ival) == 0) {
+		estate->interval = ival.interval;
+		estate->valid |= V4L2_SUBDEV_STATE_INTERVAL;
+	}
+
+	return 0;
+}
+
+struct v4l2_subdev_state *v4l2_subdev_get_state(struct media_device *media,
+	enum v4l2_subdev_format_whence which)
+{
+	struct v4l2_subdev_pad_state *pads;
+	struct v4l2_subdev_state *state;
+	unsigned int i;
+
+	state = calloc(1, sizeof(*state));
+	if (state == NULL)
+		return NULL;
+
+	state->media = media;
+	state->which = which;
+
+	for (i = 0; i < media->entities_count; ++i)
+		state->num_pads += media->entities[i].info.pads;
+
+	state->entities = calloc(media->entities_count, sizeof(*state->entities));
+	state->pads = calloc(state->num_pads, sizeof(*state->pads));
+	if (state->entities == NULL ||
+	    (state->pads == NULL && state->num_pads != 0)) {
+		v4l2_subdev_free_state(state);
+		return NULL;
+	}
+
+	for (i = 0, pads = state->pads; i < media->entities_count; ++i) {
+		struct media_entity *entity = &media->entities[i];
+		unsigned int j;
+
+		state->entities[i].entity = entity;
+		state->entities[i].pads = pads;
+		for (j = 0; j < entity->info.pads; ++j)
+			pads[j].pad = &entity->pads[j];
+		pads += entity->info.pads;
+
+		v4l2_subdev_update_state(state, entity);
+	}
+
+	return state;
+}
+
+void v4l2_subdev_free_state(struct v4l2_subdev_state *state)
+{
+	if (state == NULL)
+		return;
+
+	free(state->entities);
+	free(state->pads);
+	free(state);
+}
+
+struct v4l2_subdev_entity_state *v4l2_subdev_state_entity(
+	struct v4l2_subdev_state *state, struct media_entity *entity)
+{
+	return &state->entities[entity - state->media->entities];
+}
+
+struct v4l2_subdev_pad_state *v4l2_subdev_state_pad(
+	struct v4l2_subdev_state *state, struct media_pad *pad)
+{
+	return &v4l2_subdev_state_entity(state, pad->entity)->pads[pad->index];
+}
+
+/* -----------------------------------------------------------------------------
+ * Pipeline format solver
+ */
+
+struct v4l2_subdev_step {
+	struct media_pad *pad;
+	int crop;
+	struct v4l2_mbus_framefmt format;
+	struct v4l2_rect rect;
+};
+
+struct v4l2_subdev_solver {
+	struct media_pad **path;
+	unsigned int length;
+	struct v4l2_subdev_step *steps;
+	unsigned int num_steps;
+	int verbose;
+};
+
+static int v4l2_subdev_is_subdev(struct media_pad *pad)
+{
+	return media_entity_type(pad->entity) == MEDIA_ENT_T_V4L2_SUBDEV;
+}
+
+/*
+ * Depth first search along active links. The path alternates source and sink
+ * pads, starting with the source pad at index n. Return the path length, or 0
+ * if @end can't be reached.
+ */
+static unsigned int v4l2_subdev_find_path(struct media_pad **path,
+	unsigned int n, unsigned int max, struct media_pad *end)
+{
+	struct media_entity *entity = path[n]->entity;
+	unsigned int length;
+	unsigned int i, j;
+
+	if (path[n] == end)
+		return n + 1;
+
+	if (n + 2 >= max)
+		return 0;
+
+	for (i = 0; i < entity->num_links; ++i) {
+		struct media_link *link = &entity->links[i];
+		struct media_entity *sink;
+
+		if (link->source != path[n] ||
+		    !(link->flags & MEDIA_LNK_FL_ENABLED))
+			continue;
+
+		path[n + 1] = link->sink;
+		if (link->sink == end)
+			return n + 2;
+
+		if (!v4l2_subdev_is_subdev(link->sink))
+			continue;
+
+		sink = link->sink->entity;
+		for (j = 0; j < sink->info.pads; ++j) {
+			if (!(sink->pads[j].flags & MEDIA_PAD_FL_SOURCE))
+				continue;
+
+			path[n + 2] = &sink->pads[j];
+			length = v4l2_subdev_find_path(path, n + 2, max, end);
+			if (length)
+				return length;
+		}
+	}
+
+	return 0;
+}
+
+static int v4l2_subdev_same_format(const struct v4l2_mbus_framefmt *a,
+				   const struct v4l2_mbus_framefmt *b)
+{
+	return a->code == b->code && a->width == b->width &&
+	       a->height == b->height;
+}
+
+/*
+ * Set a try format and record it. The format is updated with the one the
+ * driver picked.
+ */
+static int v4l2_subdev_try_format(struct v4l2_subdev_solver *solver,
+	struct media_pad *pad, struct v4l2_mbus_framefmt *format)
+{
+	struct v4l2_subdev_step *step = &solver->steps[solver->num_steps];
+	int ret;
+
+	ret = v4l2_subdev_set_format(pad->entity, format, pad->index,
+				     V4L2_SUBDEV_FORMAT_TRY);
+	if (ret < 0)
+		return ret;
+
+	step->pad = pad;
+	step->crop = 0;
+	step->format = *format;
+	solver->num_steps++;
+	return 0;
+}
+
+static int v4l2_subdev_try_crop(struct v4l2_subdev_solver *solver,
+	struct media_pad *pad, struct v4l2_rect *rect)
+{
+	struct v4l2_subdev_step *step = &solver->steps[solver->num_steps];
+	int ret;
+
+	ret = v4l2_subdev_set_crop(pad->entity, rect, pad->index,
+				   V4L2_SUBDEV_FORMAT_TRY);
+	if (ret < 0)
+		return ret;
+
+	step->pad = pad;
+	step->crop = 1;
+	step->rect = *rect;
+	solver->num_steps++;
+	return 0;
+}
+
+/* The last recorded step is superseded by the next one on the same pad. */
+static void v4l2_subdev_drop_step(struct v4l2_subdev_solver *solver)
+{
+	solver->num_steps--;
+}
+
+/*
+ * Negotiate the format of source pad path[n], whose try format has been
+ * propagated from its sink pad (or seeded for the first pad).
+ */
+static int v4l2_subdev_solve_source(struct v4l2_subdev_solver *solver,
+	unsigned int n, struct v4l2_mbus_framefmt *format,
+	const struct v4l2_mbus_framefmt *output, int last)
+{
+	struct media_pad *pad = solver->path[n];
+	struct v4l2_mbus_framefmt propagated = *format;
+	struct v4l2_rect rect;
+	int ret;
+
+	if (!last) {
+		/* Convert to the output code as early as possible, but leave
+		 * scaling to the last subdev.
+		 */
+		if (format->code != output->code) {
+			format->code = output->code;
+			ret = v4l2_subdev_try_format(solver, pad, format);
+			if (ret == 0 && format->code == output->code &&
+			    format->width == propagated.width &&
+			    format->height == propagated.height)
+				return 0;
+			if (ret == 0)
+				v4l2_subdev_drop_step(solver);
+			*format = propagated;
+		}
+
+		ret = v4l2_subdev_try_format(solver, pad, format);
+		if (ret < 0)
+			goto error;
+		return 0;
+	}
+
+	*format = *output;
+	ret = v4l2_subdev_try_format(solver, pad, format);
+	if (ret == 0 && v4l2_subdev_same_format(format, output))
+		return 0;
+	if (ret == 0)
+		v4l2_subdev_drop_step(solver);
+
+	/* The subdev can't scale to the output size, try cropping. */
+	if (output->width > propagated.width || output->height > propagated.height)
+		goto error;
+
+	rect.left = (propagated.width - output->width) / 2 & ~1;
+	rect.top = (propagated.height - output->height) / 2 & ~1;
+	rect.width = output->width;
+	rect.height = output->height;
+	ret = v4l2_subdev_try_crop(solver, pad, &rect);
+	if (ret < 0)
+		goto error;
+
+	*format = *output;
+	ret = v4l2_subdev_try_format(solver, pad, format);
+	if (ret == 0 && v4l2_subdev_same_format(format, output))
+		return 0;
+
+error:
+	printf("%s: Pad %s/%u can't output 0x%04x %ux%u from 0x%04x %ux%u\n",
+		__func__, pad->entity->info.name, pad->index,
+		last ? output->code : propagated.code,
+		last ? output->width : propagated.width,
+		last ? output->height : propagated.height,
+		propagated.code, propagated.width, propagated.height);
+	return -EINVAL;
+}
+
+/*
+ * Sink pad path[n + 1] must take the format of source pad path[n] unmodified.
+ */
+static int v4l2_subdev_solve_sink(struct v4l2_subdev_solver *solver,
+	unsigned int n, const struct v4l2_mbus_framefmt *source)
+{
+	struct media_pad *pad = solver->path[n + 1];
+	struct v4l2_mbus_framefmt format = *source;
+	int ret;
+
+	ret = v4l2_subdev_try_format(solver, pad, &format);
+	if (ret == 0 && v4l2_subdev_same_format(&format, source))
+		return 0;
+
+	printf("%s: Pad %s/%u can't take 0x%04x %ux%u from %s/%u\n", __func__,
+		pad->entity->info.name, pad->index, source->code, source->width,
+		source->height, solver->path[n]->entity->info.name,
+		solver->path[n]->index);
+	return -EINVAL;
+}
+
+static int v4l2_subdev_solve(struct v4l2_subdev_solver *solver,
+	struct v4l2_mbus_framefmt *input, const struct v4l2_mbus_framefmt *output)
+{
+	unsigned int last = (solver->length - 1) & ~1U;
+	struct v4l2_mbus_framefmt format;
+	struct media_pad *pad;
+	unsigned int n;
+	int ret;
+
+	for (n = 0; n <= last; n += 2) {
+		pad = solver->path[n];
+
+		if (n == 0 && input != NULL && input->width != 0 && last != 0) {
+			/* An explicit start format must be accepted as is. */
+			format = *input;
+			ret = v4l2_subdev_try_format(solver, pad, &format);
+			if (ret < 0 || !v4l2_subdev_same_format(&format, input)) {
+				printf("%s: Pad %s/%u doesn't support 0x%04x %ux%u\n",
+					__func__, pad->entity->info.name,
+					pad->index, input->code, input->width,
+					input->height);
+				return -EINVAL;
+			}
+		} else {
+			/* The first pad starts from its active format, the
+			 * others from the format propagated from their sink.
+			 */
+			ret = v4l2_subdev_get_format(pad->entity, &format, pad->index,
+						     n == 0 ? V4L2_SUBDEV_FORMAT_ACTIVE
+						     : V4L2_SUBDEV_FORMAT_TRY);
+			if (ret < 0)
+				return ret;
+
+			ret = v4l2_subdev_solve_source(solver, n, &format, output,
+						       n == last);
+			if (ret < 0)
+				return ret;
+		}
+
+		if (n + 1 < solver->length && v4l2_subdev_is_subdev(solver->path[n + 1])) {
+			ret = v4l2_subdev_solve_sink(solver, n, &format);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int v4l2_subdev_commit(struct v4l2_subdev_solver *solver)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < solver->num_steps; ++i) {
+		struct v4l2_subdev_step *step = &solver->steps[i];
+		struct media_pad *pad = step->pad;
+		struct v4l2_mbus_framefmt format = step->format;
+		struct v4l2_rect rect = step->rect;
+
+		if (step->crop) {
+			ret = v4l2_subdev_set_crop(pad->entity, &rect, pad->index,
+						   V4L2_SUBDEV_FORMAT_ACTIVE);
+			if (ret == 0 && memcmp(&rect, &step->rect, sizeof(rect)))
+				ret = -EIO;
+		} else {
+			ret = v4l2_subdev_set_format(pad->entity, &format, pad->index,
+						     V4L2_SUBDEV_FORMAT_ACTIVE);
+			if (ret == 0 && !v4l2_subdev_same_format(&format, &step->format))
+				ret = -EIO;
+		}
+
+		if (ret < 0) {
+			printf("%s: Unable to apply the negotiated %s on pad %s/%u (%d)\n",
+				__func__, step->crop ? "crop rectangle" : "format",
+				pad->entity->info.name, pad->index, ret);
+			return ret;
+		}
+
+		if (!solver->verbose)
+			continue;
+
+		if (step->crop)
+			printf("Pad %s/%u: crop (%d,%d)/%ux%u\n",
+				pad->entity->info.name, pad->index, rect.left,
+				rect.top, rect.width, rect.height);
+		else
+			printf("Pad %s/%u: format 0x%04x %ux%u\n",
+				pad->entity->info.name, pad->index, format.code,
+				format.width, format.height);
+	}
+
+	return 0;
+}
+
+int v4l2_subdev_setup_pipeline(struct media_device *media,
+	struct media_pad *start, struct v4l2_mbus_framefmt *input,
+	struct media_pad *end, struct v4l2_mbus_framefmt *output, int verbose)
+{
+	struct v4l2_subdev_solver solver;
+	unsigned int max = 2 * media->entities_count + 1;
+	int ret;
+
+	if (!v4l2_subdev_is_subdev(start) ||
+	    !(start->flags & MEDIA_PAD_FL_SOURCE))
+		return -EINVAL;
+
+	memset(&solver, 0, sizeof(solver));
+	solver.verbose = verbose;
+	solver.path = malloc(max * sizeof(*solver.path));
+	/* A sink format, a crop rectangle and a source format per entity. */
+	solver.steps = malloc(2 * max * sizeof(*solver.steps));
+	if (solver.path == NULL || solver.steps == NULL) {
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	solver.path[0] = start;
+	solver.length = v4l2_subdev_find_path(solver.path, 0, max, end);
+	if (solver.length == 0) {
+		printf("%s: No active path from %s/%u to %s/%u\n", __func__,
+			start->entity->info.name, start->index,
+			end->entity->info.name, end->index);
+		ret = -EPIPE;
+		goto done;
+	}
+
+	ret = v4l2_subdev_solve(&solver, input, output);
+	if (ret == 0)
+		ret = v4l2_subdev_commit(&solver);
+
+done:
+	free(solver.path);
+	free(solver.steps);
+	return ret;
+}
@@ -22,7 +22,40 @@
 
 #include <linux/v4l2-subdev.h>
 
+struct media_device;
 struct media_entity;
+struct media_pad;
+
+#define V4L2_SUBDEV_STATE_FORMAT	(1 << 0)
+#define V4L2_SUBDEV_STATE_CROP		(1 << 1)
+#define V4L2_SUBDEV_STATE_INTERVAL	(1 << 2)
+
+struct v4l2_subdev_pad_state {
+	struct media_pad *pad;
+	unsigned int valid;		/* V4L2_SUBDEV_STATE_FORMAT and _CROP */
+	struct v4l2_mbus_framefmt format;
+	struct v4l2_rect crop;
+};
+
+struct v4l2_subdev_entity_state {
+	struct media_entity *entity;
+	unsigned int valid;		/* V4L2_SUBDEV_STATE_INTERVAL */
+	struct v4l2_fract interval;
+	struct v4l2_subdev_pad_state *pads;
+};
+
+/*
+ * Formats, crop rectangles and frame intervals of all subdevs of a media
+ * device. The entities array is indexed like the media device entities array,
+ * entities that are not subdevs have nothing valid.
+ */
+struct v4l2_subdev_state {
+	struct media_device *media;
+	enum v4l2_subdev_format_whence which;
+	struct v4l2_subdev_entity_state *entities;
+	struct v4l2_subdev_pad_state *pads;
+	unsigned int num_pads;
+};
 
 /**
  * @brief Open a sub-device.
@@ -158,5 +191,106 @@ int v4l2_subdev_get_frame_interval(struct media_entity *entity,
 int v4l2_subdev_set_frame_interval(struct media_entity *entity,
 	struct v4l2_fract *interval);
 
+/**
+ * @brief Retrieve the format and crop rectangle on a pad.
+ * @param pad - sub-device pad.
+ * @param which - identifier of the state to get.
+ * @param state - pad state to be filled.
+ *
+ * Fill @a state with the format and crop rectangle of @a pad, and flag the
+ * ones the sub-device reported as valid.
+ *
+ * @return 0 on success, or a negative error code if the sub-device can't be
+ * opened.
+ */
+int v4l2_subdev_get_pad_state(struct media_pad *pad,
+	enum v4l2_subdev_format_whence which, struct v4l2_subdev_pad_state *state);
+
+/**
+ * @brief Retrieve the state of all sub-devices.
+ * @param media - media device.
+ * @param which - identifier of the state to get.
+ *
+ * Gather the format and crop rectangle of every pad and the frame interval of
+ * every sub-device in one pass. Each device node is opened once and kept open,
+ * and crop rectangles are not queried further on a sub-device that doesn't
+ * implement them. Sub-devices that can't be opened are reported with nothing
+ * valid.
+ *
+ * The state must be freed with v4l2_subdev_free_state().
+ *
+ * @return A pointer to the state, or NULL if memory can't be allocated.
+ */
+struct v4l2_subdev_state *v4l2_subdev_get_state(struct media_device *media,
+	enum v4l2_subdev_format_whence which);
+
+/**
+ * @brief Refresh the state of a sub-device.
+ * @param state - state to update.
+ * @param entity - sub-device media entity.
+ *
+ * Query the state of @a entity again, after its configuration changed.
+ *
+ * @return 0 on success, or a negative error code if the sub-device can't be
+ * opened.
+ */
+int v4l2_subdev_update_state(struct v4l2_subdev_state *state,
+	struct media_entity *entity);
+
+/**
+ * @brief Free a sub-devices state.
+ * @param state - state returned by v4l2_subdev_get_state().
+ */
+void v4l2_subdev_free_state(struct v4l2_subdev_state *state);
+
+/**
+ * @brief Find the state of a sub-device.
+ * @param state - sub-devices state.
+ * @param entity - media entity.
+ *
+ * @return A pointer to the state of @a entity.
+ */
+struct v4l2_subdev_entity_state *v4l2_subdev_state_entity(
+	struct v4l2_subdev_state *state, struct media_entity *entity);
+
+/**
+ * @brief Find the state of a pad.
+ * @param state - sub-devices state.
+ * @param pad - media pad.
+ *
+ * @return A pointer to the state of @a pad.
+ */
+struct v4l2_subdev_pad_state *v4l2_subdev_state_pad(
+	struct v4l2_subdev_state *state, struct media_pad *pad);
+
+/**
+ * @brief Configure formats along a pipeline.
+ * @param media - media device.
+ * @param start - source pad at the start of the pipeline, usually a sensor.
+ * @param input - format on @a start, or NULL to keep the active format.
+ * @param end - pad at the end of the pipeline.
+ * @param output - format requested at @a end.
+ * @param verbose - whether to print the formats on the standard output.
+ *
+ * Follow the active links from @a start to @a end and configure the format of
+ * every pad on the way. Sink pads take the format of the source pad they are
+ * linked to. Intermediate source pads keep the format propagated from their
+ * sink pad, switching to the @a output media bus code when the subdev can
+ * convert to it. The last source pad of the pipeline is set to @a output,
+ * cropped to the requested size when the subdev can't scale to it.
+ *
+ * The whole pipeline is first negotiated on try formats, which are stored in
+ * the sub-devices file handles. The active formats are only touched once
+ * every pad accepted its format, so impossible pipelines are rejected with the
+ * hardware configuration left unmodified.
+ *
+ * @return 0 on success, or a negative error code on failure: -EPIPE when no
+ * path of active links leads from @a start to @a end, -EINVAL when a pad
+ * doesn't accept the format required by the pipeline.
+ */
+int v4l2_subdev_setup_pipeline(struct media_device *media,
+	struct media_pad *start, struct v4l2_mbus_framefmt *input,
+	struct media_pad *end, struct v4l2_mbus_framefmt *output, int verbose);
+
 #endif
 